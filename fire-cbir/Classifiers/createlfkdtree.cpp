@@ -21,11 +21,7 @@
 #include "getpot.hpp"
 #include "gzstream.hpp"
 #include "database.hpp"
-#ifdef HAVE_KDTREE_LIBRARY
-#include "knn_api.h"
-#else
-#warning "KDTREE LIBRARY NOT AVAILABLE. This program will not make any sense."
-#endif
+#include "localfeatureindex.hpp"
 
 
 using namespace std;
@@ -33,16 +29,18 @@ using namespace std;
 void USAGE() {
   cout << "USAGE: " << endl
        << "   createlfkdtree (--filelist <filelist>|--firefilelist <firefilelist>) --kdtree <treefile>" << endl
-       << "   creates a kdtree from the local feature files specified in filelist" << endl
+       << "   creates a forest of kd-trees from the local feature files specified in filelist" << endl
+       << "   to be used with globallocalfeaturedistance:TREE=<treefile>" << endl
        << "   Available options:" << endl
        << "     -h, --help       show this help and exit" << endl
+       << "     --trees <n>      number of trees, default 4" << endl
        << endl;
 }
 
 int main(int argc, char **argv) {
   GetPot cl(argc, argv);
-  char *ctmp;  
-  string kdtreefilename=cl.follow("tree.kdt","--kdtree");
+  string kdtreefilename=cl.follow("tree.lfi","--kdtree");
+  uint trees=cl.follow(4,"--trees");
   string filelistname;
   string filename;
   vector<string> filenames;
@@ -84,67 +82,27 @@ int main(int argc, char **argv) {
   if(cl.search(2,"--help","-h")) {USAGE(); exit(20);}
   
   if(!cl.search("--kdtree") || (!cl.search("--filelist") and !cl.search("--firefilelist"))) {USAGE(); exit(20);}
-#ifdef HAVE_KDTREE_LIBRARY  
-  LocalFeatures lf;
-  t_fvec* vectors=new t_fvec;
-  uint number=0;
-  uint dimchanges=0;
 
-  for(int i=0;i<filenames.size();++i) {
+  LocalFeatureIndex index;
+  LocalFeatures lf;
+  for(uint i=0;i<filenames.size();++i) {
     filename=filenames[i];
-    DBG(10) << "Consistency check for features from '" << filename << "'." << endl;
+    DBG(10) << "Loading " << filename << endl;
     lf=LocalFeatures();
-    lf.load(filename);
-    if(vectors->dim!=int(lf.dim())) {
-      vectors->dim=lf.dim();
-      DBG(10) << "Setting dim to " << vectors->dim << endl;
-      ++dimchanges;
+    if(!lf.load(filename)) {
+      ERR << "Cannot load local features from " << filename << ". Aborting." << endl;
+      exit(20);
+    }
+    if(!index.add(lf)) {
+      DBG(10) << "Probably not consistent: There have been local features of different dimensionalities: Exiting" << endl;
+      exit(10);
     }
-    number+=lf.size();
-  }
-  if(dimchanges==1) {
-    DBG(10) << "Loading " << number<< " local features of dimension " << vectors->dim << endl;
-  } else {
-    DBG(10) << "Probably not consistent: There have been local features of different dimensionalities: Exiting" << endl;
-    exit(10);
   }
+  DBG(10) << "Loaded " << index.size() << " local features of dimension " << index.dim() << endl;
 
-  
-  vectors->featvec=new float*[number];
-  vectors->labelvec=new char*[number];
-  vectors->nvectors=number;
-  int aktvec=0;
-  DBG(10) << "Consistency check finished. Now loading features." << endl;
-
-  for(int j=0;j<filenames.size();++j) {
-    filename=filenames[j];
-    DBG(10) << "Loading " << filename << " " << VAR(aktvec)<< endl;
-    lf=LocalFeatures();
-    lf.load(filename);
-    for(uint i=0;i<lf.size();++i) {
-      
-      vectors->featvec[aktvec]=new float[vectors->dim];
-      for(int j=0;j<vectors->dim;++j) {
-        vectors->featvec[aktvec][j]=lf[i][j];
-      }
-      ctmp=new char[lf.filename().size()+1];
-      strcpy(ctmp,lf.filename().c_str());
-      
-      vectors->labelvec[aktvec]=ctmp;
-      DBG(50) << "Copied filename: " <<vectors->labelvec[aktvec]<< endl;
-      ++aktvec;
-    }
-    DBG(30) << "aktvec=" << aktvec << endl;
+  DBG(10) << "Creating " << trees << " kd-trees from these data" << endl;
+  if(!index.build(trees) || !index.save(kdtreefilename)) {
+    exit(20);
   }
-  
-  t_knn_kdtree *kdt=(t_knn_kdtree *)malloc(1*sizeof(t_knn_kdtree)); 
-  
-  DBG(10) << "Creating kdtree from these data" << endl;
-  knn_kdtree_create(vectors,10,kdt);
-  DBG(10) << "Saving kdtree to " << kdtreefilename << endl;
-  char *fn=new char[kdtreefilename.size()];
-  strcpy(fn,kdtreefilename.c_str());
-  knn_kdtree_save(kdt,10,0,fn);
   DBG(10) << "cmdline was: " ; printCmdline(argc,argv);
-  #endif
 }
@@ -31,7 +31,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 using namespace std;
 
-#include "ScopeTimer.h"
+#include "profiler.hpp"
 
 EM::EM() {
   poolMode_=noPooling;
@@ -113,9 +113,7 @@ void EM::run(const DoubleVectorVector& inputdata, ResultVector &clusterInformati
 }
 
 void EM::run(const DoubleVectorVector& inputdata, ResultVector &clusterInformation, string filename) {
-#ifdef SCOPETIMER
-  ScopeTimer st1("EM::run");
-#endif
+  ProfileScope st1("EM::run");
 
   DBG(20) << " Starting " << endl;
   
@@ -152,10 +150,8 @@ void EM::run(const DoubleVectorVector& inputdata, ResultVector &clusterInformati
   
 
   
-#ifdef SCOPETIMER
 {
-   ScopeTimer st2("EM::run -> split iteration");
-#endif
+   ProfileScope st2("split");
   //--------------------------------------------------------------------
   // split iteration
   
@@ -242,10 +238,8 @@ void EM::run(const DoubleVectorVector& inputdata, ResultVector &clusterInformati
 
       DBGI(200,{ostringstream filenames(""); filenames << "aftersplit-" << split<<".clustermodel";saveModel(filenames.str());});
 
-#ifdef SCOPETIMER
 {
-   ScopeTimer st3("EM::run -> reestimate iterations");
-#endif
+   ProfileScope st3("reestimate");
       //-----------------------------------------------
       //reestimate iterations
       nOfClusters=clusters_.size();
@@ -259,10 +253,8 @@ void EM::run(const DoubleVectorVector& inputdata, ResultVector &clusterInformati
 	
         DBG(25) << "Reassigning" <<endl;
 
-#ifdef SCOPETIMER
 {
-   ScopeTimer st4("EM::run -> reassigning the features");
-#endif
+   ProfileScope st4("reassign");
         //-----------------------------------------------
         //reassigning the features to the clusters
         
@@ -278,9 +270,6 @@ void EM::run(const DoubleVectorVector& inputdata, ResultVector &clusterInformati
 #pragma omp for
         for(int i=0;i<ids;++i)
         {
-#ifdef SCOPETIMER
-ScopeTimer st6("EM::run -> reassigning the features - for");
-#endif
 
           DoubleVector dists;
           int bestCluster=classify(inputdata[i],clusters_,dists);
@@ -301,9 +290,7 @@ ScopeTimer st6("EM::run -> reassigning the features - for");
         }
 #endif
 
-#ifdef SCOPETIMER
 }
-#endif
 
         DBG(15)  <<"#(Clusters):" << clusters_.size() << " after: "<< split+1 << "/" << maxSplits_ << " splits, " << reestimation+1 << "/" <<iterationsBetweenSplits_ << " reestimations." << endl;
         for(vector<GaussianDensity>::iterator aktClust=clusters_.begin();aktClust<clusters_.end();++aktClust) {
@@ -311,10 +298,8 @@ ScopeTimer st6("EM::run -> reassigning the features - for");
         }
         
 
-#ifdef SCOPETIMER
 {
-   ScopeTimer st5("EM::run -> reestimation");
-#endif
+   ProfileScope st5("reestimation");
         //check whether there are any clusters which are to small
         DBG(25) << "Deleting too small clusters" << endl;
         deleteToSmallClusters(clusters_,clusterInformation);
@@ -343,15 +328,11 @@ ScopeTimer st6("EM::run -> reassigning the features - for");
 
 	DBGI(200,{ostringstream filenames("");filenames << filename <<  "-aftersplit-" << split << ".clustermodel"; saveModel(filenames.str());});
 
-#ifdef SCOPETIMER
 }
-#endif
 
       }
 
-#ifdef SCOPETIMER
 }
-#endif
 
     } else {
       DBG(15) << "stopWithNClusters=" << stopWithNClusters_ << " reached." << endl;
@@ -359,9 +340,7 @@ ScopeTimer st6("EM::run -> reassigning the features - for");
 
   }
 
-#ifdef SCOPETIMER
 }
-#endif
  
   DBG(25) << " ending" << endl;
 }
@@ -41,11 +41,11 @@ public:
   
   ::std::string getTime() {
     char buffer[40];
-    struct tm *TM;
+    struct tm TM;
     time_t t;
     time(&t);
-    TM=localtime(&t);
-    strftime(buffer,40,"%Y-%m-%d %H:%M:%S",TM);
+    localtime_r(&t,&TM); // the server logs from several threads
+    strftime(buffer,40,"%Y-%m-%d %H:%M:%S",&TM);
     ::std::string result(buffer);
     return result;
   }
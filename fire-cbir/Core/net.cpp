@@ -18,6 +18,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <cerrno>
 #include <errno.h>
+#include <sys/time.h>
 #include "net.hpp"
 using namespace std;
 
@@ -116,6 +117,10 @@ const int &ServerSocket::port() const {
 int &ServerSocket::port() {
   return port_;
 }
+
+const int &ServerSocket::listenerFilePointer() const {
+  return listenerFilePointer_;
+}
   
 
 //////////////////////////////////////////////////////////////////////
@@ -148,16 +153,19 @@ void Socket::connect(string host, int port) {
   struct hostent *hostlookup;
   connected_=true;
 
+  socketPointer_=-1;
   hostlookup=gethostbyname(host.c_str());
   if(hostlookup==NULL) {
     ERR << "Cannot lookup host '"<< host<<"'." << ::std::endl;
     connected_=false;
+    return;
   }
     
   socketPointer_=socket(AF_INET,SOCK_STREAM,0);
   if(socketPointer_<0) {
     ERR << "Problem allocation socket" << ::std::endl;
     connected_=false;
+    return;
   }
   socketAddress_->sin_family=AF_INET;
   memcpy(&(socketAddress_->sin_addr), hostlookup->h_addr, hostlookup->h_length);
@@ -171,6 +179,14 @@ void Socket::connect(string host, int port) {
   }
 }
   
+void Socket::setTimeout(uint milliseconds) {
+  struct timeval tv;
+  tv.tv_sec=milliseconds/1000;
+  tv.tv_usec=(milliseconds%1000)*1000;
+  setsockopt(socketPointer_,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));
+  setsockopt(socketPointer_,SOL_SOCKET,SO_SNDTIMEO,&tv,sizeof(tv));
+}
+
 const bool Socket::connected() const {
   return connected_;
 }
@@ -287,6 +303,37 @@ void Socket::send(string text) {
   }
 }
   
+bool Socket::sendBytes(const char *data, size_t size) {
+  while(size>0) {
+    ssize_t res=write(socketPointer_,data,size);
+    if(res<0 && errno==EINTR) continue;
+    if(res<=0) {
+      ERR << "Error in sendBytes: " << strerror(errno) << ::std::endl;
+      return false;
+    }
+    data+=res;
+    size-=res;
+  }
+  return true;
+}
+
+bool Socket::receiveBytes(char *buffer, size_t size) {
+  while(size>0) {
+    ssize_t res=read(socketPointer_,buffer,size);
+    if(res<0 && errno==EINTR) continue;
+    if(res<0) {
+      ERR << "Error in receiveBytes: " << strerror(errno) << ::std::endl;
+      return false;
+    }
+    if(res==0) {
+      return false;
+    }
+    buffer+=res;
+    size-=res;
+  }
+  return true;
+}
+
 string Socket::receive() {
   char received[1024];
   string result;
@@ -87,6 +87,17 @@ public:
   ///receive a ::std::string from the other side of the socket.
   ::std::string receive();
 
+  ///send exactly size bytes. returns false if the connection broke.
+  bool sendBytes(const char *data, size_t size);
+
+  ///receive exactly size bytes into buffer. returns false if the
+  ///connection was closed or broke before.
+  bool receiveBytes(char *buffer, size_t size);
+
+  ///let reading and writing fail after waiting for the given time
+  ///instead of blocking forever.
+  void setTimeout(uint milliseconds);
+
   ///return true, if the socket is connected.
   const bool connected() const ;
     
@@ -168,6 +179,8 @@ public:
     
   /** Return true, if the server socket is listening for connections. */
   const bool listening() const;
+  ///return the file descriptor of the listener, e.g. to poll it.
+  const int &listenerFilePointer() const;
     
 private:
   int listenerFilePointer_;
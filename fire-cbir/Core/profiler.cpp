@@ -0,0 +1,237 @@
+/*
+  This file is part of the FIRE -- Flexible Image Retrieval System
+
+  FIRE is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  FIRE is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FIRE; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <cstdio>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "profiler.hpp"
+#include "diag.hpp"
+
+using namespace std;
+
+/// one scope of one thread, node 0 of each thread is the root
+struct ProfileNode {
+  const char* name;
+  uint parent;
+  uint64_t calls, nanoseconds;
+  vector<uint> children;
+
+  ProfileNode(const char* n, uint p) : name(n), parent(p), calls(0), nanoseconds(0), children() {}
+};
+
+/// the data of one thread. The thread itself changes it only holding
+/// lock, report() reads it holding lock.
+struct ProfileThread {
+  pthread_mutex_t lock;
+  vector<ProfileNode> nodes;
+  uint current;
+  map<string,uint64_t> counters;
+
+  ProfileThread() : nodes(1, ProfileNode("", 0)), current(0), counters() {
+    pthread_mutex_init(&lock, NULL);
+  }
+};
+
+namespace {
+  volatile bool profilingEnabled=true;
+
+  pthread_mutex_t threadsLock=PTHREAD_MUTEX_INITIALIZER;
+  /// the data of all threads that ever collected something, never freed
+  /// such that threads which have ended are still reported
+  vector<ProfileThread*> profileThreads;
+  __thread ProfileThread* currentThread=NULL;
+
+  string dumpFilename;
+  uint dumpSeconds=0;
+  bool dumpRunning=false;
+
+  ProfileThread* thisThread() {
+    if(!currentThread) {
+      currentThread=new ProfileThread();
+      pthread_mutex_lock(&threadsLock);
+      profileThreads.push_back(currentThread);
+      pthread_mutex_unlock(&threadsLock);
+    }
+    return currentThread;
+  }
+
+  string path(const vector<ProfileNode>& nodes, uint node) {
+    string result=nodes[node].name;
+    for(uint n=nodes[node].parent;n!=0;n=nodes[n].parent) {
+      result=string(nodes[n].name)+"/"+result;
+    }
+    return result;
+  }
+
+  void* dumpProcess(void*) {
+    while(true) {
+      pthread_mutex_lock(&threadsLock);
+      const string filename=dumpFilename;
+      const uint seconds=dumpSeconds;
+      pthread_mutex_unlock(&threadsLock);
+      sleep(seconds);
+
+      // written to a temporary file first, readers never see half a report
+      const string tmpname=filename+".tmp";
+      ofstream ofs(tmpname.c_str());
+      ofs << Profiler::report();
+      ofs.close();
+      if(!ofs || rename(tmpname.c_str(), filename.c_str())!=0) {
+        ERR << "Cannot write profile to " << filename << endl;
+      }
+    }
+    return NULL;
+  }
+}
+
+uint64_t Profiler::now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec)*1000000000ull+ts.tv_nsec;
+}
+
+void Profiler::enable(bool on) {
+  profilingEnabled=on;
+}
+
+bool Profiler::enabled() {
+  return profilingEnabled;
+}
+
+void Profiler::count(const string& name, uint64_t n) {
+  if(!profilingEnabled) return;
+  ProfileThread* thread=thisThread();
+  pthread_mutex_lock(&thread->lock);
+  thread->counters[name]+=n;
+  pthread_mutex_unlock(&thread->lock);
+}
+
+string Profiler::report(const string& separator) {
+  map<string, pair<uint64_t,uint64_t> > scopes;
+  map<string,uint64_t> counters;
+  pthread_mutex_lock(&threadsLock);
+  for(uint t=0;t<profileThreads.size();++t) {
+    ProfileThread* thread=profileThreads[t];
+    pthread_mutex_lock(&thread->lock);
+    for(uint n=1;n<thread->nodes.size();++n) {
+      const ProfileNode& node=thread->nodes[n];
+      if(node.calls>0) {
+        pair<uint64_t,uint64_t>& scope=scopes[path(thread->nodes, n)];
+        scope.first+=node.calls;
+        scope.second+=node.nanoseconds;
+      }
+    }
+    for(map<string,uint64_t>::const_iterator i=thread->counters.begin();i!=thread->counters.end();++i) {
+      counters[i->first]+=i->second;
+    }
+    pthread_mutex_unlock(&thread->lock);
+  }
+  pthread_mutex_unlock(&threadsLock);
+
+  ostringstream os;
+  os << setiosflags(ios::fixed) << setprecision(6);
+  bool first=true;
+  for(map<string, pair<uint64_t,uint64_t> >::const_iterator i=scopes.begin();i!=scopes.end();++i) {
+    if(!first) os << separator;
+    first=false;
+    os << "scope " << i->first << " calls " << i->second.first << " seconds " << i->second.second*1e-9;
+  }
+  for(map<string,uint64_t>::const_iterator i=counters.begin();i!=counters.end();++i) {
+    if(!first) os << separator;
+    first=false;
+    os << "counter " << i->first << " " << i->second;
+  }
+  return os.str();
+}
+
+void Profiler::reset() {
+  pthread_mutex_lock(&threadsLock);
+  for(uint t=0;t<profileThreads.size();++t) {
+    ProfileThread* thread=profileThreads[t];
+    pthread_mutex_lock(&thread->lock);
+    for(uint n=0;n<thread->nodes.size();++n) {
+      thread->nodes[n].calls=0;
+      thread->nodes[n].nanoseconds=0;
+    }
+    thread->counters.clear();
+    pthread_mutex_unlock(&thread->lock);
+  }
+  pthread_mutex_unlock(&threadsLock);
+}
+
+bool Profiler::startDump(const string& filename, uint seconds) {
+  pthread_mutex_lock(&threadsLock);
+  dumpFilename=filename;
+  dumpSeconds=max(1u, seconds);
+  bool ok=true;
+  if(!dumpRunning) {
+    pthread_t thr;
+    int errcode=pthread_create(&thr, NULL, dumpProcess, NULL);
+    if(errcode!=0) {
+      ERR << "Cannot start thread writing the profile: " << strerror(errcode) << endl;
+      ok=false;
+    } else {
+      pthread_detach(thr);
+      dumpRunning=true;
+    }
+  }
+  pthread_mutex_unlock(&threadsLock);
+  return ok;
+}
+
+ProfileScope::ProfileScope(const char* name) : thread_(NULL), node_(0), parent_(0), start_(0) {
+  if(!profilingEnabled) return;
+  thread_=thisThread();
+  parent_=thread_->current;
+
+  // only this thread adds nodes, it may look for them without the lock
+  const vector<uint>& children=thread_->nodes[parent_].children;
+  for(uint i=0;i<children.size() && node_==0;++i) {
+    const char* childName=thread_->nodes[children[i]].name;
+    if(childName==name || strcmp(childName,name)==0) {
+      node_=children[i];
+    }
+  }
+  if(node_==0) {
+    pthread_mutex_lock(&thread_->lock);
+    node_=thread_->nodes.size();
+    thread_->nodes.push_back(ProfileNode(name, parent_));
+    thread_->nodes[parent_].children.push_back(node_);
+    pthread_mutex_unlock(&thread_->lock);
+  }
+  thread_->current=node_;
+  start_=Profiler::now();
+}
+
+ProfileScope::~ProfileScope() {
+  if(!thread_) return;
+  const uint64_t elapsed=Profiler::now()-start_;
+  pthread_mutex_lock(&thread_->lock);
+  ProfileNode& node=thread_->nodes[node_];
+  ++node.calls;
+  node.nanoseconds+=elapsed;
+  pthread_mutex_unlock(&thread_->lock);
+  thread_->current=parent_;
+}
@@ -0,0 +1,81 @@
+/*
+  This file is part of the FIRE -- Flexible Image Retrieval System
+
+  FIRE is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  FIRE is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FIRE; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __profiler_hpp__
+#define __profiler_hpp__
+
+#include <string>
+#include <stdint.h>
+
+struct ProfileThread;
+
+/** Profiler: time spent in named scopes and named counters, collected
+    without locks shared between threads.
+
+    Every thread accumulates into its own data, report() merges the
+    data of all threads. Scopes are hierarchical: a scope entered
+    while another one is active on the same thread is reported as
+    "outer/inner". Scopes entered by the threads of a parallel region
+    have no parent on the other threads, put them around the region
+    instead. Names must not contain white space.
+
+    The report has one entry per line:
+      scope <path> calls <n> seconds <s>
+      counter <name> <value>
+ */
+class Profiler {
+public:
+  /// switch collecting on or off, it is on by default
+  static void enable(bool on);
+  static bool enabled();
+
+  /// add n to the counter name
+  static void count(const ::std::string& name, uint64_t n=1);
+
+  /// the merged data of all threads, entries separated by separator
+  static ::std::string report(const ::std::string& separator="\n");
+
+  /// set all times and counters to zero
+  static void reset();
+
+  /// write the report to filename every seconds seconds from a
+  /// background thread. Returns false if the thread cannot be started.
+  static bool startDump(const ::std::string& filename, uint seconds);
+
+  /// nanoseconds of a monotonic clock
+  static uint64_t now();
+};
+
+/// measures the time from construction to destruction in the scope name
+class ProfileScope {
+private:
+  ProfileThread* thread_;
+  uint node_, parent_;
+  uint64_t start_;
+
+  // not copyable
+  ProfileScope(const ProfileScope&);
+  ProfileScope& operator=(const ProfileScope&);
+
+public:
+  /// name has to live as long as the program, e.g. a string literal
+  ProfileScope(const char* name);
+  ~ProfileScope();
+};
+
+#endif
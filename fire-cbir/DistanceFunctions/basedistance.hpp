@@ -72,9 +72,29 @@ public:
   virtual ::std::string name() {return "base";}
   virtual ~BaseDistance() {}
   virtual double distance(const BaseFeature*, const BaseFeature*) {return 0.0;}
+  /** compare one query feature with count database features and write
+      the distances to result[0..count-1]. Distances that can save work
+      by seeing many database features at once (e.g. casting the query
+      only once) override this; by default distance is called for each. */
+  virtual void distances(const BaseFeature* queryFeature, const BaseFeature* const* databaseFeatures, uint count, double* result) {
+    for(uint n=0;n<count;++n) {
+      result[n]=distance(queryFeature, databaseFeatures[n]);
+    }
+  }
   virtual void initialize(Database &, uint) {};
   virtual void start(const BaseFeature*) {}
   virtual void stop(){}
+  /** whether this distance can be used by several queries at the same
+      time. Distances which keep information about the current query
+      between start() and stop() or which are changed by tune() return
+      false, the server then runs queries using them one at a time. */
+  virtual bool reentrant() const {return true;}
+  /** a new distance with the same settings for the queries of another
+      thread, which shares what initialize() prepared with this one and
+      therefore must not outlive it. The ImageComparator gives each
+      thread such a copy of the distances which are not reentrant.
+      Returns NULL if the distance cannot be copied. */
+  virtual BaseDistance* clone() const {return NULL;}
     /** tune the parameters of the distance function given a set of positive and negative queries, e.g. after relevance feedback. */
   virtual void tune(const std::vector<const BaseFeature*>&, const std::vector<const BaseFeature*>&) {}
 };
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "vectorfeature.hpp"
 #include "diag.hpp"
 #include "basedistance.hpp"
+#include "vectorkernels.hpp"
 #include <iostream>
 
 class ArccosFidelityDistance : public BaseDistance {
@@ -49,6 +50,14 @@ public:
     }
   }
 
+  static double kernel(const double* q, const double* d, uint dim) {
+    return 2.0/M_PI*acos(VectorKernels::fidelity(q, d, dim));
+  }
+
+  virtual void distances(const BaseFeature* queryFeature, const BaseFeature* const* databaseFeatures, uint count, double* result) {
+    batchVectorDistances(*this, kernel, queryFeature, databaseFeatures, count, result);
+  }
+
   virtual ::std::string name() {return "arccosfidelity";}
   virtual void start(const BaseFeature *) {}
   virtual void stop(){}
@@ -17,6 +17,26 @@ void BM25Distance::start(const BaseFeature * queryFeature) {
 	//compute score for query Image for GIFT-TFIDF normalization
 	queryScore_=scoreFeatureSet(queryFeature_);
 
+	//accumulate the scores of all database features sharing bins with the query
+	const BM25Distance* idx=index();
+	vector<double> scores(idx->documentFeatures_.size(), 0.0);
+	for (MapTypeDouble::iterator i=queryMap_.begin(); i!=queryMap_.end(); i++) {
+		MapTypeInt::const_iterator t=idx->terms_.find(i->first);
+		if (t==idx->terms_.end())
+			continue;
+		const double idf=collectionFrequency(i->first);
+		const double wtq=(k3_+1)*i->second/(k3_+i->second);
+		const vector<Posting>& postings=idx->postings_[t->second];
+		for (uint p=0; p<postings.size(); ++p) {
+			const uint d=postings[p].document;
+			double wtd=(idf*(k1_+1)*postings[p].value/(idx->documentK_[d]+postings[p].value));
+			scores[d]+=wtd*wtq;
+		}
+	}
+	queryDistances_.resize(scores.size());
+	for (uint d=0; d<scores.size(); ++d) {
+		queryDistances_[d]=1-scores[d]/(queryLength_*idx->documentLengths_[d]);
+	}
 }
 
 //score a featureset according to some scoring function
@@ -33,10 +53,10 @@ double BM25Distance::scoreFeatureSet(const SparseHistogramFeature * featureset)
 double BM25Distance::scoreFeature(const SparseHistogramFeature *featureset,
 		MapTypeDouble::iterator F, MapTypeDouble::iterator Q) {
 
-	double cf=collectionFrequencies_[F->first];
+	double cf=collectionFrequency(F->first);
 	double idf=cf;//log((dataBaseSize_-cf+0.5)/(cf+0.5));
 
-	double K=k1_*((1-b_)+b_*featureset->length()/avgDL_);
+	double K=k1_*((1-b_)+b_*featureset->length()/index()->avgDL_);
 	double result=idf*(k1_+1)*F->second*(k3_+1)*Q->second/((K+F->second)*(k3_
 			+Q->second));
 
@@ -46,6 +66,9 @@ double BM25Distance::scoreFeature(const SparseHistogramFeature *featureset,
 double BM25Distance::distance(const BaseFeature* queryFeature,
 		const BaseFeature* databaseFeature) {
 	double result=0.0;
+	if (indexedDistance(queryFeature, databaseFeature, result))
+		return result;
+
 	const SparseHistogramFeature * data=
 			dynamic_cast<const SparseHistogramFeature*>(databaseFeature);
 
@@ -60,9 +83,9 @@ double BM25Distance::distance(const BaseFeature* queryFeature,
 		if (j!=databaseMap.end()) {
 			double tmp;
 			if (true) {
-				double cf=collectionFrequencies_[j->first];
+				double cf=collectionFrequency(j->first);
 				double idf=cf;
-				double K=k1_*((1-b_)+b_*data->length()/avgDL_);
+				double K=k1_*((1-b_)+b_*data->length()/index()->avgDL_);
 				double wtq=(k3_+1)*i->second/(k3_+i->second);
 				double wtd=(idf*(k1_+1)*j->second/(K+j->second));
 				tmp=wtd*wtq;
@@ -100,4 +123,11 @@ void BM25Distance::initialize(Database &db, uint distanceIndex) {
 	}
 	avgDL_/=dataBaseSize_;
 
+	documentK_.resize(documentFeatures_.size());
+	documentLengths_.resize(documentFeatures_.size());
+	for (uint d=0; d<documentFeatures_.size(); ++d) {
+		documentK_[d]=k1_*((1-b_)+b_*documentFeatures_[d]->length()/avgDL_);
+		documentLengths_[d]=getLength(documentFeatures_[d]->getMap());
+	}
+
 }
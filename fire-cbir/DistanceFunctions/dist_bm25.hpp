@@ -45,14 +45,27 @@ public:
 
   virtual void start(const BaseFeature * queryFeature);
 
+  //a distance for the queries of another thread using the index and document lengths of this one
+  virtual BaseDistance* clone() const {
+    BM25Distance* result=new BM25Distance(k1_,k3_,b_);
+    result->index_=index_;
+    return result;
+  }
+
 private:
 
+  //the distance holding the index, see TFIDFDistance::index_
+  const BM25Distance* index() const {return static_cast<const BM25Distance*>(index_);}
+
   //bm25 parameters
   double k1_,k3_,b_;
 
   //average document length
   double avgDL_;
 
+  //the BM25 length normalization K and the euclidean length of each indexed document
+  ::std::vector<double> documentK_, documentLengths_;
+
   //scoring function
   double scoreFeature(const SparseHistogramFeature * featureset, MapTypeDouble::iterator F, MapTypeDouble::iterator Q);
   double scoreFeatureSet(const SparseHistogramFeature * featureset);
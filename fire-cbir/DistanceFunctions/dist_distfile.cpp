@@ -27,15 +27,41 @@
 
 using namespace std;
 
-DistanceFileDistance::DistanceFileDistance(const ::std::string& sname, bool clearing) :  currentLine_(0), clearing_(clearing) {
+DistanceFileDistance::DistanceFileDistance(const ::std::string& sname, bool clearing) :  scoringName_(sname), queryFeat_(NULL), loadedFeat_(NULL), currentLine_(0), clearing_(clearing) {
     scoring_=getScoring(sname, 0);
 }
 
+void DistanceFileDistance::start(const BaseFeature *q) {
+    currentLine_=0;
+    delete loadedFeat_;
+    loadedFeat_=NULL;
+    DistanceFileFeature *query=dynamic_cast<DistanceFileFeature*>(const_cast<BaseFeature *>(q));
+    queryFeat_=query;
+    if(clearing_) {
+        // the query feature is shared with the queries of other
+        // threads, it is only read by them
+        if(not query->loaded()) {
+            loadedFeat_=query->clone();
+            loadedFeat_->loadYourself();
+            queryFeat_=loadedFeat_;
+        }
+    } else {
+#pragma omp critical(distanceFileLoad)
+        if(not query->loaded()) {
+            query->loadYourself();
+        }
+    }
+}
+
 
  double DistanceFileDistance::distance(const BaseFeature* queryFeature, const BaseFeature* databaseFeature) {
     
     const DistanceFileFeature* db=dynamic_cast<const DistanceFileFeature*>(databaseFeature);
     const DistanceFileFeature* query=dynamic_cast<const DistanceFileFeature*>(queryFeature);
+    // the distances of the started query may have been loaded into a copy
+    if (query && loadedFeat_) {
+        query=loadedFeat_;
+    }
     
     if (db && query) {
         //find the right line in the queryFeature
@@ -25,8 +25,12 @@
 
 class DistanceFileDistance : public BaseDistance {
 private:
+    ::std::string scoringName_;
     BaseScoring *scoring_;
-    DistanceFileFeature *queryFeat_;
+    const DistanceFileFeature *queryFeat_;
+    /// the copy of the query feature loaded in start() if the
+    /// distances are cleared after each query, deleted in stop()
+    DistanceFileFeature *loadedFeat_;
 
     uint currentLine_;
     bool clearing_;
@@ -36,6 +40,7 @@ public:
     DistanceFileDistance(const ::std::string& sname="linear", bool clearing=true);
 
     virtual ~DistanceFileDistance() {
+        delete loadedFeat_;
         delete scoring_;
     }
     
@@ -45,18 +50,23 @@ public:
         return "distfile";
     }
     
-    virtual void start(const BaseFeature *q) {
-        currentLine_=0;
-        queryFeat_=dynamic_cast<DistanceFileFeature*>(const_cast<BaseFeature *>(q));
-        if(not queryFeat_->loaded()) {
-            queryFeat_->loadYourself();
-        }
-    }
+    /// loads the distances of the query. If they are cleared after
+    /// the query, they are loaded into a copy of the query feature,
+    /// otherwise into the query feature itself which keeps them for
+    /// later queries.
+    virtual void start(const BaseFeature *q);
 
     virtual void stop() {
-        if(clearing_) {
-            queryFeat_->clear();
-        }
+        delete loadedFeat_;
+        loadedFeat_=NULL;
+        queryFeat_=NULL;
+    }
+
+    /// the distances are read line by line from the query's file
+    virtual bool reentrant() const {return false;}
+
+    virtual BaseDistance* clone() const {
+        return new DistanceFileDistance(scoringName_, clearing_);
     }
 };
 
@@ -1,83 +1,85 @@
 #include "dist_globallocalfeaturedistance.hpp"
 #include "localfeatures.hpp"
+#include "database.hpp"
 
 using namespace std;
 
 double GlobalLocalFeatureDistance::distance(const BaseFeature* queryFeature, const BaseFeature* databaseFeature) {
-#ifdef HAVE_KDTREE_LIBRARY
   const LocalFeatures* db=dynamic_cast<const LocalFeatures*>(databaseFeature);
   const LocalFeatures* query=dynamic_cast<const LocalFeatures*>(queryFeature);
   
   if(db && query) {
-    double result;
-    
     if(query->filename() != calculatedFor) {
       ERR << "System not prepared for this query:" << query->filename() << " beeing prepared for " << calculatedFor  << endl;
       exit(20);
     }
     
-    if( hits.find(db->filename()) ==hits.end()) {
+    const uint label=this->label(*db);
+    if(label>=hits.size() || hits[label]==0) {
       DBG(25) << "No single hit for this database image: " << db->filename() << endl;
-      result=hitcounter;
-    } else {
-      result=hitcounter-hits[db->filename()];
+      return hitcounter;
     }
-    return result;
+    return hitcounter-hits[label];
   } else {
-#endif
     ERR << "Features not comparable" << ::std::endl;
     return -1.0;
-#ifdef HAVE_KDTREE_LIBRARY
   }
-#endif
+}
+
+void GlobalLocalFeatureDistance::initialize(Database &db, uint distanceIndex) {
+  distanceIndex_=distanceIndex;
+  database_=&db;
+  dbIndex_.clear();
+  dbLabels_.clear();
+  if(!loaded) {
+    return;
+  }
+
+  dbLabels_.resize(db.size(), index_->labels());
+  for(uint i=0;i<db.size();++i) {
+    const FeatureSet *fs=(*db[i])[distanceIndex];
+    const LocalFeatures *lf=(fs && fs->feature_count()>0) ? dynamic_cast<const LocalFeatures*>((*fs)[0]) : NULL;
+    if(lf) {
+      dbIndex_[lf]=i;
+      dbLabels_[i]=index_->label(lf->filename());
+    }
+  }
+}
+
+uint GlobalLocalFeatureDistance::label(const LocalFeatures& feature) const {
+  map<const BaseFeature*, uint>::const_iterator it=labels_->dbIndex_.find(&feature);
+  if(it!=labels_->dbIndex_.end()) {
+    // features removed and loaded again (partial loading) may be at
+    // the address of a different image now
+    const uint i=it->second;
+    const FeatureSet *fs=(i<labels_->database_->size()) ? (*(*labels_->database_)[i])[distanceIndex_] : NULL;
+    if(fs && fs->feature_count()>0 && (*fs)[0]==&feature) {
+      return labels_->dbLabels_[i];
+    }
+  }
+  return index_->label(feature.filename());
 }
 
 void GlobalLocalFeatureDistance::start(const BaseFeature *queryFeature) {
-#ifdef HAVE_KDTREE_LIBRARY
   const LocalFeatures* query=dynamic_cast<const LocalFeatures*>(queryFeature);
+  if(!loaded) {
+    ERR << "No local feature index loaded from " << filename << endl;
+    exit(20);
+  }
   if(query) {
     calculatedFor=query->filename();
-    hits.clear();
-    hitcounter=0;
-    float *point=new float[query->dim()];
     DBG(25) << "Number of features: " << query->numberOfFeatures() << endl;
-    for(uint i=0;i<query->numberOfFeatures();++i) {
-      for(uint j=0;j<query->dim();++j) {
-        point[j]=(*query)[i][j];
-      }
-      knn_kdtree_search_idc(kdt,point,k,epsilon,neighbors);
-      for(uint i=0;i<k;++i) {
-        hits[string(neighbors[i].labelvec)]++;
-        ++hitcounter;
-      }
-    }
-    delete[] point;
+    hitcounter=index_->vote(*query,k,epsilon,checks,hits);
     
-    DBGI(20,{ for(map<string,uint>::const_iterator i=hits.begin();i!=hits.end();++i) { DBG(20)<< i->first << " " << i->second << endl; }})
+    DBGI(20,{ for(uint i=0;i<hits.size();++i) { if(hits[i]) { DBG(20)<< index_->labelName(i) << " " << hits[i] << endl; }}})
     
   } else {
-#endif
     ERR << "Not possible to use this feature for this distance!" << endl;
     exit(20);
-#ifdef HAVE_KDTREE_LIBRARY 
-}
-#endif
+  }
 }
 
 void GlobalLocalFeatureDistance::stop() {
-#ifdef HAVE_KDTREE_LIBRARY 
   hits.clear();
   hitcounter=0;
-#endif
-}
-
-
-void GlobalLocalFeatureDistance::loadTree(::std::string kdtreefilename) {
-#ifdef HAVE_KDTREE_LIBRARY
-  DBG(20) << "Loading kdtree from file " << kdtreefilename << endl;
-  char *fn=new char[kdtreefilename.size()+1];
-  strcpy(fn,kdtreefilename.c_str());
-  knn_kdtree_read(fn,0,kdt); // load non binary
-  delete fn;
-#endif
 }
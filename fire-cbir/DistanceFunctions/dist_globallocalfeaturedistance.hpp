@@ -18,64 +18,53 @@
 #ifndef __dist_globallocalfeaturedistance_hpp__
 #define __dist_globallocalfeaturedistance_hpp__
 
-#include "vectorfeature.hpp"
-#include "vectorvectorfeature.hpp"
 #include "diag.hpp"
 #include "basedistance.hpp"
+#include "localfeatureindex.hpp"
 #include <iostream>
-#include <map>
+#include <vector>
 #include <string>
-#include <stdlib.h>
-
-#ifdef HAVE_KDTREE_LIBRARY
-#include "knn_api.h"
-#else
-#warning "KDTREE LIBRARY NOT AVAILABLE. GlobalLocalFeatureDistance will not work."
-#endif
+#include <map>
 
+/** counts for each database image how many of the k nearest neighbours
+    of the query's local features come from it. The neighbours are
+    searched in a LocalFeatureIndex over the local features of all
+    database images (created with createlfkdtree), searching stops
+    after checks features have been compared (0: no limit) or when
+    no closer neighbour than 1+epsilon times the k-th can be found. */
 class GlobalLocalFeatureDistance : public BaseDistance {
 public:
   
-  GlobalLocalFeatureDistance(::std::string fn="tree.kdt", uint ka=10, double eps=0.1): k(ka), epsilon(eps), filename(fn) {
-#ifdef HAVE_KDTREE_LIBRARY
-    kdt=(t_knn_kdtree *)malloc(1*sizeof(t_knn_kdtree));
-
-    DBG(10) << "tree=" << fn << " k=" << k << " epsilon=" << epsilon << ::std::endl;
-
-    DBG(10) << "Loading Tree from " << filename;
-    loadTree(filename);
-    BLINK(10) << "... done" << ::std::endl;
-
-    neighbors=new t_knn[k];
-    uint dim=kdt->dim;
-    for (uint i=0; i<k; ++i) {
-      neighbors[i].featvec=(float *)malloc(dim*sizeof(float));
-      neighbors[i].labelvec=(char *)calloc(LIBKNN_LABEL_SIZE,sizeof(char));
-    }
-#endif
-  }
-  
-  virtual ~GlobalLocalFeatureDistance() {
-#ifdef HAVE_KDTREE_LIBRARY
-    knn_kdtree_free(kdt);
-    delete[] neighbors;
-    free(kdt);
-#endif
+  GlobalLocalFeatureDistance(::std::string fn="tree.lfi", uint ka=10, double eps=0.1, uint ch=256): hitcounter(0), k(ka), epsilon(eps), checks(ch), filename(fn), index_(&index), database_(NULL), labels_(this) {
+    DBG(10) << "tree=" << fn << " k=" << k << " epsilon=" << epsilon << " checks=" << checks << ::std::endl;
+    loaded=index.load(filename);
   }
   
   virtual double distance(const BaseFeature* queryFeature, const BaseFeature* databaseFeature);  
+  /// looks up the labels of the database images in the index
+  virtual void initialize(Database &db, uint distanceIndex);
   virtual ::std::string name() {return "globallocalfeaturedistance";}
   virtual void start(const BaseFeature *);
   virtual void stop();
+  /// the hits counted in start() belong to one query
+  virtual bool reentrant() const {return false;}
+  /// a distance for the queries of another thread searching the index of this one
+  virtual BaseDistance* clone() const {return new GlobalLocalFeatureDistance(*this, index_);}
   
 private:
-  //load a tree into this distance object
-  virtual void loadTree(::std::string filename);
-  
+  /// the copy made by clone(), it counts its own hits in the index given
+  GlobalLocalFeatureDistance(const GlobalLocalFeatureDistance& other, const LocalFeatureIndex* sharedIndex): hitcounter(0), k(other.k), epsilon(other.epsilon), checks(other.checks), filename(other.filename), index_(sharedIndex), loaded(other.loaded), database_(NULL), labels_(other.labels_) {
+    distanceIndex_=other.distanceIndex_;
+  }
+
+  /// the label in the index of a database feature, the one found in
+  /// initialize() if the feature is still that of its image
+  uint label(const LocalFeatures& feature) const;
+
   // distances are currently calculated for the query image with the name in this string:
   ::std::string calculatedFor;
-  // here the hits for each image are stored (the image is not contained if no hit was obtained)
-  ::std::map< ::std::string, uint > hits;
+  // here the hits for each image of the index are stored
+  ::std::vector<uint> hits;
   // here we count the total number of hits.
   uint hitcounter;
 
@@ -84,15 +73,28 @@ private:
   
   // the epsilon for the approximate search
   double epsilon;
+
+  // the maximal number of local features compared per search
+  uint checks;
   
-  // the filename of the search tree
+  // the filename of the index
   ::std::string filename;
   
-  // here is the tree
-#ifdef HAVE_KDTREE_LIBRARY
-  t_knn_kdtree *kdt;
-  t_knn *neighbors;
-#endif
-  
+  // here is the index
+  LocalFeatureIndex index;
+  // the index searched: index, or the one of the distance this one was cloned from
+  const LocalFeatureIndex* index_;
+  bool loaded;
+
+  /// the database given to initialize(), used to check that a
+  /// feature is still the one the label was looked up for
+  const Database* database_;
+  /// position in the database of each database feature
+  ::std::map<const BaseFeature*, uint> dbIndex_;
+  /// label in the index of the images, by position in the database
+  ::std::vector<uint> dbLabels_;
+  /// the distance whose labels are used: this one, or for a clone()
+  /// the distance it was cloned from
+  const GlobalLocalFeatureDistance* labels_;
 };
 #endif
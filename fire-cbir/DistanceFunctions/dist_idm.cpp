@@ -17,141 +17,280 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
 #include <limits>
+#include <algorithm>
 #include "dist_idm.hpp"
 #include "imagelib.hpp"
 #include "dist_euclidean.hpp"
 using namespace std;
 
+void ImageDistortionModelDistance::prepare(const ImageFeature& image, IDMPlanes& planes) const {
+  ImageFeature img=image;
+  if(sobel_) {
+    ImageFeature tmpImg=img;
+    sobelv(img);
+    sobelh(tmpImg);
+    img.append(tmpImg);
+
+    for(uint x=0;x<img.xsize();++x) {
+      for(uint y=0;y<img.ysize();++y) {
+        img(x,y,0)+=4.0; img(x,y,0)/=8.0;
+        img(x,y,1)+=4.0; img(x,y,1)/=8.0;}}
+  }
+
+  planes.xsize=img.xsize();
+  planes.ysize=img.ysize();
+  planes.zsize=img.zsize();
+  planes.data.resize(size_t(planes.xsize)*planes.ysize*planes.zsize);
+  size_t i=0;
+  for(uint c=0;c<planes.zsize;++c) {
+    for(uint y=0;y<planes.ysize;++y) {
+      for(uint x=0;x<planes.xsize;++x) {
+        planes.data[i++]=img(x,y,c);
+      }
+    }
+  }
+}
+
+void ImageDistortionModelDistance::initialize(Database &db, uint distanceIndex) {
+  distanceIndex_=distanceIndex;
+  database_=&db;
+  index_=this;
+  dbIndex_.clear();
+  dbPositions_.clear();
+
+  vector<const ImageFeature*> images;
+  for(uint i=0;i<db.size();++i) {
+    const FeatureSet *fs=(*db[i])[distanceIndex];
+    for(uint f=0;fs && f<fs->feature_count();++f) {
+      const ImageFeature *img=dynamic_cast<const ImageFeature*>((*fs)[f]);
+      if(img) {
+        dbIndex_[img]=images.size();
+        dbPositions_.push_back(make_pair(i,f));
+        images.push_back(img);
+      }
+    }
+  }
+
+  dbPlanes_.clear();
+  dbPlanes_.resize(images.size());
+#pragma omp parallel for schedule(dynamic,64)
+  for(long n=0;n<long(images.size());++n) {
+    prepare(*images[n], dbPlanes_[n]);
+  }
+  DBG(10) << "Prepared IDM planes for " << images.size() << " images" << endl;
+}
+
+const IDMPlanes* ImageDistortionModelDistance::prepared(const BaseFeature* feature) const {
+  const ImageDistortionModelDistance& index=*index_;
+  map<const BaseFeature*, uint>::const_iterator it=index.dbIndex_.find(feature);
+  if(it==index.dbIndex_.end()) {
+    return NULL;
+  }
+  // features removed and loaded again (partial loading) may be at
+  // the address of a different image now
+  const uint i=index.dbPositions_[it->second].first, f=index.dbPositions_[it->second].second;
+  if(i>=index.database_->size()) {
+    return NULL;
+  }
+  const FeatureSet *fs=(*(*index.database_)[i])[index.distanceIndex_];
+  if(!fs || f>=fs->feature_count() || (*fs)[f]!=feature) {
+    return NULL;
+  }
+  return &index.dbPlanes_[it->second];
+}
+
+void ImageDistortionModelDistance::start(const BaseFeature *queryFeature) {
+  const ImageFeature* query=dynamic_cast<const ImageFeature*>(queryFeature);
+  queryFeature_=NULL;
+  if(query) {
+    prepare(*query, queryPlanes_);
+    queryFeature_=query;
+  }
+}
+
+void ImageDistortionModelDistance::stop() {
+  queryFeature_=NULL;
+  queryPlanes_.data.clear();
+}
+
+const IDMPlanes& ImageDistortionModelDistance::queryPlanes(const ImageFeature& query, IDMPlanes& tmp) const {
+  if(&query==queryFeature_) {
+    return queryPlanes_;
+  }
+  prepare(query, tmp);
+  return tmp;
+}
+
 double ImageDistortionModelDistance::distance(const BaseFeature* queryFeature, const BaseFeature* databaseFeature) {
-  double dist=-10.0;
-    
   const ImageFeature* db=dynamic_cast<const ImageFeature*>(databaseFeature);
   const ImageFeature* query=dynamic_cast<const ImageFeature*>(queryFeature);
-    
-  if(db && query) {
-    dist=0.0;
-    const ImageFeature DB=*db;
-    const ImageFeature Q=*query;
-    double bestDist;
-    
-    ImageFeature db=DB;
-    ImageFeature query=Q;
-    ImageFeature tmpImg;
-    
-    if(sobel_) {
-      DBG(35) << "Sobelfiltering...";
-      
-      tmpImg=db;
-      sobelv(db);
-      sobelh(tmpImg);
-      db.append(tmpImg);        
-      
-      tmpImg=query;
-      sobelv(query);
-      sobelh(tmpImg);
-      query.append(tmpImg);
-      
-      for(uint x=0;x<db.xsize();++x) {
-        for(uint y=0;y<db.ysize();++y) {
-          db(x,y,0)+=4.0; db(x,y,0)/=8.0;
-          db(x,y,1)+=4.0; db(x,y,1)/=8.0;}}
-      
-      for(uint x=0;x<query.xsize();++x) {
-        for(uint y=0;y<query.ysize();++y) {
-          query(x,y,0)+=4.0; query(x,y,0)/=8.0;
-          query(x,y,1)+=4.0; query(x,y,1)/=8.0;}}
-      
-
-      BLINK(35) << "done" << endl;
+  if(!db || !query) {
+    return -10.0;
+  }
+
+  IDMPlanes tmpQuery;
+  const IDMPlanes& qPlanes=queryPlanes(*query, tmpQuery);
+  const IDMPlanes* dbPlanes=prepared(db);
+  if(dbPlanes) {
+    return distance(qPlanes, *dbPlanes);
+  }
+  IDMPlanes tmp;
+  prepare(*db, tmp);
+  return distance(qPlanes, tmp);
+}
+
+void ImageDistortionModelDistance::distances(const BaseFeature* queryFeature, const BaseFeature* const* databaseFeatures, uint count, double* result) {
+  const ImageFeature* query=dynamic_cast<const ImageFeature*>(queryFeature);
+  if(!query) {
+    for(uint n=0;n<count;++n) {
+      result[n]=-10.0;
     }
+    return;
+  }
+
+  IDMPlanes tmpQuery, tmp;
+  const IDMPlanes& qPlanes=queryPlanes(*query, tmpQuery);
+  for(uint n=0;n<count;++n) {
+    const IDMPlanes* dbPlanes=prepared(databaseFeatures[n]);
+    if(!dbPlanes) {
+      const ImageFeature* db=dynamic_cast<const ImageFeature*>(databaseFeatures[n]);
+      if(!db) {
+        result[n]=-10.0;
+        continue;
+      }
+      prepare(*db, tmp);
+      dbPlanes=&tmp;
+    }
+    result[n]=distance(qPlanes, *dbPlanes);
+  }
+}
 
-    // deformation of reference image, that is search for optimum
-    // position in reference image
-
-    double tmp;
-
-    if(db.xsize()==query.xsize() && db.ysize()==query.ysize()) {
-      DBG(35) << "comparing images of same size" << endl;
-
-      for(int y=0;y<int(query.ysize());++y) {
-        for(int x=0;x<int(query.xsize());++x) {
-          
-          bestDist=numeric_limits<double>::max();
-          
-          for(int xx=x-int(wr1_);xx<=x+int(wr1_);++xx) {
-            if(xx>=0 && xx<int(db.xsize())) {
-              for(int yy=y-int(wr1_);yy<=y+int(wr1_);++yy) {
-                if(yy >= 0 && yy < int(db.ysize())) {
-                  tmp=pixelDist(query,db,x,y,xx,yy);
-                  if(tmp<bestDist || (tmp==bestDist && xx==x && yy==y)) {
-                    bestDist=tmp;
-                  }
-                }
-              }
-            }
+double ImageDistortionModelDistance::distance(const IDMPlanes& query, const IDMPlanes& db) const {
+  if(db.xsize==query.xsize && db.ysize==query.ysize) {
+    DBG(35) << "comparing images of same size" << endl;
+    return sameSizeDistance(query, db);
+  }
+
+  // deformation of reference image, that is search for optimum
+  // position in reference image
+  DBG(35) << "comparing images of different sizes" << endl;
+  double dist=0.0, bestDist, tmp;
+  for(int y=0;y<int(query.ysize);++y) {
+    int db_y=int( double((db.ysize-1)*y)/double(query.ysize-1)+0.5);
+    for(int x=0;x<int(query.xsize);++x) {
+      int db_x=int( double((db.xsize-1)*x)/double(query.xsize-1)+0.5);
+      bestDist=numeric_limits<double>::max();
+
+      for(int xx=max(0,db_x-int(wr1_));xx<=db_x+int(wr1_) && xx<int(db.xsize);++xx) {
+        for(int yy=max(0,db_y-int(wr1_));yy<=db_y+int(wr1_) && yy<int(db.ysize);++yy) {
+          tmp=pixelDist(query,db,x,y,xx,yy);
+          if(tmp<bestDist) {
+            bestDist=tmp;
           }
-          dist+=bestDist;
         }
       }
-    } else {
-      DBG(35) << "comparing images of different sizes" << endl;
-      for(int y=0;y<int(query.ysize());++y) {
-        int db_y=int( double((db.ysize()-1)*y)/double(query.ysize()-1)+0.5);
-        for(int x=0;x<int(query.xsize());++x) {
-          int db_x=int( double((db.xsize()-1)*x)/double(query.xsize()-1)+0.5);
-          bestDist=numeric_limits<double>::max();
-
-          for(int xx=db_x-int(wr1_);xx<=db_x+int(wr1_);++xx) {
-            if(xx>=0 && xx<int(db.xsize())) {
-              for(int yy=db_y-int(wr1_);yy<=db_y+int(wr1_);++yy) {
-                if(yy >= 0 && yy < int(db.ysize())) {
-                  tmp=pixelDist(query,db,x,y,xx,yy);
-                  if(tmp<bestDist || (tmp==bestDist && xx==x && yy==y)) {
-                    bestDist=tmp;
-                  }
-                }
-              }
-            }
+      dist+=bestDist;
+    }
+  }
+  return dist;
+}
+
+namespace {
+  /// number of offsets -r..r for which p+offset lies in [from,to)
+  inline int overlap(int p, int r, int from, int to) {
+    return min(p+r+1, to)-max(p-r, from);
+  }
+}
+
+double ImageDistortionModelDistance::sameSizeDistance(const IDMPlanes& query, const IDMPlanes& db) const {
+  const int X=query.xsize, Y=query.ysize;
+  const uint Z=min(query.zsize, db.zsize);
+  const int r1=wr1_, r2=wr2_;
+
+  vector<double> best(size_t(X)*Y, numeric_limits<double>::max());
+  // squared differences summed over the layers, their running sums
+  // over the rows and then over the columns of the local context
+  vector<double> diff(size_t(X)*Y), rowSum(size_t(X)*Y);
+
+  for(int dy=-r1;dy<=r1;++dy) {
+    for(int dx=-r1;dx<=r1;++dx) {
+      // query pixels (x,y) whose displaced pixel (x+dx,y+dy) is in the image
+      const int x0=max(0,-dx), x1=min(X,X-dx);
+      const int y0=max(0,-dy), y1=min(Y,Y-dy);
+      if(x0>=x1 || y0>=y1) continue;
+
+      for(int y=y0;y<y1;++y) {
+        double *d=&diff[size_t(y)*X];
+        for(int x=x0;x<x1;++x) d[x]=0.0;
+        for(uint c=0;c<Z;++c) {
+          const float *q=query.layer(c)+size_t(y)*X;
+          const float *r=db.layer(c)+size_t(y+dy)*X+dx;
+          for(int x=x0;x<x1;++x) {
+            const double v=double(q[x])-double(r[x]);
+            d[x]+=v*v;
           }
-          dist+=bestDist;
+        }
+
+        // sum over x-r2..x+r2, the pixels outside x0..x1-1 count as zero
+        double *s=&rowSum[size_t(y)*X];
+        double sum=0.0;
+        for(int x=x0;x<min(x1,x0+r2);++x) sum+=d[x];
+        for(int x=x0;x<x1;++x) {
+          if(x+r2<x1) sum+=d[x+r2];
+          s[x]=sum;
+          if(x-r2>=x0) sum-=d[x-r2];
+        }
+      }
+
+      // sum the row sums over y-r2..y+r2 and take the mean over the
+      // pixels in the local context
+      for(int x=x0;x<x1;++x) {
+        const int cntx=overlap(x, r2, x0, x1);
+        double sum=0.0;
+        for(int y=y0;y<min(y1,y0+r2);++y) sum+=rowSum[size_t(y)*X+x];
+        for(int y=y0;y<y1;++y) {
+          if(y+r2<y1) sum+=rowSum[size_t(y+r2)*X+x];
+          double pd=sum/double(cntx*overlap(y, r2, y0, y1));
+          if(threshold_>0) pd=min(threshold_, pd);
+          double &b=best[size_t(y)*X+x];
+          if(pd<b) b=pd;
+          if(y-r2>=y0) sum-=rowSum[size_t(y-r2)*X+x];
         }
       }
     }
   }
+
+  double dist=0.0;
+  for(size_t i=0;i<best.size();++i) {
+    dist+=best[i];
+  }
   return dist;
 }
 
-double ImageDistortionModelDistance::pixelDist(const ImageFeature& query,
-                                               const ImageFeature& db, 
+double ImageDistortionModelDistance::pixelDist(const IDMPlanes& query,
+                                               const IDMPlanes& db, 
                                                const uint xquery, const uint yquery, const uint xdb, const uint ydb) const {
-  
-  double dist=0.0, tmpDist, aktDist;
-  int queryx, queryy, dbx, dby;
-  int cnt;
-  
-  for(uint c=0;c<query.zsize();++c) {
-    tmpDist=0.0;
-    cnt=0;
-
-    for(int i=-int(wr2_);i<=int(wr2_);++i) {
-      dby=ydb+i;  
-      queryy=yquery+i;
-      if(dby>=0 && dby <int(db.ysize()) && queryy>=0 && queryy<int(query.ysize())) {
-        for(int j=-int(wr2_);j<=int(wr2_);++j) {
-          dbx=xdb+j;
-          queryx=xquery+j;
-          if(dbx>=0 && dbx <int(db.xsize()) &&  queryx>=0 && queryx <int(query.xsize())) {
-            aktDist=((query)(queryx,queryy,c)-(db)(dbx,dby,c));
-            aktDist*=aktDist;
-            tmpDist+=aktDist;
-            cnt+=1;
-          }
-        }
+  // the same number of pixels is compared in each layer, so the sum
+  // over all layers is divided by it once
+  const int r=wr2_;
+  const int i0=max(max(-r, -int(ydb)), -int(yquery));
+  const int i1=min(min(r, int(db.ysize)-1-int(ydb)), int(query.ysize)-1-int(yquery));
+  const int j0=max(max(-r, -int(xdb)), -int(xquery));
+  const int j1=min(min(r, int(db.xsize)-1-int(xdb)), int(query.xsize)-1-int(xquery));
+
+  double dist=0.0;
+  for(uint c=0;c<min(query.zsize, db.zsize);++c) {
+    const float *q=query.layer(c), *d=db.layer(c);
+    for(int i=i0;i<=i1;++i) {
+      const float *qrow=q+size_t(yquery+i)*query.xsize+xquery;
+      const float *drow=d+size_t(ydb+i)*db.xsize+xdb;
+      for(int j=j0;j<=j1;++j) {
+        const double v=double(qrow[j])-double(drow[j]);
+        dist+=v*v;
       }
     }
-    tmpDist/=cnt;
-    dist+=tmpDist;
   }
+  dist/=double((i1-i0+1)*(j1-j0+1));
 
   if(threshold_>0) {
     return min(threshold_, dist);
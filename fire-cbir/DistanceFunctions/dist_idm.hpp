@@ -23,6 +23,18 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "basedistance.hpp"
 #include "imagefeature.hpp"
 #include <iostream>
+#include <vector>
+#include <map>
+
+/** The layers of an image as IDM compares them: the (Sobel filtered
+    and scaled) layers as contiguous floats, layer c starts at
+    data[c*xsize*ysize], rows are stored one after the other. */
+struct IDMPlanes {
+  uint xsize, ysize, zsize;
+  ::std::vector<float> data;
+
+  const float* layer(uint c) const { return &data[size_t(c)*xsize*ysize]; }
+};
 
 class ImageDistortionModelDistance : public BaseDistance {
 private: 
@@ -31,13 +43,48 @@ private:
   bool sobel_;
   bool gray_;
 
-  double pixelDist(const ImageFeature& query, 
-                   const ImageFeature& db, 
+  /// the planes of the database images, prepared in initialize()
+  ::std::vector<IDMPlanes> dbPlanes_;
+  /// position (image, frame) in the database of the planes in dbPlanes_
+  ::std::vector< ::std::pair<uint,uint> > dbPositions_;
+  /// index in dbPlanes_ of each database feature
+  ::std::map<const BaseFeature*, uint> dbIndex_;
+  /// the database given to initialize(), used to check that a
+  /// feature is still the one the planes were made from
+  const Database* database_;
+  /// the distance whose database planes are used: this one, or for a
+  /// clone() the distance it was cloned from
+  const ImageDistortionModelDistance* index_;
+
+  /// the query started and its planes, prepared in start()
+  const BaseFeature* queryFeature_;
+  IDMPlanes queryPlanes_;
+
+  /// the planes of the query: the prepared ones if it is the started
+  /// query, otherwise they are made in tmp
+  const IDMPlanes& queryPlanes(const ImageFeature& query, IDMPlanes& tmp) const;
+
+  /// make the planes compared for the given image
+  void prepare(const ImageFeature& image, IDMPlanes& planes) const;
+
+  /// the prepared planes for the database feature or NULL if there are none
+  const IDMPlanes* prepared(const BaseFeature* feature) const;
+
+  /// the distance between the prepared query and database planes
+  double distance(const IDMPlanes& query, const IDMPlanes& db) const;
+
+  /// distance for images of the same size: for each displacement the
+  /// squared differences are summed over the local context with
+  /// running sums instead of once for every pixel pair
+  double sameSizeDistance(const IDMPlanes& query, const IDMPlanes& db) const;
+
+  double pixelDist(const IDMPlanes& query, 
+                   const IDMPlanes& db, 
                    const uint x, const uint y, const uint xx, const uint yy) const;
   
 public:
   ImageDistortionModelDistance(uint wr1=2, uint wr2=1, double threshold=-2.0, bool sobel=true, bool gray=true) :
-    wr1_(wr1), wr2_(wr2), threshold_(threshold), sobel_(sobel) , gray_(gray){
+    wr1_(wr1), wr2_(wr2), threshold_(threshold), sobel_(sobel) , gray_(gray), database_(NULL), index_(this), queryFeature_(NULL) {
     DBG(35) << "WR1=" << wr1_ 
             << " WR2=" << wr2_ 
             << " TH=" << threshold_ 
@@ -46,10 +93,28 @@ public:
   }
   
   virtual double distance(const BaseFeature* queryFeature, const BaseFeature* databaseFeature);
+
+  /// the query planes are prepared once for all given database features
+  virtual void distances(const BaseFeature* queryFeature, const BaseFeature* const* databaseFeatures, uint count, double* result);
+
+  /// prepare the planes of all database images
+  virtual void initialize(Database &db, uint distanceIndex);
   
   virtual ::std::string name() {return "idm";}
-  virtual void start(const BaseFeature *) {}
-  virtual void stop(){}
+
+  /// prepare the planes of the query once for all comparisons
+  virtual void start(const BaseFeature *queryFeature);
+  virtual void stop();
+
+  /// the planes of the started query are kept in this object
+  virtual bool reentrant() const {return false;}
+
+  /// a distance for the queries of another thread using the database planes of this one
+  virtual BaseDistance* clone() const {
+    ImageDistortionModelDistance* result=new ImageDistortionModelDistance(wr1_, wr2_, threshold_, sobel_, gray_);
+    result->index_=index_;
+    return result;
+  }
 };
 
 #endif
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "vectorfeature.hpp"
 #include "diag.hpp"
 #include "basedistance.hpp"
+#include "vectorkernels.hpp"
 #include "sparsehistogramfeature.hpp"
 #include <iostream>
 #include <cmath>
@@ -237,6 +238,14 @@ public:
     }
   }
 
+#ifndef OLD_SLOW_JSD
+  /// one query against many database features, sparse histograms are
+  /// handled by distance()
+  virtual void distances(const BaseFeature* queryFeature, const BaseFeature* const* databaseFeatures, uint count, double* result) {
+    batchVectorDistances(*this, VectorKernels::jsd, queryFeature, databaseFeatures, count, result);
+  }
+#endif
+
   virtual ::std::string name() {return "jsd";}
   virtual void start(const BaseFeature *) {}
   virtual void stop(){}
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "vectorfeature.hpp"
 #include "diag.hpp"
 #include "basedistance.hpp"
+#include "vectorkernels.hpp"
 #include <iostream>
 
 class KLDDistance : public BaseDistance {
@@ -55,6 +56,10 @@ public:
     }
   }
 
+  virtual void distances(const BaseFeature* queryFeature, const BaseFeature* const* databaseFeatures, uint count, double* result) {
+    batchVectorDistances(*this, VectorKernels::kld, queryFeature, databaseFeatures, count, result);
+  }
+
   virtual ::std::string name() {return "kld";}
   virtual void start(const BaseFeature *) {}
   virtual void stop(){}
@@ -1,93 +1,201 @@
+#include <cmath>
 #include "dist_lfsigemd.hpp"
-#include "lfsignaturefeature.hpp"
+#include "database.hpp"
 #include "emd.hpp"
 
 
 using namespace std;
 
 
-float dist(feature_t *F1, feature_t *F2)
-{
-  double res=0.0,tmp;
+void LFSignatureEMDistance::prepare(const LFSignatureFeature& feature, EMDSignature& signature) const {
+  const uint size=feature.signature().size();
+  signature.size=size;
+  signature.dim=0;
+  signature.weights.clear();
+  signature.means.clear();
+  signature.centroid.clear();
+  if(size==0) {
+    return;
+  }
+  if(size>MAX_SIG_SIZE) {
+    ERR << "Signatures with " << size << " clusters are too large for the EMD, at most " << MAX_SIG_SIZE << " are possible" << endl;
+    exit(20);
+  }
 
-  for(uint d=0;d<F1->D;++d) {
-    tmp=F1->vec[d]-F2->vec[d];
-    res+=tmp*tmp;
+  const uint D=feature.model()[0].dim;
+  signature.dim=D;
+  uint sum=0; for(uint i=0;i<size;++i) {sum+=feature.signature()[i];}
+  signature.weights.resize(size);
+  signature.means.resize(size*D);
+  signature.centroid.assign(D,0.0);
+  for(uint i=0;i<size;++i) {
+    signature.weights[i]=float(feature.signature()[i])/float(sum);
+    for(uint d=0;d<D;++d) {
+      signature.means[i*D+d]=feature.model()[i].mean[d];
+      signature.centroid[d]+=signature.weights[i]*signature.means[i*D+d];
+    }
   }
-  return sqrt(res); 
 }
 
+const EMDSignature* LFSignatureEMDistance::prepared(const BaseFeature* feature) const {
+  const LFSignatureEMDistance& index=*index_;
+  map<const BaseFeature*, uint>::const_iterator it=index.dbIndex_.find(feature);
+  if(it==index.dbIndex_.end()) {
+    return NULL;
+  }
+  // features removed and loaded again (partial loading) may be at
+  // the address of a different image now
+  const uint i=index.dbPositions_[it->second].first, f=index.dbPositions_[it->second].second;
+  if(i>=index.database_->size()) {
+    return NULL;
+  }
+  const FeatureSet *fs=(*(*index.database_)[i])[index.distanceIndex_];
+  if(!fs || f>=fs->feature_count() || (*fs)[f]!=feature) {
+    return NULL;
+  }
+  return &index.dbSignatures_[it->second];
+}
 
-double LFSignatureEMDistance::distance(const BaseFeature* queryFeature, const BaseFeature* databaseFeature) {
-  double result=0.0;
-    
-  const LFSignatureFeature* db=dynamic_cast<const LFSignatureFeature*>(databaseFeature);
-  const LFSignatureFeature* q=dynamic_cast<const LFSignatureFeature*>(queryFeature);
-    
-  if(db && q) {
-    result=0;
+void LFSignatureEMDistance::start(const BaseFeature *queryFeature) {
+  const LFSignatureFeature* query=dynamic_cast<const LFSignatureFeature*>(queryFeature);
+  queryFeature_=NULL;
+  if(query) {
+    prepare(*query, querySignature_);
+    queryFeature_=query;
+  }
+}
 
-    uint dbsize=db->signature().size();
-    uint qsize=q->signature().size();
+void LFSignatureEMDistance::stop() {
+  queryFeature_=NULL;
+  querySignature_=EMDSignature();
+}
 
-    if(dbsize==0 or qsize==0) return 2.0;
+const EMDSignature& LFSignatureEMDistance::querySignature(const LFSignatureFeature& query, EMDSignature& tmp) const {
+  if(&query==queryFeature_) {
+    return querySignature_;
+  }
+  prepare(query, tmp);
+  return tmp;
+}
 
-    uint D=db->model()[0].dim;
-      
-    // make weights for emd;
-    float *qweights=new float[qsize];
-    float *dbweights=new float[dbsize];
-    
-    // get size of larger signature
-    uint dbsum=0; for(uint i=0;i<db->signature().size();++i) {dbsum+=db->signature()[i];}
-    uint qsum=0; for(uint i=0;i<q->signature().size();++i) {qsum+=q->signature()[i];}
-      
-    for(uint i=0;i<qsize;++i) {
-      qweights[i]=float(q->signature()[i])/float(qsum);
+double LFSignatureEMDistance::distance(const EMDSignature& query, const EMDSignature& db) const {
+  if(db.size==0 or query.size==0) return 2.0;
+
+  const uint D=query.dim;
+
+  // with normalised weights the distance of the centroids is a lower
+  // bound of the EMD with euclidean ground distance. The images pruned
+  // by it get a distance above maxDistance_, the computed ones are cut
+  // off at maxDistance_, thus no pruned image ranks before a computed one
+  if(maxDistance_>0.0) {
+    double bound=0.0;
+    for(uint d=0;d<D;++d) {
+      const double diff=query.centroid[d]-db.centroid[d];
+      bound+=diff*diff;
     }
-    
-    for(uint i=0;i<dbsize;++i) {
-      dbweights[i]=float(db->signature()[i])/float(dbsum);
+    bound=sqrt(bound);
+    if(bound>maxDistance_) {
+      DBG(100) << "lower bound " << bound << " > " << maxDistance_ << endl;
+      return bound;
     }
+  }
 
-    // make feature for emd
-    feature_t *dbfeat=new feature_t[dbsize];//
-    for(uint i=0;i<dbsize;++i) {
-      dbfeat[i].D=D;
-      dbfeat[i].vec=new float[D];
-      for(uint d=0;d<D;++d) {
-        dbfeat[i].vec[d]=db->model()[i].mean[d];
-      }
-    }
-      
-    feature_t *qfeat=new feature_t[qsize];
-    for(uint i=0;i<qsize;++i) {
-      qfeat[i].D=D;
-      qfeat[i].vec=new float[D];
+  float cost[MAX_SIG_SIZE*MAX_SIG_SIZE];
+  for(uint i=0;i<query.size;++i) {
+    const float* q=&query.means[i*D];
+    for(uint j=0;j<db.size;++j) {
+      const float* v=&db.means[j*D];
+      float res=0.0;
       for(uint d=0;d<D;++d) {
-        qfeat[i].vec[d]=q->model()[i].mean[d];
+        const float tmp=q[d]-v[d];
+        res+=tmp*tmp;
       }
+      cost[j*query.size+i]=sqrt(res);
     }
-      
-
-    signature_t dbsig={db->signature().size(),dbfeat,dbweights};
-    signature_t qsig={q->signature().size(),qfeat,qweights};
-      
-    DBG(20) << "Starting EMD ...";
-    result=emd(&dbsig, &qsig, dist,0,0);
-    BLINK(20)  << " emd=" <<result << endl;
-
-    //cleaning up
-    for(uint i=0;i<dbsize;++i) {delete[] dbfeat[i].vec;} delete[] dbfeat;
-    for(uint i=0;i<qsize;++i) {delete[] qfeat[i].vec;} delete[] qfeat;
-    delete[] qweights;
-    delete[] dbweights;
+  }
+
+  DBG(20) << "Starting EMD ...";
+  const double result=emd(db.size, &db.weights[0], query.size, &query.weights[0], cost, NULL, NULL);
+  BLINK(20)  << " emd=" <<result << endl;
+  DBG(100) << VAR(result) << endl;
+  if(maxDistance_>0.0 && result>maxDistance_) {
+    return maxDistance_;
+  }
+  return result;
+}
+
+double LFSignatureEMDistance::distance(const BaseFeature* queryFeature, const BaseFeature* databaseFeature) {
+  const LFSignatureFeature* db=dynamic_cast<const LFSignatureFeature*>(databaseFeature);
+  const LFSignatureFeature* q=dynamic_cast<const LFSignatureFeature*>(queryFeature);
     
-    DBG(100) << VAR(result) << endl;
-    return result;
-      
+  if(db && q) {
+    EMDSignature tmpQuery;
+    const EMDSignature& qSignature=querySignature(*q, tmpQuery);
+    const EMDSignature* dbSignature=prepared(db);
+    if(dbSignature) {
+      return distance(qSignature, *dbSignature);
+    }
+    EMDSignature tmp;
+    prepare(*db, tmp);
+    return distance(qSignature, tmp);
   } else {
     ERR << "Features not comparable" << endl;
     return -1.0;
   }
 }
+
+void LFSignatureEMDistance::distances(const BaseFeature* queryFeature, const BaseFeature* const* databaseFeatures, uint count, double* result) {
+  const LFSignatureFeature* q=dynamic_cast<const LFSignatureFeature*>(queryFeature);
+  if(!q) {
+    ERR << "Features not comparable" << endl;
+    for(uint n=0;n<count;++n) {
+      result[n]=-1.0;
+    }
+    return;
+  }
+
+  EMDSignature tmpQuery, tmp;
+  const EMDSignature& qSignature=querySignature(*q, tmpQuery);
+  for(uint n=0;n<count;++n) {
+    const EMDSignature* dbSignature=prepared(databaseFeatures[n]);
+    if(!dbSignature) {
+      const LFSignatureFeature* db=dynamic_cast<const LFSignatureFeature*>(databaseFeatures[n]);
+      if(!db) {
+        ERR << "Features not comparable" << endl;
+        result[n]=-1.0;
+        continue;
+      }
+      prepare(*db, tmp);
+      dbSignature=&tmp;
+    }
+    result[n]=distance(qSignature, *dbSignature);
+  }
+}
+
+void LFSignatureEMDistance::initialize(Database &db, uint distanceIndex) {
+  distanceIndex_=distanceIndex;
+  database_=&db;
+  dbIndex_.clear();
+  dbPositions_.clear();
+
+  vector<const LFSignatureFeature*> features;
+  for(uint i=0;i<db.size();++i) {
+    const FeatureSet *fs=(*db[i])[distanceIndex];
+    for(uint f=0;fs && f<fs->feature_count();++f) {
+      const LFSignatureFeature *sig=dynamic_cast<const LFSignatureFeature*>((*fs)[f]);
+      if(sig) {
+        dbIndex_[sig]=features.size();
+        dbPositions_.push_back(make_pair(i,f));
+        features.push_back(sig);
+      }
+    }
+  }
+
+  dbSignatures_.clear();
+  dbSignatures_.resize(features.size());
+#pragma omp parallel for schedule(dynamic,64)
+  for(long n=0;n<long(features.size());++n) {
+    prepare(*features[n], dbSignatures_[n]);
+  }
+  DBG(10) << "Prepared EMD signatures for " << features.size() << " images" << endl;
+}
@@ -21,18 +21,85 @@
 #include "vectorfeature.hpp"
 #include "diag.hpp"
 #include "basedistance.hpp"
+#include "lfsignaturefeature.hpp"
 #include <iostream>
+#include <vector>
+#include <map>
 
+/** A signature as the EMD uses it: the normalised weights, the means
+    of the clusters one after the other and the weighted mean of all
+    clusters, which gives a lower bound of the EMD. */
+struct EMDSignature {
+  uint size, dim;
+  ::std::vector<float> weights;
+  ::std::vector<float> means;
+  ::std::vector<float> centroid;
+};
 
 class LFSignatureEMDistance : public BaseDistance {
+private:
+  /// images whose lower bound is above this get the lower bound as
+  /// distance without computing the EMD, and the computed EMDs are cut
+  /// off at it, so that these images rank after all others. 0: always
+  /// compute the EMD
+  double maxDistance_;
+
+  /// the signatures of the database images, prepared in initialize()
+  ::std::vector<EMDSignature> dbSignatures_;
+  /// position (image, frame) in the database of the signatures in dbSignatures_
+  ::std::vector< ::std::pair<uint,uint> > dbPositions_;
+  /// index in dbSignatures_ of each database feature
+  ::std::map<const BaseFeature*, uint> dbIndex_;
+  /// the database given to initialize(), used to check that a
+  /// feature is still the one the signature was made from
+  const Database* database_;
+  /// the distance whose database signatures are used: this one, or for
+  /// a clone() the distance it was cloned from
+  const LFSignatureEMDistance* index_;
+
+  /// the query started and its signature, prepared in start()
+  const BaseFeature* queryFeature_;
+  EMDSignature querySignature_;
+
+  /// the signature of the query: the prepared one if it is the started
+  /// query, otherwise it is made in tmp
+  const EMDSignature& querySignature(const LFSignatureFeature& query, EMDSignature& tmp) const;
+
+  /// make the signature compared for the given feature
+  void prepare(const LFSignatureFeature& feature, EMDSignature& signature) const;
+
+  /// the prepared signature for the database feature or NULL if there is none
+  const EMDSignature* prepared(const BaseFeature* feature) const;
+
+  /// the distance between the prepared query and database signatures
+  double distance(const EMDSignature& query, const EMDSignature& db) const;
+
 public:
+  LFSignatureEMDistance(double maxDistance=0.0) : maxDistance_(maxDistance), database_(NULL), index_(this), queryFeature_(NULL) {}
+
   virtual double distance(const BaseFeature* queryFeature, const BaseFeature* databaseFeature);
 
+  /// the query signature is prepared once for all given database features
+  virtual void distances(const BaseFeature* queryFeature, const BaseFeature* const* databaseFeatures, uint count, double* result);
 
+  /// prepare the signatures of all database images
+  virtual void initialize(Database &db, uint distanceIndex);
 
   virtual ::std::string name() {return "lfsignatureemd";}
-  virtual void start(const BaseFeature *) {}
-  virtual void stop(){}
+
+  /// prepare the signature of the query once for all comparisons
+  virtual void start(const BaseFeature *queryFeature);
+  virtual void stop();
+
+  /// the signature of the started query is kept in this object
+  virtual bool reentrant() const {return false;}
+
+  /// a distance for the queries of another thread using the database signatures of this one
+  virtual BaseDistance* clone() const {
+    LFSignatureEMDistance* result=new LFSignatureEMDistance(maxDistance_);
+    result->index_=index_;
+    return result;
+  }
 };
 
 #endif
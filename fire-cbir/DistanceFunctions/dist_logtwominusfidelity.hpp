@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "vectorfeature.hpp"
 #include "diag.hpp"
 #include "basedistance.hpp"
+#include "vectorkernels.hpp"
 #include <iostream>
 
 class LogTwoMinusFidelityDistance : public BaseDistance {
@@ -49,6 +50,14 @@ public:
     }
   }
 
+  static double kernel(const double* q, const double* d, uint dim) {
+    return log(2.0-VectorKernels::fidelity(q, d, dim));
+  }
+
+  virtual void distances(const BaseFeature* queryFeature, const BaseFeature* const* databaseFeatures, uint count, double* result) {
+    batchVectorDistances(*this, kernel, queryFeature, databaseFeatures, count, result);
+  }
+
   virtual ::std::string name() {return "logtwominusfidelity";}
   virtual void start(const BaseFeature *) {}
   virtual void stop(){}
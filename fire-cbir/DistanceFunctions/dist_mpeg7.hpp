@@ -90,6 +90,12 @@ public:
   
   /// forget the distances for the last query which was prepared.
   virtual void stop();
+
+  /// the distances prepared by start() belong to one query
+  virtual bool reentrant() const {return false;}
+
+  /// a distance running XMMain.exe for the queries of another thread
+  virtual BaseDistance* clone() const {return new MPEG7Distance(xmmain_, mpeg7data_);}
 };
 
 #endif
@@ -17,6 +17,25 @@ void SMART2Distance::start(const BaseFeature * queryFeature) {
   //compute score for query Image for GIFT-TFIDF normalization
   //  queryScore_=scoreFeatureSet(queryFeature_);
 
+  //accumulate the scores of all database features sharing bins with the query
+  const SMART2Distance* idx=index();
+  vector<double> scores(idx->documentFeatures_.size(), 0.0), queryScores(idx->documentFeatures_.size(), 0.0);
+  for (MapTypeDouble::iterator i=queryMap_.begin();i!=queryMap_.end();i++){
+    MapTypeInt::const_iterator t=idx->terms_.find(i->first);
+    if (t==idx->terms_.end()) continue;
+    const double wtq=scoreFeature(i)*collectionFrequency(i->first);
+    const vector<Posting>& postings=idx->postings_[t->second];
+    for (uint p=0;p<postings.size();++p){
+      const uint d=postings[p].document;
+      double gtd=(1+(1+log(postings[p].value)))/(1+idx->documentInfo_[d].meanTF);
+      scores[d]+=gtd/((0.8)*idx->pivot_+0.3*idx->documentInfo_[d].numSingletons);
+      queryScores[d]+=wtq;
+    }
+  }
+  queryDistances_.resize(scores.size());
+  for (uint d=0;d<scores.size();++d){
+    queryDistances_[d]=1-scores[d]/queryScores[d];
+  }
 }
 
 //score a featureset according to some scoring function
@@ -38,27 +57,33 @@ double SMART2Distance::scoreFeature(MapTypeDouble::iterator F){
     
 double SMART2Distance::distance(const BaseFeature* queryFeature, const BaseFeature* databaseFeature){
   double result=0.0;
+  if (indexedDistance(queryFeature, databaseFeature, result)) return result;
 
   const SparseHistogramFeature * data=dynamic_cast<const SparseHistogramFeature*>(databaseFeature);
   double idf, wtq, gtd, wtd;
+  const SMART2Distance* idx=index();
+  //the document information is shared with the clones and only read here
+  tfsin info={0.0, 0.0};
+  map<const SparseHistogramFeature *, tfsin>::const_iterator adi=idx->ADI_.find(data);
+  if (adi!=idx->ADI_.end()) info=adi->second;
   //get map
-  MapTypeDouble databaseMap=data->getMap();
-  queryScore_=0;
+  const MapTypeDouble& databaseMap=data->map();
+  double queryScore=0;
   //iterate over query features
   for (MapTypeDouble::iterator i=queryMap_.begin();i!=queryMap_.end();i++){
 
     //look for that feature in document
-    MapTypeDouble::iterator j=databaseMap.find(i->first); 
+    MapTypeDouble::const_iterator j=databaseMap.find(i->first); 
     if (j!=databaseMap.end()){
 
-      idf=collectionFrequencies_[i->first];//log(dataBaseSize_/collectionFrequencies_[i->first]);
+      idf=collectionFrequency(i->first);//log(dataBaseSize_/collectionFrequencies_[i->first]);
       wtq=scoreFeature(i)*idf;
-      gtd=(1+scoreFeature(j))/(1+ADI_[data].meanTF);
-      wtd=gtd/((0.8)*pivot_+0.3*ADI_[data].numSingletons);
+      gtd=(1+(1+log(j->second)))/(1+info.meanTF);
+      wtd=gtd/((0.8)*idx->pivot_+0.3*info.numSingletons);
       
 
       result+=wtd;///wtq;    
-	queryScore_+=wtq;
+	queryScore+=wtq;
      
 
 //      DBG(10)<<idf<<" "<<wtq<<" "<<gtd<<" "<<wtd<<" "<<pivot_<<" "<<ADI_[data].numSingletons<<" "<<ADI_[data].meanTF<<endl;
@@ -69,7 +94,7 @@ double SMART2Distance::distance(const BaseFeature* queryFeature, const BaseFeatu
   }
   
 
-  return 1-result/queryScore_;
+  return 1-result/queryScore;
 
 }
 
@@ -84,6 +109,9 @@ void SMART2Distance::initialize(Database &db,uint distanceIndex){
 
   pivot_=0;
   DBG(10)<<"INITIALIZING"<<endl;
+  buildIndex(db, distanceIndex);
+  collectionFrequencies_.clear();
+  ADI_.clear();
   //initialize collection frequencies
   for (uint i=0;i<db.size();i++){
 
@@ -91,13 +119,13 @@ void SMART2Distance::initialize(Database &db,uint distanceIndex){
     ImageContainer * ic=db[i];
     //get correct Featuremap
     const SparseHistogramFeature * shf=dynamic_cast<const SparseHistogramFeature*>((*ic)[distanceIndex]->operator[](0));
-    MapTypeDouble documentMap=shf->getMap(); 
+    const MapTypeDouble& documentMap=shf->map(); 
     //compute collectionfrequencies, mean TF, singletons and pivot
     tfsin container;
     container.meanTF=0;
     container.numSingletons=0;
     uint counter=0;
-    for(MapTypeDouble::iterator i=documentMap.begin();i!=documentMap.end();i++){
+    for(MapTypeDouble::const_iterator i=documentMap.begin();i!=documentMap.end();i++){
       
       //search whether Feature is already registered in CollectionFrequencies
       MapTypeDouble::iterator tmp=collectionFrequencies_.find(i->first);
@@ -132,6 +160,10 @@ void SMART2Distance::initialize(Database &db,uint distanceIndex){
   }
   //normalized
   pivot_/=db.size();
+  documentInfo_.resize(documentFeatures_.size());
+  for (uint d=0;d<documentFeatures_.size();++d){
+    documentInfo_[d]=ADI_[documentFeatures_[d]];
+  }
   DBG(10)<<pivot_<<endl;
   dataBaseSize_=db.size();
 }
@@ -46,12 +46,24 @@ public:
 
   virtual void start(const BaseFeature * queryFeature);
 
+  //a distance for the queries of another thread using the index and document information of this one
+  virtual BaseDistance* clone() const {
+    SMART2Distance* result=new SMART2Distance();
+    result->index_=index_;
+    return result;
+  }
+
 private:
 
+  //the distance holding the index, see TFIDFDistance::index_
+  const SMART2Distance* index() const {return static_cast<const SMART2Distance*>(index_);}
+
   double pivot_;
 
   //additional document information
   std:: map<const SparseHistogramFeature *, tfsin> ADI_;
+  //the same for each indexed document
+  std::vector<tfsin> documentInfo_;
   
 
   //scoring function
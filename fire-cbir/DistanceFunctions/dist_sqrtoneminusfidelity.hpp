@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "vectorfeature.hpp"
 #include "diag.hpp"
 #include "basedistance.hpp"
+#include "vectorkernels.hpp"
 #include <iostream>
 
 class SqrtOneMinusFidelityDistance : public BaseDistance {
@@ -48,6 +49,14 @@ public:
     }
   }
 
+  static double kernel(const double* q, const double* d, uint dim) {
+    return sqrt(1.0-VectorKernels::fidelity(q, d, dim));
+  }
+
+  virtual void distances(const BaseFeature* queryFeature, const BaseFeature* const* databaseFeatures, uint count, double* result) {
+    batchVectorDistances(*this, kernel, queryFeature, databaseFeatures, count, result);
+  }
+
   virtual ::std::string name() {return "sqrtoneminusfidelity";}
   virtual void start(const BaseFeature *) {}
   virtual void stop(){}
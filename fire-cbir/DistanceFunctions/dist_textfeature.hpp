@@ -42,6 +42,10 @@ public:
   virtual ::std::string language() {return language_;}
   virtual void start(const BaseFeature *);
   virtual void stop(){}
+  /// the retrieval status values of the current query are kept here
+  virtual bool reentrant() const {return false;}
+  /// each copy asks the text retrieval server on its own
+  virtual BaseDistance* clone() const {return new TextFeatureDistance(server_, port_, language_);}
 
   virtual void getServerSettings(::std::string &server, unsigned &port, ::std::string &language);
   
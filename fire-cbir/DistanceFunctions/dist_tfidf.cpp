@@ -17,8 +17,64 @@ void TFIDFDistance::start(const BaseFeature * queryFeature) {
   //compute score for query Image for GIFT-TFIDF normalization
   queryScore_=scoreFeatureSet(queryFeature_);
 
- 
-  
+  //accumulate the scores of all database features sharing bins with the query
+  vector<double> scores(index_->documentFeatures_.size(), 0.0);
+  for (MapTypeDouble::iterator i=queryMap_.begin();i!=queryMap_.end();i++){
+    MapTypeInt::const_iterator t=index_->terms_.find(i->first);
+    if (t==index_->terms_.end()) continue;
+    const double q=sqrt(i->second);
+    const vector<Posting>& postings=index_->postings_[t->second];
+    for (uint p=0;p<postings.size();++p){
+      scores[postings[p].document]+=q*sqrt(postings[p].value);
+    }
+  }
+  queryDistances_.resize(scores.size());
+  for (uint d=0;d<scores.size();++d){
+    queryDistances_[d]=1-scores[d];
+  }
+}
+
+void TFIDFDistance::buildIndex(Database &db, uint distanceIndex){
+  index_=this;
+  terms_.clear();
+  postings_.clear();
+  documentFeatures_.clear();
+  documents_.clear();
+  queryDistances_.clear();
+
+  ulong entries=0;
+  for (uint i=0;i<db.size();i++){
+    const SparseHistogramFeature * shf=dynamic_cast<const SparseHistogramFeature*>((*db[i])[distanceIndex]->operator[](0));
+    if (!shf) continue;
+    const uint document=documentFeatures_.size();
+    documentFeatures_.push_back(shf);
+    documents_[shf]=document;
+
+    const MapTypeDouble& documentMap=shf->map();
+    for (MapTypeDouble::const_iterator j=documentMap.begin();j!=documentMap.end();j++){
+      MapTypeInt::iterator t=terms_.find(j->first);
+      uint term;
+      if (t==terms_.end()){
+        term=postings_.size();
+        terms_[j->first]=term;
+        postings_.push_back(vector<Posting>());
+      } else {
+        term=t->second;
+      }
+      Posting posting={document, j->second};
+      postings_[term].push_back(posting);
+      ++entries;
+    }
+  }
+  DBG(10) << "Inverted index of " << documentFeatures_.size() << " features: " << postings_.size() << " bins, " << entries << " postings" << endl;
+}
+
+bool TFIDFDistance::indexedDistance(const BaseFeature* query, const BaseFeature* databaseFeature, double& result) const{
+  if (query!=queryFeature_ || queryDistances_.empty()) return false;
+  map<const BaseFeature*, uint>::const_iterator d=index_->documents_.find(databaseFeature);
+  if (d==index_->documents_.end()) return false;
+  result=queryDistances_[d->second];
+  return true;
 }
 
 //score a featureset according to some scoring function
@@ -37,7 +93,13 @@ double TFIDFDistance::scoreFeatureSet(const SparseHistogramFeature * featureset)
 double TFIDFDistance::scoreFeature(const SparseHistogramFeature * featureset, MapTypeDouble::iterator F){
 
   //gift tf/idf
-  return (F->second)*collectionFrequencies_[F->first];
+  return (F->second)*collectionFrequency(F->first);
+}
+
+double TFIDFDistance::collectionFrequency(const Position& bin) const{
+  MapTypeDouble::const_iterator cf=index_->collectionFrequencies_.find(bin);
+  if (cf==index_->collectionFrequencies_.end()) return 0.0;
+  return cf->second;
 }
 
 //Dummy for the Moment
@@ -62,18 +124,20 @@ double TFIDFDistance::getLength(MapTypeDouble inMap){
 double TFIDFDistance::distance(const BaseFeature* queryFeature, const BaseFeature* databaseFeature) {
   
   double result=0.0;
+  if (indexedDistance(queryFeature, databaseFeature, result)) return result;
+
   const SparseHistogramFeature * data=dynamic_cast<const SparseHistogramFeature*>(databaseFeature);
   const SparseHistogramFeature* query=dynamic_cast<const SparseHistogramFeature*>(queryFeature);
   //get map
-  MapTypeDouble databaseMap=data->getMap();
-  MapTypeDouble queryMap= query->getMap();
+  const MapTypeDouble& databaseMap=data->map();
+  const MapTypeDouble& queryMap=query->map();
 
   //iterate over query features
   
-  for (MapTypeDouble::iterator i=queryMap.begin();i!=queryMap.end();i++){
+  for (MapTypeDouble::const_iterator i=queryMap.begin();i!=queryMap.end();i++){
 
     //look for that feature in document
-    MapTypeDouble::iterator j=databaseMap.find(i->first); 
+    MapTypeDouble::const_iterator j=databaseMap.find(i->first); 
 
     if (j!=databaseMap.end()){
   
@@ -112,49 +176,23 @@ void TFIDFDistance::stop(){
   //length and score for convenience
   queryLength_=0;
   queryScore_=0;
+  queryFeature_=NULL;
+  queryDistances_.clear();
 }
 
 
-//this initializes the collection frequencies of all features by iterating over the database
+//this builds the inverted index, the collection frequency of a bin is the length of its posting list
 void TFIDFDistance::initialize(Database &db, uint distanceIndex){
 
-  
-  //iterate over database
-  for (uint i=0;i<db.size();i++){
+  buildIndex(db, distanceIndex);
 
-    //get ImageContainer
-    ImageContainer * ic=db[i];
-    //get correct Featuremap
-    const SparseHistogramFeature * shf=dynamic_cast<const SparseHistogramFeature*>((*ic)[distanceIndex]->operator[](0));
-    MapTypeDouble documentMap=shf->getMap(); 
-    //compute collectionfrequencies
-    for(MapTypeDouble::iterator i=documentMap.begin();i!=documentMap.end();i++){
-     
-      //search whether Feature is already registered in CollectionFrequencies
-      MapTypeDouble::iterator tmp=collectionFrequencies_.find(i->first);
-     
-      if (tmp==collectionFrequencies_.end()){
-	//if not, insert
-	collectionFrequencies_[i->first]=1;
-      }
-      else{
-	//if, increase
-	collectionFrequencies_[i->first]+=1;
-      }
-     
-    } 
-  }
-  
-
-  for (MapTypeDouble::iterator i=collectionFrequencies_.begin();i!=collectionFrequencies_.end();i++){
-  
-    i->second=log(db.size()/i->second);
-    i->second*=i->second;
+  collectionFrequencies_.clear();
+  for (MapTypeInt::const_iterator t=terms_.begin();t!=terms_.end();t++){
+    double cf=postings_[t->second].size();
+    cf=log(db.size()/cf);
+    collectionFrequencies_[t->first]=cf*cf;
   }
   //save value for speed
   dataBaseSize_=db.size();
 
 }
-
-
-
@@ -23,25 +23,72 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "diag.hpp"
 #include "basedistance.hpp"
 #include <iostream>
+#include <vector>
+#include <map>
 
 
 
 class TFIDFDistance : public BaseDistance {
 public:
+  TFIDFDistance() : index_(this), queryFeature_(NULL) {}
+
   virtual double distance(const BaseFeature* queryFeature, const BaseFeature* databaseFeature);
 
   virtual ::std::string name() {return "tfidf";}
   
   //this initializes the term frequencies of the features contained in the query image
+  //and computes the distances to all database features from the inverted index
   virtual void start(const BaseFeature * queryFeature);
 
   //clears term frequencies
   virtual void stop();
 
-  //this initializes the collection frequencies of all features by iterating over the database
+  //the query term frequencies are kept in this object
+  virtual bool reentrant() const {return false;}
+
+  //a distance for the queries of another thread using the inverted index of this one
+  virtual BaseDistance* clone() const {
+    TFIDFDistance* result=new TFIDFDistance();
+    result->index_=index_;
+    return result;
+  }
+
+  //this builds the inverted index and initializes the collection frequencies of all features
   virtual void initialize(Database &db,uint distanceIndex);
 
 protected:
+
+  /// an entry of a posting list: a database feature in which the bin
+  /// is filled and the value of the bin there
+  struct Posting {
+    uint document;
+    double value;
+  };
+
+  /// the distance whose inverted index and collection frequencies are
+  /// used: this one, or for a clone() the distance it was cloned from.
+  /// The index is only read after initialize().
+  const TFIDFDistance* index_;
+
+  /// the inverted index built in initialize(): the posting list of
+  /// each bin is postings_[terms_[bin]]
+  MapTypeInt terms_;
+  ::std::vector< ::std::vector<Posting> > postings_;
+  /// the indexed database features, their position is the document
+  /// number used in the posting lists
+  ::std::vector<const SparseHistogramFeature*> documentFeatures_;
+  ::std::map<const BaseFeature*, uint> documents_;
+  /// the distances of the started query to all indexed database
+  /// features, computed in start() from the posting lists of its bins
+  ::std::vector<double> queryDistances_;
+
+  /// build the inverted index over the given feature of all database images
+  void buildIndex(Database &db, uint distanceIndex);
+
+  /// look up the distance of the started query to the database
+  /// feature. Returns false if query is not the started query or the
+  /// database feature is not in the index.
+  bool indexedDistance(const BaseFeature* query, const BaseFeature* databaseFeature, double& result) const;
   
   MapTypeDouble queryMap_;
   double queryScore_;
@@ -52,6 +99,9 @@ protected:
   uint  dataBaseSize_;
   
 
+  //the collection frequency of a bin from the index, 0 for unknown bins
+  double collectionFrequency(const Position& bin) const;
+
   //compute termfrequencies for some featuremap
   MapTypeDouble getTermFrequencies(MapTypeDouble inQuery);
 
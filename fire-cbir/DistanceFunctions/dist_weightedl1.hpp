@@ -35,6 +35,11 @@ public:
   virtual void stop(){}
   
   virtual void tune(const std::vector<const BaseFeature*>& posFeat, const std::vector<const BaseFeature*>& negFeat);
+
+  /// the weights are tuned for each query
+  virtual bool reentrant() const {return false;}
+  /// a copy tuning its own weights
+  virtual BaseDistance* clone() const {return new WeightedL1Distance(*this);}
   
 private:
   float wdisl1(float * i, float *j, int dim); 
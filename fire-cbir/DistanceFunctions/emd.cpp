@@ -51,20 +51,21 @@ typedef struct node2_t {
 
 
 
-/* GLOBAL VARIABLE DECLARATION */
-static int _n1, _n2;                          /* SIGNATURES SIZES */
-static float _C[MAX_SIG_SIZE1][MAX_SIG_SIZE1];/* THE COST MATRIX */
-static node2_t _X[MAX_SIG_SIZE1*2];            /* THE BASIC VARIABLES VECTOR */
+/* GLOBAL VARIABLE DECLARATION, ONE COPY PER THREAD */
+static __thread int _n1, _n2;                          /* SIGNATURES SIZES */
+static __thread float _C[MAX_SIG_SIZE1][MAX_SIG_SIZE1];/* THE COST MATRIX */
+static __thread node2_t _X[MAX_SIG_SIZE1*2];            /* THE BASIC VARIABLES VECTOR */
 /* VARIABLES TO HANDLE _X EFFICIENTLY */
-static node2_t *_EndX, *_EnterX;
-static char _IsX[MAX_SIG_SIZE1][MAX_SIG_SIZE1];
-static node2_t *_RowsX[MAX_SIG_SIZE1], *_ColsX[MAX_SIG_SIZE1];
-static double _maxW;
-static float _maxC;
+static __thread node2_t *_EndX, *_EnterX;
+static __thread char _IsX[MAX_SIG_SIZE1][MAX_SIG_SIZE1];
+static __thread node2_t *_RowsX[MAX_SIG_SIZE1], *_ColsX[MAX_SIG_SIZE1];
+static __thread double _maxW;
+static __thread float _maxC;
 
 /* DECLARATION OF FUNCTIONS */
-static float init(signature_t *Signature1, signature_t *Signature2,
-		  float (*Dist)(feature_t *, feature_t *));
+static void checkSizes(int n1, int n2);
+static float init(int n1, const float *Weights1, int n2, const float *Weights2);
+static float solve(float w, int n1, int n2, flow_t *Flow, int *FlowSize);
 static void findBasicVariables(node1_t *U, node1_t *V);
 static int isOptimal(node1_t *U, node1_t *V);
 static int findLoop(node2_t **Loop);
@@ -101,16 +102,67 @@ where
 float emd(signature_t *Signature1, signature_t *Signature2,
 	  float (*Dist)(feature_t *, feature_t *),
 	  flow_t *Flow, int *FlowSize)
+{
+  int i, j;
+  feature_t *P1, *P2;
+
+  checkSizes(Signature1->n, Signature2->n);
+
+  /* COMPUTE THE DISTANCE MATRIX */
+  _maxC = 0;
+  for(i=0, P1=Signature1->Features; i < Signature1->n; i++, P1++)
+    for(j=0, P2=Signature2->Features; j < Signature2->n; j++, P2++) 
+      {
+	_C[i][j] = Dist(P1, P2);
+	if (_C[i][j] > _maxC)
+	  _maxC = _C[i][j];
+      }
+
+  return solve(init(Signature1->n, Signature1->Weights, Signature2->n, Signature2->Weights),
+	       Signature1->n, Signature2->n, Flow, FlowSize);
+}
+
+
+/******************************************************************************
+float emd(int n1, const float *Weights1, int n2, const float *Weights2,
+          const float *Cost, flow_t *Flow, int *FlowSize)
+
+   the same with the ground distances given as the n1 x n2 matrix Cost
+   (row major), Cost[i*n2+j] is the distance of feature i of the first
+   to feature j of the second signature.
+******************************************************************************/
+
+float emd(int n1, const float *Weights1, int n2, const float *Weights2,
+	  const float *Cost, flow_t *Flow, int *FlowSize)
+{
+  int i, j;
+
+  checkSizes(n1, n2);
+
+  _maxC = 0;
+  for(i=0; i < n1; i++)
+    for(j=0; j < n2; j++)
+      {
+	_C[i][j] = Cost[i*n2+j];
+	if (_C[i][j] > _maxC)
+	  _maxC = _C[i][j];
+      }
+
+  return solve(init(n1, Weights1, n2, Weights2), n1, n2, Flow, FlowSize);
+}
+
+
+/**********************
+   solve
+**********************/
+static float solve(float w, int n1, int n2, flow_t *Flow, int *FlowSize)
 {
   int itr;
   double totalCost;
-  float w;
   node2_t *XP;
   flow_t *FlowP;
   node1_t U[MAX_SIG_SIZE1], V[MAX_SIG_SIZE1];
 
-  w = init(Signature1, Signature2, Dist);
-
 #if DEBUG_LEVEL > 1
   printf("\nINITIAL SOLUTION:\n");
   printSolution();
@@ -149,7 +201,7 @@ float emd(signature_t *Signature1, signature_t *Signature2,
     {
       if (XP == _EnterX)  /* _EnterX IS THE EMPTY SLOT */
 	continue;
-      if (XP->i == Signature1->n || XP->j == Signature2->n)  /* DUMMY FEATURE */
+      if (XP->i == n1 || XP->j == n2)  /* DUMMY FEATURE */
 	continue;
       
       if (XP->val == 0)  /* ZERO FLOW */
@@ -179,49 +231,44 @@ float emd(signature_t *Signature1, signature_t *Signature2,
 
 
 
+/**********************
+   checkSizes
+**********************/
+static void checkSizes(int n1, int n2)
+{
+  if (n1 > MAX_SIG_SIZE || n2 > MAX_SIG_SIZE)
+    {
+      fprintf(stderr, "emd: Signature size is limited to %d\n", MAX_SIG_SIZE);
+      exit(1);
+    }
+}
+
+
 /**********************
    init
 **********************/
-static float init(signature_t *Signature1, signature_t *Signature2, 
-		  float (*Dist)(feature_t *, feature_t *))
+static float init(int n1, const float *Weights1, int n2, const float *Weights2)
 {
   int i, j;
   double sSum, dSum, diff;
-  feature_t *P1, *P2;
   double S[MAX_SIG_SIZE1], D[MAX_SIG_SIZE1];
  
-  _n1 = Signature1->n;
-  _n2 = Signature2->n;
+  _n1 = n1;
+  _n2 = n2;
 
-  if (_n1 > MAX_SIG_SIZE || _n2 > MAX_SIG_SIZE)
-    {
-      fprintf(stderr, "emd: Signature size is limited to %d\n", MAX_SIG_SIZE);
-      exit(1);
-    }
-  
-  /* COMPUTE THE DISTANCE MATRIX */
-  _maxC = 0;
-  for(i=0, P1=Signature1->Features; i < _n1; i++, P1++)
-    for(j=0, P2=Signature2->Features; j < _n2; j++, P2++) 
-      {
-	_C[i][j] = Dist(P1, P2);
-	if (_C[i][j] > _maxC)
-	  _maxC = _C[i][j];
-      }
-	
   /* SUM UP THE SUPPLY AND DEMAND */
   sSum = 0.0;
   for(i=0; i < _n1; i++)
     {
-      S[i] = Signature1->Weights[i];
-      sSum += Signature1->Weights[i];
+      S[i] = Weights1[i];
+      sSum += Weights1[i];
       _RowsX[i] = NULL;
     }
   dSum = 0.0;
   for(j=0; j < _n2; j++)
     {
-      D[j] = Signature2->Weights[j];
-      dSum += Signature2->Weights[j];
+      D[j] = Weights2[j];
+      dSum += Weights2[j];
       _ColsX[j] = NULL;
     }
 
@@ -50,4 +50,8 @@ float emd(signature_t *Signature1, signature_t *Signature2,
 	  float (*func)(feature_t *, feature_t *),
 	  flow_t *Flow, int *FlowSize);
 
+/* the same with a precomputed n1 x n2 ground distance matrix (row major) */
+float emd(int n1, const float *Weights1, int n2, const float *Weights2,
+	  const float *Cost, flow_t *Flow, int *FlowSize);
+
 #endif
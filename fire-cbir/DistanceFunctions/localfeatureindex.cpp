@@ -0,0 +1,524 @@
+/*
+  This file is part of the FIRE -- Flexible Image Retrieval System
+  
+  FIRE is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  FIRE is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with FIRE; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#include <algorithm>
+#include <fstream>
+#include <queue>
+#include <cstring>
+#include <limits>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "localfeatureindex.hpp"
+#include "diag.hpp"
+
+using namespace std;
+
+namespace {
+  const char lfiMagic[8]={'F','I','R','E','_','L','F','I'};
+  const uint32_t lfiVersion=1;
+
+  /// maximal number of features in a leaf
+  const uint32_t leafSize=16;
+  /// number of features used to estimate mean and variance of a node
+  const uint32_t sampleSize=128;
+  /// the split dimension is chosen at random among this many dimensions
+  /// with the highest variance
+  const uint splitCandidates=5;
+
+  uint32_t nextRandom(uint32_t& seed) {
+    seed=seed*1103515245u+12345u;
+    return seed>>16;
+  }
+
+  struct Branch {
+    float bound;
+    uint32_t node, tree;
+    Branch(float b, uint32_t n, uint32_t t) : bound(b), node(n), tree(t) {}
+    /// reversed, the priority queue gives the smallest bound first
+    bool operator<(const Branch& other) const { return bound>other.bound; }
+  };
+
+  /// orders features by their value in one dimension
+  struct FeatureLess {
+    const float* features;
+    uint dim, split;
+    FeatureLess(const float* f, uint d, uint s) : features(f), dim(d), split(s) {}
+    bool operator()(uint32_t a, uint32_t b) const { return features[size_t(a)*dim+split]<features[size_t(b)*dim+split]; }
+  };
+
+  /// true for the features left of a split
+  struct SplitLess {
+    const float* features;
+    uint dim, split;
+    float value;
+    SplitLess(const float* f, uint d, uint s, float v) : features(f), dim(d), split(s), value(v) {}
+    bool operator()(uint32_t a) const { return features[size_t(a)*dim+split]<value; }
+  };
+}
+
+LocalFeatureIndex::LocalFeatureIndex() : dim_(0), trees_(0), labels_(0), size_(0), nodes_(0),
+                                         labelOffsets_(NULL), node_(NULL), features_(NULL), featureLabels_(NULL),
+                                         order_(NULL), roots_(NULL), labelData_(NULL), map_(NULL), mapSize_(0) {
+}
+
+LocalFeatureIndex::~LocalFeatureIndex() {
+  unmap();
+}
+
+void LocalFeatureIndex::unmap() {
+  if(map_) {
+    munmap(const_cast<char*>(map_), mapSize_);
+    map_=NULL;
+    mapSize_=0;
+  }
+}
+
+void LocalFeatureIndex::setPointers() {
+  labelOffsets_=labelOffsetData_.empty() ? NULL : &labelOffsetData_[0];
+  node_=nodeData_.empty() ? NULL : &nodeData_[0];
+  features_=featureData_.empty() ? NULL : &featureData_[0];
+  featureLabels_=featureLabelData_.empty() ? NULL : &featureLabelData_[0];
+  order_=orderData_.empty() ? NULL : &orderData_[0];
+  roots_=rootData_.empty() ? NULL : &rootData_[0];
+  labelData_=labelString_.data();
+}
+
+bool LocalFeatureIndex::add(const LocalFeatures& lf) {
+  if(lf.numberOfFeatures()==0) {
+    return true;
+  }
+  if(trees_>0 || map_) {
+    ERR << "Cannot add features to an index that has been built already" << endl;
+    return false;
+  }
+  if(size_>0 && lf.dim()!=dim_) {
+    ERR << "Local features of '" << lf.filename() << "' have dimension " << lf.dim() << " instead of " << dim_ << endl;
+    return false;
+  }
+  if(size_+lf.numberOfFeatures()>=numeric_limits<uint32_t>::max()) {
+    ERR << "Too many local features for one index" << endl;
+    return false;
+  }
+  dim_=lf.dim();
+
+  map<string,uint32_t>::const_iterator it=addedLabels_.find(lf.filename());
+  uint32_t label;
+  if(it==addedLabels_.end()) {
+    label=addedLabels_.size();
+    addedLabels_[lf.filename()]=label;
+  } else {
+    label=it->second;
+  }
+
+  featureData_.reserve(featureData_.size()+size_t(lf.numberOfFeatures())*dim_);
+  for(uint i=0;i<lf.numberOfFeatures();++i) {
+    const vector<double>& f=lf[i];
+    for(uint d=0;d<dim_;++d) {
+      featureData_.push_back(f[d]);
+    }
+    featureLabelData_.push_back(label);
+  }
+  size_+=lf.numberOfFeatures();
+  return true;
+}
+
+uint32_t LocalFeatureIndex::buildTree(uint32_t* order, uint32_t begin, uint32_t end, vector<Node>& nodes, uint32_t& seed) const {
+  const uint32_t index=nodes.size();
+  nodes.push_back(Node());
+  if(end-begin<=leafSize) {
+    nodes[index].dim=leaf;
+    nodes[index].value=0.0;
+    nodes[index].first=begin;
+    nodes[index].second=end;
+    return index;
+  }
+
+  // mean and variance on a sample of the features
+  const uint32_t samples=min(end-begin, sampleSize);
+  vector<double> mean(dim_,0.0), var(dim_,0.0);
+  for(uint32_t s=0;s<samples;++s) {
+    const float* f=features_+size_t(order[begin+uint64_t(s)*(end-begin)/samples])*dim_;
+    for(uint d=0;d<dim_;++d) {
+      mean[d]+=f[d];
+    }
+  }
+  for(uint d=0;d<dim_;++d) {
+    mean[d]/=samples;
+  }
+  for(uint32_t s=0;s<samples;++s) {
+    const float* f=features_+size_t(order[begin+uint64_t(s)*(end-begin)/samples])*dim_;
+    for(uint d=0;d<dim_;++d) {
+      const double diff=f[d]-mean[d];
+      var[d]+=diff*diff;
+    }
+  }
+  vector< pair<double,uint> > dims(dim_);
+  for(uint d=0;d<dim_;++d) {
+    dims[d]=make_pair(-var[d],d);
+  }
+  const uint candidates=min(splitCandidates, dim_);
+  partial_sort(dims.begin(), dims.begin()+candidates, dims.end());
+  const uint32_t dim=dims[nextRandom(seed)%candidates].second;
+
+  // split at the mean, or at the median if all features are on one side.
+  // The features left of the split are <= value, the others >= value.
+  float value=mean[dim];
+  uint32_t* middle=partition(order+begin, order+end, SplitLess(features_, dim_, dim, value));
+  if(middle==order+begin || middle==order+end) {
+    middle=order+begin+(end-begin)/2;
+    nth_element(order+begin, middle, order+end, FeatureLess(features_, dim_, dim));
+    value=features_[size_t(*middle)*dim_+dim];
+  }
+
+  const uint32_t left=buildTree(order, begin, middle-order, nodes, seed);
+  const uint32_t right=buildTree(order, middle-order, end, nodes, seed);
+  nodes[index].dim=dim;
+  nodes[index].value=value;
+  nodes[index].first=left;
+  nodes[index].second=right;
+  return index;
+}
+
+bool LocalFeatureIndex::build(uint trees) {
+  if(size_==0 || trees==0) {
+    ERR << "Cannot build an index without features or trees" << endl;
+    return false;
+  }
+  if(trees_>0 || map_) {
+    ERR << "Index has been built already" << endl;
+    return false;
+  }
+
+  // number the labels in sorted order
+  vector<uint32_t> renumber(addedLabels_.size());
+  labelOffsetData_.clear();
+  labelString_.clear();
+  uint32_t l=0;
+  for(map<string,uint32_t>::const_iterator it=addedLabels_.begin();it!=addedLabels_.end();++it,++l) {
+    renumber[it->second]=l;
+    labelOffsetData_.push_back(labelString_.size());
+    labelString_+=it->first;
+  }
+  labelOffsetData_.push_back(labelString_.size());
+  for(uint64_t f=0;f<size_;++f) {
+    featureLabelData_[f]=renumber[featureLabelData_[f]];
+  }
+  labels_=addedLabels_.size();
+  addedLabels_.clear();
+
+  orderData_.resize(size_t(trees)*size_);
+  setPointers();
+
+  vector< vector<Node> > treeNodes(trees);
+  vector<uint32_t> treeRoots(trees);
+#pragma omp parallel for schedule(dynamic,1)
+  for(long t=0;t<long(trees);++t) {
+    uint32_t* order=&orderData_[size_t(t)*size_];
+    for(uint32_t f=0;f<size_;++f) {
+      order[f]=f;
+    }
+    uint32_t seed=t*7919+1;
+    treeRoots[t]=buildTree(order, 0, size_, treeNodes[t], seed);
+  }
+
+  nodeData_.clear();
+  rootData_.resize(trees);
+  for(uint t=0;t<trees;++t) {
+    const uint32_t offset=nodeData_.size();
+    for(uint n=0;n<treeNodes[t].size();++n) {
+      Node node=treeNodes[t][n];
+      if(node.dim!=leaf) {
+        node.first+=offset;
+        node.second+=offset;
+      }
+      nodeData_.push_back(node);
+    }
+    rootData_[t]=treeRoots[t]+offset;
+    vector<Node>().swap(treeNodes[t]);
+  }
+  trees_=trees;
+  nodes_=nodeData_.size();
+  setPointers();
+
+  DBG(10) << "Built " << trees_ << " trees over " << size_ << " local features of dimension " << dim_ << " from " << labels_ << " images" << endl;
+  return true;
+}
+
+bool LocalFeatureIndex::save(const string& filename) const {
+  ofstream ofs(filename.c_str(), ios::binary);
+  if(!ofs.good() || trees_==0) {
+    ERR << "Cannot write index '" << filename << "'" << endl;
+    return false;
+  }
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, lfiMagic, sizeof(lfiMagic));
+  header.version=lfiVersion;
+  header.dim=dim_;
+  header.trees=trees_;
+  header.labels=labels_;
+  header.size=size_;
+  header.nodes=nodes_;
+  header.labelBytes=labelOffsets_[labels_];
+  ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  ofs.write(reinterpret_cast<const char*>(labelOffsets_), (size_t(labels_)+1)*sizeof(uint64_t));
+  ofs.write(reinterpret_cast<const char*>(node_), nodes_*sizeof(Node));
+  ofs.write(reinterpret_cast<const char*>(features_), size_*dim_*sizeof(float));
+  ofs.write(reinterpret_cast<const char*>(featureLabels_), size_*sizeof(uint32_t));
+  ofs.write(reinterpret_cast<const char*>(order_), size_*trees_*sizeof(uint32_t));
+  ofs.write(reinterpret_cast<const char*>(roots_), trees_*sizeof(uint32_t));
+  ofs.write(labelData_, header.labelBytes);
+  if(!ofs.good()) {
+    ERR << "Cannot write index '" << filename << "'" << endl;
+    return false;
+  }
+  DBG(10) << "Saved index to " << filename << endl;
+  return true;
+}
+
+bool LocalFeatureIndex::load(const string& filename) {
+  int fd=open(filename.c_str(), O_RDONLY);
+  struct stat st;
+  if(fd<0) {
+    ERR << "Cannot open index '" << filename << "'" << endl;
+    return false;
+  }
+  if(fstat(fd,&st)!=0 || size_t(st.st_size)<sizeof(Header)) {
+    ERR << "Index '" << filename << "' is too short" << endl;
+    close(fd);
+    return false;
+  }
+  void *mem=mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(mem==MAP_FAILED) {
+    ERR << "Cannot map index '" << filename << "'" << endl;
+    return false;
+  }
+
+  // the nodes, features and their order are checked while searching,
+  // reading them all here would touch the whole file
+  Header header;
+  memcpy(&header, mem, sizeof(header));
+  const char* data=static_cast<const char*>(mem);
+  const size_t labelOffsetsPos=sizeof(Header);
+  const size_t nodesPos=labelOffsetsPos+(size_t(header.labels)+1)*sizeof(uint64_t);
+  const size_t featuresPos=nodesPos+header.nodes*sizeof(Node);
+  const size_t featureLabelsPos=featuresPos+header.size*header.dim*sizeof(float);
+  const size_t orderPos=featureLabelsPos+header.size*sizeof(uint32_t);
+  const size_t rootsPos=orderPos+header.size*header.trees*sizeof(uint32_t);
+  const size_t labelDataPos=rootsPos+header.trees*sizeof(uint32_t);
+  bool ok=memcmp(header.magic, lfiMagic, sizeof(lfiMagic))==0 && header.version==lfiVersion &&
+    header.trees>0 && header.size>0 && header.size<numeric_limits<uint32_t>::max() &&
+    size_t(st.st_size)==labelDataPos+header.labelBytes;
+  if(ok) {
+    const uint64_t* labelOffsets=reinterpret_cast<const uint64_t*>(data+labelOffsetsPos);
+    const uint32_t* roots=reinterpret_cast<const uint32_t*>(data+rootsPos);
+    ok=labelOffsets[0]==0 && labelOffsets[header.labels]==header.labelBytes;
+    for(uint l=0;ok && l<header.labels;++l) {
+      ok=labelOffsets[l]<=labelOffsets[l+1];
+    }
+    for(uint t=0;ok && t<header.trees;++t) {
+      ok=roots[t]<header.nodes;
+    }
+  }
+  if(!ok) {
+    ERR << "'" << filename << "' is not a valid local feature index" << endl;
+    munmap(mem, st.st_size);
+    return false;
+  }
+
+  unmap();
+  labelOffsetData_.clear();
+  nodeData_.clear();
+  featureData_.clear();
+  featureLabelData_.clear();
+  orderData_.clear();
+  rootData_.clear();
+  labelString_.clear();
+  addedLabels_.clear();
+  map_=data;
+  mapSize_=st.st_size;
+  dim_=header.dim;
+  trees_=header.trees;
+  labels_=header.labels;
+  size_=header.size;
+  nodes_=header.nodes;
+  labelOffsets_=reinterpret_cast<const uint64_t*>(data+labelOffsetsPos);
+  node_=reinterpret_cast<const Node*>(data+nodesPos);
+  features_=reinterpret_cast<const float*>(data+featuresPos);
+  featureLabels_=reinterpret_cast<const uint32_t*>(data+featureLabelsPos);
+  order_=reinterpret_cast<const uint32_t*>(data+orderPos);
+  roots_=reinterpret_cast<const uint32_t*>(data+rootsPos);
+  labelData_=data+labelDataPos;
+  DBG(10) << "Mapped index " << filename << ": " << trees_ << " trees over " << size_ << " local features of dimension " << dim_ << " from " << labels_ << " images" << endl;
+  return true;
+}
+
+float LocalFeatureIndex::featureDistance(const float* query, uint32_t f, float limit) const {
+  const float* v=features_+size_t(f)*dim_;
+  float result=0.0;
+  for(uint d=0;d<dim_;++d) {
+    const float diff=query[d]-v[d];
+    result+=diff*diff;
+    if((d&15)==15 && result>limit) {
+      break;
+    }
+  }
+  return result;
+}
+
+uint LocalFeatureIndex::search(const float* query, uint k, double epsilon, uint checks, uint32_t* neighbours) const {
+  if(trees_==0 || k==0) {
+    return 0;
+  }
+  const float scale=(1.0+epsilon)*(1.0+epsilon);
+  // the k best features found so far, the worst one on top
+  vector< pair<float,uint32_t> > best;
+  best.reserve(k+1);
+  float worst=numeric_limits<float>::max();
+  uint checked=0;
+  priority_queue<Branch> branches;
+  for(uint t=0;t<trees_;++t) {
+    branches.push(Branch(0.0, roots_[t], t));
+  }
+
+  while(!branches.empty()) {
+    const Branch branch=branches.top();
+    branches.pop();
+    if(best.size()==k && (branch.bound*scale>=worst || (checks>0 && checked>=checks))) {
+      break;
+    }
+
+    // descend to a leaf, remembering the branches not taken
+    uint32_t n=branch.node;
+    while(n<nodes_ && node_[n].dim!=leaf) {
+      const Node& node=node_[n];
+      const float diff=query[node.dim]-node.value;
+      const float bound=max(branch.bound, diff*diff);
+      const uint32_t nearer=diff<0 ? node.first : node.second;
+      const uint32_t further=diff<0 ? node.second : node.first;
+      if(best.size()<k || bound*scale<worst) {
+        branches.push(Branch(bound, further, branch.tree));
+      }
+      n=nearer;
+    }
+    if(n>=nodes_) {
+      continue;
+    }
+
+    const uint32_t* order=order_+size_t(branch.tree)*size_;
+    for(uint32_t i=node_[n].first;i<node_[n].second && i<size_;++i) {
+      const uint32_t f=order[i];
+      if(f>=size_) {
+        continue;
+      }
+      ++checked;
+      const float dist=featureDistance(query, f, worst);
+      if(best.size()==k && dist>=worst) {
+        continue;
+      }
+      // the same feature may be found in several trees
+      bool found=false;
+      for(uint j=0;j<best.size() && !found;++j) {
+        found=best[j].second==f;
+      }
+      if(found) {
+        continue;
+      }
+      best.push_back(make_pair(dist,f));
+      push_heap(best.begin(), best.end());
+      if(best.size()>k) {
+        pop_heap(best.begin(), best.end());
+        best.pop_back();
+      }
+      if(best.size()==k) {
+        worst=best.front().first;
+      }
+    }
+  }
+
+  sort_heap(best.begin(), best.end());
+  for(uint i=0;i<best.size();++i) {
+    neighbours[i]=featureLabels_[best[i].second];
+  }
+  return best.size();
+}
+
+uint LocalFeatureIndex::vote(const LocalFeatures& query, uint k, double epsilon, uint checks, vector<uint>& votes) const {
+  votes.assign(labels_, 0);
+  const uint N=query.numberOfFeatures();
+  if(trees_==0 || N==0) {
+    return 0;
+  }
+  if(query.dim()!=dim_) {
+    ERR << "Query local features have dimension " << query.dim() << " instead of " << dim_ << endl;
+    return 0;
+  }
+
+  vector<uint32_t> neighbours(size_t(N)*k);
+  vector<uint> found(N);
+#pragma omp parallel
+  {
+    vector<float> point(dim_);
+#pragma omp for schedule(dynamic,16)
+    for(long i=0;i<long(N);++i) {
+      const vector<double>& f=query[i];
+      for(uint d=0;d<dim_;++d) {
+        point[d]=f[d];
+      }
+      found[i]=search(&point[0], k, epsilon, checks, &neighbours[size_t(i)*k]);
+    }
+  }
+
+  uint result=0;
+  for(uint i=0;i<N;++i) {
+    for(uint j=0;j<found[i];++j) {
+      const uint32_t l=neighbours[size_t(i)*k+j];
+      if(l<labels_) {
+        ++votes[l];
+        ++result;
+      }
+    }
+  }
+  return result;
+}
+
+uint LocalFeatureIndex::label(const string& name) const {
+  uint low=0, high=labels_;
+  while(low<high) {
+    const uint mid=low+(high-low)/2;
+    const int cmp=name.compare(0, string::npos, labelData_+labelOffsets_[mid], labelOffsets_[mid+1]-labelOffsets_[mid]);
+    if(cmp==0) {
+      return mid;
+    } else if(cmp<0) {
+      high=mid;
+    } else {
+      low=mid+1;
+    }
+  }
+  return labels_;
+}
+
+string LocalFeatureIndex::labelName(uint l) const {
+  if(l>=labels_) {
+    return "";
+  }
+  return string(labelData_+labelOffsets_[l], labelOffsets_[l+1]-labelOffsets_[l]);
+}
@@ -0,0 +1,151 @@
+/*
+  This file is part of the FIRE -- Flexible Image Retrieval System
+  
+  FIRE is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+  
+  FIRE is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with FIRE; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#ifndef __localfeatureindex_hpp__
+#define __localfeatureindex_hpp__
+
+#include <string>
+#include <vector>
+#include <map>
+#include <stdint.h>
+#include "localfeatures.hpp"
+
+/** LocalFeatureIndex: a forest of randomised kd-trees over the local
+    features of all database images, used for approximate nearest
+    neighbour search of local features.
+
+    Every local feature is labelled with the filename of the image it
+    was extracted from, labels are numbered in sorted order so that
+    they can be used as image ids. Each tree splits at the mean of one
+    of the dimensions with the highest variance (chosen at random), the
+    trees are searched together best bin first: a search stops when
+    checks local features have been compared or when no unseen bin
+    can contain a neighbour closer than the k-th one found by more than
+    a factor of 1+epsilon. checks=0 and epsilon=0 give an exact search.
+
+    The index is built by add()ing the local features of all images and
+    calling build(). It is saved as one binary file which is mapped into
+    memory when it is loaded: a header, the label offsets (uint64), the
+    tree nodes, the features (floats), the label of every feature, the
+    feature order of all trees, the roots (all uint32) and the labels.
+
+    search() and vote() may be called from several threads at the same time.
+ */
+class LocalFeatureIndex {
+private:
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t dim;
+    uint32_t trees;
+    uint32_t labels;
+    uint64_t size;
+    uint64_t nodes;
+    uint64_t labelBytes;
+  };
+
+  /// an inner node splits at value in dimension dim, a leaf
+  /// (dim==leaf) holds the features order[first..second) of its tree
+  struct Node {
+    uint32_t dim;
+    float value;
+    uint32_t first;
+    uint32_t second;
+  };
+  static const uint32_t leaf=0xffffffff;
+
+  uint dim_, trees_, labels_;
+  uint64_t size_, nodes_;
+
+  /// the index data, pointing into the vectors below after build()
+  /// and into the mapped file after load()
+  const uint64_t* labelOffsets_;
+  const Node* node_;
+  const float* features_;
+  const uint32_t* featureLabels_;
+  const uint32_t* order_;
+  const uint32_t* roots_;
+  const char* labelData_;
+
+  ::std::vector<uint64_t> labelOffsetData_;
+  ::std::vector<Node> nodeData_;
+  ::std::vector<float> featureData_;
+  ::std::vector<uint32_t> featureLabelData_;
+  ::std::vector<uint32_t> orderData_;
+  ::std::vector<uint32_t> rootData_;
+  ::std::string labelString_;
+
+  /// the labels while features are added, with their preliminary numbers
+  ::std::map< ::std::string, uint32_t > addedLabels_;
+
+  const char* map_;
+  size_t mapSize_;
+
+  /// build one tree over order[begin..end) of one tree into nodes, returns its root
+  uint32_t buildTree(uint32_t* order, uint32_t begin, uint32_t end, ::std::vector<Node>& nodes, uint32_t& seed) const;
+
+  /// the squared euclidean distance between the query and feature f,
+  /// may stop early and return something larger once it exceeds limit
+  float featureDistance(const float* query, uint32_t f, float limit) const;
+
+  void unmap();
+  void setPointers();
+
+  // not copyable
+  LocalFeatureIndex(const LocalFeatureIndex&);
+  LocalFeatureIndex& operator=(const LocalFeatureIndex&);
+
+public:
+  LocalFeatureIndex();
+  ~LocalFeatureIndex();
+
+  /// add the local features of one image, labelled with lf.filename().
+  /// Returns false if they do not have the dimensionality of the ones
+  /// added before.
+  bool add(const LocalFeatures& lf);
+
+  /// build trees trees over all added features
+  bool build(uint trees=4);
+
+  /// write the index to the given file
+  bool save(const ::std::string& filename) const;
+
+  /// map the index from the given file
+  bool load(const ::std::string& filename);
+
+  /// the labels of the k nearest neighbours of query (dim() floats),
+  /// nearest first. Returns the number of neighbours found.
+  uint search(const float* query, uint k, double epsilon, uint checks, uint32_t* neighbours) const;
+
+  /// search the k nearest neighbours of all local features of the
+  /// query in parallel, votes[l] becomes the number of neighbours
+  /// with label l. Returns the number of votes cast.
+  uint vote(const LocalFeatures& query, uint k, double epsilon, uint checks, ::std::vector<uint>& votes) const;
+
+  /// the number of the given label, labels() if it is not contained
+  uint label(const ::std::string& name) const;
+
+  /// the name of label l
+  ::std::string labelName(uint l) const;
+
+  uint dim() const { return dim_; }
+  uint trees() const { return trees_; }
+  uint labels() const { return labels_; }
+  uint64_t size() const { return size_; }
+};
+
+#endif
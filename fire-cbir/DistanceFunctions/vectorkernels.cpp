@@ -0,0 +1,572 @@
+/*
+This file is part of the FIRE -- Flexible Image Retrieval System
+
+FIRE is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+FIRE is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FIRE; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#include <cmath>
+#include "vectorkernels.hpp"
+#include "diag.hpp"
+
+// the vectorised kernels are compiled for the respective instruction
+// set using target attributes, such that the rest of FIRE does not
+// need -mavx2 and still runs on every x86 CPU.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(FIRE_NO_SIMD)
+#define FIRE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+/*----------------------------------------------------------------------
+ * scalar versions: these are the loops of the distance() methods
+ *--------------------------------------------------------------------*/
+
+double VectorKernels::Scalar::euclidean(const double* q, const double* d, uint dim) {
+  double result=0.0, tmp;
+  for(uint i=0;i<dim;++i) {
+    tmp=d[i]-q[i];
+    result+=tmp*tmp;
+  }
+  return result;
+}
+
+double VectorKernels::Scalar::l1(const double* q, const double* d, uint dim) {
+  double result=0.0;
+  for(uint i=0;i<dim;++i) {
+    result+=fabs(d[i]-q[i]);
+  }
+  return result;
+}
+
+double VectorKernels::Scalar::chisquare(const double* q, const double* d, uint dim) {
+  double result=0.0, tmp, n1, n2;
+  for(uint i=0;i<dim;++i) {
+    n1=d[i];
+    n2=q[i];
+    if(n1+n2!=0) {
+      tmp=n1-n2;
+      tmp*=tmp;
+      tmp/=(n1+n2);
+      result+=tmp;
+    }
+  }
+  return result;
+}
+
+double VectorKernels::Scalar::histogramintersection(const double* q, const double* d, uint dim) {
+  double result=0.0;
+  for(uint i=0;i<dim;++i) {
+    result+=(d[i]<q[i]) ? d[i] : q[i];
+  }
+  return 1-result;
+}
+
+double VectorKernels::Scalar::jsd(const double* q, const double* d, uint dim) {
+  double result=0.0;
+  float tmp1,tmp2;
+  float n1,n2,by_n;
+  for(uint i=0;i<dim;++i) {
+    n1=(float)d[i];
+    n2=(float)q[i];
+    if(n1==0 && n2==0) continue;
+    by_n=2.0f/(n1+n2);
+    if(n1==0) {
+      tmp2=log(by_n*n2)*n2;
+      result+=tmp2;
+    } else if(n2==0) {
+      tmp1=log(by_n*n1)*n1;
+      result+=tmp1;
+    } else {
+      tmp2=log(by_n*n2)*n2;
+      tmp1=log(by_n*n1)*n1;
+      result+=tmp1;
+      result+=tmp2;
+    }
+  }
+  return result;
+}
+
+double VectorKernels::Scalar::kld(const double* q, const double* d, uint dim) {
+  double result=0.0, n1, n2;
+  for(uint i=0;i<dim;++i) {
+    n1=d[i];
+    n2=q[i];
+    if(n1!=0 && n2!=0) {
+      result+=log(n1/n2)*n1;
+    }
+  }
+  return result;
+}
+
+double VectorKernels::Scalar::fidelity(const double* q, const double* d, uint dim) {
+  double result=0.0;
+  for(uint i=0;i<dim;++i) {
+    result+=sqrt(d[i])*sqrt(q[i]);
+  }
+  return result;
+}
+
+#ifdef FIRE_X86_KERNELS
+
+/*----------------------------------------------------------------------
+ * logarithm approximations. Both follow the cephes library: split
+ * x=m*2^e with m in [sqrt(0.5),sqrt(2)), approximate log(m) by a
+ * polynomial (single precision) or a rational function (double
+ * precision) and add e*log(2) in two parts.
+ * Only valid for positive, finite x; other lanes are masked out by
+ * the callers.
+ *--------------------------------------------------------------------*/
+
+namespace {
+
+  // single precision, 4 lanes
+  __attribute__((target("sse4.1")))
+  inline __m128 log_ps(__m128 x) {
+    const __m128 one=_mm_set1_ps(1.0f);
+    x=_mm_max_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x00800000))); // no denormals
+
+    __m128i ix=_mm_castps_si128(x);
+    __m128i emm0=_mm_sub_epi32(_mm_srli_epi32(ix, 23), _mm_set1_epi32(126));
+    x=_mm_castsi128_ps(_mm_or_si128(_mm_and_si128(ix, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f000000)));
+    __m128 e=_mm_cvtepi32_ps(emm0);
+
+    // x in [0.5,1): if x<sqrt(0.5) use 2x-1 and e-1, else x-1
+    __m128 mask=_mm_cmplt_ps(x, _mm_set1_ps(0.707106781186547524f));
+    __m128 tmp=_mm_and_ps(x, mask);
+    x=_mm_sub_ps(x, one);
+    e=_mm_sub_ps(e, _mm_and_ps(one, mask));
+    x=_mm_add_ps(x, tmp);
+
+    __m128 z=_mm_mul_ps(x, x);
+    __m128 y=_mm_set1_ps(7.0376836292E-2f);
+    y=_mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.1514610310E-1f));
+    y=_mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.1676998740E-1f));
+    y=_mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.2420140846E-1f));
+    y=_mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.4249322787E-1f));
+    y=_mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.6668057665E-1f));
+    y=_mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(2.0000714765E-1f));
+    y=_mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-2.4999993993E-1f));
+    y=_mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(3.3333331174E-1f));
+    y=_mm_mul_ps(_mm_mul_ps(y, x), z);
+
+    y=_mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(-2.12194440e-4f)));
+    y=_mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+    x=_mm_add_ps(x, y);
+    return _mm_add_ps(x, _mm_mul_ps(e, _mm_set1_ps(0.693359375f)));
+  }
+
+  // single precision, 8 lanes
+  __attribute__((target("avx2")))
+  inline __m256 log256_ps(__m256 x) {
+    const __m256 one=_mm256_set1_ps(1.0f);
+    x=_mm256_max_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(0x00800000)));
+
+    __m256i ix=_mm256_castps_si256(x);
+    __m256i emm0=_mm256_sub_epi32(_mm256_srli_epi32(ix, 23), _mm256_set1_epi32(126));
+    x=_mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(ix, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f000000)));
+    __m256 e=_mm256_cvtepi32_ps(emm0);
+
+    __m256 mask=_mm256_cmp_ps(x, _mm256_set1_ps(0.707106781186547524f), _CMP_LT_OS);
+    __m256 tmp=_mm256_and_ps(x, mask);
+    x=_mm256_sub_ps(x, one);
+    e=_mm256_sub_ps(e, _mm256_and_ps(one, mask));
+    x=_mm256_add_ps(x, tmp);
+
+    __m256 z=_mm256_mul_ps(x, x);
+    __m256 y=_mm256_set1_ps(7.0376836292E-2f);
+    y=_mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(-1.1514610310E-1f));
+    y=_mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.1676998740E-1f));
+    y=_mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(-1.2420140846E-1f));
+    y=_mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.4249322787E-1f));
+    y=_mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(-1.6668057665E-1f));
+    y=_mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(2.0000714765E-1f));
+    y=_mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(-2.4999993993E-1f));
+    y=_mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(3.3333331174E-1f));
+    y=_mm256_mul_ps(_mm256_mul_ps(y, x), z);
+
+    y=_mm256_add_ps(y, _mm256_mul_ps(e, _mm256_set1_ps(-2.12194440e-4f)));
+    y=_mm256_sub_ps(y, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+    x=_mm256_add_ps(x, y);
+    return _mm256_add_ps(x, _mm256_mul_ps(e, _mm256_set1_ps(0.693359375f)));
+  }
+
+  // coefficients of the double precision rational approximation
+  const double logP[6]={1.01875663804580931796E-4, 4.97494994976747001425E-1, 4.70579119878881725854E0,
+                        1.44989225341610930846E1, 1.79368678507819816313E1, 7.70838733755885391666E0};
+  const double logQ[5]={1.12873587189167450590E1, 4.52279145837532221105E1, 8.29875266912776603211E1,
+                        7.11544750618563894466E1, 2.31251620126765340583E1};
+
+  // double precision, 2 lanes
+  __attribute__((target("sse4.1")))
+  inline __m128d log_pd(__m128d x) {
+    const __m128d one=_mm_set1_pd(1.0);
+    const __m128d two52=_mm_set1_pd(4503599627370496.0);
+    x=_mm_max_pd(x, _mm_set1_pd(2.2250738585072014e-308));
+
+    __m128i ix=_mm_castpd_si128(x);
+    // exponent as double: put the biased exponent into the mantissa of 2^52
+    __m128d e=_mm_sub_pd(_mm_castsi128_pd(_mm_or_si128(_mm_srli_epi64(ix, 52), _mm_castpd_si128(two52))), two52);
+    e=_mm_sub_pd(e, _mm_set1_pd(1022.0));
+    x=_mm_castsi128_pd(_mm_or_si128(_mm_and_si128(ix, _mm_set1_epi64x(0x000fffffffffffffLL)), _mm_set1_epi64x(0x3fe0000000000000LL)));
+
+    __m128d mask=_mm_cmplt_pd(x, _mm_set1_pd(0.70710678118654752440));
+    __m128d tmp=_mm_and_pd(x, mask);
+    x=_mm_sub_pd(x, one);
+    e=_mm_sub_pd(e, _mm_and_pd(one, mask));
+    x=_mm_add_pd(x, tmp);
+
+    __m128d z=_mm_mul_pd(x, x);
+    __m128d p=_mm_set1_pd(logP[0]);
+    for(uint k=1;k<6;++k) p=_mm_add_pd(_mm_mul_pd(p, x), _mm_set1_pd(logP[k]));
+    __m128d r=_mm_add_pd(x, _mm_set1_pd(logQ[0]));
+    for(uint k=1;k<5;++k) r=_mm_add_pd(_mm_mul_pd(r, x), _mm_set1_pd(logQ[k]));
+    __m128d y=_mm_mul_pd(x, _mm_div_pd(_mm_mul_pd(z, p), r));
+
+    y=_mm_sub_pd(y, _mm_mul_pd(e, _mm_set1_pd(2.121944400546905827679e-4)));
+    y=_mm_sub_pd(y, _mm_mul_pd(z, _mm_set1_pd(0.5)));
+    x=_mm_add_pd(x, y);
+    return _mm_add_pd(x, _mm_mul_pd(e, _mm_set1_pd(0.693359375)));
+  }
+
+  // double precision, 4 lanes
+  __attribute__((target("avx2")))
+  inline __m256d log256_pd(__m256d x) {
+    const __m256d one=_mm256_set1_pd(1.0);
+    const __m256d two52=_mm256_set1_pd(4503599627370496.0);
+    x=_mm256_max_pd(x, _mm256_set1_pd(2.2250738585072014e-308));
+
+    __m256i ix=_mm256_castpd_si256(x);
+    __m256d e=_mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(ix, 52), _mm256_castpd_si256(two52))), two52);
+    e=_mm256_sub_pd(e, _mm256_set1_pd(1022.0));
+    x=_mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(ix, _mm256_set1_epi64x(0x000fffffffffffffLL)), _mm256_set1_epi64x(0x3fe0000000000000LL)));
+
+    __m256d mask=_mm256_cmp_pd(x, _mm256_set1_pd(0.70710678118654752440), _CMP_LT_OS);
+    __m256d tmp=_mm256_and_pd(x, mask);
+    x=_mm256_sub_pd(x, one);
+    e=_mm256_sub_pd(e, _mm256_and_pd(one, mask));
+    x=_mm256_add_pd(x, tmp);
+
+    __m256d z=_mm256_mul_pd(x, x);
+    __m256d p=_mm256_set1_pd(logP[0]);
+    for(uint k=1;k<6;++k) p=_mm256_add_pd(_mm256_mul_pd(p, x), _mm256_set1_pd(logP[k]));
+    __m256d r=_mm256_add_pd(x, _mm256_set1_pd(logQ[0]));
+    for(uint k=1;k<5;++k) r=_mm256_add_pd(_mm256_mul_pd(r, x), _mm256_set1_pd(logQ[k]));
+    __m256d y=_mm256_mul_pd(x, _mm256_div_pd(_mm256_mul_pd(z, p), r));
+
+    y=_mm256_sub_pd(y, _mm256_mul_pd(e, _mm256_set1_pd(2.121944400546905827679e-4)));
+    y=_mm256_sub_pd(y, _mm256_mul_pd(z, _mm256_set1_pd(0.5)));
+    x=_mm256_add_pd(x, y);
+    return _mm256_add_pd(x, _mm256_mul_pd(e, _mm256_set1_pd(0.693359375)));
+  }
+
+  __attribute__((target("sse4.1")))
+  inline double hsum(__m128d v) {
+    return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+  }
+
+  __attribute__((target("avx2")))
+  inline double hsum256(__m256d v) {
+    __m128d s=_mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+  }
+}
+
+/*----------------------------------------------------------------------
+ * SSE4.1 versions, two doubles at a time
+ *--------------------------------------------------------------------*/
+
+namespace VectorKernels {
+  namespace SSE41 {
+
+    __attribute__((target("sse4.1")))
+    double euclidean(const double* q, const double* d, uint dim) {
+      __m128d acc0=_mm_setzero_pd(), acc1=_mm_setzero_pd();
+      uint i=0;
+      for(;i+4<=dim;i+=4) {
+        __m128d t0=_mm_sub_pd(_mm_loadu_pd(d+i), _mm_loadu_pd(q+i));
+        __m128d t1=_mm_sub_pd(_mm_loadu_pd(d+i+2), _mm_loadu_pd(q+i+2));
+        acc0=_mm_add_pd(acc0, _mm_mul_pd(t0, t0));
+        acc1=_mm_add_pd(acc1, _mm_mul_pd(t1, t1));
+      }
+      double result=hsum(_mm_add_pd(acc0, acc1));
+      return result+Scalar::euclidean(q+i, d+i, dim-i);
+    }
+
+    __attribute__((target("sse4.1")))
+    double l1(const double* q, const double* d, uint dim) {
+      const __m128d absmask=_mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+      __m128d acc0=_mm_setzero_pd(), acc1=_mm_setzero_pd();
+      uint i=0;
+      for(;i+4<=dim;i+=4) {
+        acc0=_mm_add_pd(acc0, _mm_and_pd(absmask, _mm_sub_pd(_mm_loadu_pd(d+i), _mm_loadu_pd(q+i))));
+        acc1=_mm_add_pd(acc1, _mm_and_pd(absmask, _mm_sub_pd(_mm_loadu_pd(d+i+2), _mm_loadu_pd(q+i+2))));
+      }
+      double result=hsum(_mm_add_pd(acc0, acc1));
+      return result+Scalar::l1(q+i, d+i, dim-i);
+    }
+
+    __attribute__((target("sse4.1")))
+    double chisquare(const double* q, const double* d, uint dim) {
+      const __m128d zero=_mm_setzero_pd();
+      __m128d acc=_mm_setzero_pd();
+      uint i=0;
+      for(;i+2<=dim;i+=2) {
+        __m128d n1=_mm_loadu_pd(d+i), n2=_mm_loadu_pd(q+i);
+        __m128d s=_mm_add_pd(n1, n2);
+        __m128d t=_mm_sub_pd(n1, n2);
+        __m128d valid=_mm_cmpneq_pd(s, zero);
+        // avoid 0/0 in the lanes that are dropped anyway
+        t=_mm_div_pd(_mm_mul_pd(t, t), _mm_blendv_pd(_mm_set1_pd(1.0), s, valid));
+        acc=_mm_add_pd(acc, _mm_and_pd(t, valid));
+      }
+      return hsum(acc)+Scalar::chisquare(q+i, d+i, dim-i);
+    }
+
+    __attribute__((target("sse4.1")))
+    double histogramintersection(const double* q, const double* d, uint dim) {
+      __m128d acc0=_mm_setzero_pd(), acc1=_mm_setzero_pd();
+      uint i=0;
+      for(;i+4<=dim;i+=4) {
+        acc0=_mm_add_pd(acc0, _mm_min_pd(_mm_loadu_pd(d+i), _mm_loadu_pd(q+i)));
+        acc1=_mm_add_pd(acc1, _mm_min_pd(_mm_loadu_pd(d+i+2), _mm_loadu_pd(q+i+2)));
+      }
+      double result=hsum(_mm_add_pd(acc0, acc1));
+      // the scalar kernel returns 1-sum
+      return Scalar::histogramintersection(q+i, d+i, dim-i)-result;
+    }
+
+    __attribute__((target("sse4.1")))
+    double jsd(const double* q, const double* d, uint dim) {
+      const __m128 zero=_mm_setzero_ps();
+      __m128d acc=_mm_setzero_pd();
+      uint i=0;
+      for(;i+4<=dim;i+=4) {
+        __m128 n1=_mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(d+i)), _mm_cvtpd_ps(_mm_loadu_pd(d+i+2)));
+        __m128 n2=_mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(q+i)), _mm_cvtpd_ps(_mm_loadu_pd(q+i+2)));
+        __m128 by_n=_mm_div_ps(_mm_set1_ps(2.0f), _mm_add_ps(n1, n2));
+        __m128 t1=_mm_and_ps(_mm_mul_ps(log_ps(_mm_mul_ps(by_n, n1)), n1), _mm_cmpneq_ps(n1, zero));
+        __m128 t2=_mm_and_ps(_mm_mul_ps(log_ps(_mm_mul_ps(by_n, n2)), n2), _mm_cmpneq_ps(n2, zero));
+        // the terms are summed in double precision as in JSDDistance
+        acc=_mm_add_pd(acc, _mm_add_pd(_mm_cvtps_pd(t1), _mm_cvtps_pd(_mm_movehl_ps(t1, t1))));
+        acc=_mm_add_pd(acc, _mm_add_pd(_mm_cvtps_pd(t2), _mm_cvtps_pd(_mm_movehl_ps(t2, t2))));
+      }
+      return hsum(acc)+Scalar::jsd(q+i, d+i, dim-i);
+    }
+
+    __attribute__((target("sse4.1")))
+    double kld(const double* q, const double* d, uint dim) {
+      const __m128d zero=_mm_setzero_pd();
+      __m128d acc=_mm_setzero_pd();
+      uint i=0;
+      for(;i+2<=dim;i+=2) {
+        __m128d n1=_mm_loadu_pd(d+i), n2=_mm_loadu_pd(q+i);
+        __m128d valid=_mm_and_pd(_mm_cmpneq_pd(n1, zero), _mm_cmpneq_pd(n2, zero));
+        __m128d ratio=_mm_div_pd(n1, _mm_blendv_pd(_mm_set1_pd(1.0), n2, valid));
+        acc=_mm_add_pd(acc, _mm_and_pd(_mm_mul_pd(log_pd(ratio), n1), valid));
+      }
+      return hsum(acc)+Scalar::kld(q+i, d+i, dim-i);
+    }
+
+    __attribute__((target("sse4.1")))
+    double fidelity(const double* q, const double* d, uint dim) {
+      __m128d acc0=_mm_setzero_pd(), acc1=_mm_setzero_pd();
+      uint i=0;
+      for(;i+4<=dim;i+=4) {
+        acc0=_mm_add_pd(acc0, _mm_mul_pd(_mm_sqrt_pd(_mm_loadu_pd(d+i)), _mm_sqrt_pd(_mm_loadu_pd(q+i))));
+        acc1=_mm_add_pd(acc1, _mm_mul_pd(_mm_sqrt_pd(_mm_loadu_pd(d+i+2)), _mm_sqrt_pd(_mm_loadu_pd(q+i+2))));
+      }
+      double result=hsum(_mm_add_pd(acc0, acc1));
+      return result+Scalar::fidelity(q+i, d+i, dim-i);
+    }
+  }
+
+/*----------------------------------------------------------------------
+ * AVX2 versions, four doubles at a time
+ *--------------------------------------------------------------------*/
+
+  namespace AVX2 {
+
+    __attribute__((target("avx2")))
+    double euclidean(const double* q, const double* d, uint dim) {
+      __m256d acc0=_mm256_setzero_pd(), acc1=_mm256_setzero_pd();
+      uint i=0;
+      for(;i+8<=dim;i+=8) {
+        __m256d t0=_mm256_sub_pd(_mm256_loadu_pd(d+i), _mm256_loadu_pd(q+i));
+        __m256d t1=_mm256_sub_pd(_mm256_loadu_pd(d+i+4), _mm256_loadu_pd(q+i+4));
+        acc0=_mm256_add_pd(acc0, _mm256_mul_pd(t0, t0));
+        acc1=_mm256_add_pd(acc1, _mm256_mul_pd(t1, t1));
+      }
+      double result=hsum256(_mm256_add_pd(acc0, acc1));
+      return result+Scalar::euclidean(q+i, d+i, dim-i);
+    }
+
+    __attribute__((target("avx2")))
+    double l1(const double* q, const double* d, uint dim) {
+      const __m256d absmask=_mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+      __m256d acc0=_mm256_setzero_pd(), acc1=_mm256_setzero_pd();
+      uint i=0;
+      for(;i+8<=dim;i+=8) {
+        acc0=_mm256_add_pd(acc0, _mm256_and_pd(absmask, _mm256_sub_pd(_mm256_loadu_pd(d+i), _mm256_loadu_pd(q+i))));
+        acc1=_mm256_add_pd(acc1, _mm256_and_pd(absmask, _mm256_sub_pd(_mm256_loadu_pd(d+i+4), _mm256_loadu_pd(q+i+4))));
+      }
+      double result=hsum256(_mm256_add_pd(acc0, acc1));
+      return result+Scalar::l1(q+i, d+i, dim-i);
+    }
+
+    __attribute__((target("avx2")))
+    double chisquare(const double* q, const double* d, uint dim) {
+      const __m256d zero=_mm256_setzero_pd();
+      __m256d acc=_mm256_setzero_pd();
+      uint i=0;
+      for(;i+4<=dim;i+=4) {
+        __m256d n1=_mm256_loadu_pd(d+i), n2=_mm256_loadu_pd(q+i);
+        __m256d s=_mm256_add_pd(n1, n2);
+        __m256d t=_mm256_sub_pd(n1, n2);
+        __m256d valid=_mm256_cmp_pd(s, zero, _CMP_NEQ_UQ);
+        t=_mm256_div_pd(_mm256_mul_pd(t, t), _mm256_blendv_pd(_mm256_set1_pd(1.0), s, valid));
+        acc=_mm256_add_pd(acc, _mm256_and_pd(t, valid));
+      }
+      return hsum256(acc)+Scalar::chisquare(q+i, d+i, dim-i);
+    }
+
+    __attribute__((target("avx2")))
+    double histogramintersection(const double* q, const double* d, uint dim) {
+      __m256d acc0=_mm256_setzero_pd(), acc1=_mm256_setzero_pd();
+      uint i=0;
+      for(;i+8<=dim;i+=8) {
+        acc0=_mm256_add_pd(acc0, _mm256_min_pd(_mm256_loadu_pd(d+i), _mm256_loadu_pd(q+i)));
+        acc1=_mm256_add_pd(acc1, _mm256_min_pd(_mm256_loadu_pd(d+i+4), _mm256_loadu_pd(q+i+4)));
+      }
+      double result=hsum256(_mm256_add_pd(acc0, acc1));
+      return Scalar::histogramintersection(q+i, d+i, dim-i)-result;
+    }
+
+    __attribute__((target("avx2")))
+    double jsd(const double* q, const double* d, uint dim) {
+      const __m256 zero=_mm256_setzero_ps();
+      __m256d acc=_mm256_setzero_pd();
+      uint i=0;
+      for(;i+8<=dim;i+=8) {
+        __m256 n1=_mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(_mm256_loadu_pd(d+i))), _mm256_cvtpd_ps(_mm256_loadu_pd(d+i+4)), 1);
+        __m256 n2=_mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(_mm256_loadu_pd(q+i))), _mm256_cvtpd_ps(_mm256_loadu_pd(q+i+4)), 1);
+        __m256 by_n=_mm256_div_ps(_mm256_set1_ps(2.0f), _mm256_add_ps(n1, n2));
+        __m256 t1=_mm256_and_ps(_mm256_mul_ps(log256_ps(_mm256_mul_ps(by_n, n1)), n1), _mm256_cmp_ps(n1, zero, _CMP_NEQ_UQ));
+        __m256 t2=_mm256_and_ps(_mm256_mul_ps(log256_ps(_mm256_mul_ps(by_n, n2)), n2), _mm256_cmp_ps(n2, zero, _CMP_NEQ_UQ));
+        // the terms are summed in double precision as in JSDDistance
+        acc=_mm256_add_pd(acc, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(t1)), _mm256_cvtps_pd(_mm256_extractf128_ps(t1, 1))));
+        acc=_mm256_add_pd(acc, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(t2)), _mm256_cvtps_pd(_mm256_extractf128_ps(t2, 1))));
+      }
+      return hsum256(acc)+Scalar::jsd(q+i, d+i, dim-i);
+    }
+
+    __attribute__((target("avx2")))
+    double kld(const double* q, const double* d, uint dim) {
+      const __m256d zero=_mm256_setzero_pd();
+      __m256d acc=_mm256_setzero_pd();
+      uint i=0;
+      for(;i+4<=dim;i+=4) {
+        __m256d n1=_mm256_loadu_pd(d+i), n2=_mm256_loadu_pd(q+i);
+        __m256d valid=_mm256_and_pd(_mm256_cmp_pd(n1, zero, _CMP_NEQ_UQ), _mm256_cmp_pd(n2, zero, _CMP_NEQ_UQ));
+        __m256d ratio=_mm256_div_pd(n1, _mm256_blendv_pd(_mm256_set1_pd(1.0), n2, valid));
+        acc=_mm256_add_pd(acc, _mm256_and_pd(_mm256_mul_pd(log256_pd(ratio), n1), valid));
+      }
+      return hsum256(acc)+Scalar::kld(q+i, d+i, dim-i);
+    }
+
+    __attribute__((target("avx2")))
+    double fidelity(const double* q, const double* d, uint dim) {
+      __m256d acc0=_mm256_setzero_pd(), acc1=_mm256_setzero_pd();
+      uint i=0;
+      for(;i+8<=dim;i+=8) {
+        acc0=_mm256_add_pd(acc0, _mm256_mul_pd(_mm256_sqrt_pd(_mm256_loadu_pd(d+i)), _mm256_sqrt_pd(_mm256_loadu_pd(q+i))));
+        acc1=_mm256_add_pd(acc1, _mm256_mul_pd(_mm256_sqrt_pd(_mm256_loadu_pd(d+i+4)), _mm256_sqrt_pd(_mm256_loadu_pd(q+i+4))));
+      }
+      double result=hsum256(_mm256_add_pd(acc0, acc1));
+      return result+Scalar::fidelity(q+i, d+i, dim-i);
+    }
+  }
+}
+
+#endif // FIRE_X86_KERNELS
+
+/*----------------------------------------------------------------------
+ * dispatching
+ *--------------------------------------------------------------------*/
+
+namespace VectorKernels {
+
+  // start with the scalar versions, the constructor of the selector
+  // below switches to the best available ones
+  Kernel euclidean=Scalar::euclidean;
+  Kernel l1=Scalar::l1;
+  Kernel chisquare=Scalar::chisquare;
+  Kernel histogramintersection=Scalar::histogramintersection;
+  Kernel jsd=Scalar::jsd;
+  Kernel kld=Scalar::kld;
+  Kernel fidelity=Scalar::fidelity;
+
+  namespace {
+    ::std::string currentSet="scalar";
+
+    bool supported(const ::std::string& name) {
+      if(name=="scalar") return true;
+#ifdef FIRE_X86_KERNELS
+      __builtin_cpu_init();
+      if(name=="sse4.1") return __builtin_cpu_supports("sse4.1");
+      if(name=="avx2") return __builtin_cpu_supports("avx2");
+#endif
+      return false;
+    }
+
+    struct Selector {
+      Selector() {
+        if(!useInstructionSet("avx2")) {
+          if(!useInstructionSet("sse4.1")) {
+            useInstructionSet("scalar");
+          }
+        }
+      }
+    } selector;
+  }
+
+  const ::std::string& instructionSet() {
+    return currentSet;
+  }
+
+  bool useInstructionSet(const ::std::string& name) {
+    if(!supported(name)) {
+      return false;
+    }
+    if(name=="scalar") {
+      euclidean=Scalar::euclidean; l1=Scalar::l1; chisquare=Scalar::chisquare;
+      histogramintersection=Scalar::histogramintersection;
+      jsd=Scalar::jsd; kld=Scalar::kld; fidelity=Scalar::fidelity;
+    }
+#ifdef FIRE_X86_KERNELS
+    else if(name=="sse4.1") {
+      euclidean=SSE41::euclidean; l1=SSE41::l1; chisquare=SSE41::chisquare;
+      histogramintersection=SSE41::histogramintersection;
+      jsd=SSE41::jsd; kld=SSE41::kld; fidelity=SSE41::fidelity;
+    } else if(name=="avx2") {
+      euclidean=AVX2::euclidean; l1=AVX2::l1; chisquare=AVX2::chisquare;
+      histogramintersection=AVX2::histogramintersection;
+      jsd=AVX2::jsd; kld=AVX2::kld; fidelity=AVX2::fidelity;
+    }
+#endif
+    currentSet=name;
+    DBG(15) << "vector kernels use " << currentSet << ::std::endl;
+    return true;
+  }
+}
@@ -0,0 +1,110 @@
+/*
+This file is part of the FIRE -- Flexible Image Retrieval System
+
+FIRE is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+FIRE is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FIRE; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#ifndef __vectorkernels_hpp__
+#define __vectorkernels_hpp__
+
+#include <string>
+#include "vectorfeature.hpp"
+#include "basedistance.hpp"
+
+/** Kernels of the dense vector distances working on plain arrays of
+    doubles, and batchVectorDistances which applies such a kernel to
+    one query and many database features.
+
+    For each kernel there is a plain C++ version (VectorKernels::Scalar)
+    which computes exactly the same value as the distance() method of
+    the corresponding distance, and SSE4.1 and AVX2 versions. Which of
+    them is used is decided once at program start depending on the
+    CPU; the kernels are then called through the function pointers
+    VectorKernels::euclidean etc.
+
+    The vectorised versions sum in a different order than the scalar
+    ones, so the results may differ in the last digits. JSD and KLD
+    use a vectorised polynomial approximation of the logarithm (as in
+    the cephes library), which is accurate to about one ulp in the
+    precision the respective distance works in.
+
+    Misc/testvectorkernels.cpp compares all versions with the scalar
+    distances and measures their speed.
+ */
+namespace VectorKernels {
+
+  typedef double (*Kernel)(const double* q, const double* d, uint dim);
+
+  /// the kernels in use, set to the fastest version for this CPU
+  extern Kernel euclidean;
+  extern Kernel l1;
+  extern Kernel chisquare;
+  extern Kernel histogramintersection;
+  /// single precision as in JSDDistance
+  extern Kernel jsd;
+  extern Kernel kld;
+  /// sum_i sqrt(q_i)*sqrt(d_i), the fidelity distances are functions of it
+  extern Kernel fidelity;
+
+  namespace Scalar {
+    double euclidean(const double* q, const double* d, uint dim);
+    double l1(const double* q, const double* d, uint dim);
+    double chisquare(const double* q, const double* d, uint dim);
+    double histogramintersection(const double* q, const double* d, uint dim);
+    double jsd(const double* q, const double* d, uint dim);
+    double kld(const double* q, const double* d, uint dim);
+    double fidelity(const double* q, const double* d, uint dim);
+  }
+
+  /// the name of the instruction set the kernels currently use:
+  /// "avx2", "sse4.1" or "scalar"
+  const ::std::string& instructionSet();
+
+  /// use the kernels for the given instruction set. returns false
+  /// (and changes nothing) if this CPU or build does not support it.
+  bool useInstructionSet(const ::std::string& name);
+}
+
+/// compare queryFeature with count database features using kernel if
+/// all of them are dense vectors (plain vector features or histograms,
+/// see VectorFeature::dense) of the same size. Features for which this
+/// is not the case are handed to dist.distance().
+/// Compactly stored features are decoded one by one into a buffer
+/// which stays in the cache.
+inline void batchVectorDistances(BaseDistance& dist, VectorKernels::Kernel kernel,
+                                 const BaseFeature* queryFeature, const BaseFeature* const* databaseFeatures,
+                                 uint count, double* result) {
+  const VectorFeature* query=VectorFeature::dense(queryFeature);
+  if(!query) {
+    for(uint n=0;n<count;++n) {
+      result[n]=dist.distance(queryFeature, databaseFeatures[n]);
+    }
+    return;
+  }
+
+  const uint dim=query->size();
+  ::std::vector<double> buffer(2*dim+1);
+  const double* q=query->decoded(&buffer[0]);
+  double* decoded=&buffer[dim];
+  for(uint n=0;n<count;++n) {
+    const VectorFeature* db=VectorFeature::dense(databaseFeatures[n]);
+    if(db && db->size()==dim) {
+      result[n]=kernel(q, db->decoded(decoded), dim);
+    } else {
+      result[n]=dist.distance(queryFeature, databaseFeatures[n]);
+    }
+  }
+}
+
+#endif
@@ -17,6 +17,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
 #include "differenceofgaussian.hpp"
+#include <map>
 
 const int DifferenceOfGaussian::MIN_PATCH_SIZE = 7;
 const int DifferenceOfGaussian::MAX_PATCH_SIZE = 31;
@@ -117,10 +118,10 @@ void DifferenceOfGaussian::fftwImage(const ImageFeature& img, int& paddedSize, f
   
 
   // Fourier-Transformation
-  fftwnd_plan plan = fftw2d_create_plan(paddedWidth, paddedHeight, FFTW_FORWARD, FFTW_ESTIMATE); 
+  fftwnd_plan plan = cachedFFTPlan(paddedHeight, paddedWidth, FFTW_FORWARD);
   fftwnd_one(plan, hsIn, hsTransformed);
   fftwnd_one(plan, vIn, vTransformed);
-  fftwnd_destroy_plan(plan);
+  releaseFFTPlan(plan, paddedHeight, paddedWidth);
   
   // we do not need the complex input data anymore
   delete[] hsIn;
@@ -186,9 +187,10 @@ ImageFeature DifferenceOfGaussian::fftwBackImage(fftw_complex* &hsTransformedIma
   fftwnd_plan plan;
   fftw_complex* hsResult = new fftw_complex[size * size];
   fftw_complex* vResult = new fftw_complex[size * size];
-  plan = fftw2d_create_plan(size, size, FFTW_BACKWARD, FFTW_ESTIMATE); 
+  plan = cachedFFTPlan(size, size, FFTW_BACKWARD);
   fftwnd_one(plan, hsTransformedImage, hsResult);
   fftwnd_one(plan, vTransformedImage, vResult);
+  releaseFFTPlan(plan, size, size);
   //fftwnd_one(plan, hsTransformedFilter, hsResult);
   //fftwnd_one(plan, vTransformedFilter, vResult);
 
@@ -219,7 +221,6 @@ ImageFeature DifferenceOfGaussian::fftwBackImage(fftw_complex* &hsTransformedIma
     }
   }
 
-  fftwnd_destroy_plan(plan);
   delete[] hsResult;
   delete[] vResult;
   delete[] hsTransformedImage;
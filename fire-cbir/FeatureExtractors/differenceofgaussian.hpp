@@ -26,9 +26,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "colorhsv.hpp"
 
 #ifdef HAVE_FFT_LIBRARY
-extern "C" {
-  #include FFTW_INCLUDE
-}
+#include "fftplancache.hpp"
 #endif
 
 struct InterestPoint {
@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "diag.hpp"
 #include "imagefeature.hpp"
 #include "vectorfeature.hpp"
+#include "globalfeatureextraction.hpp"
 using namespace std;
 
 void USAGE() {
@@ -82,8 +83,7 @@ int main(int argc, char** argv) {
     string filename=infiles[i];
     DBG(10) << "Processing '" << filename << "' (" << i+1<< "/" << infiles.size() << "): ";
     img.load(filename);
-    out[0]=img.xsize();
-    out[1]=img.ysize();
+    out=getAspectRatio(img);
     out.save(filename+"."+suffix);
     
     BLINK(10) << out[0] << " " << out[1] << endl;
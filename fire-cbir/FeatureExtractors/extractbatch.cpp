@@ -0,0 +1,466 @@
+/*
+This file is part of the FIRE -- Flexible Image Retrieval System
+
+FIRE is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+FIRE is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FIRE; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <set>
+#include <cstdio>
+#include <sys/time.h>
+#include <unistd.h>
+#include <omp.h>
+#include "getpot.hpp"
+#include "diag.hpp"
+#include "imagefeature.hpp"
+#include "featureset.hpp"
+#include "database.hpp"
+#include "featureloader.hpp"
+#include "largebinaryfeaturefile.hpp"
+#include "extractorregistry.hpp"
+
+using namespace std;
+
+void USAGE() {
+  cout << "USAGE:" << endl
+       << "extractbatch [options] --filelist <filelist>" << endl
+       << "   Extracts the features of all images of a FIRE filelist using the extraction" << endl
+       << "   programs of type2bin, loading each image once for those that can be run in" << endl
+       << "   process. The other programs are run on each image file, their feature files" << endl
+       << "   are read and removed again." << endl
+       << "   The features are written to one large binary feature file per suffix, which" << endl
+       << "   is continued after the last checkpoint when extractbatch is started again." << endl
+       << "   Images that cannot be loaded or whose feature cannot be extracted get the" << endl
+       << "   feature of a blank image (an empty feature for the programs run on the" << endl
+       << "   files) as a placeholder, such that the files keep the order of the filelist." << endl
+       << "   They are listed with the suffix in extractbatch.failed in the target" << endl
+       << "   directory. When the images are available again, --retry extracts these" << endl
+       << "   features and replaces the placeholders in the finished files." << endl
+       << "   Options:" << endl
+       << "    -h, --help                show this help" << endl
+       << "    -f, --filelist <file>     the filelist, giving the images, their path and the suffixes" << endl
+       << "    -t, --type2bin <file>     override the type2bin-path set in the filelist" << endl
+       << "    -s, --suffixes <s1,s2..>  only extract these suffixes (default: all of the filelist)" << endl
+       << "    -d, --targetdirectory <path>  where the large binary feature files are written" << endl
+       << "                              (default: the path of the filelist)" << endl
+       << "    -j, --threads <n>         number of threads (default: number of processors)" << endl
+       << "    -c, --checkpoint <n>      images between two checkpoints (default: 1000)" << endl
+       << "    --restart                 ignore the checkpoints of a previous run" << endl
+       << "    --retry                   extract the features listed in extractbatch.failed again" << endl
+       << "                              and replace their placeholders. extractbatch.failed then" << endl
+       << "                              lists the features which failed again" << endl
+       << endl;
+  exit(20);
+}
+
+namespace {
+  /// wall clock time in seconds, used to report the speed
+  double seconds() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec+tv.tv_usec*1e-6;
+  }
+
+  /// size of the blank image the placeholders are extracted from
+  const uint placeholderSize=64;
+
+  /// how the suffixes given by their positions in the filelist are
+  /// extracted: in process by the registry, or by running the program
+  /// of type2bin, which writes the feature to a temporary suffix
+  struct Extraction {
+    ExtractorRegistry extractors;
+    FeatureLoader loader;
+    vector<uint> suffixes;
+    vector<string> commands;
+    vector<bool> external;
+    vector<string> tempSuffixes;
+  };
+
+  /// extract the features wanted[s] of image img into features[s],
+  /// NULL where the extraction fails. The image is loaded once for all
+  /// suffixes extracted in process.
+  void extractImage(const Extraction& x, const Database& db, const ImageContainer* img,
+                    const vector<bool>& wanted, vector<BaseFeature*>& features) {
+    const string imagefile=db.path()+"/"+img->basename();
+    bool loadImage=false;
+    for(uint s=0;s<x.suffixes.size();++s) {
+      features[s]=NULL;
+      loadImage=loadImage || (wanted[s] && !x.external[s]);
+    }
+    ImageFeature image;
+    const bool loaded=loadImage && image.load(imagefile);
+    if(loadImage && !loaded) {
+#pragma omp critical(extractbatch_messages)
+      ERR << "Cannot load image '" << img->basename() << "'." << endl;
+    }
+    for(uint s=0;s<x.suffixes.size();++s) {
+      if(!wanted[s]) {
+        continue;
+      }
+      BaseFeature *feature=NULL;
+      if(x.external[s]) {
+        const string featurefile=imagefile+"."+x.tempSuffixes[s];
+        if(ExtractorRegistry::runProgram(x.commands[s], x.tempSuffixes[s], imagefile)) {
+          feature=x.loader.makeNewFeature(db.relevantSuffix(x.suffixes[s]));
+          if(feature && !feature->load(featurefile)) {
+            delete feature;
+            feature=NULL;
+          }
+        }
+        remove(featurefile.c_str());
+        if(!feature) {
+#pragma omp critical(extractbatch_messages)
+          ERR << "Cannot extract suffix " << db.suffix(x.suffixes[s]) << " of image '" << img->basename() << "' with '" << x.commands[s] << "'." << endl;
+        }
+      } else if(loaded) {
+        feature=x.extractors.extract(x.commands[s], image);
+        if(!feature) {
+#pragma omp critical(extractbatch_messages)
+          ERR << "Cannot extract suffix " << db.suffix(x.suffixes[s]) << " of image '" << img->basename() << "'." << endl;
+        }
+      }
+      features[s]=feature;
+    }
+  }
+
+  /// extract the features listed in the file of failures again and
+  /// write the files of their suffixes anew, with the new features
+  /// instead of the placeholders. The file of failures is replaced by
+  /// the list of those which failed again. Returns their number.
+  unsigned long int retry(const Extraction& x, Database& db, const string& target, const string& failedName) {
+    ifstream is(failedName.c_str());
+    if(!is.good()) {
+      ERR << "Cannot read '" << failedName << "'. Aborting." << endl;
+      exit(20);
+    }
+    map<string,long int> positions;
+    for(uint i=0;i<db.size();++i) {
+      positions[db[i]->basename()]=i;
+    }
+
+    // the images with their suffixes to extract again. Lines of other
+    // suffixes or images are kept as they are
+    map<long int, vector<bool> > todo;
+    vector<string> kept;
+    string line;
+    while(getline(is,line)) {
+      if(line.empty()) continue;
+      size_t space=line.rfind(' ');
+      string name=line.substr(0,space==string::npos ? 0 : space);
+      string suffix=(space==string::npos) ? string() : line.substr(space+1);
+      uint s=0;
+      while(s<x.suffixes.size() && db.suffix(x.suffixes[s])!=suffix) ++s;
+      if(space==string::npos || s==x.suffixes.size() || !positions.count(name)) {
+        kept.push_back(line);
+        continue;
+      }
+      vector<bool>& wanted=todo[positions[name]];
+      wanted.resize(x.suffixes.size(),false);
+      wanted[s]=true;
+    }
+    is.close();
+
+    // the files are only rewritten when they are complete
+    set<uint> rewrite;
+    for(map<long int, vector<bool> >::const_iterator it=todo.begin();it!=todo.end();++it) {
+      for(uint s=0;s<x.suffixes.size();++s) {
+        if(it->second[s]) rewrite.insert(s);
+      }
+    }
+    for(set<uint>::const_iterator it=rewrite.begin();it!=rewrite.end();++it) {
+      string filename=target+"/"+db.suffix(x.suffixes[*it])+".lbff";
+      if(ifstream((filename+".journal").c_str()).good()) {
+        ERR << "The extraction into '" << filename << "' is not finished, run extractbatch without --retry first. Aborting." << endl;
+        exit(20);
+      }
+    }
+
+    vector<long int> images;
+    for(map<long int, vector<bool> >::const_iterator it=todo.begin();it!=todo.end();++it) {
+      images.push_back(it->first);
+    }
+    vector< vector<BaseFeature*> > features(images.size(), vector<BaseFeature*>(x.suffixes.size(), (BaseFeature*)NULL));
+    DBG(10) << "Extracting the features of " << images.size() << " images again." << endl;
+#pragma omp parallel for schedule(dynamic)
+    for(long int k=0;k<long(images.size());++k) {
+      extractImage(x, db, db[images[k]], todo[images[k]], features[k]);
+    }
+
+    // the features extracted now replace the records of the files
+    const unsigned long int N=db.size();
+    for(set<uint>::const_iterator it=rewrite.begin();it!=rewrite.end();++it) {
+      const uint s=*it, j=x.suffixes[s];
+      vector<BaseFeature*> replacement(N, (BaseFeature*)NULL);
+      uint replaced=0;
+      for(uint k=0;k<images.size();++k) {
+        if(features[k][s]) {
+          replacement[images[k]]=features[k][s];
+          ++replaced;
+        }
+      }
+      if(replaced==0) {
+        continue;
+      }
+
+      string filename=target+"/"+db.suffix(j)+".lbff";
+      string newname=filename+".retry";
+      LargeBinaryFeatureFile* in=new LargeBinaryFeatureFile(filename);
+      if(in->getFormat()!=B_FORMAT_MAPPED || in->getNumSaved()!=N) {
+        ERR << "'" << filename << "' does not hold the " << N << " images of the filelist. Aborting." << endl;
+        exit(20);
+      }
+      LargeBinaryFeatureFile out(newname, db.featureType(j), N, 0, false, B_FILENAMESIZE, B_FORMAT_MAPPED);
+      for(unsigned long int i=0;i<N;++i) {
+        ImageContainer *img=db[i];
+        if(replacement[i]) {
+          FeatureSet *fs=new FeatureSet();
+          fs->add_feature(replacement[i]);
+          (*img)[j]=fs;
+        } else if(!in->read(img, j, i)) {
+          ERR << "Cannot read the feature of '" << img->basename() << "' from '" << filename << "'. Aborting." << endl;
+          exit(20);
+        }
+        out.writeNext(img, j);
+        delete (*img)[j];
+        (*img)[j]=NULL;
+      }
+      out.closeWriting();
+      delete in;
+      if(rename(newname.c_str(), filename.c_str())!=0) {
+        ERR << "Cannot replace '" << filename << "' by '" << newname << "'. Aborting." << endl;
+        exit(20);
+      }
+      DBG(10) << "Replaced " << replaced << " placeholders in '" << filename << "'." << endl;
+    }
+
+    // the failures which remain
+    unsigned long int failures=kept.size();
+    ofstream failedList(failedName.c_str(), ios::trunc);
+    for(uint f=0;f<kept.size();++f) {
+      failedList << kept[f] << endl;
+    }
+    for(uint k=0;k<images.size();++k) {
+      const vector<bool>& wanted=todo[images[k]];
+      for(uint s=0;s<x.suffixes.size();++s) {
+        if(wanted[s] && !features[k][s]) {
+          failedList << db[images[k]]->basename() << " " << db.suffix(x.suffixes[s]) << endl;
+          ++failures;
+        }
+      }
+    }
+    if(!failedList.good()) {
+      ERR << "Cannot write '" << failedName << "'." << endl;
+    }
+    return failures;
+  }
+}
+
+int main(int argc, char** argv) {
+  GetPot cl(argc,argv);
+
+  //command line parsing
+  if(cl.search(2,"--help","-h")) USAGE();
+  if(!cl.search(2,"-f","--filelist")) USAGE();
+
+  string filelist=cl.follow("filelist",2,"-f","--filelist");
+  uint checkpoint=max(1,cl.follow(1000,2,"-c","--checkpoint"));
+  bool restart=cl.search("--restart");
+  bool retrying=cl.search("--retry");
+  if(restart && retrying) USAGE();
+  if(cl.search(2,"-j","--threads")) {
+    omp_set_num_threads(max(1,cl.follow(1,2,"-j","--threads")));
+  }
+
+  Database db;
+  if(db.loadFileList(filelist)==0) {
+    ERR << "Cannot load filelist " << filelist << ". Aborting." << endl;
+    exit(20);
+  }
+  string t2bpath=cl.follow(db.t2bpath().c_str(),2,"-t","--type2bin");
+  string target=cl.follow(db.path().c_str(),2,"-d","--targetdirectory");
+
+  map<string,string> type2bin;
+  if(!ExtractorRegistry::readType2Bin(t2bpath, type2bin)) {
+    ERR << "Cannot read type2bin file '" << t2bpath << "'. Aborting." << endl;
+    exit(20);
+  }
+
+  // the suffixes to extract, by default all of the filelist
+  Extraction x;
+  vector<uint>& suffixes=x.suffixes;
+  if(cl.search(2,"-s","--suffixes")) {
+    istringstream iss(cl.follow("",2,"-s","--suffixes"));
+    string suffix;
+    while(getline(iss,suffix,',')) {
+      uint j=0;
+      while(j<db.numberOfSuffices() && db.suffix(j)!=suffix) ++j;
+      if(j==db.numberOfSuffices()) {
+        ERR << "Suffix " << suffix << " is not in the filelist. Aborting." << endl;
+        exit(20);
+      }
+      suffixes.push_back(j);
+    }
+  } else {
+    for(uint j=0;j<db.numberOfSuffices();++j) suffixes.push_back(j);
+  }
+
+  // the programs not known to the registry are run on the image files
+  // and write their features to a temporary suffix of this process
+  x.commands.resize(suffixes.size());
+  x.external.resize(suffixes.size(),false);
+  x.tempSuffixes.resize(suffixes.size());
+  for(uint s=0;s<suffixes.size();++s) {
+    x.commands[s]=type2bin[db.suffix(suffixes[s])];
+    if(x.commands[s].empty()) {
+      ERR << "No extractor for suffix " << db.suffix(suffixes[s]) << " in '" << t2bpath << "'. Aborting." << endl;
+      exit(20);
+    }
+    if(!x.extractors.known(x.commands[s])) {
+      x.external[s]=true;
+      ostringstream oss;
+      oss << "extractbatch" << getpid() << "." << db.suffix(suffixes[s]);
+      x.tempSuffixes[s]=oss.str();
+      DBG(10) << "Suffix " << db.suffix(suffixes[s]) << " is extracted by running '" << x.commands[s] << "'." << endl;
+    }
+  }
+
+  const string failedName=target+"/extractbatch.failed";
+  if(retrying) {
+    unsigned long int failures=retry(x, db, target, failedName);
+    if(failures>0) {
+      ERR << failures << " features still could not be extracted, see '" << failedName << "'." << endl;
+    }
+    DBG(10) << "cmdline was: "; printCmdline(argc,argv);
+    return failures>0 ? 1 : 0;
+  }
+
+  // the features written for images which fail
+  vector<BaseFeature*> placeholders(suffixes.size());
+  {
+    ImageFeature blank(placeholderSize,placeholderSize,3);
+    for(uint s=0;s<suffixes.size();++s) {
+      if(x.external[s]) {
+        placeholders[s]=x.loader.makeNewFeature(db.relevantSuffix(suffixes[s]));
+      } else {
+        placeholders[s]=x.extractors.extract(x.commands[s], blank);
+      }
+      if(!placeholders[s]) {
+        ERR << "Cannot extract suffix " << db.suffix(suffixes[s]) << " from a blank image. Aborting." << endl;
+        exit(20);
+      }
+    }
+  }
+
+  // open the files, each continues after its last checkpoint
+  const unsigned long int N=db.size();
+  vector<LargeBinaryFeatureFile*> files(suffixes.size());
+  unsigned long int start=N;
+  for(uint s=0;s<suffixes.size();++s) {
+    string filename=target+"/"+db.suffix(suffixes[s])+".lbff";
+    string journal=filename+".journal";
+    if(restart) {
+      remove(journal.c_str());
+    }
+    files[s]=new LargeBinaryFeatureFile(filename, db.featureType(suffixes[s]), N, journal);
+
+    // only the images at the same position of the filelist as before are kept
+    unsigned long int kept=0;
+    while(kept<files[s]->written() && kept<N && files[s]->writtenName(kept)==db[kept]->basename()) {
+      ++kept;
+    }
+    start=min(start,kept);
+  }
+  for(uint s=0;s<suffixes.size();++s) {
+    files[s]->discardFrom(start);
+  }
+  if(start>0) {
+    DBG(10) << "Continuing after " << start << " of " << N << " images." << endl;
+  }
+
+  // the images which failed, with the suffix
+  ofstream failedList(failedName.c_str(), (start>0) ? ios::app : ios::trunc);
+  if(!failedList.good()) {
+    ERR << "Cannot write '" << failedName << "'. Aborting." << endl;
+    exit(20);
+  }
+  unsigned long int failures=0;
+
+  const vector<bool> all(suffixes.size(), true);
+  double started=seconds();
+  for(unsigned long int first=start;first<N;first+=checkpoint) {
+    const long int last=min(N,first+checkpoint);
+
+    // the threads take the next image when they are done with one,
+    // each image is loaded once for all suffixes
+    vector<string> failed(size_t(last-first)*suffixes.size());
+#pragma omp parallel for schedule(dynamic)
+    for(long int i=first;i<last;++i) {
+      ImageContainer *img=db[i];
+      vector<BaseFeature*> features(suffixes.size());
+      extractImage(x, db, img, all, features);
+      for(uint s=0;s<suffixes.size();++s) {
+        BaseFeature *feature=features[s];
+        if(!feature) {
+          failed[size_t(i-first)*suffixes.size()+s]=img->basename()+" "+db.suffix(suffixes[s]);
+          feature=placeholders[s]->clone();
+        }
+        FeatureSet *fs=new FeatureSet();
+        fs->add_feature(feature);
+        (*img)[suffixes[s]]=fs;
+      }
+    }
+    // the records are written in the order of the filelist. The
+    // failures are listed before the checkpoint, such that they are
+    // not lost if the program stops in between (but may be listed
+    // twice)
+    for(long int i=first;i<last;++i) {
+      ImageContainer *img=db[i];
+      for(uint s=0;s<suffixes.size();++s) {
+        files[s]->writeNext(img, suffixes[s]);
+        delete (*img)[suffixes[s]];
+        (*img)[suffixes[s]]=NULL;
+      }
+    }
+    for(uint f=0;f<failed.size();++f) {
+      if(!failed[f].empty()) {
+        failedList << failed[f] << endl;
+        ++failures;
+      }
+    }
+    failedList.flush();
+    for(uint s=0;s<suffixes.size();++s) {
+      files[s]->sync();
+    }
+
+    double elapsed=seconds()-started;
+    DBG(10) << last << "/" << N << " images, " << (last-start)/max(elapsed,1e-3) << " images/s" << endl;
+  }
+
+  for(uint s=0;s<suffixes.size();++s) {
+    files[s]->closeWriting();
+    delete files[s];
+    delete placeholders[s];
+  }
+  if(failures>0) {
+    ERR << failures << " features could not be extracted and got placeholders, see '" << failedName
+        << "'. Run extractbatch --retry to replace them." << endl;
+  }
+
+  DBG(10) << "cmdline was: "; printCmdline(argc,argv);
+}
@@ -22,7 +22,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "diag.hpp"
 #include "imagefeature.hpp"
 #include "histogramfeature.hpp"
-#include "imagelib.hpp"
+#include "globalfeatureextraction.hpp"
 using namespace std;
 
 void USAGE() {
@@ -93,35 +93,9 @@ int main(int argc, char** argv) {
     DBG(10) << "Processing '" << filename << "' (" << i+1<< "/" << infiles.size() << ")." << endl;
     im.load(filename);
     if(color) {
-      HistogramFeature result(vector<uint>(3,steps));
-      result.min()=vector<double>(3,0.0);
-      result.max()=vector<double>(3,1.0);
-      result.initStepsize();
-
-      vector<double> tofeed(3);
-
-      for(uint x=0;x<im.xsize();++x) {
-        for(uint y=0;y<im.ysize();++y) {
-          tofeed[0]=im(x,y,0);
-          tofeed[1]=im(x,y,1);
-          tofeed[2]=im(x,y,2);
-          result.feed(tofeed);
-        }
-      }
-      result.save(filename+"."+suffix);
-
+      getColorHistogram(im, steps).save(filename+"."+suffix);
     } else {
-      im = makeGray(im, 2);
-      HistogramFeature result(steps);
-      result.min()=vector<double>(1,0.0);
-      result.max()=vector<double>(1,1.0);
-      result.initStepsize();
-      for(uint x=0;x<im.xsize();++x) {
-        for(uint y=0;y<im.ysize();++y) {
-          result.feed(vector<double>(1,im(x,y,0)));
-        }
-      }
-      result.save(filename+"."+suffix);
+      getGrayHistogram(im, steps).save(filename+"."+suffix);
     }
     DBG(20) << "Finished with '" << filename << "'." << endl;
   }
@@ -20,8 +20,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "getpot.hpp"
 #include "gzstream.hpp"
 #include "diag.hpp"
-#include "gabor.hpp"
-#include "imagelib.hpp"
+#include "globalfeatureextraction.hpp"
 
 using namespace std;
 
@@ -84,32 +83,12 @@ int main(int argc, char** argv) {
 
   // processing the files
   ImageFeature img;
-  VectorFeature vecfeat;
   for(uint i=0;i<infiles.size();++i) {
     string filename=infiles[i];
     DBG(10) << "Processing '" << filename << "' (" << i+1<< "/" << infiles.size() << ")." << endl;
     img.load(filename);
 
-    vecfeat=VectorFeature(numPhases*numFrequencies*2);
-
-    DBG(20) << "Calculating Gabor features" << endl;
-    Gabor gabor(img);
-    gabor.calculate(numPhases, numFrequencies, hMargin, vMargin);
-    DBG(20) << "Gabor feature calculated" << endl;
-
-    DBG(20) << "Making GaborImage to vector" << endl;
-    double mean, variance;
-    for(uint i=0;i<numPhases*numFrequencies;++i) {
-      ImageFeature gaborImage=gabor.getImage(i);
-      normalize(gaborImage);
-      if(saveImgs) {
-        ostringstream iss; iss << filename << "-" << i << ".png";
-        gaborImage.save(iss.str());
-      }
-      meanandvariance(gaborImage, mean, variance);
-      vecfeat[2*i]=mean; vecfeat[2*i+1]=sqrt(variance);
-    }
-    
+    VectorFeature vecfeat=getGaborFeature(img, numPhases, numFrequencies, hMargin, vMargin, saveImgs ? filename : string());
     vecfeat.save(filename+"."+suffix);
     DBG(20) << "Finished with '" << filename << "'." << endl;
   }
@@ -0,0 +1,139 @@
+/*
+This file is part of the FIRE -- Flexible Image Retrieval System
+
+FIRE is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+FIRE is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FIRE; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <cstdlib>
+#include "diag.hpp"
+#include "extractorregistry.hpp"
+#include "globalfeatureextraction.hpp"
+
+using namespace std;
+
+namespace {
+  // the defaults are those of the programs of the same name
+
+  BaseFeature* colorHistogram(const ImageFeature& image, GetPot& options) {
+    if(options.search("--gray")) {
+      return new HistogramFeature(getGrayHistogram(image, options.follow(256,"--steps")));
+    }
+    return new HistogramFeature(getColorHistogram(image, options.follow(8,"--steps")));
+  }
+
+  BaseFeature* tamuraHistogram(const ImageFeature& image, GetPot& ) {
+    return new HistogramFeature(getTamuraHistogram(image));
+  }
+
+  BaseFeature* gaborFeature(const ImageFeature& image, GetPot& options) {
+    uint numPhases=options.follow(5,2,"--numPhases","-p");
+    uint numFrequencies=options.follow(3,2,"--numFrequencies","-f");
+    int hMargin=options.follow(32,"--hMargin");
+    int vMargin=options.follow(32,"--vMargin");
+    return new VectorFeature(getGaborFeature(image, numPhases, numFrequencies, hMargin, vMargin));
+  }
+
+  BaseFeature* globalTextureFeature(const ImageFeature& image, GetPot& ) {
+    return new VectorFeature(getGlobalTextureFeature(image));
+  }
+
+  BaseFeature* aspectRatio(const ImageFeature& image, GetPot& ) {
+    return new VectorFeature(getAspectRatio(image));
+  }
+
+  /// split a command line at white space, the first token is the program
+  void splitCommand(const string& command, vector<string>& tokens) {
+    istringstream iss(command);
+    string token;
+    while(iss >> token) {
+      tokens.push_back(token);
+    }
+  }
+
+  /// the name of the executable without its directory
+  string programName(const string& command) {
+    vector<string> tokens;
+    splitCommand(command, tokens);
+    if(tokens.empty()) {
+      return string();
+    }
+    return tokens[0].substr(tokens[0].rfind('/')+1);
+  }
+}
+
+ExtractorRegistry::ExtractorRegistry() {
+  extractors_["extractcolorhistogram"]=colorHistogram;
+  extractors_["extracttamuratexturefeature"]=tamuraHistogram;
+  extractors_["extractglobaltexturefeature"]=globalTextureFeature;
+  extractors_["extractaspectratio"]=aspectRatio;
+  // fftw plans are taken from the thread safe plan cache
+  extractors_["extractgaborfeaturevector"]=gaborFeature;
+}
+
+ExtractorRegistry::Extractor ExtractorRegistry::find(const string& command) const {
+  map<string,Extractor>::const_iterator it=extractors_.find(programName(command));
+  if(it==extractors_.end()) {
+    return NULL;
+  }
+  return it->second;
+}
+
+bool ExtractorRegistry::known(const string& command) const {
+  return find(command)!=NULL;
+}
+
+BaseFeature* ExtractorRegistry::extract(const string& command, const ImageFeature& image) const {
+  Extractor extractor=find(command);
+  if(!extractor) {
+    return NULL;
+  }
+
+  // the options are parsed as the program would see them
+  vector<string> tokens;
+  splitCommand(command, tokens);
+  vector<char*> argv(tokens.size());
+  for(uint i=0;i<tokens.size();++i) {
+    argv[i]=const_cast<char*>(tokens[i].c_str());
+  }
+  GetPot options(argv.size(), &argv[0]);
+
+  DBG(20) << "extracting " << programName(command) << " in process" << endl;
+  return extractor(image, options);
+}
+
+bool ExtractorRegistry::runProgram(const string& command, const string& suffix, const string& imagefile) {
+  string cmdline=command+" --suffix "+suffix+" --images \""+imagefile+"\"";
+  DBG(20) << "Command: " << cmdline << endl;
+  return system(cmdline.c_str())==0;
+}
+
+bool ExtractorRegistry::readType2Bin(const string& filename, map<string,string>& commands) {
+  ifstream is(filename.c_str());
+  if(!is.good()) {
+    return false;
+  }
+  string line;
+  while(getline(is,line)) {
+    size_t space=line.find(' ');
+    if(space==string::npos) {
+      continue;
+    }
+    commands[line.substr(0,space)]=line.substr(space+1);
+  }
+  return true;
+}
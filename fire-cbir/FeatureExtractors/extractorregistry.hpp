@@ -0,0 +1,69 @@
+/*
+This file is part of the FIRE -- Flexible Image Retrieval System
+
+FIRE is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+FIRE is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FIRE; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __extractorregistry_hpp__
+#define __extractorregistry_hpp__
+
+#include <string>
+#include <map>
+#include "basefeature.hpp"
+#include "imagefeature.hpp"
+#include "getpot.hpp"
+
+/** The feature extraction programs of a type2bin file as functions
+    that work on an image that is already loaded. The programs are
+    identified by the name of the executable in the command line, the
+    options of the command line are interpreted as by the program
+    itself. This allows a server to extract the features of a new
+    image without starting a process per feature, loading the image
+    for each of them and reading the features back from disk.
+    Programs that need model files or options of their own (e.g. the
+    sparse sift histograms or the local features) are not known here
+    and are run as programs on the image file by runProgram.
+    All extractions known here may run in parallel.
+*/
+class ExtractorRegistry {
+public:
+  ExtractorRegistry();
+
+  /// whether the program of this type2bin command line can be run in process
+  bool known(const ::std::string& command) const;
+
+  /// extract the feature of this type2bin command line from the
+  /// image. The caller owns the feature. NULL if the program is not known.
+  BaseFeature* extract(const ::std::string& command, const ImageFeature& image) const;
+
+  /// run the program of this type2bin command line on an image file,
+  /// which writes the feature to imagefile.suffix. false if the
+  /// program fails
+  static bool runProgram(const ::std::string& command, const ::std::string& suffix, const ::std::string& imagefile);
+
+  /// read the command lines of a type2bin file, given per suffix as
+  /// "<suffix> <command line>". false if the file can't be read
+  static bool readType2Bin(const ::std::string& filename, ::std::map< ::std::string, ::std::string >& commands);
+
+private:
+  typedef BaseFeature* (*Extractor)(const ImageFeature& image, GetPot& options);
+
+  ::std::map< ::std::string, Extractor > extractors_;
+
+  /// the extractor for the program of the command line, NULL if unknown
+  Extractor find(const ::std::string& command) const;
+};
+
+#endif
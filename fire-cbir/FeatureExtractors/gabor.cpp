@@ -55,10 +55,7 @@ void Gabor::calculate(int numPha_, int numFreq_, uint horizonalMargin_, uint ver
   xsize_ = originalImage.xsize();
   ysize_ = originalImage.ysize();
   zsize_ = numPha * numFreq * (GABOR_USE_HS ? 2 : 1);
-  data_.resize(zsize_);
-  for (uint c = 0; c < zsize_; ++c) {
-    data_[c].resize(xsize_ * ysize_);
-  }
+  data_.resize(xsize_, ysize_, zsize_);
   
 #ifdef HAVE_FFT_LIBRARY
   
@@ -129,11 +126,15 @@ void Gabor::init(fftw_complex* &hsTransformed, fftw_complex* &vTransformed) {
   hh = height / 2;
   hb = width / 2;
 
-  hsTransformed = new fftw_complex[dim];
-  vTransformed = new fftw_complex[dim];     
-  // Allocate memory for temp arrays
-  fftw_complex* hsIn = new fftw_complex[dim];
-  fftw_complex* vIn = new fftw_complex[dim];
+  // the value channel is real, thus it is transformed by a real to
+  // complex transformation and its spectrum is completed by symmetry
+  vTransformed = new fftw_complex[dim];
+  fftw_real* vIn = new fftw_real[dim];
+  fftw_complex* hsIn = NULL;
+  if (GABOR_USE_HS) {
+    hsTransformed = new fftw_complex[dim];
+    hsIn = new fftw_complex[dim];
+  }
 
   // Fill vectors with padded image
   int xoffset=paddedWidth/2-width/2;
@@ -144,10 +145,11 @@ void Gabor::init(fftw_complex* &hsTransformed, fftw_complex* &vTransformed) {
   for(uint x = 0; x < paddedWidth; x++) {
     for(uint y = 0; y < paddedHeight; y++) {
       idx = y * paddedWidth + x;
-      hsIn[idx].re = complPix[0];
-      hsIn[idx].im = complPix[1];
-      vIn[idx].re = complPix[2];
-      vIn[idx].im = 0.0;
+      if (GABOR_USE_HS) {
+        hsIn[idx].re = complPix[0];
+        hsIn[idx].im = complPix[1];
+      }
+      vIn[idx] = complPix[2];
     }
   }
 
@@ -172,30 +174,38 @@ void Gabor::init(fftw_complex* &hsTransformed, fftw_complex* &vTransformed) {
       }
       ColorHSV(rValue, gValue, bValue).complexPixel(complPix);
       idx = (y + yoffset) * paddedWidth + (x + xoffset);
-      hsIn[idx].re = complPix[0];
-      hsIn[idx].im = complPix[1];
-      vIn[idx].re = complPix[2];
-      vIn[idx].im = 0.0;
+      if (GABOR_USE_HS) {
+        hsIn[idx].re = complPix[0];
+        hsIn[idx].im = complPix[1];
+      }
+      vIn[idx] = complPix[2];
     }
   }
   
 
   // Fourier-Transformation
-  fftwnd_plan plan = fftw2d_create_plan(paddedWidth, paddedHeight, FFTW_FORWARD, FFTW_ESTIMATE); 
-  fftwnd_one(plan, hsIn, hsTransformed);
-  fftwnd_one(plan, vIn, vTransformed);
-  fftwnd_destroy_plan(plan);
+  fftw_complex* vHalf = new fftw_complex[paddedHeight * (paddedWidth / 2 + 1)];
+  rfftwnd_plan realPlan = cachedRealFFTPlan(paddedHeight, paddedWidth, FFTW_REAL_TO_COMPLEX);
+  rfftwnd_one_real_to_complex(realPlan, vIn, vHalf);
+  releaseRealFFTPlan(realPlan, paddedHeight, paddedWidth);
+  expandHalfSpectrum(vHalf, vTransformed, paddedHeight, paddedWidth);
+  delete[] vHalf;
+  if (GABOR_USE_HS) {
+    fftwnd_plan plan = cachedFFTPlan(paddedHeight, paddedWidth, FFTW_FORWARD);
+    fftwnd_one(plan, hsIn, hsTransformed);
+    releaseFFTPlan(plan, paddedHeight, paddedWidth);
+  }
   
-  // we do not need the complex input data anymore
+  // we do not need the input data anymore
   delete[] hsIn;
   delete[] vIn;
 }
 
 // calculates a filter for the given phase and frequency
-void Gabor::calcFilter(complex<double>* &curFilter, unsigned int curPha, int curFreq) {
+void Gabor::calcFilter(double* curFilter, unsigned int curPha, int curFreq) {
   // Erase old filter
   for (uint i = 0; i < dim; i++) {
-    curFilter[i] = complex<double>(0.0, 0.0);
+    curFilter[i] = 0.0;
   }
   
   double alpha = sqrt(log(2.0)/2.0);
@@ -228,7 +238,7 @@ void Gabor::calcFilter(complex<double>* &curFilter, unsigned int curPha, int cur
       int idxx, idxy;
       idxx=(x+paddedWidth)%paddedWidth;
       idxy=(y+paddedHeight)%paddedHeight;
-      curFilter[(idxy*paddedWidth)+idxx] = exp(std::complex<double>(s*(delta1*delta1+delta2*delta2),0.0));
+      curFilter[(idxy*paddedWidth)+idxx] = exp(s*(delta1*delta1+delta2*delta2));
     }
   }
 
@@ -243,66 +253,56 @@ void Gabor::calcFilter(complex<double>* &curFilter, unsigned int curPha, int cur
 // and the result data is copied back into the image
 void Gabor::extractGabor(fftw_complex* hsTransformed, fftw_complex* vTransformed) {
   
-  fftw_complex* hsResult = new fftw_complex[dim];
-  fftw_complex* vResult = new fftw_complex[dim];
-  fftw_complex* hsSave = new fftw_complex[dim];
-  fftw_complex* vSave = new fftw_complex[dim];
-  complex<double>* curFilter = new complex<double>[dim];
-
-  fftwnd_plan plan;
-  plan = fftw2d_create_plan(paddedWidth, paddedHeight, FFTW_BACKWARD, FFTW_ESTIMATE); 
-  
-  for(uint aktFreq=0; aktFreq<numFreq; aktFreq++) {
-    for(unsigned int aktPha=0; aktPha<numPha; aktPha++)  {
+  fftwnd_plan plan = cachedFFTPlan(paddedHeight, paddedWidth, FFTW_BACKWARD);
+  int numFilters = numFreq * numPha;
+
+#pragma omp parallel
+  {
+    // per thread buffers, the transformed data itself is only read
+    fftw_complex* hsFiltered = (GABOR_USE_HS ? new fftw_complex[dim] : NULL);
+    fftw_complex* hsResult = (GABOR_USE_HS ? new fftw_complex[dim] : NULL);
+    fftw_complex* vFiltered = new fftw_complex[dim];
+    fftw_complex* vResult = new fftw_complex[dim];
+    double* curFilter = new double[dim];
+
+#pragma omp for schedule(dynamic)
+    for(int f = 0; f < numFilters; f++) {
+      uint aktFreq = f / numPha;
+      uint aktPha = f % numPha;
 
       // Calculate filter
       calcFilter(curFilter, aktPha, aktFreq);
 
-      // copy transformed data
-      memcpy(&(hsSave[0]), &(hsTransformed[0]), sizeof(fftw_complex) * dim);
-      memcpy(&(vSave[0]), &(vTransformed[0]), sizeof(fftw_complex) * dim);
-
       // Apply filter
-      for(unsigned int y=0;y<paddedHeight;++y) {
-        for(unsigned int x=0;x<paddedWidth;++x) {
-	  
-          fftw_complex HStt = hsTransformed[y * maxnn + x];
-          fftw_complex Vtt = vTransformed[y * maxnn + x];
-          fftw_complex filter;
-          filter.re = curFilter[y * paddedWidth + x].real();
-          filter.im = curFilter[y * paddedWidth + x].imag();
-	  
-          // complex multiplication of 'HStt' with 'filter'
-          hsTransformed[y * maxnn + x].re = (HStt.re * filter.re) - (HStt.im * filter.im);
-          hsTransformed[y * maxnn + x].im = (HStt.re * filter.im) + (HStt.im * filter.re); // here was a minus instead of the plus
-          // complex multiplication of 'Vtt' with 'filter'
-          vTransformed[y * maxnn + x].re = (Vtt.re * filter.re) - (Vtt.im * filter.im);
-          vTransformed[y * maxnn + x].im = (Vtt.re * filter.im) + (Vtt.im * filter.re); // here was a minus instead of the plus
+      for(unsigned int i = 0; i < dim; ++i) {
+        vFiltered[i].re = vTransformed[i].re * curFilter[i];
+        vFiltered[i].im = vTransformed[i].im * curFilter[i];
+      }
+      if (GABOR_USE_HS) {
+        for(unsigned int i = 0; i < dim; ++i) {
+          hsFiltered[i].re = hsTransformed[i].re * curFilter[i];
+          hsFiltered[i].im = hsTransformed[i].im * curFilter[i];
         }
       }
 
       // Fourier-Transformation backwards
-      fftwnd_one(plan, hsTransformed, hsResult);
-      fftwnd_one(plan, vTransformed, vResult);
+      fftwnd_one(plan, vFiltered, vResult);
+      if (GABOR_USE_HS) {
+        fftwnd_one(plan, hsFiltered, hsResult);
+      }
       
       // Save calculated feature
       copyToResult(hsResult, vResult, aktFreq * numPha + aktPha);
-
-      // restore transformed data, needed for next extraction step
-      memcpy(&(hsTransformed[0]), &(hsSave[0]), sizeof(fftw_complex) * dim);
-      memcpy(&(vTransformed[0]), &(vSave[0]), sizeof(fftw_complex) * dim);
-
     }
-  }
 
-  fftwnd_destroy_plan(plan);
-
-  // cleanup allocated memory
-  delete[] curFilter;
-  delete[] hsSave;
-  delete[] vSave;
-  delete[] hsResult;
-  delete[] vResult;
+    // cleanup allocated memory
+    delete[] curFilter;
+    delete[] hsFiltered;
+    delete[] vFiltered;
+    delete[] hsResult;
+    delete[] vResult;
+  }
+  releaseFFTPlan(plan, paddedHeight, paddedWidth);
 }
 
 // copies the output store in the hsResult and vResult arrays into
@@ -35,9 +35,7 @@ const bool GABOR_USE_HS = true;
 const int GABOR_FREQ_START = 2;
    
 #ifdef HAVE_FFT_LIBRARY
-extern "C" {
-  #include FFTW_INCLUDE
-}
+#include "fftplancache.hpp"
 #endif
 
 // Gabor-Features extraction class
@@ -73,17 +71,21 @@ private:
 #ifdef HAVE_FFT_LIBRARY
 
   // initializes the gabor feature extraction
-  // sets up the data structure and performs the fourier transformation
+  // sets up the data structure and performs the fourier transformation,
+  // hsTransformed stays NULL if the hs channel is not used
   void init(fftw_complex* &hsTransformed, fftw_complex* &vTransformed);
 
-  // calculates a filter for the given phase and frequency
-  void calcFilter(std::complex<double>* &curFilter, unsigned int curPha, int curFreq);
+  // calculates a filter for the given phase and frequency,
+  // the filter is real valued in the frequency domain
+  void calcFilter(double* curFilter, unsigned int curPha, int curFreq);
 
   // extract the gabor features
   // for each phase and each frequency, a filter is computed,
   // which is applied to the fourier-transformed data.
   // afterwards the inverse fourier transformation is performed,
-  // and the result data is copied back into the image
+  // and the result data is copied back into the image.
+  // the filters are processed in parallel, all of them use the
+  // same transformed data
   void extractGabor(fftw_complex* hsTransformed, fftw_complex* vTransformed);
 
   // copies the output store in the hsResult and vResult arrays into
@@ -1,8 +1,12 @@
 #include <vector>
 #include <cmath>
 #include <math.h>
+#include <sstream>
+#include "diag.hpp"
 #include "vectorfeature.hpp"
 #include "imagelib.hpp"
+#include "tamurafeature.hpp"
+#include "gabor.hpp"
 #include "globalfeatureextraction.hpp"
 #include <cmath>
 using namespace std;
@@ -567,3 +571,70 @@ VectorFeature getGlobalTextureFeature(const ImageFeature &inImg) {
   VectorFeature result(resultVec);
   return result;
 }
+
+HistogramFeature getColorHistogram(const ImageFeature &img, uint steps) {
+  HistogramFeature result(vector<uint>(3,steps));
+  result.min()=vector<double>(3,0.0);
+  result.max()=vector<double>(3,1.0);
+  result.initStepsize();
+
+  vector<double> tofeed(3);
+  for(uint x=0;x<img.xsize();++x) {
+    for(uint y=0;y<img.ysize();++y) {
+      tofeed[0]=img(x,y,0);
+      tofeed[1]=img(x,y,1);
+      tofeed[2]=img(x,y,2);
+      result.feed(tofeed);
+    }
+  }
+  return result;
+}
+
+HistogramFeature getGrayHistogram(const ImageFeature &inImg, uint steps) {
+  ImageFeature img=makeGray(inImg, 2);
+  HistogramFeature result(steps);
+  result.min()=vector<double>(1,0.0);
+  result.max()=vector<double>(1,1.0);
+  result.initStepsize();
+  for(uint x=0;x<img.xsize();++x) {
+    for(uint y=0;y<img.ysize();++y) {
+      result.feed(vector<double>(1,img(x,y,0)));
+    }
+  }
+  return result;
+}
+
+HistogramFeature getTamuraHistogram(const ImageFeature &img) {
+  ImageFeature tamuraImage=calculate(img);
+  normalize(tamuraImage);
+  return histogramize(tamuraImage);
+}
+
+VectorFeature getGaborFeature(const ImageFeature &img, uint numPhases, uint numFrequencies, int hMargin, int vMargin, const string& imagePrefix) {
+  VectorFeature result(numPhases*numFrequencies*2);
+
+  DBG(20) << "Calculating Gabor features" << endl;
+  Gabor gabor(img);
+  gabor.calculate(numPhases, numFrequencies, hMargin, vMargin);
+  DBG(20) << "Gabor feature calculated" << endl;
+
+  double mean, variance;
+  for(uint i=0;i<numPhases*numFrequencies;++i) {
+    ImageFeature gaborImage=gabor.getImage(i);
+    normalize(gaborImage);
+    if(!imagePrefix.empty()) {
+      ostringstream oss; oss << imagePrefix << "-" << i << ".png";
+      gaborImage.save(oss.str());
+    }
+    meanandvariance(gaborImage, mean, variance);
+    result[2*i]=mean; result[2*i+1]=sqrt(variance);
+  }
+  return result;
+}
+
+VectorFeature getAspectRatio(const ImageFeature &img) {
+  VectorFeature result(2);
+  result[0]=img.xsize();
+  result[1]=img.ysize();
+  return result;
+}
@@ -18,8 +18,29 @@ along with FIRE; if not, write to the Free Software Foundation, Inc.,
 #define __globalfeatureextraction_hpp__
 
 
+#include <string>
 #include "vectorfeature.hpp"
+#include "histogramfeature.hpp"
 #include "imagefeature.hpp"
 
 VectorFeature getGlobalTextureFeature(const ImageFeature &img);
+
+/// histogram of the rgb values with steps bins per channel
+HistogramFeature getColorHistogram(const ImageFeature &img, uint steps=8);
+
+/// histogram of the gray values with steps bins
+HistogramFeature getGrayHistogram(const ImageFeature &img, uint steps=256);
+
+/// histogram of the tamura texture image
+HistogramFeature getTamuraHistogram(const ImageFeature &img);
+
+/// mean and standard deviation of the responses of
+/// numPhases*numFrequencies gabor filters. If imagePrefix is not
+/// empty, the responses are saved as imagePrefix-<i>.png. The fftw
+/// plans come from the thread safe plan cache, so this may run in
+/// parallel with other extractions.
+VectorFeature getGaborFeature(const ImageFeature &img, uint numPhases=5, uint numFrequencies=3, int hMargin=32, int vMargin=32, const ::std::string& imagePrefix="");
+
+/// width and height of the image
+VectorFeature getAspectRatio(const ImageFeature &img);
 #endif
@@ -30,27 +30,94 @@ ImageFeature calculate(const ImageFeature &img) {
 }
 
 
+namespace {
+  /// half the size of the window of the local contrast
+  const int CONTRAST_RADIUS=5;
+
+  /// add (sign=1) or subtract (sign=-1) the powers 1..4 of the values
+  /// of row y of the plane to the column sums
+  inline void addRowPowers(const double *plane, int xdim, int y, long double sign, long double *col) {
+    const double *row=plane+y*xdim;
+    for(int x=0;x<xdim;++x) {
+      long double v=row[x], v2=v*v;
+      col[4*x]+=sign*v;
+      col[4*x+1]+=sign*v2;
+      col[4*x+2]+=sign*v2*v;
+      col[4*x+3]+=sign*v2*v2;
+    }
+  }
+}
+
 ImageFeature contrast(const ImageFeature &image, uint z) {
   int xdim=image.xsize();
   int ydim=image.ysize();
   
   ImageFeature result(xdim,ydim,1);
-  
-  double min=numeric_limits<double>::max();
-  double max=0;
-  double tmp;
+  if(xdim==0 || ydim==0) {
+    return result;
+  }
+  const double *plane=&image(0,0,z);
+  double *out=&result(0,0,0);
+
   DBG(20) << "Starting to get contrast for image." << endl;
 
-  for(int x=0;x<xdim;++x) {
+  // The sums over the window of getLocalContrast are running sums:
+  // per column over the rows of the window, moved down row by row,
+  // and over these column sums, moved right column by column. The
+  // fourth central moment is derived from the raw moments, which
+  // cancels digits; the sums are kept in long double such that
+  // homogeneous windows still give a kurtosis below epsilon and the
+  // results equal those of getLocalContrast.
+#pragma omp parallel
+  {
+    vector<long double> col(4*xdim);
+    int previous=-2;
+#pragma omp for schedule(static)
     for(int y=0;y<ydim;++y) {
-      tmp=getLocalContrast(image,x,y,z);
-      result(x,y,0)=tmp;
-      min=::std::min(min,tmp);
-      max=::std::max(max,tmp);
+      int ystart=::std::max(0,y-CONTRAST_RADIUS);
+      int ystop=::std::min(ydim,y+CONTRAST_RADIUS+1);
+      if(y!=previous+1) {
+        // first row of this thread
+        fill(col.begin(),col.end(),0.0L);
+        for(int yy=ystart;yy<ystop;++yy) {
+          addRowPowers(plane,xdim,yy,1.0L,&col[0]);
+        }
+      } else {
+        if(y+CONTRAST_RADIUS<ydim) addRowPowers(plane,xdim,y+CONTRAST_RADIUS,1.0L,&col[0]);
+        if(y-CONTRAST_RADIUS-1>=0) addRowPowers(plane,xdim,y-CONTRAST_RADIUS-1,-1.0L,&col[0]);
+      }
+      previous=y;
+
+      long double s[4]={0.0L,0.0L,0.0L,0.0L};
+      for(int x=0;x<::std::min(xdim,CONTRAST_RADIUS);++x) {
+        for(int m=0;m<4;++m) s[m]+=col[4*x+m];
+      }
+      for(int x=0;x<xdim;++x) {
+        if(x+CONTRAST_RADIUS<xdim) {
+          for(int m=0;m<4;++m) s[m]+=col[4*(x+CONTRAST_RADIUS)+m];
+        }
+        if(x-CONTRAST_RADIUS-1>=0) {
+          for(int m=0;m<4;++m) s[m]-=col[4*(x-CONTRAST_RADIUS-1)+m];
+        }
+        int xstart=::std::max(0,x-CONTRAST_RADIUS);
+        int xstop=::std::min(xdim,x+CONTRAST_RADIUS+1);
+        long double size=(ystop-ystart)*(xstop-xstart);
+
+        long double mean=s[0]/size;
+        long double m2=s[1]/size, m3=s[2]/size, m4=s[3]/size;
+        double sigma=m2-mean*mean;
+        double kurtosis=m4-4.0L*mean*m3+6.0L*mean*mean*m2-3.0L*mean*mean*mean*mean;
+
+        /// as in getLocalContrast: homogeneous regions have no contrast
+        if(kurtosis<numeric_limits<double>::epsilon()) {
+          out[y*xdim+x]=0.0;
+        } else {
+          out[y*xdim+x]=sigma/sqrt(sqrt(kurtosis));
+        }
+      }
     }
   }
   
-  DBG(20) << "minContrast: " << min << " maxContrast: " << max << endl;
   return result;
 }
 
@@ -99,45 +166,45 @@ double getLocalContrast(const ImageFeature &image, int xpos, int ypos, uint z) {
   return sigma/sqrt(sqrt(kurtosis));
 }
 
-
 ImageFeature directionality(const ImageFeature &image, uint z) {
   DBG(20) << "Starting to get directionality" << endl;  
   
   //init
-  uint xdim=image.xsize();
-  uint ydim=image.ysize();  
-  
-  ImageFeature deltaH(xdim, ydim, 1);
-  ImageFeature deltaV(xdim, ydim, 1);
+  int xdim=image.xsize();
+  int ydim=image.ysize();  
   
-  for(uint x=0;x<xdim;++x) {
-    for(uint y=0;y<ydim;++y) {
-      deltaH(x,y,0)=image(x,y,z);
-      deltaV(x,y,0)=image(x,y,z);
-    }
+  ImageFeature phi(xdim,ydim,1);
+  if(xdim==0 || ydim==0) {
+    return phi;
   }
-  
-  //step1
-  ImageFeature matrixH(3,3,1), matrixV(3,3,1);
-  matrixH(0,0,0)=-1;  matrixH(0,1,0)=-2;  matrixH(0,2,0)=-1;
-  matrixH(2,0,0)=1;   matrixH(2,1,0)=2;   matrixH(2,2,0)=1;
-  
-  matrixV(0,0,0)=1;  matrixV(1,0,0)=2;  matrixV(2,0,0)=1;
-  matrixV(0,2,0)=-1; matrixV(1,2,0)=-2; matrixV(2,2,0)=-1;
-  
-  convolve(deltaH,matrixH);
-  convolve(deltaV,matrixV);
+  const double *plane=&image(0,0,z);
+  double *out=&phi(0,0,0);
 
-  //step2
-  //ImageFeature deltaG(xdim,ydim,1);
-  ImageFeature phi(xdim,ydim,1);
-  for(uint y=0;y<ydim;++y) {
-    for(uint x=0;x<xdim;++x) {
-      //deltaG(x,y,0)=fabs(deltaH(x,y,0))+fabs(deltaV(x,y,0));
-      //deltaG(x,y,0)*=0.5;
+  // step1 and step2 at once: the horizontal and the vertical sobel
+  // filter, summed up in the order of convolve, which skips the
+  // pixels outside of the image
+#pragma omp parallel for schedule(static)
+  for(int y=0;y<ydim;++y) {
+    const double *above=(y>0) ? plane+(y-1)*xdim : NULL;
+    const double *row=plane+y*xdim;
+    const double *below=(y+1<ydim) ? plane+(y+1)*xdim : NULL;
+    for(int x=0;x<xdim;++x) {
+      double deltaH=0.0, deltaV=0.0;
+      if(x>0) {
+        if(above) { deltaH+=-1*above[x-1]; deltaV+=1*above[x-1]; }
+        deltaH+=-2*row[x-1];
+        if(below) { deltaH+=-1*below[x-1]; deltaV+=-1*below[x-1]; }
+      }
+      if(above) { deltaV+=2*above[x]; }
+      if(below) { deltaV+=-2*below[x]; }
+      if(x+1<xdim) {
+        if(above) { deltaH+=1*above[x+1]; deltaV+=1*above[x+1]; }
+        deltaH+=2*row[x+1];
+        if(below) { deltaH+=1*below[x+1]; deltaV+=-1*below[x+1]; }
+      }
 
-      if(deltaH(x,y,0)!=0.0) {
-        phi(x,y,0)=atan(deltaV(x,y,0)/deltaH(x,y,0))+(M_PI/2.0+0.001); //+0.001 because otherwise sometimes getting -6.12574e-17
+      if(deltaH!=0.0) {
+        out[y*xdim+x]=atan(deltaV/deltaH)+(M_PI/2.0+0.001); //+0.001 because otherwise sometimes getting -6.12574e-17
       }
     }
   }
@@ -181,93 +248,95 @@ double efficientLocalMean(const int x,const int y,const int k,const ImageFeature
   return (unten-links-oben+obenlinks)/counter;
 }
 
+namespace {
+  /// efficientLocalMean on a plane of running sums
+  inline double localMean(int x, int y, int k, const double *laufendeSumme, int dimx, int dimy) {
+    int k2=k/2;
+    int starty=::std::max(0,y-k2);
+    int startx=::std::max(0,x-k2);
+    int stopy=::std::min(dimy-1,y+k2-1);
+    int stopx=::std::min(dimx-1,x+k2-1);
+
+    double links=(startx-1<0) ? 0 : laufendeSumme[stopy*dimx+startx-1];
+    double oben=(starty-1<0) ? 0 : laufendeSumme[(starty-1)*dimx+stopx];
+    double obenlinks=((starty-1 < 0) || (startx-1 <0)) ? 0 : laufendeSumme[(starty-1)*dimx+startx-1];
+    double unten=laufendeSumme[stopy*dimx+stopx];
+
+    int counter=(stopy-starty+1)*(stopx-startx+1);
+    return (unten-links-oben+obenlinks)/counter;
+  }
+}
 
 ImageFeature coarseness(const ImageFeature &image,const uint z) {
-  const uint yDim=image.ysize();
-  const uint xDim=image.xsize();
+  const int yDim=image.ysize();
+  const int xDim=image.xsize();
+  const int size=xDim*yDim;
+
+  ImageFeature Sbest(xDim,yDim,1);
+  if(size==0) {
+    return Sbest;
+  }
+  const double *plane=&image(0,0,z);
 
-  ImageFeature laufendeSumme(xDim,yDim,1);
-  
   // initialize for running sum calculation
+  vector<double> laufendeSumme(size);
   double links, oben, obenlinks;
-  for(int y=0;y<int(yDim);++y) {
-    for(int x=0;x<int(xDim);++x) {
-      if(x<1) links=0;
-      else links=laufendeSumme(x-1,y,0);
-      
-      if(y<1) oben=0;
-      else oben=laufendeSumme(x,y-1,0);
-      
-      if(y<1 || x<1) obenlinks=0;
-      else obenlinks=laufendeSumme(x-1,y-1,0);
-      
-      laufendeSumme(x,y,0)=image(x,y,z)+links+oben-obenlinks;
+  for(int y=0;y<yDim;++y) {
+    for(int x=0;x<xDim;++x) {
+      links=(x<1) ? 0 : laufendeSumme[y*xDim+x-1];
+      oben=(y<1) ? 0 : laufendeSumme[(y-1)*xDim+x];
+      obenlinks=(y<1 || x<1) ? 0 : laufendeSumme[(y-1)*xDim+x-1];
+      laufendeSumme[y*xDim+x]=plane[y*xDim+x]+links+oben-obenlinks;
     }
   }
   
-  ImageFeature Ak(xDim,yDim,5);
-  ImageFeature Ekh(xDim,yDim,5);
-  ImageFeature Ekv(xDim,yDim,5);
+  // one plane of local means per k
+  vector<double> Ak(5*size);
 
-  ImageFeature Sbest(xDim,yDim,1);
-  
   DBG(25) << "  ... step 1 ... " << endl;
   //step 1
-  int lenOfk=1;
-  for(int k=1;k<=5;++k) {
-    lenOfk*=2;
-    for(int y=0;y<int(yDim);++y) {
-      for(int x=0;x<int(xDim);++x) {
-        Ak(x,y,k-1)=efficientLocalMean(x,y,lenOfk,laufendeSumme);
+#pragma omp parallel for schedule(static)
+  for(int y=0;y<yDim;++y) {
+    int lenOfk=1;
+    for(int k=1;k<=5;++k) {
+      lenOfk*=2;
+      double *A=&Ak[(k-1)*size];
+      for(int x=0;x<xDim;++x) {
+        A[y*xDim+x]=localMean(x,y,lenOfk,&laufendeSumme[0],xDim,yDim);
       }
     }
   }
   
-  DBG(25) << "  ... step 2 ... " << endl;
-  //step 2
-  lenOfk=1;
-  for(int k=1;k<=5;++k) {
-    int k2=lenOfk;
-    lenOfk*=2;
-    for(int y=0;y<int(yDim);++y) {
-      for(int x=0;x<int(xDim);++x) {
-        
-        int posx1=x+k2;
-        int posx2=x-k2;
-        
-        int posy1=y+k2;
-        int posy2=y-k2;
-        if(posx1<int(xDim) && posx2>=0) {
-          Ekh(x,y,k-1)=fabs(Ak(posx1,y,k-1)-Ak(posx2,y,k-1));
-        } else {
-          Ekh(x,y,k-1)=0;
-        }
-        if(posy1<int(yDim) && posy2>=0) {
-          Ekv(x,y,k-1)=fabs(Ak(x,posy1,k-1)-Ak(x,posy2,k-1));
-        } else {
-          Ekv(x,y,k-1)=0;
-        }
-      }
-    }
-  }
+  DBG(25) << "  ... step 2 and 3 ... " << endl;
+  //step 2: the differences of the means on opposite sides, step 3: the k with the largest difference
   double sum=0.0;
-  DBG(25) << "  ... step 3 ... " << endl;  
-  //step3
-  for(int y=0;y<int(yDim);++y) {
-    for(int x=0;x<int(xDim);++x) {
+  double *best=&Sbest(0,0,0);
+#pragma omp parallel for schedule(static) reduction(+:sum)
+  for(int y=0;y<yDim;++y) {
+    for(int x=0;x<xDim;++x) {
       double maxE=0;
       int maxk=0;
+      int k2=1;
       for(int k=1;k<=5;++k) {
-        if(Ekh(x,y,k-1)>maxE) {
-          maxE=Ekh(x,y,k-1);
+        const double *A=&Ak[(k-1)*size];
+        double Ekh=0, Ekv=0;
+        if(x+k2<xDim && x-k2>=0) {
+          Ekh=fabs(A[y*xDim+x+k2]-A[y*xDim+x-k2]);
+        }
+        if(y+k2<yDim && y-k2>=0) {
+          Ekv=fabs(A[(y+k2)*xDim+x]-A[(y-k2)*xDim+x]);
+        }
+        if(Ekh>maxE) {
+          maxE=Ekh;
           maxk=k;
         }
-        if(Ekv(x,y,k-1)>maxE) {
-          maxE=Ekv(x,y,k-1);
+        if(Ekv>maxE) {
+          maxE=Ekv;
           maxk=k;
         }
+        k2*=2;
       }
-      Sbest(x,y,0)=maxk;
+      best[y*xDim+x]=maxk;
       sum+=maxk;
     }
   }
@@ -0,0 +1,100 @@
+
+/*
+This file is part of the FIRE -- Flexible Image Retrieval System
+
+FIRE is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+FIRE is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FIRE; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#include <cmath>
+#include <cstdlib>
+#include "compacthistogramfeature.hpp"
+#include "diag.hpp"
+
+using namespace std;
+
+CompactHistogramFeature::CompactHistogramFeature(const CompactVectorStore* store, uint index, const HistogramFeature& description) :
+  HistogramFeature(), store_(store), index_(index) {
+  steps_=description.steps();
+  min_=description.min();
+  max_=description.max();
+  dim_=description.dim();
+  size_=store->dim();
+  counter_=description.counter();
+  initStepsize();
+}
+
+void CompactHistogramFeature::detach() {
+  if(store_) {
+    const uint n=store_->dim();
+    data_.resize(n);
+    bins_.resize(n);
+    if(n>0) {
+      store_->decode(index_,&data_[0]);
+    }
+    for(uint i=0;i<n;++i) {
+      bins_[i]=uint(floor(data_[i]*counter_+0.5));
+    }
+    store_=NULL;
+  }
+}
+
+void CompactHistogramFeature::requireDetached(const char* method) const {
+  if(store_) {
+    ERR << "The bins of this histogram are held compactly and not in vectors, " << method << "() is not available. Use operator[] or decoded(), or detach() the histogram." << endl;
+    exit(20);
+  }
+}
+
+const double* CompactHistogramFeature::decoded(double* buffer) const {
+  if(store_) {
+    store_->decode(index_,buffer);
+    return buffer;
+  }
+  return HistogramFeature::values();
+}
+
+HistogramFeature* CompactHistogramFeature::clone() const {
+  CompactHistogramFeature* result=new CompactHistogramFeature(*this);
+  result->detach();
+  return result;
+}
+
+bool CompactHistogramFeature::read(istream &is) {
+  store_=NULL;
+  return HistogramFeature::read(is);
+}
+
+bool CompactHistogramFeature::readBinary(istream &is) {
+  store_=NULL;
+  return HistogramFeature::readBinary(is);
+}
+
+void CompactHistogramFeature::write(ostream &os) {
+  detach();
+  HistogramFeature::write(os);
+}
+
+void CompactHistogramFeature::writeBinary(ostream &os) {
+  detach();
+  HistogramFeature::writeBinary(os);
+}
+
+const unsigned long int CompactHistogramFeature::calcBinarySize() const {
+  unsigned long int bsize = 2*sizeof(uint);
+  bsize += (unsigned long int)steps_.size() * (unsigned long int)sizeof(uint);
+  bsize += (unsigned long int)min_.size() * (unsigned long int)sizeof(double);
+  bsize += (unsigned long int)max_.size() * (unsigned long int)sizeof(double);
+  bsize += (unsigned long int)size() * (unsigned long int)sizeof(uint);
+  return bsize;
+}
@@ -0,0 +1,96 @@
+
+/*
+This file is part of the FIRE -- Flexible Image Retrieval System
+
+FIRE is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+FIRE is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FIRE; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#ifndef __compacthistogramfeature_hpp__
+#define __compacthistogramfeature_hpp__
+
+#include "histogramfeature.hpp"
+#include "compactvectorfeature.hpp"
+
+/** A HistogramFeature whose normalized values are held in a
+    CompactVectorStore, which has to exist as long as the feature does
+    (clones are independent). The description of the histogram (steps,
+    min, max, counter) is copied, the bin counts are not kept. As for
+    MappedHistogramFeature, the methods that may modify the histogram
+    copy the values into data_ first and recompute the counts from
+    them (detach()), while the const methods read the store and change
+    nothing. The counts are exact for float stores as long as the
+    counter is below 2^24, for uint8 stores they are approximations.
+    The const ndata(), bins(), bin() and data() can only be used once
+    the histogram is detached, values() is NULL until then.
+ */
+class CompactHistogramFeature : public HistogramFeature {
+private:
+  /// the store, NULL once the values have been copied into data_
+  const CompactVectorStore *store_;
+
+  /// number of the vector in store_
+  uint index_;
+
+  /// stop with an error if the histogram is still held in the store,
+  /// called by the const methods that have to return references
+  void requireDetached(const char* method) const;
+
+public:
+  /// the histogram with the description of description and the
+  /// values of the index-th vector of store
+  CompactHistogramFeature(const CompactVectorStore* store, uint index, const HistogramFeature& description);
+
+  virtual ~CompactHistogramFeature() {}
+
+  /// the clone owns its data
+  virtual HistogramFeature* clone() const;
+
+  virtual bool read(::std::istream & is);
+  virtual bool readBinary(::std::istream & is);
+  virtual void write(::std::ostream & os);
+  virtual void writeBinary(::std::ostream & os);
+
+  virtual const uint size() const {return store_ ? store_->dim() : bins_.size();}
+  virtual const unsigned long int calcBinarySize() const;
+
+  virtual double operator[](const uint idx) const {return store_ ? store_->value(index_,idx) : data_[idx];}
+  virtual double& operator[](uint idx) {detach(); return data_[idx];}
+  virtual double operator()(const ::std::vector<uint>& pos) const {
+    const uint p=posToBin(pos);
+    return (p<size()) ? (*this)[p] : -1.0;
+  }
+
+  virtual const uint& bin(const uint idx) const {requireDetached("bin"); return bins_[idx];}
+  virtual const uint& bin(const ::std::vector<uint>& pos) const {return bin(posToBin(pos));}
+  virtual void feedbin(const uint idx) {detach(); HistogramFeature::feedbin(idx);}
+  virtual void feedbin(const ::std::vector<uint>& pos) {detach(); HistogramFeature::feedbin(pos);}
+  virtual void feed(const ::std::vector<double>& point) {detach(); HistogramFeature::feed(point);}
+
+  virtual const ::std::vector<double> &ndata() const {requireDetached("ndata"); return data_;}
+  virtual const ::std::vector<uint> &bins() const {requireDetached("bins"); return bins_;}
+  virtual ::std::vector<double> & data() {detach(); return data_;}
+  virtual const ::std::vector<double> & data() const {requireDetached("data"); return data_;}
+
+  /// NULL as long as the values are held in the store
+  virtual const double* values() const {return store_ ? NULL : HistogramFeature::values();}
+  virtual const double* decoded(double* buffer) const;
+
+  /// copy the values into data_, recompute the counts and drop the store
+  void detach();
+
+  /// whether the values are still held in the store
+  bool compact() const {return store_!=NULL;}
+};
+
+#endif
@@ -0,0 +1,170 @@
+
+/*
+This file is part of the FIRE -- Flexible Image Retrieval System
+
+FIRE is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+FIRE is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FIRE; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include "compactvectorfeature.hpp"
+#include "diag.hpp"
+
+using namespace std;
+
+CompactVectorStore::CompactVectorStore(CompactEncoding encoding, uint dim, uint capacity) : encoding_(encoding), dim_(dim), size_(0), offset_(dim,0.0), scale_(dim,1.0) {
+  if(encoding_==COMPACT_FLOAT) {
+    floats_.reserve(size_t(capacity)*dim_);
+  } else {
+    bytes_.reserve(size_t(capacity)*dim_);
+  }
+}
+
+void CompactVectorStore::setRange(const vector<double>& min, const vector<double>& max) {
+  for(uint d=0;d<dim_;++d) {
+    offset_[d]=min[d];
+    scale_[d]=(max[d]>min[d]) ? (max[d]-min[d])/255.0 : 1.0;
+  }
+}
+
+uint CompactVectorStore::add(const double* values) {
+  if(encoding_==COMPACT_FLOAT) {
+    for(uint d=0;d<dim_;++d) {
+      floats_.push_back(float(values[d]));
+    }
+  } else {
+    for(uint d=0;d<dim_;++d) {
+      const double level=floor((values[d]-offset_[d])/scale_[d]+0.5);
+      bytes_.push_back((unsigned char)(::std::max(0.0,::std::min(255.0,level))));
+    }
+  }
+  return size_++;
+}
+
+void CompactVectorStore::decode(uint idx, double* out) const {
+  const size_t pos=size_t(idx)*dim_;
+  if(encoding_==COMPACT_FLOAT) {
+    const float* v=&floats_[pos];
+    for(uint d=0;d<dim_;++d) {
+      out[d]=v[d];
+    }
+  } else {
+    const unsigned char* v=&bytes_[pos];
+    for(uint d=0;d<dim_;++d) {
+      out[d]=offset_[d]+scale_[d]*v[d];
+    }
+  }
+}
+
+size_t CompactVectorStore::bytes() const {
+  return floats_.capacity()*sizeof(float)+bytes_.capacity()+2*dim_*sizeof(double);
+}
+
+string CompactVectorStore::encodingName(CompactEncoding encoding) {
+  switch(encoding) {
+  case COMPACT_FLOAT: return "float";
+  case COMPACT_UINT8: return "uint8";
+  default: return "double";
+  }
+}
+
+bool CompactVectorStore::parseEncoding(const string& name, CompactEncoding& encoding) {
+  if(name=="double") {
+    encoding=COMPACT_DOUBLE;
+  } else if(name=="float") {
+    encoding=COMPACT_FLOAT;
+  } else if(name=="uint8") {
+    encoding=COMPACT_UINT8;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+CompactVectorFeature::CompactVectorFeature(const CompactVectorStore* store, uint index) : VectorFeature(), store_(store), index_(index) {
+}
+
+void CompactVectorFeature::detach() {
+  if(store_) {
+    data_.resize(store_->dim());
+    if(!data_.empty()) {
+      store_->decode(index_,&data_[0]);
+    }
+    store_=NULL;
+  }
+}
+
+const vector<double>& CompactVectorFeature::data() const {
+  if(store_) {
+    ERR << "The entries of this vector feature are held compactly and not in a vector. Use operator[] or decoded(), or detach() the feature." << endl;
+    exit(20);
+  }
+  return data_;
+}
+
+const double* CompactVectorFeature::decoded(double* buffer) const {
+  if(store_) {
+    store_->decode(index_,buffer);
+    return buffer;
+  }
+  return VectorFeature::values();
+}
+
+VectorFeature* CompactVectorFeature::clone() const {
+  CompactVectorFeature* result=new CompactVectorFeature(*this);
+  result->detach();
+  return result;
+}
+
+bool CompactVectorFeature::read(istream &is) {
+  store_=NULL;
+  return VectorFeature::read(is);
+}
+
+bool CompactVectorFeature::readBinary(istream &is) {
+  store_=NULL;
+  return VectorFeature::readBinary(is);
+}
+
+void CompactVectorFeature::write(ostream &os) {
+  if(store_) {
+    // written as the decoded doubles, the store is kept
+    VectorFeature copy(store_->dim());
+    if(copy.size()>0) {
+      store_->decode(index_,&copy.data()[0]);
+    }
+    copy.write(os);
+  } else {
+    VectorFeature::write(os);
+  }
+}
+
+void CompactVectorFeature::writeBinary(ostream &os) {
+  if(store_) {
+    uint size=store_->dim();
+    os.write((char*)&size,sizeof(uint));
+    if(size>0) {
+      vector<double> values(size);
+      store_->decode(index_,&values[0]);
+      os.write((const char*)&values[0],size*sizeof(double));
+    }
+  } else {
+    VectorFeature::writeBinary(os);
+  }
+}
+
+const unsigned long int CompactVectorFeature::calcBinarySize() const {
+  return sizeof(uint)+(unsigned long int)size()*(unsigned long int)sizeof(double);
+}
@@ -0,0 +1,132 @@
+
+/*
+This file is part of the FIRE -- Flexible Image Retrieval System
+
+FIRE is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+FIRE is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FIRE; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#ifndef __compactvectorfeature_hpp__
+#define __compactvectorfeature_hpp__
+
+#include <vector>
+#include <string>
+#include "vectorfeature.hpp"
+
+/// how the entries of the vectors of a suffix are held in memory
+enum CompactEncoding { COMPACT_DOUBLE, COMPACT_FLOAT, COMPACT_UINT8 };
+
+/** The entries of many vectors of the same size in one contiguous
+    array, either as float or as one byte per entry. Bytes are linear
+    quantisation levels per dimension between the minimum and the
+    maximum given to setRange, i.e. an entry is off by at most
+    (max-min)/510. Vectors are added once and do not change afterwards.
+ */
+class CompactVectorStore {
+private:
+  CompactEncoding encoding_;
+  uint dim_, size_;
+
+  /// COMPACT_FLOAT: the entries, vector after vector
+  ::std::vector<float> floats_;
+
+  /// COMPACT_UINT8: the levels, vector after vector
+  ::std::vector<unsigned char> bytes_;
+
+  /// COMPACT_UINT8: entry d is offset_[d]+scale_[d]*level
+  ::std::vector<double> offset_, scale_;
+
+public:
+  /// a store for capacity vectors of dim entries, encoding must not be COMPACT_DOUBLE
+  CompactVectorStore(CompactEncoding encoding, uint dim, uint capacity);
+
+  /// COMPACT_UINT8: the range of the entries per dimension, must be
+  /// set before vectors are added. Entries outside are clipped.
+  void setRange(const ::std::vector<double>& min, const ::std::vector<double>& max);
+
+  /// append the dim() entries of values, returns the number of the vector
+  uint add(const double* values);
+
+  /// entry d of vector idx
+  double value(uint idx, uint d) const {
+    const size_t pos=size_t(idx)*dim_+d;
+    return (encoding_==COMPACT_FLOAT) ? double(floats_[pos]) : offset_[d]+scale_[d]*bytes_[pos];
+  }
+
+  /// write the dim() entries of vector idx to out
+  void decode(uint idx, double* out) const;
+
+  uint dim() const {return dim_;}
+  uint size() const {return size_;}
+  CompactEncoding encoding() const {return encoding_;}
+
+  /// memory used for the entries
+  size_t bytes() const;
+
+  /// "double", "float" or "uint8"
+  static ::std::string encodingName(CompactEncoding encoding);
+  static bool parseEncoding(const ::std::string& name, CompactEncoding& encoding);
+};
+
+/** A VectorFeature whose entries are held in a CompactVectorStore,
+    which has to exist as long as the feature does (clones are
+    independent). As for MappedVectorFeature, everything that may
+    modify the entries (the non-const operator[], data(), read...)
+    first copies them into data_ (detach()), the const methods never
+    do, so that several threads can read the feature at once. The
+    distances use operator[] or decoded(), values() is NULL and the
+    const data() is not available until the feature is detached.
+ */
+class CompactVectorFeature : public VectorFeature {
+private:
+  /// the store, NULL once the entries have been copied into data_
+  const CompactVectorStore *store_;
+
+  /// number of the vector in store_
+  uint index_;
+
+public:
+  CompactVectorFeature(const CompactVectorStore* store, uint index);
+
+  virtual ~CompactVectorFeature() {}
+
+  /// the clone owns its data
+  virtual VectorFeature* clone() const;
+
+  virtual bool read(::std::istream & is);
+  virtual bool readBinary(::std::istream & is);
+  virtual void write(::std::ostream & os);
+  virtual void writeBinary(::std::ostream & os);
+
+  virtual double operator[](uint idx) const {return store_ ? store_->value(index_,idx) : data_[idx];}
+  virtual double& operator[](uint idx) {detach(); return data_[idx];}
+
+  virtual const uint size() const {return store_ ? store_->dim() : data_.size();}
+  virtual const unsigned long int calcBinarySize() const;
+
+  virtual ::std::vector<double> & data() {detach(); return data_;}
+  /// only for detached features, use operator[] or decoded() otherwise
+  virtual const ::std::vector<double> & data() const;
+
+  /// NULL as long as the entries are held in the store
+  virtual const double* values() const {return store_ ? NULL : VectorFeature::values();}
+  virtual const double* decoded(double* buffer) const;
+
+  /// copy the entries into data_ and drop the store
+  void detach();
+
+  /// whether the entries are still held in the store
+  bool compact() const {return store_!=NULL;}
+};
+
+#endif
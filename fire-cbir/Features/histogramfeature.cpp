@@ -96,7 +96,7 @@ uint HistogramFeature::posToBin(const vector<uint>& pos) const {
   uint p=0;
   if(pos.size()!=steps_.size()) {
     ERR << "Invalid position: not right dimensionality." << endl;
-    p=bins_.size()+1;
+    p=size()+1;
   } else {
     uint m=1;
     for(uint i=0;i<pos.size();++i) {
@@ -105,7 +105,7 @@ uint HistogramFeature::posToBin(const vector<uint>& pos) const {
         m*=steps_[i];
       } else {
         ERR << "Invalid position: out of range." << endl;
-        p=bins_.size()+1;
+        p=size()+1;
       }
     }
   }
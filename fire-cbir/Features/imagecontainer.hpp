@@ -91,7 +91,7 @@ public:
   DescriptionSet& description();
 
   /// return, how many features can be stored for this image
-  const uint numberOfFeatureSets() {return feature_sets_.size();}
+  const uint numberOfFeatureSets() const {return feature_sets_.size();}
   
   /// return the idx-th feature set
   FeatureSet*& operator[](uint idx);
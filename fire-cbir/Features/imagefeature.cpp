@@ -29,17 +29,13 @@ using namespace Magick;
 using namespace std;
 
 ImageFeature::ImageFeature() : xsize_(0), ysize_(0), zsize_(0),
-                               data_(0,vector<double>(0)) {type_=FT_IMG;}
+                               data_() {type_=FT_IMG;}
 
 ImageFeature::ImageFeature(uint xsize, uint ysize, uint zsize) : xsize_(xsize), ysize_(ysize), zsize_(zsize),
-                                                                 data_(zsize,vector<double>(xsize*ysize)) {type_=FT_IMG;}
+                                                                 data_(xsize,ysize,zsize) {type_=FT_IMG;}
 
 
 ImageFeature::~ImageFeature() {
-  for(uint i=0;i<data_.size();++i) {
-    data_[i].clear();
-  }
-  data_.clear();
 }
  
 
@@ -49,19 +45,16 @@ void ImageFeature::createFromJF(DoubleVector* data) {
   xsize_ = width;
   ysize_ = width;
   zsize_ = 1;
-  data_.resize(zsize_);
-  for (uint c = 0; c < zsize_; ++c) {
-    data_[c].resize(xsize_ * ysize_);
-  }
+  data_.resize(xsize_,ysize_,zsize_);
   for (uint i = 0; i < xsize_ * ysize_ ; i++) {
-    data_[0][i] = (*data)[i];
+    data_.plane(0)[i] = (*data)[i];
   }
 }
 
 DoubleVector* ImageFeature::toJF(int channel) {
   DoubleVector* dv = new DoubleVector(0);
   for (uint i = 0; i < xsize_ * ysize_; i++) {
-    dv->push_back(data_[channel][i]);
+    dv->push_back(data_.plane(channel)[i]);
   }
   return dv;
 }
@@ -71,12 +64,9 @@ void ImageFeature::createFromPixelset(int width, int height, int* pixels) {
   xsize_ = width;
   ysize_ = height;
   zsize_ = 1;
-  data_.resize(zsize_);
-  for (uint c = 0; c < zsize_; ++c) {
-    data_[c].resize(xsize_ * ysize_);
-  }
+  data_.resize(xsize_,ysize_,zsize_);
   for (uint i = 0; i < xsize_ * ysize_; i++) {
-    data_[0][i] = (pixels[i] / 255.0);
+    data_.plane(0)[i] = (pixels[i] / 255.0);
   }
 }
 
@@ -84,12 +74,9 @@ void ImageFeature::createFromPixelset(int width, int height, const vector<int>&
   xsize_ = width;
   ysize_ = height;
   zsize_ = 1;
-  data_.resize(zsize_);
-  for (uint c = 0; c < zsize_; ++c) {
-    data_[c].resize(xsize_ * ysize_);
-  }
+  data_.resize(xsize_,ysize_,zsize_);
   for (uint i = 0; i < xsize_ * ysize_; i++) {
-    data_[0][i] = (pixels[i] / 255.0);
+    data_.plane(0)[i] = (pixels[i] / 255.0);
   }
 }
 
@@ -108,16 +95,15 @@ bool ImageFeature::load(const ::std::string &filename, const Image loaded) {
   ysize_=loaded.rows();
   zsize_=3;
   
-  data_.resize(zsize_);
-  for(uint c=0;c<zsize_;++c) data_[c].resize(xsize_*ysize_);
+  data_.resize(xsize_,ysize_,zsize_);
   
   DBG(30) << "Loading rgb image" << endl;
   for(uint y=0;y<ysize_;++y) {
     for(uint x=0;x<xsize_;++x) {
       rgbPixel=loaded.pixelColor(x,y);
-      data_[0][y*xsize_+x]=rgbPixel.red();
-      data_[1][y*xsize_+x]=rgbPixel.green();
-      data_[2][y*xsize_+x]=rgbPixel.blue();
+      data_(x,y,0)=rgbPixel.red();
+      data_(x,y,1)=rgbPixel.green();
+      data_(x,y,2)=rgbPixel.blue();
     }
   }
   return true;
@@ -171,8 +157,7 @@ bool ImageFeature::load(const ::std::string& filename, bool forceGray){
   //  ERR << "Unknown color space" << loaded.colorSpace() << endl; return false;
   //}
   
-  data_.resize(zsize_);
-  for(uint c=0;c<zsize_;++c) data_[c].resize(xsize_*ysize_);
+  data_.resize(xsize_,ysize_,zsize_);
   
   switch(zsize_) {
   case 1: //gray image
@@ -180,7 +165,7 @@ bool ImageFeature::load(const ::std::string& filename, bool forceGray){
     for(uint y=0;y<ysize_;++y) {
       for(uint x=0;x<xsize_;++x) {
         rgbPixel=loaded.pixelColor(x,y);
-        data_[0][y*xsize_+x]=(rgbPixel.red()+rgbPixel.green()+rgbPixel.blue())/3;
+        data_(x,y,0)=(rgbPixel.red()+rgbPixel.green()+rgbPixel.blue())/3;
       }
     }
     break;
@@ -189,9 +174,9 @@ bool ImageFeature::load(const ::std::string& filename, bool forceGray){
     for(uint y=0;y<ysize_;++y) {
       for(uint x=0;x<xsize_;++x) {
         rgbPixel=loaded.pixelColor(x,y);
-        data_[0][y*xsize_+x]=rgbPixel.red();
-        data_[1][y*xsize_+x]=rgbPixel.green();
-        data_[2][y*xsize_+x]=rgbPixel.blue();
+        data_(x,y,0)=rgbPixel.red();
+        data_(x,y,1)=rgbPixel.green();
+        data_(x,y,2)=rgbPixel.blue();
       }
     }
     return true;
@@ -220,7 +205,7 @@ Image ImageFeature::makeMagickImage(const uint &idx1, const uint &idx2, const ui
     result.colorSpace(GRAYColorspace);
     for(uint x=0;x<xsize_;++x) {
       for(uint y=0;y<ysize_;++y) {
-        result.pixelColor(x,y,ColorGray(data_[idx1][y*xsize_+x]));
+        result.pixelColor(x,y,ColorGray(data_(x,y,idx1)));
       }
     }
   } else {
@@ -228,7 +213,7 @@ Image ImageFeature::makeMagickImage(const uint &idx1, const uint &idx2, const ui
     DBG(30) << "Making Magick image in RGB" << endl;
     for(uint x=0;x<xsize_;++x) {
       for(uint y=0;y<ysize_;++y) {
-        result.pixelColor(x,y,ColorRGB(data_[idx1][y*xsize_+x], data_[idx2][y*xsize_+x], data_[idx3][y*xsize_+x]));
+        result.pixelColor(x,y,ColorRGB(data_(x,y,idx1), data_(x,y,idx2), data_(x,y,idx3)));
       }
     }
   }
@@ -266,24 +251,21 @@ void ImageFeature::save(const ::std::string & filename, const uint& idx1, const
 const vector<double> ImageFeature::operator()(uint x, uint y) const{
   vector<double> result;
   for(uint c=0;c<zsize_;++c) {
-    result.push_back(data_[c][y*xsize_+x]);
+    result.push_back(data_(x,y,c));
   }
   return result;
 }
 
 void ImageFeature::append(const ImageFeature& img) {
   if(img.xsize()==xsize_ && img.ysize() == ysize_) {
-    uint oldsize=data_.size();
-    data_.resize(data_.size()+img.zsize(),vector<double>(xsize()*ysize()));
+    uint oldsize=zsize_;
+    data_.addLayers(img.zsize());
+    zsize_=data_.zsize();
     
     for(uint c=0;c<img.zsize();++c) {
-      for(uint x=0;x<img.xsize();++x) {
-        for(uint y=0;y<img.ysize();++y) {
-          (*this)(x,y,oldsize+c)=img(x,y,c);
-        }
-      }
+      const double* src=img.plane(c);
+      copy(src, src+xsize_*ysize_, plane(oldsize+c));
     }
-    zsize_=data_.size();
   } else {
     ERR << "Images not compatible for appending" << endl;
   }
@@ -305,10 +287,7 @@ bool ImageFeature::read(::std:: istream & is) {
   } else {
     iss >> xsize_ >> ysize_ >> zsize_;
     //    cout << xsize_ << ysize_ << zsize_ << endl;
-    data_.resize(zsize_);
-    for(uint c=0;c<zsize_;++c) {
-      data_[c].resize(xsize_*ysize_);
-    }
+    data_.resize(xsize_,ysize_,zsize_);
   }
 
   getline(is,line); iss.clear(); iss.str(line); iss >> tmp;
@@ -348,10 +327,7 @@ bool ImageFeature::readBinary(istream &is){
   	return false;
   }
   // resize the imagevector:
-  data_.resize(zsize_);
-  for(uint i=0;i<zsize_;++i){
-    data_[i].resize(xsize_ * ysize_);
-  }
+  data_.resize(xsize_,ysize_,zsize_);
   // now read the data components of the image
   for(uint x=0;x<xsize_;++x){
     for(uint y=0;y<ysize_;++y){
@@ -368,11 +344,7 @@ bool ImageFeature::readBinary(istream &is){
 
 const ImageFeature ImageFeature::layer(const uint i) const {
   ImageFeature result(xsize(),ysize(),1);
-  for(uint x=0;x<xsize_;++x) {
-    for(uint y=0;y<ysize_;++y) {
-      result(x,y,0)=this->operator()(x,y,i);
-    }
-  }
+  copy(plane(i), plane(i)+xsize_*ysize_, result.plane(0));
   return result;
 }
 
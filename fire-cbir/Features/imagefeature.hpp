@@ -22,6 +22,7 @@ along with FIRE; if not, write to the Free Software Foundation, Inc.,
 #include <iostream>
 #include <iomanip>
 #include "vectorfeature.hpp"
+#include "planarimage.hpp"
 #include "diag.hpp"
 
 #ifdef HAVE_IMAGE_MAGICK
@@ -45,9 +46,9 @@ protected:
   /// the dimensions of the image, xsize=width, ysize=height, zsize=depth (color channels etc.)
   uint xsize_, ysize_, zsize_;
 
-  /// the data itself, here the outer vector represents the layers,
-  /// the inner vector is the vector representation of one layer each.
-  ::std::vector< ::std::vector<double> > data_;
+  /// the data itself, all layers in one contiguous block, see
+  /// PlanarImage. Each layer is stored row by row.
+  PlanarImage<double> data_;
 
 
 #ifdef HAVE_IMAGE_MAGICK
@@ -76,12 +77,11 @@ public:
     xsize_=x;
     ysize_=y;
     zsize_=z;
-    data_.resize(z);
+    data_.resize(x,y,z);
     for(uint c=0;c<z;++c) {
-      data_[c].resize(x*y);
       for(uint x=0;x<xsize_;++x) {
         for(uint y=0;y<ysize_;++y) {
-          data_[c][y*xsize_+x]=vec[y*xsize_*zsize_+x*zsize_+c];
+          data_(x,y,c)=vec[y*xsize_*zsize_+x*zsize_+c];
         }
       }
     }
@@ -159,18 +159,27 @@ public:
   virtual const uint zsize() const {  return zsize_;}
 
   /// get the idx-th pixel (const)
-  virtual double operator[](uint idx) const {  return data_[idx%zsize_][idx/zsize_];}
+  virtual double operator[](uint idx) const {  return data_.plane(idx%zsize_)[idx/zsize_];}
   /// get the idx-th pixel
-  virtual double& operator[](const uint idx) {  return data_[idx%zsize_][idx/zsize_];}
+  virtual double& operator[](const uint idx) {  return data_.plane(idx%zsize_)[idx/zsize_];}
 
   /// return the values at position x,y for all layers in a vector
   virtual const ::std::vector<double> operator()(uint x, uint y) const;
 
-  /// access pixel at position (x,y), layer c
-  virtual double& operator()(uint x, uint y, uint c) {  return data_[c][y*xsize_+x];}
+  /// access pixel at position (x,y), layer c. This is not virtual to
+  /// allow inlining in the pixel loops.
+  double& operator()(uint x, uint y, uint c) {  return data_(x,y,c);}
 
   /// access pixel at position (x,y), layer c (const)
-  virtual const double& operator()(uint x, uint y, uint c) const {  return data_[c][y*xsize_+x];}
+  const double& operator()(uint x, uint y, uint c) const {  return data_(x,y,c);}
+
+  /// first pixel of row y in layer c, the row has xsize() pixels
+  double* row(uint y, uint c) { return data_.row(y,c);}
+  const double* row(uint y, uint c) const { return data_.row(y,c);}
+
+  /// first pixel of layer c, the layer has xsize()*ysize() pixels
+  double* plane(uint c) { return data_.plane(c);}
+  const double* plane(uint c) const { return data_.plane(c);}
 
   /// append the layers from the given ImageFeature to the current one
   virtual void append(const ImageFeature& img);
@@ -187,16 +196,12 @@ public:
   const ::std::string& filename() const {return filename_;}
   
 
-  virtual ::std::vector<double> layerVector(const uint i) const {return data_[i];}
+  virtual ::std::vector<double> layerVector(const uint i) const {return ::std::vector<double>(data_.plane(i), data_.plane(i)+xsize_*ysize_);}
 
   /// change the size of the image. contents are destroyed by this
   virtual void resize(const uint width, const uint height, const uint depth) {
     xsize_=width; ysize_=height; zsize_=depth;
-    
-    data_.resize(zsize_);
-    for(uint c=0;c<zsize_;++c) {
-      data_[c].resize(xsize_*ysize_);
-    }
+    data_.resize(xsize_,ysize_,zsize_);
   }
 
 private:
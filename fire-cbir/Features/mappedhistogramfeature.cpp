@@ -0,0 +1,89 @@
+
+/*
+This file is part of the FIRE -- Flexible Image Retrieval System
+
+FIRE is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+FIRE is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FIRE; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#include <cstdlib>
+#include "mappedhistogramfeature.hpp"
+#include "diag.hpp"
+
+using namespace std;
+
+MappedHistogramFeature::MappedHistogramFeature(uint counter, const vector<uint>& steps,
+                                               const vector<double>& min, const vector<double>& max,
+                                               const double* values, const uint* bins, uint size) :
+  HistogramFeature(), view_(values), binsView_(bins), viewSize_(size) {
+  steps_=steps;
+  min_=min;
+  max_=max;
+  dim_=steps.size();
+  size_=size;
+  counter_=counter;
+  initStepsize();
+}
+
+void MappedHistogramFeature::detach() {
+  if(view_) {
+    data_.assign(view_, view_+viewSize_);
+    bins_.assign(binsView_, binsView_+viewSize_);
+    view_=NULL;
+    binsView_=NULL;
+  }
+}
+
+void MappedHistogramFeature::requireDetached(const char* method) const {
+  if(view_) {
+    ERR << "The bins of this histogram are mapped and not held in vectors, " << method << "() is not available. Use operator[], bin() or values(), or detach() the histogram." << endl;
+    exit(20);
+  }
+}
+
+HistogramFeature* MappedHistogramFeature::clone() const {
+  MappedHistogramFeature* result=new MappedHistogramFeature(*this);
+  result->detach();
+  return result;
+}
+
+bool MappedHistogramFeature::read(istream &is) {
+  view_=NULL;
+  binsView_=NULL;
+  return HistogramFeature::read(is);
+}
+
+bool MappedHistogramFeature::readBinary(istream &is) {
+  view_=NULL;
+  binsView_=NULL;
+  return HistogramFeature::readBinary(is);
+}
+
+void MappedHistogramFeature::write(ostream &os) {
+  detach();
+  HistogramFeature::write(os);
+}
+
+void MappedHistogramFeature::writeBinary(ostream &os) {
+  detach();
+  HistogramFeature::writeBinary(os);
+}
+
+const unsigned long int MappedHistogramFeature::calcBinarySize() const {
+  unsigned long int bsize = 2*sizeof(uint);
+  bsize += (unsigned long int)steps_.size() * (unsigned long int)sizeof(uint);
+  bsize += (unsigned long int)min_.size() * (unsigned long int)sizeof(double);
+  bsize += (unsigned long int)max_.size() * (unsigned long int)sizeof(double);
+  bsize += (unsigned long int)size() * (unsigned long int)sizeof(uint);
+  return bsize;
+}
@@ -0,0 +1,95 @@
+
+/*
+This file is part of the FIRE -- Flexible Image Retrieval System
+
+FIRE is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+FIRE is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FIRE; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#ifndef __mappedhistogramfeature_hpp__
+#define __mappedhistogramfeature_hpp__
+
+#include "histogramfeature.hpp"
+
+/** A HistogramFeature whose normalized values and bin counts are read
+    directly from memory owned by someone else (a memory-mapped
+    LargeBinaryFeatureFile). The small description of the histogram
+    (steps, min, max, counter) is copied. As for MappedVectorFeature,
+    all methods that may modify the histogram copy the data first
+    (detach()), while the const methods read the mapped memory and
+    change nothing. The const ndata(), bins() and data() can only be
+    used once the histogram is detached.
+ */
+class MappedHistogramFeature : public HistogramFeature {
+private:
+  /// the normalized values, NULL once they have been copied into data_
+  const double *view_;
+
+  /// the bin counts, valid as long as view_ is
+  const uint *binsView_;
+
+  /// number of bins in the views
+  uint viewSize_;
+
+  /// stop with an error if the histogram is still mapped, called by the
+  /// const methods that have to return the ::std::vectors
+  void requireDetached(const char* method) const;
+
+public:
+  /// a histogram with the given description showing the size values
+  /// and bin counts starting at values and bins respectively
+  MappedHistogramFeature(uint counter, const ::std::vector<uint>& steps,
+                         const ::std::vector<double>& min, const ::std::vector<double>& max,
+                         const double* values, const uint* bins, uint size);
+
+  virtual ~MappedHistogramFeature() {}
+
+  /// the clone owns its data
+  virtual HistogramFeature* clone() const;
+
+  virtual bool read(::std::istream & is);
+  virtual bool readBinary(::std::istream & is);
+  virtual void write(::std::ostream & os);
+  virtual void writeBinary(::std::ostream & os);
+
+  virtual const uint size() const {return view_ ? viewSize_ : bins_.size();}
+  virtual const unsigned long int calcBinarySize() const;
+
+  virtual double operator[](const uint idx) const {return view_ ? view_[idx] : data_[idx];}
+  virtual double& operator[](uint idx) {detach(); return data_[idx];}
+  virtual double operator()(const ::std::vector<uint>& pos) const {
+    const uint p=posToBin(pos);
+    return (p<size()) ? (*this)[p] : -1.0;
+  }
+
+  virtual const uint& bin(const uint idx) const {return binsView_ ? binsView_[idx] : bins_[idx];}
+  virtual const uint& bin(const ::std::vector<uint>& pos) const {return bin(posToBin(pos));}
+  virtual void feedbin(const uint idx) {detach(); HistogramFeature::feedbin(idx);}
+  virtual void feedbin(const ::std::vector<uint>& pos) {detach(); HistogramFeature::feedbin(pos);}
+  virtual void feed(const ::std::vector<double>& point) {detach(); HistogramFeature::feed(point);}
+
+  virtual const ::std::vector<double> &ndata() const {requireDetached("ndata"); return data_;}
+  virtual const ::std::vector<uint> &bins() const {requireDetached("bins"); return bins_;}
+  virtual ::std::vector<double> & data() {detach(); return data_;}
+  virtual const ::std::vector<double> & data() const {requireDetached("data"); return data_;}
+
+  virtual const double* values() const {return view_ ? view_ : HistogramFeature::values();}
+
+  /// copy the values and counts into data_ and bins_ and drop the views
+  void detach();
+
+  /// whether the values are still read from the mapped memory
+  bool mapped() const {return view_!=NULL;}
+};
+
+#endif
@@ -0,0 +1,76 @@
+
+/*
+This file is part of the FIRE -- Flexible Image Retrieval System
+
+FIRE is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+FIRE is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FIRE; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#include <cstdlib>
+#include "mappedvectorfeature.hpp"
+#include "diag.hpp"
+
+using namespace std;
+
+MappedVectorFeature::MappedVectorFeature(const double* values, uint size) : VectorFeature(), view_(values), viewSize_(size) {
+}
+
+void MappedVectorFeature::detach() {
+  if(view_) {
+    data_.assign(view_, view_+viewSize_);
+    view_=NULL;
+  }
+}
+
+const vector<double>& MappedVectorFeature::data() const {
+  if(view_) {
+    ERR << "The entries of this vector feature are mapped and not held in a vector. Use operator[] or values(), or detach() the feature." << endl;
+    exit(20);
+  }
+  return data_;
+}
+
+VectorFeature* MappedVectorFeature::clone() const {
+  MappedVectorFeature* result=new MappedVectorFeature(*this);
+  result->detach();
+  return result;
+}
+
+bool MappedVectorFeature::read(istream &is) {
+  view_=NULL;
+  return VectorFeature::read(is);
+}
+
+bool MappedVectorFeature::readBinary(istream &is) {
+  view_=NULL;
+  return VectorFeature::readBinary(is);
+}
+
+void MappedVectorFeature::write(ostream &os) {
+  detach();
+  VectorFeature::write(os);
+}
+
+void MappedVectorFeature::writeBinary(ostream &os) {
+  if(view_) {
+    uint size=viewSize_;
+    os.write((char*)&size,sizeof(uint));
+    os.write((const char*)view_,viewSize_*sizeof(double));
+  } else {
+    VectorFeature::writeBinary(os);
+  }
+}
+
+const unsigned long int MappedVectorFeature::calcBinarySize() const {
+  return sizeof(uint)+(unsigned long int)size()*(unsigned long int)sizeof(double);
+}
@@ -0,0 +1,78 @@
+
+/*
+This file is part of the FIRE -- Flexible Image Retrieval System
+
+FIRE is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+FIRE is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FIRE; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+#ifndef __mappedvectorfeature_hpp__
+#define __mappedvectorfeature_hpp__
+
+#include "vectorfeature.hpp"
+
+/** A VectorFeature whose entries are not copied into data_ but are
+    read directly from memory owned by someone else, usually the pages
+    of a memory-mapped LargeBinaryFeatureFile. The memory has to stay
+    valid as long as the feature exists (clones are independent).
+
+    Everything that may modify the entries (the non-const operator[],
+    data(), read...) first copies the entries into data_ (detach()),
+    afterwards the feature behaves like a normal VectorFeature. The
+    const methods never do this, so a mapped feature can be read by
+    several threads at once. They read the mapped memory, except for the
+    const data(), which has no ::std::vector to return before the
+    feature is detached. Thus the distances use operator[] or values().
+ */
+class MappedVectorFeature : public VectorFeature {
+private:
+  /// the entries, NULL once they have been copied into data_
+  const double *view_;
+
+  /// number of entries in view_
+  uint viewSize_;
+
+public:
+  /// a feature showing the size doubles starting at values
+  MappedVectorFeature(const double* values, uint size);
+
+  virtual ~MappedVectorFeature() {}
+
+  /// the clone owns its data
+  virtual VectorFeature* clone() const;
+
+  virtual bool read(::std::istream & is);
+  virtual bool readBinary(::std::istream & is);
+  virtual void write(::std::ostream & os);
+  virtual void writeBinary(::std::ostream & os);
+
+  virtual double operator[](uint idx) const {return view_ ? view_[idx] : data_[idx];}
+  virtual double& operator[](uint idx) {detach(); return data_[idx];}
+
+  virtual const uint size() const {return view_ ? viewSize_ : data_.size();}
+  virtual const unsigned long int calcBinarySize() const;
+
+  virtual ::std::vector<double> & data() {detach(); return data_;}
+  /// only for detached features, use operator[] or values() otherwise
+  virtual const ::std::vector<double> & data() const;
+
+  virtual const double* values() const {return view_ ? view_ : VectorFeature::values();}
+
+  /// copy the entries into data_ and drop the view
+  void detach();
+
+  /// whether the entries are still read from the mapped memory
+  bool mapped() const {return view_!=NULL;}
+};
+
+#endif
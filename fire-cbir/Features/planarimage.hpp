@@ -0,0 +1,135 @@
+/*
+This file is part of the FIRE -- Flexible Image Retrieval System
+
+FIRE is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+
+FIRE is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with FIRE; if not, write to the Free Software Foundation, Inc.,
+59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#ifndef __planarimage_hpp__
+#define __planarimage_hpp__
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "diag.hpp"
+
+/**
+ * Contiguous storage for the layers of an image. All layers are kept in
+ * one aligned block of memory, each layer row by row, and each layer
+ * starts on an aligned address. Rows and layers can thus be walked with
+ * plain pointers, which lets the compiler vectorize loops over them.
+ *
+ * The pixel type T is a template parameter (float or double, it must be
+ * a plain type, the memory is not constructed). ImageFeature uses
+ * PlanarImage<double>.
+ */
+template<class T>
+class PlanarImage {
+public:
+  /// alignment of the block and of each layer in bytes
+  static const uint Alignment=32;
+
+  /// empty image
+  PlanarImage() : xsize_(0), ysize_(0), zsize_(0), stride_(0), data_(NULL) {}
+
+  /// image of the given size, all pixels are zero
+  PlanarImage(uint xsize, uint ysize, uint zsize) : xsize_(0), ysize_(0), zsize_(0), stride_(0), data_(NULL) {
+    resize(xsize, ysize, zsize);
+  }
+
+  PlanarImage(const PlanarImage& src) : xsize_(0), ysize_(0), zsize_(0), stride_(0), data_(NULL) {
+    *this=src;
+  }
+
+  ~PlanarImage() {
+    free(data_);
+  }
+
+  PlanarImage& operator=(const PlanarImage& src) {
+    if(this!=&src) {
+      reallocate(src.xsize_, src.ysize_, src.zsize_);
+      if(data_) memcpy(data_, src.data_, sizeof(T)*stride_*zsize_);
+    }
+    return *this;
+  }
+
+  /// change the size of the image, all pixels are set to zero
+  void resize(uint xsize, uint ysize, uint zsize) {
+    reallocate(xsize, ysize, zsize);
+    if(data_) memset(data_, 0, sizeof(T)*stride_*zsize_);
+  }
+
+  /// add n zero layers at the end, the existing layers are kept
+  void addLayers(uint n) {
+    T* old=data_;
+    data_=allocate(size_t(stride_)*(zsize_+n));
+    if(data_) {
+      if(old) memcpy(data_, old, sizeof(T)*stride_*zsize_);
+      memset(data_+size_t(stride_)*zsize_, 0, sizeof(T)*stride_*n);
+    }
+    free(old);
+    zsize_+=n;
+  }
+
+  uint xsize() const { return xsize_; }
+  uint ysize() const { return ysize_; }
+  uint zsize() const { return zsize_; }
+
+  /// access pixel at position (x,y), layer c
+  T& operator()(uint x, uint y, uint c) { return data_[size_t(c)*stride_+y*xsize_+x]; }
+  const T& operator()(uint x, uint y, uint c) const { return data_[size_t(c)*stride_+y*xsize_+x]; }
+
+  /// first pixel of layer c, the xsize*ysize pixels of a layer are contiguous
+  T* plane(uint c) { return data_+size_t(c)*stride_; }
+  const T* plane(uint c) const { return data_+size_t(c)*stride_; }
+
+  /// first pixel of row y in layer c
+  T* row(uint y, uint c) { return data_+size_t(c)*stride_+y*xsize_; }
+  const T* row(uint y, uint c) const { return data_+size_t(c)*stride_+y*xsize_; }
+
+private:
+  /// set the sizes and get memory for them, contents are undefined
+  void reallocate(uint xsize, uint ysize, uint zsize) {
+    uint stride=alignedStride(xsize*ysize);
+    if(size_t(stride)*zsize != size_t(stride_)*zsize_ || !data_) {
+      free(data_);
+      data_=allocate(size_t(stride)*zsize);
+    }
+    xsize_=xsize; ysize_=ysize; zsize_=zsize; stride_=stride;
+  }
+
+  /// number of elements of a layer of n pixels, padded so that the next
+  /// layer starts aligned
+  static uint alignedStride(uint n) {
+    uint perAlignment=::std::max(uint(1), uint(Alignment/sizeof(T)));
+    return (n+perAlignment-1)/perAlignment*perAlignment;
+  }
+
+  static T* allocate(size_t n) {
+    if(n==0) return NULL;
+    void* result=NULL;
+    if(posix_memalign(&result, Alignment, n*sizeof(T))!=0) {
+      ERR << "Unable to allocate " << n*sizeof(T) << " bytes for an image." << ::std::endl;
+      exit(20);
+    }
+    return static_cast<T*>(result);
+  }
+
+  uint xsize_, ysize_, zsize_;
+  /// distance between the starts of two layers in elements
+  uint stride_;
+  T* data_;
+};
+
+#endif
@@ -93,6 +93,8 @@ public:
   double operator()(const Position& pos);
   uint binCount(const Position& pos);
   MapTypeDouble getMap() const;
+  /// the normalized bin values without copying them
+  const MapTypeDouble& map() const { return data_; }
   MapTypeInt getBinMap() const;
 
   // add items to the histogram
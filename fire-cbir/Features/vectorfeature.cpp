@@ -114,7 +114,7 @@ VectorFeature VectorFeature::operator-(const VectorFeature & v ) const
     if (v.size() != size()){
       DBG(10)<<"THIS SHOULD NEVER HAPPEN!"<<std::endl;
     }
-    VectorFeature result = VectorFeature((*this));
+    VectorFeature result(size());
     for (size_t i=0; i < size(); ++i)
       result[i] = (*this)[i] - v[i];
     return result;
@@ -78,6 +78,39 @@ public:
   ///feature. This allows for various modifications.
   virtual ::std::vector<double> & data() {return data_;}
   virtual const ::std::vector<double> & data() const {return data_;}
+
+  /// return the entries as a plain array of size() doubles (NULL if
+  /// there are none). Unlike data() this does not require the entries
+  /// to be held in a ::std::vector, see MappedVectorFeature.
+  virtual const double* values() const {return data_.empty() ? NULL : &data_[0];}
+
+  /// return the entries as a plain array of size() doubles: values()
+  /// if they are held as doubles, otherwise they are decoded into
+  /// buffer, which must have room for size() entries. See
+  /// CompactVectorFeature.
+  virtual const double* decoded(double* buffer) const {return values();}
+
+  /// return f as VectorFeature if it is a plain vector feature (type
+  /// FT_VEC), NULL otherwise. Other features derived from
+  /// VectorFeature (e.g. ImageFeature) have their own storage and type.
+  /// This is much cheaper than a dynamic_cast in loops over the database.
+  static const VectorFeature* plain(const BaseFeature* f) {
+    if(f && f->type()==FT_VEC) {
+      return static_cast<const VectorFeature*>(f);
+    }
+    return NULL;
+  }
+
+  /// return f as VectorFeature if its entries are a dense vector of
+  /// doubles that the distances read through operator[], i.e. if it
+  /// is a plain vector feature or a histogram (type FT_HISTO, whose
+  /// entries are the normalized bin counts), NULL otherwise.
+  static const VectorFeature* dense(const BaseFeature* f) {
+    if(f && (f->type()==FT_VEC || f->type()==FT_HISTO)) {
+      return static_cast<const VectorFeature*>(f);
+    }
+    return NULL;
+  }
   
 };
 
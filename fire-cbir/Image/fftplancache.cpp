@@ -0,0 +1,135 @@
+/*
+This file is part of the FIRE -- Flexible Image Retrieval System
+
+FIRE is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+FIRE is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FIRE; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifdef HAVE_FFT_LIBRARY
+
+#include <map>
+#include "fftplancache.hpp"
+
+using namespace std;
+
+namespace {
+  /// what identifies a plan: size, direction and layout
+  struct PlanKey {
+    uint rows, cols;
+    int dir;
+    bool inPlace;
+
+    PlanKey(uint r, uint c, int d, bool ip) : rows(r), cols(c), dir(d), inPlace(ip) {}
+
+    bool operator<(const PlanKey& o) const {
+      if(rows!=o.rows) return rows<o.rows;
+      if(cols!=o.cols) return cols<o.cols;
+      if(dir!=o.dir) return dir<o.dir;
+      return inPlace<o.inPlace;
+    }
+  };
+
+  typedef map<PlanKey, fftwnd_plan> ComplexPlanMap;
+  typedef map<PlanKey, rfftwnd_plan> RealPlanMap;
+
+  ComplexPlanMap& complexPlans() {
+    static ComplexPlanMap plans;
+    return plans;
+  }
+
+  RealPlanMap& realPlans() {
+    static RealPlanMap plans;
+    return plans;
+  }
+
+  bool powerOfTwo(uint n) {
+    return n>0 && (n&(n-1))==0;
+  }
+
+  /// whether plans of this size are kept in the cache
+  bool cached(uint rows, uint cols) {
+    return powerOfTwo(rows) && powerOfTwo(cols);
+  }
+}
+
+fftwnd_plan cachedFFTPlan(uint rows, uint cols, fftw_direction dir, bool inPlace) {
+  fftwnd_plan plan;
+  int flags=FFTW_ESTIMATE | FFTW_THREADSAFE;
+  if(inPlace) flags|=FFTW_IN_PLACE;
+#pragma omp critical(fftplancache)
+  {
+    if(cached(rows, cols)) {
+      PlanKey key(rows, cols, dir, inPlace);
+      ComplexPlanMap::iterator it=complexPlans().find(key);
+      if(it==complexPlans().end()) {
+        it=complexPlans().insert(make_pair(key, fftw2d_create_plan(rows, cols, dir, flags))).first;
+      }
+      plan=it->second;
+    } else {
+      plan=fftw2d_create_plan(rows, cols, dir, flags);
+    }
+  }
+  return plan;
+}
+
+rfftwnd_plan cachedRealFFTPlan(uint rows, uint cols, fftw_direction dir) {
+  rfftwnd_plan plan;
+#pragma omp critical(fftplancache)
+  {
+    if(cached(rows, cols)) {
+      PlanKey key(rows, cols, dir, false);
+      RealPlanMap::iterator it=realPlans().find(key);
+      if(it==realPlans().end()) {
+        it=realPlans().insert(make_pair(key, rfftw2d_create_plan(rows, cols, dir, FFTW_ESTIMATE | FFTW_THREADSAFE))).first;
+      }
+      plan=it->second;
+    } else {
+      plan=rfftw2d_create_plan(rows, cols, dir, FFTW_ESTIMATE | FFTW_THREADSAFE);
+    }
+  }
+  return plan;
+}
+
+void releaseFFTPlan(fftwnd_plan plan, uint rows, uint cols) {
+  if(!cached(rows, cols)) {
+#pragma omp critical(fftplancache)
+    fftwnd_destroy_plan(plan);
+  }
+}
+
+void releaseRealFFTPlan(rfftwnd_plan plan, uint rows, uint cols) {
+  if(!cached(rows, cols)) {
+#pragma omp critical(fftplancache)
+    rfftwnd_destroy_plan(plan);
+  }
+}
+
+void expandHalfSpectrum(const fftw_complex* half, fftw_complex* full, uint rows, uint cols) {
+  uint halfcols=cols/2+1;
+  for(uint r=0;r<rows;++r) {
+    const fftw_complex* hrow=half+r*halfcols;
+    // the conjugate symmetric partner of row r
+    const fftw_complex* mrow=half+((rows-r)%rows)*halfcols;
+    fftw_complex* frow=full+r*cols;
+    for(uint c=0;c<halfcols;++c) {
+      frow[c]=hrow[c];
+    }
+    for(uint c=halfcols;c<cols;++c) {
+      frow[c].re=mrow[cols-c].re;
+      frow[c].im=-mrow[cols-c].im;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,71 @@
+/*
+This file is part of the FIRE -- Flexible Image Retrieval System
+
+FIRE is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+FIRE is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FIRE; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __fftplancache_hpp__
+#define __fftplancache_hpp__
+
+#ifdef HAVE_FFT_LIBRARY
+
+#include <sys/types.h>
+
+#ifndef RFFTW_INCLUDE
+#define RFFTW_INCLUDE <rfftw.h>
+#endif
+
+extern "C" {
+  #include FFTW_INCLUDE
+  #include RFFTW_INCLUDE
+}
+
+/**
+ * Process wide cache of FFTW plans. Only plans for power of two sizes
+ * (the padded sizes of Gabor, DifferenceOfGaussian and fftconvolve) are
+ * cached: such a plan is created the first time a size and direction is
+ * asked for and is kept until the program ends, which bounds the cache to
+ * a few dozen plans. Plans for other sizes (fft and fftscale work at the
+ * size of the image) are created for the caller. Callers hand every plan they get
+ * from here back with releaseFFTPlan or releaseRealFFTPlan, which
+ * destroy the uncached ones, and never destroy plans themselves.
+ *
+ * Plan creation is serialized and all plans are created with
+ * FFTW_THREADSAFE, so a cached plan can be executed by several threads at
+ * the same time. Code that needs FFTW plans in threaded contexts (e.g. the
+ * feature extractors run by the server or by extractbatch) must get them
+ * from here and not call the fftw*_create_plan functions directly.
+ */
+
+/// complex 2D plan for a rows x cols array (stored row major)
+fftwnd_plan cachedFFTPlan(uint rows, uint cols, fftw_direction dir, bool inPlace=false);
+
+/// real 2D plan for a rows x cols array, dir is FFTW_REAL_TO_COMPLEX or
+/// FFTW_COMPLEX_TO_REAL. The complex side has rows x (cols/2+1) entries.
+rfftwnd_plan cachedRealFFTPlan(uint rows, uint cols, fftw_direction dir);
+
+/// give back a plan of cachedFFTPlan
+void releaseFFTPlan(fftwnd_plan plan, uint rows, uint cols);
+
+/// give back a plan of cachedRealFFTPlan
+void releaseRealFFTPlan(rfftwnd_plan plan, uint rows, uint cols);
+
+/// fill the full rows x cols spectrum of a real input from the
+/// rows x (cols/2+1) half spectrum computed by a real to complex plan
+void expandHalfSpectrum(const fftw_complex* half, fftw_complex* full, uint rows, uint cols);
+
+#endif
+
+#endif
@@ -24,14 +24,18 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "interpolatingimage.hpp"
 #include <map>
 #ifdef HAVE_FFT_LIBRARY
-extern "C" {
-  #include FFTW_INCLUDE
-}
+#include "fftplancache.hpp"
 #endif
-#include <map>
 
 using namespace std;
 
+namespace {
+  /// images with fewer pixels are filtered by one thread, for them
+  /// (e.g. the 32x32 thumbnails of the IDM) starting the threads takes
+  /// longer than the filtering
+  const int minParallelPixels=128*128;
+}
+
 void sobelv(ImageFeature &img) {
   ImageFeature filter(3,3,1);
   filter(0,0,0)=-1; filter(1,0,0)=0; filter(2,0,0)=1;
@@ -73,42 +77,42 @@ void laplace(ImageFeature &img) {
 void fftconvolve(ImageFeature &img, const ImageFeature &filter) {
 #ifdef HAVE_FFT_LIBRARY
 
-  // get size and smallest power of 2 that is larger
+  // get size, the image and the filter are real, thus only half of the
+  // spectrum needs to be computed. As for Gabor, the image is padded to
+  // the next power of two, such that the plans come from the cache
   uint width=img.xsize(); uint height=img.ysize();
-  uint dim=width; if(height>dim) dim=height;
-  uint maxnn=1; while(maxnn<dim) maxnn*=2;
-  uint padded=dim;
-  dim*=dim;
+  uint padded=1;
+  while(padded<width || padded<height) padded*=2;
+  uint dim=padded*padded;
+  uint halfdim=padded*(padded/2+1);
   
-  // variables for image and filter in transformed
-  fftw_complex *FIMG=NULL, *FFILTER=NULL;
-  FIMG=new fftw_complex[dim]; FFILTER=new fftw_complex[dim];
+  // variables for image and filter in spatial and in fourier domain
+  fftw_real *IMG=new fftw_real[dim], *FILTER=new fftw_real[dim];
+  fftw_complex *FIMG=new fftw_complex[halfdim], *FFILTER=new fftw_complex[halfdim];
+  for(uint i=0;i<dim;++i) { IMG[i]=0.0; FILTER[i]=0.0; }
   
   //copy image to temp variable
   uint xoffset=padded/2-width/2; uint yoffset=padded/2-height/2;
   for(uint y=0;y<height;++y) {
     for(uint x=0;x<width;++x) {
-      uint idx=((y+yoffset)*padded)+x+xoffset;
-      FIMG[idx].re=img(x,y,0);
+      IMG[((y+yoffset)*padded)+x+xoffset]=img(x,y,0);
     }
   }
   
   //copy filter to temp variable
-  xoffset=padded/2-filter.xsize()/2; yoffset=padded/2-filter.ysize()/2;
   for(uint y=0;y<filter.ysize();++y) {
     for(uint x=0;x<filter.xsize();++x) {
-      FFILTER[y*padded+x].re=filter(x,y,0);
+      FILTER[y*padded+x]=filter(x,y,0);
     }
   }
   
   //fourier transform
-  fftwnd_plan plan = fftw2d_create_plan(padded, padded, FFTW_FORWARD, FFTW_ESTIMATE  | FFTW_IN_PLACE); 
-  fftwnd_one(plan,FIMG,NULL);
-  fftwnd_one(plan,FFILTER,NULL);
-  fftwnd_destroy_plan(plan);
+  rfftwnd_plan plan=cachedRealFFTPlan(padded, padded, FFTW_REAL_TO_COMPLEX);
+  rfftwnd_one_real_to_complex(plan,IMG,FIMG);
+  rfftwnd_one_real_to_complex(plan,FILTER,FFILTER);
   
   //multiplication in fourier domain
-  for(uint x=0;x<dim;++x) {
+  for(uint x=0;x<halfdim;++x) {
     double re=FIMG[x].re*FFILTER[x].re-FIMG[x].im*FFILTER[x].im;
     double im=FIMG[x].re*FFILTER[x].im+FIMG[x].im*FFILTER[x].re;
     
@@ -117,22 +121,21 @@ void fftconvolve(ImageFeature &img, const ImageFeature &filter) {
   }
   
   //fourier transform backwards
-  fftwnd_plan planb = fftw2d_create_plan(padded, padded, FFTW_BACKWARD, FFTW_ESTIMATE | FFTW_IN_PLACE); 
-  fftwnd_one(planb,FIMG,NULL);
-  fftwnd_destroy_plan(planb);
+  rfftwnd_plan planb=cachedRealFFTPlan(padded, padded, FFTW_COMPLEX_TO_REAL);
+  rfftwnd_one_complex_to_real(planb,FIMG,IMG);
+  releaseRealFFTPlan(plan, padded, padded);
+  releaseRealFFTPlan(planb, padded, padded);
 
   //copy back
-  xoffset=padded/2-width/2;  yoffset=padded/2-height/2;
   for(uint y=0;y<height;++y) {
     for(uint x=0;x<width;++x) {
-      uint idx=((y+yoffset)*padded)+x+xoffset;
-      img(x,y,0)=FIMG[idx].re;
+      img(x,y,0)=IMG[((y+yoffset)*padded)+x+xoffset];
     }
   }
   delete[] FFILTER;
   delete[] FIMG;
-  
-
+  delete[] FILTER;
+  delete[] IMG;
 
 #else
   DBG(10) << "Compiled without fftw library. Thus using normal convolution." << endl;
@@ -142,28 +145,37 @@ void fftconvolve(ImageFeature &img, const ImageFeature &filter) {
 
 
 void convolve(ImageFeature &img, const ImageFeature &filter) {
-  ImageFeature copy=img;
+  ImageFeature source=img;
   
+  int width=img.xsize(); int height=img.ysize();
   int height2=filter.ysize()/2;
   int width2=filter.xsize()/2;
 
-  double tmp;
-  for(uint c=0;c<img.zsize();++c) {
-    for(uint x=0;x<img.xsize();++x) {
-      for(uint y=0;y<img.ysize();++y) {
-        tmp=0.0;
+  // each pixel sums the filter taps in the same order as the plain
+  // per pixel loop, but a whole output row is updated per tap, so that
+  // the inner loop runs over contiguous memory and is vectorized
+#pragma omp parallel if(width*height>minParallelPixels)
+  {
+    vector<double> tmp(width);
+    for(uint c=0;c<img.zsize();++c) {
+#pragma omp for
+      for(int y=0;y<height;++y) {
+        for(int x=0;x<width;++x) tmp[x]=0.0;
         for(int i=-width2;i<=width2;++i) {
-          int xx=x+i;
-          if(xx<int(img.xsize()) && int(xx) >= 0) {
-            for(int j=-height2;j<=height2;++j) {
-              int yy=y+j; 
-              if(int(yy)>=0 && yy < int(img.ysize())) {
-                tmp+=filter(i+width2,j+height2,0)*copy(xx,yy,c);
+          int xbegin=::std::max(0,-i); int xend=::std::min(width,width-i);
+          for(int j=-height2;j<=height2;++j) {
+            int yy=y+j;
+            if(yy>=0 && yy<height) {
+              const double f=filter(i+width2,j+height2,0);
+              const double *src=source.row(yy,c);
+              for(int x=xbegin;x<xend;++x) {
+                tmp[x]+=f*src[x+i];
               }
             }
           }
         }
-        img(x,y,c)=tmp;
+        double *dst=img.row(y,c);
+        for(int x=0;x<width;++x) dst[x]=tmp[x];
       }
     }
   }
@@ -175,19 +187,22 @@ void multiply(ImageFeature &img1, const ImageFeature& img2) {
       (img1.zsize() != img2.zsize())) {
     DBG(10) << "image features have different sizes, cannot be multiplied.";
   }
-  for (uint z = 0; z < img1.zsize(); z++)
-    for (uint x = 0; x < img1.xsize(); x++)
-      for (uint y = 0; y < img1.ysize(); y++) {
-	img1(x, y, z) = img1(x, y, z) * img2(x, y, z);
-      }
+  uint n=img1.xsize()*img1.ysize();
+  for (uint z = 0; z < img1.zsize(); z++) {
+    double *a=img1.plane(z);
+    const double *b=img2.plane(z);
+    for (uint i = 0; i < n; i++) {
+      a[i] = a[i] * b[i];
+    }
+  }
 }
 
 void multiply(ImageFeature &img, const double s) {
+  uint n=img.xsize()*img.ysize();
   for(uint z=0;z<img.zsize();++z) {
-    for(uint x=0;x<img.xsize();++x) {
-      for(uint y=0;y<img.ysize();++y)  {
-        img(x,y,z)*=s;
-      }
+    double *p=img.plane(z);
+    for(uint i=0;i<n;++i) {
+      p[i]*=s;
     }
   }
 }
@@ -198,86 +213,92 @@ void square(ImageFeature &img1) {
 }
 
 void power(ImageFeature &img1, int p) {
-  for (uint z = 0; z < img1.zsize(); z++)
-    for (uint x = 0; x < img1.xsize(); x++)
-      for (uint y = 0; y < img1.ysize(); y++) {
-	double tmp = 1.0;
-	double val = img1(x, y, z);
-	for (int t = 0; t < p; t++) {
-	  tmp *= val;
-	}
-	img1(x, y, z) = tmp;
+  uint n=img1.xsize()*img1.ysize();
+  for (uint z = 0; z < img1.zsize(); z++) {
+    double *a=img1.plane(z);
+    for (uint i = 0; i < n; i++) {
+      double tmp = 1.0;
+      double val = a[i];
+      for (int t = 0; t < p; t++) {
+        tmp *= val;
       }
+      a[i] = tmp;
+    }
+  }
 }
 
 void signedPower(ImageFeature &img1, int p) {
-  for (uint z = 0; z < img1.zsize(); z++)
-    for (uint x = 0; x < img1.xsize(); x++)
-      for (uint y = 0; y < img1.ysize(); y++) {
-	double tmp = 1.0;
-	for (int t = 0; t < p; t++) {
-	  tmp *= img1(x, y, z);
-	}
-	if ((img1(x, y, z) < 0.0) && ((p % 2) == 0)) {
-	  tmp *= -1.0;
-	}
-	img1(x, y, z) = tmp;
+  uint n=img1.xsize()*img1.ysize();
+  for (uint z = 0; z < img1.zsize(); z++) {
+    double *a=img1.plane(z);
+    for (uint i = 0; i < n; i++) {
+      double tmp = 1.0;
+      for (int t = 0; t < p; t++) {
+        tmp *= a[i];
       }
+      if ((a[i] < 0.0) && ((p % 2) == 0)) {
+        tmp *= -1.0;
+      }
+      a[i] = tmp;
+    }
+  }
 }
 
 void absolute(ImageFeature &img1) {
-  for (uint z = 0; z < img1.zsize(); z++)
-    for (uint x = 0; x < img1.xsize(); x++)
-      for (uint y = 0; y < img1.ysize(); y++) {
-	if (img1(x, y, z) < 0.0) {
-	  img1(x, y, z) = -img1(x, y, z);
-	} 
-      }
+  uint n=img1.xsize()*img1.ysize();
+  for (uint z = 0; z < img1.zsize(); z++) {
+    double *a=img1.plane(z);
+    for (uint i = 0; i < n; i++) {
+      if (a[i] < 0.0) {
+        a[i] = -a[i];
+      } 
+    }
+  }
 }
 
 void normalize(ImageFeature &img) {
   double min, max;
+  uint n=img.xsize()*img.ysize();
   
   for(uint c=0;c<img.zsize();++c) {
     min=minimum(img,c);
     max=maximum(img,c);
     if (max - min != 0.0) {
       double d=(1.0/(max-min));
-      for(uint x=0;x<img.xsize();++x) {
-        for(uint y=0;y<img.ysize();++y) {
-          img(x,y,c)=(img(x,y,c)-min)*d;
-        }
+      double *p=img.plane(c);
+      for(uint i=0;i<n;++i) {
+        p[i]=(p[i]-min)*d;
       }
     }
   }
 }
 
 void gammaCorrection(ImageFeature &img, double gamma) {
+  uint n=img.xsize()*img.ysize();
   for(uint c=0;c<img.zsize();++c) {
-    for(uint x=0;x<img.xsize();++x) {
-      for(uint y=0;y<img.ysize();++y) {
-        img(x,y,c)=exp(gamma*log(img(x,y,c)));
-      }
+    double *p=img.plane(c);
+    for(uint i=0;i<n;++i) {
+      p[i]=exp(gamma*log(p[i]));
     }
   }
 }
 
 double minimum(const ImageFeature &img, uint c) {
   double min=numeric_limits<double>::max();
-  for(uint x=0;x<img.xsize();++x) {
-    for(uint y=0;y<img.ysize();++y) {
-      min=::std::min(min,img(x,y,c));
-    }
+  uint n=img.xsize()*img.ysize();
+  const double *p=img.plane(c);
+  for(uint i=0;i<n;++i) {
+    min=::std::min(min,p[i]);
   }
   return min;
 }
 
 double maximum(const ImageFeature &img, uint c) {
   double max=-1.0;
-  for(uint x=0;x<img.xsize();++x) {
-    for(uint y=0;y<img.ysize();++y) {
-      max=::std::max(max,img(x,y,c));
-    }
+  uint n=img.xsize()*img.ysize();
+  const double *p=img.plane(c);
+  for(uint i=0;i<n;++i) {
+    max=::std::max(max,p[i]);
   }
   return max;
 }
@@ -312,20 +333,21 @@ double maximum(const ImageFeature &img, uint c) {
 
 
 void add(ImageFeature &a, const ImageFeature &b, const uint z) {
-  for(uint x=0;x<a.xsize();++x) {
-    for(uint y=0;y<a.ysize();++y) {
-      a(x,y,z)+=b(x,y,0);
-    }
+  uint n=a.xsize()*a.ysize();
+  double *pa=a.plane(z);
+  const double *pb=b.plane(0);
+  for(uint i=0;i<n;++i) {
+    pa[i]+=pb[i];
   }
 }
 
 
 void divide(ImageFeature &a, const double &d) {
-  for(uint x=0;x<a.xsize();++x) {
-    for(uint y=0;y<a.ysize();++y) {
-      for(uint z=0;z<a.zsize();++z) {
-        a(x,y,z)/=d;
-      }
+  uint n=a.xsize()*a.ysize();
+  for(uint z=0;z<a.zsize();++z) {
+    double *p=a.plane(z);
+    for(uint i=0;i<n;++i) {
+      p[i]/=d;
     }
   }
 }
@@ -344,27 +366,30 @@ ImageFeature makeGray(const ImageFeature &img, const uint type) {
     return result;
   }
   
-  for(uint x=0;x<img.xsize();++x) {
-    for(uint y=0;y<img.ysize();++y) {
-      value=0.0;
-      switch(type){
-      case 0: //max
-	for(uint c=0;c<img.zsize();++c) {
-	  value=::std::max(value,img(x,y,c));
-	}
-	break;
-      case 1: //mean
-        for(uint c=0;c<img.zsize();++c) {
-          value+=img(x,y,c);
-        }
-        value/=img.zsize();
-        break;
-      case 2: // luminance
-        value = 0.3 * img(x,y,0) + 0.59 * img(x,y,1) + 0.11 * img(x,y,2);
-        break;
+  uint n=img.xsize()*img.ysize();
+  vector<const double*> planes(img.zsize());
+  for(uint c=0;c<img.zsize();++c) planes[c]=img.plane(c);
+  double *dst=result.plane(0);
+  
+  for(uint i=0;i<n;++i) {
+    value=0.0;
+    switch(type){
+    case 0: //max
+      for(uint c=0;c<img.zsize();++c) {
+        value=::std::max(value,planes[c][i]);
+      }
+      break;
+    case 1: //mean
+      for(uint c=0;c<img.zsize();++c) {
+        value+=planes[c][i];
       }
-      result(x,y,0)=value;
+      value/=img.zsize();
+      break;
+    case 2: // luminance
+      value = 0.3 * planes[0][i] + 0.59 * planes[1][i] + 0.11 * planes[2][i];
+      break;
     }
+    dst[i]=value;
   }
   return result;
 }
@@ -397,11 +422,11 @@ ImageFeature flip(const ImageFeature &img) {
 
 void contrast(ImageFeature &img,const double min, const double max) {
   double m=max-min;
-  for(uint x=0;x<img.xsize();++x) {
-    for(uint y=0;y<img.ysize();++y) {
-      for(uint z=0;z<img.zsize();++z) {
-        img(x,y,z)=img(x,y,z)*m+min;
-      }
+  uint n=img.xsize()*img.ysize();
+  for(uint z=0;z<img.zsize();++z) {
+    double *p=img.plane(z);
+    for(uint i=0;i<n;++i) {
+      p[i]=p[i]*m+min;
     }
   }
 }
@@ -536,8 +561,9 @@ ImageFeature affineTransformation(const ImageFeature &image, const AffineTransfo
 ImageFeature localvariance(const ImageFeature &image, const uint winsize) {
   ImageFeature result(image.xsize(),image.ysize(),1);
 
-  for(uint x=winsize;x<image.xsize()-winsize;++x) {
-    for(uint y=winsize;y<image.ysize()-winsize;++y) {
+#pragma omp parallel for if(int(image.xsize()*image.ysize())>minParallelPixels)
+  for(int y=winsize;y<int(image.ysize()-winsize);++y) {
+    for(uint x=winsize;x<image.xsize()-winsize;++x) {
       result(x,y,0)=localvariance(image, winsize, x,y);
     }
   }
@@ -743,9 +769,9 @@ ImageFeature fft(const ImageFeature &img) {
     }
   }
   
-  fftwnd_plan plan = fftw2d_create_plan(img.xsize(),img.ysize(), FFTW_FORWARD, FFTW_ESTIMATE  | FFTW_IN_PLACE); 
+  fftwnd_plan plan = cachedFFTPlan(img.xsize(),img.ysize(), FFTW_FORWARD, true);
   fftwnd_one(plan,&FIMG[0][0],NULL);
-  fftwnd_destroy_plan(plan);
+  releaseFFTPlan(plan, img.xsize(), img.ysize());
   
   for(uint x=0;x<img.xsize();++x) {
     for(uint y=0;y<img.ysize();++y) {
@@ -767,22 +793,27 @@ ImageFeature fftscale(const ImageFeature& image, const uint newWidth, const uint
   uint imgwidth=image.xsize();
 
   // variables for image and filter in transformed
-  fftw_complex *FIMG=new fftw_complex[image.xsize()*image.ysize()];
+  fftw_real *IMG=new fftw_real[imgwidth*imgheight];
+  fftw_complex *FHALF=new fftw_complex[imgheight*(imgwidth/2+1)];
+  fftw_complex *FIMG=new fftw_complex[imgwidth*imgheight];
   fftw_complex *FRESULT=new fftw_complex[newWidth*newHeight];
   for(uint i=0;i<newWidth*newHeight;++i) { FRESULT[i].re=0.0; FRESULT[i].im=0.0;}
   
   //copy image to temp variable
-  for(uint x=0;x<image.xsize();++x) {
-    for(uint y=0;y<image.ysize();++y) {
-      FIMG[y*imgwidth+x].re=image(x,y,0);
-      FIMG[y*imgwidth+x].im=0.0;
+  for(uint y=0;y<imgheight;++y) {
+    for(uint x=0;x<imgwidth;++x) {
+      IMG[y*imgwidth+x]=image(x,y,0);
     }
   }
   
-  //fourier transform
-  fftwnd_plan plan = fftw2d_create_plan(imgheight,imgwidth, FFTW_FORWARD, FFTW_ESTIMATE  | FFTW_IN_PLACE); 
-  fftwnd_one(plan,FIMG,NULL);
-  fftwnd_destroy_plan(plan);
+  //fourier transform, the image is real thus the other half of the
+  //spectrum is obtained by symmetry
+  rfftwnd_plan plan = cachedRealFFTPlan(imgheight,imgwidth, FFTW_REAL_TO_COMPLEX);
+  rfftwnd_one_real_to_complex(plan,IMG,FHALF);
+  releaseRealFFTPlan(plan, imgheight, imgwidth);
+  expandHalfSpectrum(FHALF,FIMG,imgheight,imgwidth);
+  delete[] FHALF;
+  delete[] IMG;
 
   // copy into destination with zeropadding
   
@@ -838,9 +869,9 @@ ImageFeature fftscale(const ImageFeature& image, const uint newWidth, const uint
 
   
   //fourier transform backwards
-  fftwnd_plan planb = fftw2d_create_plan(newHeight,newWidth, FFTW_BACKWARD, FFTW_ESTIMATE | FFTW_IN_PLACE); 
+  fftwnd_plan planb = cachedFFTPlan(newHeight,newWidth, FFTW_BACKWARD, true);
   fftwnd_one(planb,FRESULT,NULL);
-  fftwnd_destroy_plan(planb);
+  releaseFFTPlan(planb, newHeight, newWidth);
   
 
   int divider=(imgwidth*imgheight);
@@ -851,7 +882,9 @@ ImageFeature fftscale(const ImageFeature& image, const uint newWidth, const uint
       res(x,y,0)=sqrt((FRESULT[y*newWidth+x].re*FRESULT[y*newWidth+x].re)+(FRESULT[y*newWidth+x].im*FRESULT[y*newWidth+x].im))/divider;
     }
   }
-  
+  delete[] FRESULT;
+  delete[] FIMG;
+
   cutoff(res);
   return res;
 
@@ -881,6 +914,8 @@ ImageFeature scale(const ImageFeature& image, const uint newWidth, const uint ne
   
     for(uint y=0; y< oldHeight ; y++) {
       // scale line y from oldWidth to newWidth
+      const double *src=image.row(y,z);
+      double *dst=work.row(y,0);
       index_orig=0;
       index_scaled=0;
       akku = 0.0;
@@ -890,23 +925,23 @@ ImageFeature scale(const ImageFeature& image, const uint newWidth, const uint ne
         if( (akku+x_weight) >= 1.0) { 
           // target pixel left
         
-          work(index_scaled,y,0) += image(index_orig,y,z) * (1.0 - akku) ;
+          dst[index_scaled] += src[index_orig] * (1.0 - akku) ;
           akku += x_weight - 1.0;
           index_scaled++;
           
           //target pixel centered (if enlarging)
           while( akku >= 1.0 ) {
-            work(index_scaled,y,0) = image(index_orig,y,z);
+            dst[index_scaled] = src[index_orig];
             index_scaled++;
             akku -= 1.0;
           }
 
           if( index_scaled < newWidth ) {
-            work(index_scaled,y,0)=image(index_orig,y,z) * (akku);
+            dst[index_scaled]=src[index_orig] * (akku);
           }
         } else {
           // border to new target pixel not crossed
-          work(index_scaled,y,0) += image(index_orig,y,z) * x_weight;
+          dst[index_scaled] += src[index_orig] * x_weight;
           akku += x_weight;
         }
         index_orig++;
@@ -1001,14 +1036,12 @@ void box(ImageFeature &img, const uint centerx, const uint centery, const vector
 
 void meanandvariance(const ImageFeature &img, double &mean, double &variance, const uint layer) {
   mean=0.0; variance=0.0;
-  for(uint y=0;y<img.ysize();++y) {
-    for(uint x=0;x<img.xsize();++x) {
-      mean+=img(x,y,layer);
-      variance+=img(x,y,layer)*img(x,y,layer);
-    }
-  }
-
   uint size=img.xsize()*img.ysize();
+  const double *p=img.plane(layer);
+  for(uint i=0;i<size;++i) {
+    mean+=p[i];
+    variance+=p[i]*p[i];
+  }
 
   mean/=double(size);
   variance/=double(size);
@@ -1018,38 +1051,39 @@ void meanandvariance(const ImageFeature &img, double &mean, double &variance, co
 
 void meanAndVarianceNormalization(ImageFeature &img, const double mu, const double sigma) {
   double mean, variance,stddev;
+  uint n=img.xsize()*img.ysize();
   for(uint c=0;c<img.zsize();++c) {
     meanandvariance(img,mean,variance,c);
     mean+=mu;
     stddev=sqrt(variance);
     stddev/=sqrt(sigma);
-    for(uint x=0;x<img.xsize();++x) {
-      for(uint y=0;y<img.ysize();++y) {
-        img(x,y,c)=(img(x,y,c)-mean)/stddev;
-      }
+    double *p=img.plane(c);
+    for(uint i=0;i<n;++i) {
+      p[i]=(p[i]-mean)/stddev;
     }
   }
 }
 
 
 void cutoff(ImageFeature &img, const double minimum, const double maximum) {
+  uint n=img.xsize()*img.ysize();
   for(uint c=0;c<img.zsize();++c) {
-    for(uint x=0;x<img.xsize();++x) {
-      for(uint y=0;y<img.ysize();++y) {
-        img(x,y,c)=max(minimum,img(x,y,c));
-        img(x,y,c)=min(maximum,img(x,y,c));
-      }
+    double *p=img.plane(c);
+    for(uint i=0;i<n;++i) {
+      p[i]=min(maximum,max(minimum,p[i]));
     }
   }
 }
 
 
 void shift(ImageFeature &img, const double offset) {
+  uint n=img.xsize()*img.ysize();
   for(uint c=0;c<img.zsize();++c) {
-    for(uint x=0;x<img.xsize();++x) {
-      for(uint y=0;y<img.ysize();++y) {
-        img(x,y,c)+=offset;
-      }}}
+    double *p=img.plane(c);
+    for(uint i=0;i<n;++i) {
+      p[i]+=offset;
+    }
+  }
 }
 
 
@@ -1200,12 +1234,13 @@ void rect(ImageFeature &img, const uint x, const uint y, const uint w, const uin
 
 void RGBtoHSV(ImageFeature &img) {
   HSVPixel hsv;
-  for(uint x=0;x<img.xsize();++x) {
-    for(uint y=0;y<img.ysize();++y) {
+  for(uint y=0;y<img.ysize();++y) {
+    double *h=img.row(y,0), *s=img.row(y,1), *v=img.row(y,2);
+    for(uint x=0;x<img.xsize();++x) {
       hsv=img.hsvPixel(x,y);
-      img(x,y,0)=hsv.h;
-      img(x,y,1)=hsv.s;
-      img(x,y,2)=hsv.v;
+      h[x]=hsv.h;
+      s[x]=hsv.s;
+      v[x]=hsv.v;
     }
   }
 }
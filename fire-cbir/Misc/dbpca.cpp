@@ -112,7 +112,7 @@ int main(int argc, char **argv) {
         
         // Calc PCA
         DBG(10) << "Accumulating for suffix " << j+1 <<"/" << db.numberOfSuffices()  << " image " <<i+1 <<"/" << db.size() << endl;
-        const VectorFeature* dbfeat=dynamic_cast<const VectorFeature *>(img[j]->operator[](0));
+        VectorFeature* dbfeat=dynamic_cast<VectorFeature *>(img[j]->operator[](0));
         if(dbfeat) {
           pca.putData(dbfeat->data());
         } else {
@@ -151,7 +151,7 @@ int main(int argc, char **argv) {
       
       // PCA Transform
       DBG(10) << "Transforming for suffix " << j+1 <<"/" << db.numberOfSuffices()  << " image " <<i+1 <<"/" << db.size() << endl;
-      const VectorFeature* dbfeat=dynamic_cast<const VectorFeature *>(img[j]->operator[](0));
+      VectorFeature* dbfeat=dynamic_cast<VectorFeature *>(img[j]->operator[](0));
       if(dbfeat) {
         DoubleVector tr=pca.transform(dbfeat->data(),PCAdim);
         VectorFeature toSave(tr);
@@ -0,0 +1,139 @@
+#include "dist_lfsigemd.hpp"
+#include "lfsignaturefeature.hpp"
+#include "diag.hpp"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+// compares the ranking of random signatures by the EMD with and without
+// the lower bound (lfsigemd:MAX=<d>): the images whose EMD is at most d
+// have to come first, in the same order, and the top k of both rankings
+// have to be the same as long as the k-th distance is at most d. The
+// clone of a distance has to give the same distances as the distance.
+
+LFSignatureFeature* randomSignature(uint dim) {
+  LFSignatureFeature* result=new LFSignatureFeature();
+  uint size=2+rand()%7;
+  // the signatures are spread over a few places, such that some of
+  // them are far from the query
+  double offset=2.0*(rand()%4);
+  for(uint i=0;i<size;++i) {
+    GaussianDensity g(dim);
+    for(uint d=0;d<dim;++d) {
+      g.mean[d]=offset+double(rand())/RAND_MAX;
+    }
+    result->model().push_back(g);
+    result->signature().push_back(1+rand()%50);
+  }
+  return result;
+}
+
+// the positions of the images ordered by distance, ties by position
+vector<uint> ranking(const vector<double>& distances) {
+  vector< pair<double,uint> > order(distances.size());
+  for(uint n=0;n<distances.size();++n) {
+    order[n]=make_pair(distances[n],n);
+  }
+  sort(order.begin(), order.end());
+  vector<uint> result(order.size());
+  for(uint n=0;n<order.size();++n) {
+    result[n]=order[n].second;
+  }
+  return result;
+}
+
+int main(int argc, char** argv) {
+  uint count=(argc>1) ? atoi(argv[1]) : 500;
+  uint k=(argc>2) ? atoi(argv[2]) : 20;
+  const uint dim=4;
+
+  if(argc>3 || k==0 || k>=count) {
+    ERR << "Usage: testemdbound [# images] [k < # images]" << endl;
+    exit(1);
+  }
+
+  srand(42);
+  LFSignatureFeature* query=randomSignature(dim);
+  vector<BaseFeature*> db(count);
+  for(uint n=0;n<count;++n) {
+    db[n]=randomSignature(dim);
+  }
+
+  LFSignatureEMDistance exact;
+  vector<double> exactDistances(count);
+  exact.start(query);
+  exact.distances(query, &db[0], count, &exactDistances[0]);
+  exact.stop();
+  vector<uint> exactRanking=ranking(exactDistances);
+
+  // the cut-off is the distance of the 2k-th image, thus the k best are
+  // below it and many others are pruned
+  double maxDistance=exactDistances[exactRanking[2*k<count ? 2*k : count-1]];
+  LFSignatureEMDistance bounded(maxDistance);
+  vector<double> boundedDistances(count);
+  bounded.start(query);
+  bounded.distances(query, &db[0], count, &boundedDistances[0]);
+  bounded.stop();
+  vector<uint> boundedRanking=ranking(boundedDistances);
+
+  bool failed=false;
+  uint computed=0, pruned=0;
+  for(uint n=0;n<count;++n) {
+    if(boundedDistances[n]>maxDistance) {
+      ++pruned;
+    } else {
+      ++computed;
+      if(exactDistances[n]<maxDistance && boundedDistances[n]!=exactDistances[n]) {
+        ERR << "image " << n << ": EMD " << exactDistances[n] << " became " << boundedDistances[n] << endl;
+        failed=true;
+      }
+    }
+    if(exactDistances[n]<maxDistance && boundedDistances[n]>maxDistance) {
+      ERR << "image " << n << " with EMD " << exactDistances[n] << " was pruned" << endl;
+      failed=true;
+    }
+  }
+  cout << count << " images, cut-off " << maxDistance << ": " << computed << " computed, " << pruned << " pruned" << endl;
+
+  for(uint n=0;n<k;++n) {
+    if(exactRanking[n]!=boundedRanking[n]) {
+      ERR << "rank " << n << ": image " << exactRanking[n] << " without and " << boundedRanking[n] << " with the bound" << endl;
+      failed=true;
+    }
+  }
+  // no pruned image may rank before a computed one
+  for(uint n=1;n<count;++n) {
+    if(boundedDistances[boundedRanking[n-1]]>maxDistance && boundedDistances[boundedRanking[n]]<=maxDistance) {
+      ERR << "pruned image " << boundedRanking[n-1] << " ranks before image " << boundedRanking[n] << endl;
+      failed=true;
+    }
+  }
+
+  // a clone shares the prepared signatures and prepares its own query
+  BaseDistance* clone=bounded.clone();
+  vector<double> cloneDistances(count);
+  clone->start(query);
+  for(uint n=0;n<count;++n) {
+    cloneDistances[n]=clone->distance(query, db[n]);
+  }
+  clone->stop();
+  delete clone;
+  if(cloneDistances!=boundedDistances) {
+    ERR << "the clone gives other distances" << endl;
+    failed=true;
+  }
+
+  for(uint n=0;n<count;++n) delete db[n];
+  delete query;
+
+  if(failed) {
+    ERR << "the lower bound changes the ranking" << endl;
+    return 1;
+  }
+  cout << "top " << k << " are the same with and without the bound" << endl;
+  return 0;
+}
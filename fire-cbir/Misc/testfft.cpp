@@ -0,0 +1,154 @@
+#include "imagefeature.hpp"
+#include "imagelib.hpp"
+#include "gabor.hpp"
+#include "diag.hpp"
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <omp.h>
+
+#ifdef HAVE_FFT_LIBRARY
+#include "fftplancache.hpp"
+#endif
+
+using namespace std;
+
+// checks the fourier transforms on top of the fftw plan cache: the
+// full spectrum completed by expandHalfSpectrum from a real to
+// complex transform against the complex transform and back to the
+// input, fftscale to the size of the image against the image, and the
+// parallel Gabor filter bank against the same bank run by one thread.
+
+#ifdef HAVE_FFT_LIBRARY
+
+// the largest difference of the spectrum of rows x cols random values
+// computed via expandHalfSpectrum to the complex transform, and of its
+// inverse to the input
+bool checkHalfSpectrum(uint rows, uint cols) {
+  const uint n=rows*cols;
+  vector<fftw_real> in(n);
+  vector<fftw_complex> complexIn(n), full(n), expanded(n), back(n);
+  vector<fftw_complex> half(rows*(cols/2+1));
+  for(uint i=0;i<n;++i) {
+    in[i]=double(rand())/RAND_MAX-0.5;
+    complexIn[i].re=in[i];
+    complexIn[i].im=0.0;
+  }
+
+  fftwnd_plan forward=cachedFFTPlan(rows, cols, FFTW_FORWARD);
+  fftwnd_one(forward, &complexIn[0], &full[0]);
+  releaseFFTPlan(forward, rows, cols);
+
+  rfftwnd_plan realForward=cachedRealFFTPlan(rows, cols, FFTW_REAL_TO_COMPLEX);
+  rfftwnd_one_real_to_complex(realForward, &in[0], &half[0]);
+  releaseRealFFTPlan(realForward, rows, cols);
+  expandHalfSpectrum(&half[0], &expanded[0], rows, cols);
+
+  fftwnd_plan backward=cachedFFTPlan(rows, cols, FFTW_BACKWARD);
+  fftwnd_one(backward, &expanded[0], &back[0]);
+  releaseFFTPlan(backward, rows, cols);
+
+  double spectrumError=0.0, inverseError=0.0;
+  for(uint i=0;i<n;++i) {
+    spectrumError=max(spectrumError, fabs(expanded[i].re-full[i].re)+fabs(expanded[i].im-full[i].im));
+    inverseError=max(inverseError, fabs(back[i].re/n-in[i])+fabs(back[i].im/n));
+  }
+  bool ok=spectrumError<=1e-9*n && inverseError<=1e-12*n;
+  cout << "expandHalfSpectrum " << rows << "x" << cols << ": spectrum error " << spectrumError
+       << ", inverse error " << inverseError << (ok ? "" : " FAILED") << endl;
+  return ok;
+}
+
+ImageFeature randomImage(uint width, uint height, uint depth) {
+  ImageFeature img(width, height, depth);
+  for(uint c=0;c<depth;++c) {
+    for(uint y=0;y<height;++y) {
+      for(uint x=0;x<width;++x) {
+        img(x,y,c)=0.1+0.8*double(rand())/RAND_MAX;
+      }
+    }
+  }
+  return img;
+}
+
+double maxDifference(const ImageFeature& a, const ImageFeature& b) {
+  if(a.xsize()!=b.xsize() || a.ysize()!=b.ysize() || a.zsize()!=b.zsize()) {
+    return HUGE_VAL;
+  }
+  double result=0.0;
+  for(uint c=0;c<a.zsize();++c) {
+    for(uint y=0;y<a.ysize();++y) {
+      for(uint x=0;x<a.xsize();++x) {
+        result=max(result, fabs(a(x,y,c)-b(x,y,c)));
+      }
+    }
+  }
+  return result;
+}
+
+// fftscale to the same size only takes the image to the fourier
+// domain and back
+bool checkFFTScale(uint width, uint height) {
+  ImageFeature img=randomImage(width, height, 1);
+  double error=maxDifference(fftscale(img, width, height), img);
+  bool ok=error<=1e-9;
+  cout << "fftscale " << width << "x" << height << ": error " << error << (ok ? "" : " FAILED") << endl;
+  return ok;
+}
+
+// the filters of the bank are independent, thus the result must not
+// depend on the number of threads
+bool checkGabor(uint width, uint height) {
+  ImageFeature img=randomImage(width, height, 3);
+  int threads=omp_get_max_threads();
+
+  omp_set_num_threads(1);
+  Gabor serial(img);
+  serial.calculate(3, 2, 4, 3);
+
+  omp_set_num_threads(max(threads,4));
+  Gabor parallel(img);
+  parallel.calculate(3, 2, 4, 3);
+  omp_set_num_threads(threads);
+
+  double error=maxDifference(serial, parallel);
+  bool ok=error==0.0;
+  cout << "gabor " << width << "x" << height << ": difference of 1 and " << max(threads,4) << " threads "
+       << error << (ok ? "" : " FAILED") << endl;
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  if(argc>1) {
+    ERR << "Usage: testfft" << endl;
+    exit(1);
+  }
+
+  srand(42);
+  bool ok=true;
+  // power of two sizes come from the cache, the others are planned per call
+  ok=checkHalfSpectrum(8, 8) && ok;
+  ok=checkHalfSpectrum(16, 4) && ok;
+  ok=checkHalfSpectrum(5, 7) && ok;
+  ok=checkHalfSpectrum(6, 9) && ok;
+  ok=checkHalfSpectrum(1, 12) && ok;
+  ok=checkFFTScale(16, 16) && ok;
+  ok=checkFFTScale(21, 13) && ok;
+  ok=checkGabor(37, 29) && ok;
+
+  if(!ok) {
+    ERR << "fourier transforms differ" << endl;
+    return 1;
+  }
+  return 0;
+}
+
+#else
+
+int main() {
+  cout << "compiled without fftw, nothing to test" << endl;
+  return 0;
+}
+
+#endif
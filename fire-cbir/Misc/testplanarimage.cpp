@@ -0,0 +1,280 @@
+#include "planarimage.hpp"
+#include "imagefeature.hpp"
+#include "imagelib.hpp"
+#include "diag.hpp"
+#include <iostream>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <omp.h>
+
+using namespace std;
+
+// checks the planar storage of images: the layout of PlanarImage and
+// ImageFeature, and the imagelib kernels working on rows and planes
+// against the plain per pixel loops they replaced. The kernels sum
+// each pixel in the same order as those loops, thus the results have
+// to be identical, for images filtered by one thread and by several.
+
+bool report(const string& name, bool ok) {
+  cout << name << (ok ? ": ok" : ": FAILED") << endl;
+  return ok;
+}
+
+ImageFeature randomImage(uint width, uint height, uint depth) {
+  ImageFeature img(width, height, depth);
+  for(uint c=0;c<depth;++c) {
+    for(uint y=0;y<height;++y) {
+      for(uint x=0;x<width;++x) {
+        img(x,y,c)=double(rand())/RAND_MAX;
+      }
+    }
+  }
+  return img;
+}
+
+bool same(const ImageFeature& a, const ImageFeature& b) {
+  if(a.xsize()!=b.xsize() || a.ysize()!=b.ysize() || a.zsize()!=b.zsize()) {
+    return false;
+  }
+  for(uint c=0;c<a.zsize();++c) {
+    for(uint y=0;y<a.ysize();++y) {
+      for(uint x=0;x<a.xsize();++x) {
+        if(a(x,y,c)!=b(x,y,c)) return false;
+      }
+    }
+  }
+  return true;
+}
+
+template<class T>
+bool checkLayout(uint xsize, uint ysize, uint zsize) {
+  PlanarImage<T> img(xsize, ysize, zsize);
+  bool ok=true;
+  for(uint c=0;c<zsize;++c) {
+    ok=ok && size_t(img.plane(c))%PlanarImage<T>::Alignment==0;
+    for(uint y=0;y<ysize;++y) {
+      ok=ok && img.row(y,c)==img.plane(c)+y*xsize;
+      for(uint x=0;x<xsize;++x) {
+        ok=ok && img(x,y,c)==T(0) && &img(x,y,c)==img.row(y,c)+x;
+        img(x,y,c)=T(c*1000+y*10+x);
+      }
+    }
+  }
+
+  // copies and added layers keep the pixels, resize zeroes them
+  PlanarImage<T> copy(img);
+  copy.addLayers(2);
+  ok=ok && copy.zsize()==zsize+2;
+  for(uint c=0;c<copy.zsize();++c) {
+    ok=ok && size_t(copy.plane(c))%PlanarImage<T>::Alignment==0;
+    for(uint y=0;y<ysize;++y) {
+      for(uint x=0;x<xsize;++x) {
+        ok=ok && copy(x,y,c)==(c<zsize ? img(x,y,c) : T(0));
+      }
+    }
+  }
+  img.resize(xsize, ysize, zsize);
+  for(uint c=0;c<zsize;++c) {
+    for(uint i=0;i<xsize*ysize;++i) {
+      ok=ok && img.plane(c)[i]==T(0);
+    }
+  }
+  return ok;
+}
+
+bool checkImageFeature() {
+  ImageFeature a=randomImage(13, 7, 2), b=randomImage(13, 7, 1);
+  ImageFeature appended=a;
+  appended.append(b);
+  bool ok=appended.zsize()==3;
+  for(uint y=0;y<7;++y) {
+    for(uint x=0;x<13;++x) {
+      ok=ok && appended(x,y,0)==a(x,y,0) && appended(x,y,1)==a(x,y,1) && appended(x,y,2)==b(x,y,0);
+      ok=ok && appended.row(y,2)[x]==b(x,y,0) && appended.plane(1)[y*13+x]==a(x,y,1);
+    }
+  }
+  ok=ok && same(appended.layer(2), b) && same(appended.layer(0), a.layer(0));
+  appended.resize(5, 4, 2);
+  for(uint c=0;c<2;++c) {
+    for(uint i=0;i<20;++i) {
+      ok=ok && appended.plane(c)[i]==0.0;
+    }
+  }
+  return ok;
+}
+
+// the loops of the kernels before they were moved to rows and planes
+
+void referenceConvolve(ImageFeature &img, const ImageFeature &filter) {
+  ImageFeature copy=img;
+  int height2=filter.ysize()/2;
+  int width2=filter.xsize()/2;
+  double tmp;
+  for(uint c=0;c<img.zsize();++c) {
+    for(uint x=0;x<img.xsize();++x) {
+      for(uint y=0;y<img.ysize();++y) {
+        tmp=0.0;
+        for(int i=-width2;i<=width2;++i) {
+          int xx=x+i;
+          if(xx<int(img.xsize()) && int(xx) >= 0) {
+            for(int j=-height2;j<=height2;++j) {
+              int yy=y+j;
+              if(int(yy)>=0 && yy < int(img.ysize())) {
+                tmp+=filter(i+width2,j+height2,0)*copy(xx,yy,c);
+              }
+            }
+          }
+        }
+        img(x,y,c)=tmp;
+      }
+    }
+  }
+}
+
+ImageFeature referenceMakeGray(const ImageFeature &img, const uint type) {
+  ImageFeature result(img.xsize(),img.ysize(),1);
+  double value;
+  for(uint x=0;x<img.xsize();++x) {
+    for(uint y=0;y<img.ysize();++y) {
+      value=0.0;
+      switch(type){
+      case 0: //max
+        for(uint c=0;c<img.zsize();++c) {
+          value=::std::max(value,img(x,y,c));
+        }
+        break;
+      case 1: //mean
+        for(uint c=0;c<img.zsize();++c) {
+          value+=img(x,y,c);
+        }
+        value/=img.zsize();
+        break;
+      case 2: // luminance
+        value = 0.3 * img(x,y,0) + 0.59 * img(x,y,1) + 0.11 * img(x,y,2);
+        break;
+      }
+      result(x,y,0)=value;
+    }
+  }
+  return result;
+}
+
+void referenceMeanAndVariance(const ImageFeature &img, double &mean, double &variance, const uint layer) {
+  mean=0.0; variance=0.0;
+  for(uint y=0;y<img.ysize();++y) {
+    for(uint x=0;x<img.xsize();++x) {
+      mean+=img(x,y,layer);
+      variance+=img(x,y,layer)*img(x,y,layer);
+    }
+  }
+  uint size=img.xsize()*img.ysize();
+  mean/=double(size);
+  variance/=double(size);
+  variance-=mean*mean;
+}
+
+ImageFeature referenceLocalVariance(const ImageFeature &image, const uint winsize) {
+  ImageFeature result(image.xsize(),image.ysize(),1);
+  for(uint x=winsize;x<image.xsize()-winsize;++x) {
+    for(uint y=winsize;y<image.ysize()-winsize;++y) {
+      result(x,y,0)=localvariance(image, winsize, x,y);
+    }
+  }
+  return result;
+}
+
+// runs the kernels on a width x height RGB image
+bool checkKernels(uint width, uint height, uint threads) {
+  omp_set_num_threads(threads);
+  ImageFeature img=randomImage(width, height, 3);
+  bool ok=true;
+
+  ImageFeature filter=randomImage(5, 3, 1);
+  ImageFeature result=img, reference=img;
+  convolve(result, filter);
+  referenceConvolve(reference, filter);
+  ok=report("  convolve", same(result, reference)) && ok;
+
+  result=img; reference=img;
+  sobelv(result);
+  ImageFeature sobel(3,3,1);
+  sobel(0,0,0)=-1; sobel(2,0,0)=1; sobel(0,1,0)=-2; sobel(2,1,0)=2; sobel(0,2,0)=-1; sobel(2,2,0)=1;
+  referenceConvolve(reference, sobel);
+  ok=report("  sobelv", same(result, reference)) && ok;
+
+  bool gray=true;
+  for(uint type=0;type<3;++type) {
+    gray=gray && same(makeGray(img, type), referenceMakeGray(img, type));
+  }
+  ok=report("  makeGray", gray) && ok;
+
+  bool moments=true;
+  for(uint c=0;c<3;++c) {
+    double mean, variance, refMean, refVariance;
+    meanandvariance(img, mean, variance, c);
+    referenceMeanAndVariance(img, refMean, refVariance, c);
+    moments=moments && mean==refMean && variance==refVariance;
+  }
+  ok=report("  meanandvariance", moments) && ok;
+
+  ok=report("  localvariance", same(localvariance(img, 2), referenceLocalVariance(img, 2))) && ok;
+
+  // the pointwise functions
+  result=img; reference=img;
+  shift(result, -0.5); signedPower(result, 2); absolute(result); power(result, 3); multiply(result, 1.5);
+  for(uint c=0;c<3;++c) {
+    for(uint y=0;y<height;++y) {
+      for(uint x=0;x<width;++x) {
+        double v=reference(x,y,c)-0.5;
+        double t=v*v;
+        if(v<0.0) t*=-1.0;
+        if(t<0.0) t=-t;
+        reference(x,y,c)=t*t*t*1.5;
+      }
+    }
+  }
+  ok=report("  pointwise", same(result, reference)) && ok;
+
+  result=img; reference=img;
+  RGBtoHSV(result);
+  for(uint y=0;y<height;++y) {
+    for(uint x=0;x<width;++x) {
+      HSVPixel hsv=img.hsvPixel(x,y);
+      reference(x,y,0)=hsv.h; reference(x,y,1)=hsv.s; reference(x,y,2)=hsv.v;
+    }
+  }
+  ok=report("  RGBtoHSV", same(result, reference)) && ok;
+
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  if(argc>1) {
+    ERR << "Usage: testplanarimage" << endl;
+    exit(1);
+  }
+
+  srand(42);
+  bool ok=true;
+  ok=report("PlanarImage<double>", checkLayout<double>(7, 5, 3) && checkLayout<double>(32, 32, 1)) && ok;
+  ok=report("PlanarImage<float>", checkLayout<float>(7, 5, 3) && checkLayout<float>(3, 1, 4)) && ok;
+  ok=report("ImageFeature", checkImageFeature()) && ok;
+
+  // small images are filtered by one thread, large ones in parallel
+  int threads=omp_get_max_threads();
+  uint sizes[][2]={{32, 32}, {23, 17}, {151, 133}};
+  for(uint s=0;s<3;++s) {
+    for(uint t=1;t<=4;t+=3) {
+      cout << "kernels on " << sizes[s][0] << "x" << sizes[s][1] << " with " << t << " threads" << endl;
+      ok=checkKernels(sizes[s][0], sizes[s][1], t) && ok;
+    }
+  }
+  omp_set_num_threads(threads);
+
+  if(!ok) {
+    ERR << "planar image kernels differ from the per pixel loops" << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,273 @@
+#include "tamurafeature.hpp"
+#include "imagefeature.hpp"
+#include "histogramfeature.hpp"
+#include "imagelib.hpp"
+#include "diag.hpp"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+// checks the Tamura texture feature computed with running sums against
+// the per pixel implementation it replaced: contrast, coarseness and
+// directionality of each layer have to agree up to rounding and the
+// histograms of calculate have to be identical. Synthetic images are
+// always checked, the image files given on the command line in
+// addition.
+
+// the per pixel implementation before the running sums
+
+ImageFeature referenceContrast(const ImageFeature &image, uint z) {
+  ImageFeature result(image.xsize(),image.ysize(),1);
+  for(int x=0;x<int(image.xsize());++x) {
+    for(int y=0;y<int(image.ysize());++y) {
+      result(x,y,0)=getLocalContrast(image,x,y,z);
+    }
+  }
+  return result;
+}
+
+ImageFeature referenceDirectionality(const ImageFeature &image, uint z) {
+  uint xdim=image.xsize();
+  uint ydim=image.ysize();
+  ImageFeature deltaH=image.layer(z);
+  ImageFeature deltaV=image.layer(z);
+
+  ImageFeature matrixH(3,3,1), matrixV(3,3,1);
+  matrixH(0,0,0)=-1;  matrixH(0,1,0)=-2;  matrixH(0,2,0)=-1;
+  matrixH(2,0,0)=1;   matrixH(2,1,0)=2;   matrixH(2,2,0)=1;
+
+  matrixV(0,0,0)=1;  matrixV(1,0,0)=2;  matrixV(2,0,0)=1;
+  matrixV(0,2,0)=-1; matrixV(1,2,0)=-2; matrixV(2,2,0)=-1;
+
+  convolve(deltaH,matrixH);
+  convolve(deltaV,matrixV);
+
+  ImageFeature phi(xdim,ydim,1);
+  for(uint y=0;y<ydim;++y) {
+    for(uint x=0;x<xdim;++x) {
+      if(deltaH(x,y,0)!=0.0) {
+        phi(x,y,0)=atan(deltaV(x,y,0)/deltaH(x,y,0))+(M_PI/2.0+0.001);
+      }
+    }
+  }
+  return phi;
+}
+
+double referenceLocalMean(const int x, const int y, const int k, const ImageFeature &laufendeSumme) {
+  int k2=k/2;
+  int dimx=laufendeSumme.xsize();
+  int dimy=laufendeSumme.ysize();
+
+  //wanting average over area: (y-k2,x-k2) ... (y+k2-1, x+k2-1)
+  int starty=max(0,y-k2);
+  int startx=max(0,x-k2);
+  int stopy=min(dimy-1,y+k2-1);
+  int stopx=min(dimx-1,x+k2-1);
+
+  double links=(startx-1<0) ? 0 : laufendeSumme(startx-1,stopy,0);
+  double oben=(starty-1<0) ? 0 : laufendeSumme(stopx,starty-1,0);
+  double obenlinks=(starty-1<0 || startx-1<0) ? 0 : laufendeSumme(startx-1,starty-1,0);
+  double unten=laufendeSumme(stopx,stopy,0);
+
+  int counter=(stopy-starty+1)*(stopx-startx+1);
+  return (unten-links-oben+obenlinks)/counter;
+}
+
+ImageFeature referenceCoarseness(const ImageFeature &image, uint z) {
+  const int yDim=image.ysize();
+  const int xDim=image.xsize();
+
+  ImageFeature laufendeSumme(xDim,yDim,1);
+  double links, oben, obenlinks;
+  for(int y=0;y<yDim;++y) {
+    for(int x=0;x<xDim;++x) {
+      links=(x<1) ? 0 : laufendeSumme(x-1,y,0);
+      oben=(y<1) ? 0 : laufendeSumme(x,y-1,0);
+      obenlinks=(y<1 || x<1) ? 0 : laufendeSumme(x-1,y-1,0);
+      laufendeSumme(x,y,0)=image(x,y,z)+links+oben-obenlinks;
+    }
+  }
+
+  ImageFeature Ak(xDim,yDim,5), Ekh(xDim,yDim,5), Ekv(xDim,yDim,5);
+  ImageFeature Sbest(xDim,yDim,1);
+
+  int lenOfk=1;
+  for(int k=1;k<=5;++k) {
+    lenOfk*=2;
+    for(int y=0;y<yDim;++y) {
+      for(int x=0;x<xDim;++x) {
+        Ak(x,y,k-1)=referenceLocalMean(x,y,lenOfk,laufendeSumme);
+      }
+    }
+  }
+
+  lenOfk=1;
+  for(int k=1;k<=5;++k) {
+    int k2=lenOfk;
+    lenOfk*=2;
+    for(int y=0;y<yDim;++y) {
+      for(int x=0;x<xDim;++x) {
+        if(x+k2<xDim && x-k2>=0) {
+          Ekh(x,y,k-1)=fabs(Ak(x+k2,y,k-1)-Ak(x-k2,y,k-1));
+        }
+        if(y+k2<yDim && y-k2>=0) {
+          Ekv(x,y,k-1)=fabs(Ak(x,y+k2,k-1)-Ak(x,y-k2,k-1));
+        }
+      }
+    }
+  }
+
+  for(int y=0;y<yDim;++y) {
+    for(int x=0;x<xDim;++x) {
+      double maxE=0;
+      int maxk=0;
+      for(int k=1;k<=5;++k) {
+        if(Ekh(x,y,k-1)>maxE) {
+          maxE=Ekh(x,y,k-1);
+          maxk=k;
+        }
+        if(Ekv(x,y,k-1)>maxE) {
+          maxE=Ekv(x,y,k-1);
+          maxk=k;
+        }
+      }
+      Sbest(x,y,0)=maxk;
+    }
+  }
+  return Sbest;
+}
+
+ImageFeature referenceCalculate(const ImageFeature &img) {
+  ImageFeature result(img.xsize(), img.ysize(), 3);
+  for(uint z=0;z<img.zsize();++z) {
+    add(result,referenceDirectionality(img,z),0);
+    add(result,referenceCoarseness(img,z),1);
+    add(result,referenceContrast(img,z),2);
+  }
+  divide(result,img.zsize());
+  return result;
+}
+
+double maxDifference(const ImageFeature& a, const ImageFeature& b) {
+  if(a.xsize()!=b.xsize() || a.ysize()!=b.ysize() || a.zsize()!=b.zsize()) {
+    return HUGE_VAL;
+  }
+  double result=0.0;
+  for(uint c=0;c<a.zsize();++c) {
+    for(uint y=0;y<a.ysize();++y) {
+      for(uint x=0;x<a.xsize();++x) {
+        result=max(result, fabs(a(x,y,c)-b(x,y,c)));
+      }
+    }
+  }
+  return result;
+}
+
+// the histograms of the tamura image as getTamuraHistogram makes them
+HistogramFeature tamuraHistogram(ImageFeature tamuraImage) {
+  normalize(tamuraImage);
+  return histogramize(tamuraImage);
+}
+
+bool check(const string& name, const ImageFeature& img) {
+  double contrastError=0.0, coarsenessError=0.0, directionalityError=0.0;
+  for(uint z=0;z<img.zsize();++z) {
+    contrastError=max(contrastError, maxDifference(contrast(img,z), referenceContrast(img,z)));
+    coarsenessError=max(coarsenessError, maxDifference(coarseness(img,z), referenceCoarseness(img,z)));
+    directionalityError=max(directionalityError, maxDifference(directionality(img,z), referenceDirectionality(img,z)));
+  }
+
+  HistogramFeature histogram=tamuraHistogram(calculate(img));
+  HistogramFeature reference=tamuraHistogram(referenceCalculate(img));
+  bool sameHistogram=histogram.size()==reference.size();
+  for(uint i=0;sameHistogram && i<histogram.size();++i) {
+    sameHistogram=histogram.bin(i)==reference.bin(i);
+  }
+
+  bool ok=contrastError<=1e-9 && coarsenessError==0.0 && directionalityError<=1e-9 && sameHistogram;
+  cout << name << " " << img.xsize() << "x" << img.ysize() << "x" << img.zsize()
+       << ": contrast " << contrastError << ", coarseness " << coarsenessError
+       << ", directionality " << directionalityError
+       << ", histogram " << (sameHistogram ? "same" : "differs") << (ok ? "" : " FAILED") << endl;
+  return ok;
+}
+
+// random gray values quantized to the given number of levels
+ImageFeature randomImage(uint width, uint height, uint depth, uint levels) {
+  ImageFeature img(width, height, depth);
+  for(uint c=0;c<depth;++c) {
+    for(uint y=0;y<height;++y) {
+      for(uint x=0;x<width;++x) {
+        img(x,y,c)=double(rand()%levels)/(levels-1);
+      }
+    }
+  }
+  return img;
+}
+
+// homogeneous blocks of blockSize pixels, the texture coarseness looks for
+ImageFeature blockImage(uint width, uint height, uint blockSize) {
+  ImageFeature img(width, height, 3);
+  for(uint c=0;c<3;++c) {
+    for(uint by=0;by<height;by+=blockSize) {
+      for(uint bx=0;bx<width;bx+=blockSize) {
+        double value=double(rand()%256)/255;
+        for(uint y=by;y<min(height,by+blockSize);++y) {
+          for(uint x=bx;x<min(width,bx+blockSize);++x) {
+            img(x,y,c)=value;
+          }
+        }
+      }
+    }
+  }
+  return img;
+}
+
+// a flat image with low noise, where the windows of the contrast are
+// close to the threshold for homogeneous regions
+ImageFeature flatImage(uint width, uint height) {
+  ImageFeature img(width, height, 3);
+  for(uint c=0;c<3;++c) {
+    for(uint y=0;y<height;++y) {
+      for(uint x=0;x<width;++x) {
+        img(x,y,c)=0.5+((rand()%16==0) ? 1e-5*(rand()%3) : 0.0);
+      }
+    }
+  }
+  return img;
+}
+
+int main(int argc, char** argv) {
+  srand(42);
+  bool ok=true;
+
+  uint sizes[][2]={{1, 1}, {7, 5}, {40, 33}, {160, 120}};
+  for(uint s=0;s<4;++s) {
+    ok=check("8 bit", randomImage(sizes[s][0], sizes[s][1], 3, 256)) && ok;
+    ok=check("16 bit", randomImage(sizes[s][0], sizes[s][1], 1, 65536)) && ok;
+    ok=check("flat", flatImage(sizes[s][0], sizes[s][1])) && ok;
+  }
+  ok=check("blocks of 4", blockImage(97, 64, 4)) && ok;
+  ok=check("blocks of 16", blockImage(120, 90, 16)) && ok;
+
+  for(int i=1;i<argc;++i) {
+    ImageFeature img;
+    if(!img.load(argv[i])) {
+      ERR << "Cannot load image '" << argv[i] << "'." << endl;
+      ok=false;
+      continue;
+    }
+    ok=check(argv[i], img) && ok;
+  }
+
+  if(!ok) {
+    ERR << "the tamura features differ from the per pixel implementation" << endl;
+    return 1;
+  }
+  return 0;
+}
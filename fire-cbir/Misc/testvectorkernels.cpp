@@ -0,0 +1,201 @@
+#include "vectorkernels.hpp"
+#include "histogramfeature.hpp"
+#include "mappedhistogramfeature.hpp"
+#include "compacthistogramfeature.hpp"
+#include "dist_euclidean.hpp"
+#include "dist_l1.hpp"
+#include "dist_chisquare.hpp"
+#include "dist_histogramintersection.hpp"
+#include "dist_jsd.hpp"
+#include "dist_kld.hpp"
+#include "dist_oneminusfidelity.hpp"
+#include "dist_arccosfidelity.hpp"
+#include "dist_logtwominusfidelity.hpp"
+#include "dist_oneminusfidelitysquare.hpp"
+#include "dist_sqrtoneminusfidelity.hpp"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <sys/time.h>
+
+using namespace std;
+
+// compares the batched distances() of the dense vector distances for
+// all instruction sets available on this CPU with the plain
+// distance() methods and reports the time needed for both, once for
+// plain vector features and once for histograms (held in memory,
+// mapped and compactly).
+
+double seconds() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec+tv.tv_usec*1e-6;
+}
+
+VectorFeature* randomHistogram(uint dim) {
+  VectorFeature* result=new VectorFeature(dim);
+  double sum=0.0;
+  for(uint i=0;i<dim;++i) {
+    // about every fifth bin is empty to test the special cases for 0
+    double v=(rand()%5==0) ? 0.0 : double(rand())/RAND_MAX;
+    (*result)[i]=v;
+    sum+=v;
+  }
+  for(uint i=0;i<dim;++i) {
+    (*result)[i]/=sum;
+  }
+  return result;
+}
+
+// random bin counts of which about every fifth is 0
+vector<uint> randomCounts(uint dim, uint& counter) {
+  vector<uint> bins(dim);
+  counter=0;
+  for(uint i=0;i<dim;++i) {
+    bins[i]=(rand()%5==0) ? 0 : 1+rand()%1000;
+    counter+=bins[i];
+  }
+  if(counter==0) {
+    bins[0]=counter=1;
+  }
+  return bins;
+}
+
+// compares dists[d]->distances() with dists[d]->distance() for all
+// instruction sets, returns false if one of them is off by more than
+// tolerances[d]
+bool compare(const vector<BaseDistance*>& dists, const vector<double>& tolerances,
+             const BaseFeature* query, const vector<BaseFeature*>& db, uint iter) {
+  vector<string> sets;
+  sets.push_back("scalar"); sets.push_back("sse4.1"); sets.push_back("avx2");
+
+  const uint count=db.size();
+  vector<double> reference(count), result(count);
+  bool ok=true;
+  for(uint d=0;d<dists.size();++d) {
+    BaseDistance* dist=dists[d];
+
+    double start=seconds();
+    for(uint it=0;it<iter;++it) {
+      for(uint n=0;n<count;++n) {
+        reference[n]=dist->distance(query, db[n]);
+      }
+    }
+    double plain=seconds()-start;
+    cout << dist->name() << ": distance() " << plain*1000 << " ms";
+
+    for(uint s=0;s<sets.size();++s) {
+      if(!VectorKernels::useInstructionSet(sets[s])) continue;
+
+      start=seconds();
+      for(uint it=0;it<iter;++it) {
+        dist->distances(query, &db[0], count, &result[0]);
+      }
+      double batched=seconds()-start;
+
+      double maxError=0.0;
+      for(uint n=0;n<count;++n) {
+        double err=fabs(result[n]-reference[n])/(1.0+fabs(reference[n]));
+        if(!(err<=maxError)) maxError=err; // also catches NaN
+      }
+      cout << ", " << sets[s] << " " << batched*1000 << " ms (x" << plain/batched << ", error " << maxError << ")";
+      if(!(maxError<=tolerances[d])) {
+        cout << " FAILED";
+        ok=false;
+      }
+    }
+    cout << endl;
+  }
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  uint dim=(argc>1) ? atoi(argv[1]) : 259;
+  uint count=(argc>2) ? atoi(argv[2]) : 2000;
+  uint iter=(argc>3) ? atoi(argv[3]) : 20;
+
+  if(argc>4) {
+    ERR << "Usage: testvectorkernels [dimension] [# images] [# iter]" << endl;
+    exit(1);
+  }
+
+  srand(42);
+  VectorFeature* query=randomHistogram(dim);
+  vector<BaseFeature*> db(count);
+  for(uint n=0;n<count;++n) {
+    db[n]=randomHistogram(dim);
+  }
+
+  vector<BaseDistance*> dists;
+  vector<double> tolerances;
+  dists.push_back(new EuclideanDistance()); tolerances.push_back(1e-9);
+  dists.push_back(new L1Distance()); tolerances.push_back(1e-9);
+  dists.push_back(new ChisquareDistance()); tolerances.push_back(1e-9);
+  dists.push_back(new HistogramintersectionDistance()); tolerances.push_back(1e-9);
+  dists.push_back(new JSDDistance()); tolerances.push_back(1e-5);
+  dists.push_back(new KLDDistance()); tolerances.push_back(1e-9);
+  dists.push_back(new OneMinusFidelityDistance()); tolerances.push_back(1e-9);
+  dists.push_back(new ArccosFidelityDistance()); tolerances.push_back(1e-9);
+  dists.push_back(new LogTwoMinusFidelityDistance()); tolerances.push_back(1e-9);
+  dists.push_back(new SqrtOneMinusFidelitySquareDistance()); tolerances.push_back(1e-9);
+  dists.push_back(new SqrtOneMinusFidelityDistance()); tolerances.push_back(1e-9);
+
+  const string best=VectorKernels::instructionSet();
+  cout << "dimension " << dim << ", " << count << " images, " << iter << " iterations, default kernels: " << best << endl;
+
+  cout << "vector features" << endl;
+  bool failed=!compare(dists, tolerances, query, db, iter);
+
+  // histograms, every third one read from memory it does not own as
+  // from a mapped feature file and every third one held as floats
+  uint counter;
+  vector<uint> queryBins=randomCounts(dim,counter);
+  HistogramFeature* histoQuery=new HistogramFeature(counter, queryBins);
+  vector<BaseFeature*> histos(count);
+  vector< vector<uint> > mappedBins(count);
+  vector< vector<double> > mappedValues(count);
+  CompactVectorStore store(COMPACT_FLOAT, dim, count);
+  for(uint n=0;n<count;++n) {
+    vector<uint> bins=randomCounts(dim,counter);
+    if(n%3==0) {
+      histos[n]=new HistogramFeature(counter, bins);
+    } else if(n%3==2) {
+      const HistogramFeature histo(counter, bins);
+      histos[n]=new CompactHistogramFeature(&store, store.add(&histo.ndata()[0]), histo);
+    } else {
+      mappedBins[n]=bins;
+      mappedValues[n]=HistogramFeature(counter, bins).ndata();
+      histos[n]=new MappedHistogramFeature(counter, vector<uint>(1,dim), vector<double>(1,0.0), vector<double>(1,1.0),
+                                           &mappedValues[n][0], &mappedBins[n][0], dim);
+    }
+    if(!VectorFeature::dense(histos[n])) {
+      ERR << "histogram " << n << " is not taken as dense vector" << endl;
+      failed=true;
+    }
+  }
+  cout << "histograms" << endl;
+  failed=!compare(dists, tolerances, histoQuery, histos, iter) || failed;
+  for(uint n=0;n<count;++n) {
+    if((n%3==1 && !static_cast<MappedHistogramFeature*>(histos[n])->mapped()) ||
+       (n%3==2 && !static_cast<CompactHistogramFeature*>(histos[n])->compact())) {
+      ERR << "histogram " << n << " was copied by the distances" << endl;
+      failed=true;
+    }
+    delete histos[n];
+  }
+  delete histoQuery;
+
+  VectorKernels::useInstructionSet(best);
+
+  for(uint d=0;d<dists.size();++d) delete dists[d];
+  for(uint n=0;n<count;++n) delete db[n];
+  delete query;
+
+  if(failed) {
+    ERR << "vector kernels differ from the distances" << endl;
+    return 1;
+  }
+  return 0;
+}
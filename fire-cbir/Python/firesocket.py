@@ -1,4 +1,4 @@
-import socket, os, sys,re 
+import socket, os, sys,re,struct
 # ----------------------------------------------------------------------
 # socket implementation for comunication with the server system
 # running on any computer which is reachable via network sockets
@@ -64,3 +64,42 @@ class FIRESocket:
     def flush(self):
         chunk=self.sock.recv(5000)
         return
+    # ------------------------------------------------------------------
+    # binary protocol (see Retriever/server.hpp). Requests can be sent
+    # without waiting for the answers, which arrive in the same order.
+    # ------------------------------------------------------------------
+    def binary(self):
+        '''switch this connection to the binary protocol'''
+        self.sendcmd("binary")
+        return self.getline()=="binary"
+    def sendframe(self,id,type,payload):
+        self.send(struct.pack("<III",len(payload)+8,id,type)+payload)
+    def sendtext(self,id,cmd):
+        self.sendframe(id,1,cmd)
+    def sendretrieve(self,id,positives,negatives=[],results=0):
+        '''retrieve for the images with the given indices in the filelist'''
+        queries=list(positives)+list(negatives)
+        payload=struct.pack("<III",results,len(positives),len(negatives))+struct.pack("<%dI" % len(queries),*queries)
+        self.sendframe(id,2,payload)
+    def sendbye(self,id=0):
+        self.sendframe(id,3,"")
+    def receivebytes(self,size):
+        msg=''
+        while len(msg) < size:
+            chunk=self.sock.recv(size-len(msg))
+            if chunk == '':
+                raise RuntimeError, "socket connection broken"
+            msg=msg+chunk
+        return msg
+    def receiveframe(self):
+        '''the next answer as (id, status, payload), status 0 is success'''
+        size,=struct.unpack("<I",self.receivebytes(4))
+        data=self.receivebytes(size)
+        id,status=struct.unpack("<II",data[:8])
+        return id,status,data[8:]
+    def results(self,payload):
+        '''the (index, score) pairs of the payload of a retrieve answer'''
+        count,=struct.unpack("<I",payload[:4])
+        indices=struct.unpack("<%dI" % count,payload[4:4+4*count])
+        scores=struct.unpack("<%dd" % count,payload[4+4*count:4+12*count])
+        return zip(indices,scores)
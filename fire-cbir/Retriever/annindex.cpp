@@ -0,0 +1,331 @@
+/*
+ This file is part of the FIRE -- Flexible Image Retrieval System
+
+ FIRE is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ FIRE is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with FIRE; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "annindex.hpp"
+#include "vectorfeature.hpp"
+#include "diag.hpp"
+
+using namespace std;
+
+namespace {
+  const char annMagic[8]={'F','I','R','E','_','I','V','F'};
+  const uint32_t annVersion=2;
+
+  /// number of k-means iterations when building an index
+  const uint kmeansIterations=10;
+  /// number of training vectors per list
+  const uint trainingPerList=64;
+}
+
+AnnIndex::AnnIndex() : dim_(0), lists_(0), size_(0), fingerprint_(0), centroids_(NULL), offsets_(NULL), ids_(NULL), map_(NULL), mapSize_(0) {
+}
+
+AnnIndex::~AnnIndex() {
+  unmap();
+}
+
+void AnnIndex::unmap() {
+  if(map_) {
+    munmap(const_cast<char*>(map_), mapSize_);
+    map_=NULL;
+    mapSize_=0;
+  }
+}
+
+uint64_t AnnIndex::fingerprint(const Database& db) {
+  // 64 bit FNV-1a over the names, each terminated by a zero byte
+  uint64_t hash=14695981039346656037ULL;
+  for(uint i=0;i<db.size();++i) {
+    const string& name=db[i]->basename();
+    for(uint c=0;c<=name.size();++c) {
+      hash^=(c<name.size()) ? uint64_t(static_cast<unsigned char>(name[c])) : 0;
+      hash*=1099511628211ULL;
+    }
+  }
+  return hash;
+}
+
+uint AnnIndex::featureSize(const Database& db, uint suffix, uint idx) {
+  const FeatureSet* fs=(*db[idx])[suffix];
+  const VectorFeature* v=(fs && fs->feature_count()==1) ? VectorFeature::dense((*fs)[0]) : NULL;
+  return v ? v->size() : 0;
+}
+
+size_t AnnIndex::offsetsPosition(uint dim, uint lists) {
+  size_t pos=sizeof(Header)+size_t(dim)*lists*sizeof(float);
+  return (pos+sizeof(uint64_t)-1)/sizeof(uint64_t)*sizeof(uint64_t);
+}
+
+size_t AnnIndex::idsPosition(uint dim, uint lists) {
+  return offsetsPosition(dim, lists)+(size_t(lists)+1)*sizeof(uint64_t);
+}
+
+double AnnIndex::centroidDistance(const double* v, uint l) const {
+  const float* c=centroids_+size_t(l)*dim_;
+  double result=0.0;
+  for(uint d=0;d<dim_;++d) {
+    const double diff=v[d]-c[d];
+    result+=diff*diff;
+  }
+  return result;
+}
+
+uint AnnIndex::nearest(const double* v) const {
+  uint best=0;
+  double bestDist=numeric_limits<double>::max();
+  for(uint l=0;l<lists_;++l) {
+    const double dist=centroidDistance(v, l);
+    if(dist<bestDist) {
+      bestDist=dist;
+      best=l;
+    }
+  }
+  return best;
+}
+
+bool AnnIndex::build(const Database& db, uint suffix, uint lists) {
+  const uint N=db.size();
+  vector<const VectorFeature*> vectors(N);
+  uint dim=0;
+  for(uint i=0;i<N;++i) {
+    const FeatureSet* fs=(*db[i])[suffix];
+    const VectorFeature* v=(fs && fs->feature_count()==1) ? VectorFeature::dense((*fs)[0]) : NULL;
+    if(!v || (i>0 && v->size()!=dim) || v->size()==0) {
+      ERR << "Cannot build an index for suffix " << suffix << ": image " << i << " has no vector or histogram feature of the same size as the others." << endl;
+      return false;
+    }
+    dim=v->size();
+    vectors[i]=v;
+  }
+  if(N==0) {
+    return false;
+  }
+  if(lists==0) {
+    lists=uint(sqrt(double(N)));
+  }
+  lists=max(1u, min(lists, N));
+
+  unmap();
+  dim_=dim;
+  lists_=lists;
+  size_=N;
+  fingerprint_=fingerprint(db);
+
+  // k-means on an evenly spaced sample of the database, the initial
+  // centroids are evenly spaced in the sample as well. The sample is
+  // copied as the vectors may be held compactly
+  const uint samples=min(N, lists*trainingPerList);
+  vector<double> sample(size_t(samples)*dim);
+  for(uint s=0;s<samples;++s) {
+    double* row=&sample[size_t(s)*dim];
+    const double* v=vectors[uint(uint64_t(s)*N/samples)]->decoded(row);
+    if(v!=row) {
+      copy(v, v+dim, row);
+    }
+  }
+  centroidData_.resize(size_t(lists)*dim);
+  for(uint l=0;l<lists;++l) {
+    const double* v=&sample[size_t(uint64_t(l)*samples/lists)*dim];
+    copy(v, v+dim, centroidData_.begin()+size_t(l)*dim);
+  }
+  centroids_=&centroidData_[0];
+
+  vector<uint> assignment(samples);
+  vector<double> sums(size_t(lists)*dim);
+  vector<uint> counts(lists);
+  for(uint it=0;it<kmeansIterations;++it) {
+#pragma omp parallel for schedule(static)
+    for(long s=0;s<long(samples);++s) {
+      assignment[s]=nearest(&sample[size_t(s)*dim]);
+    }
+
+    fill(sums.begin(), sums.end(), 0.0);
+    fill(counts.begin(), counts.end(), 0);
+    for(uint s=0;s<samples;++s) {
+      const double* v=&sample[size_t(s)*dim];
+      double* sum=&sums[size_t(assignment[s])*dim];
+      for(uint d=0;d<dim;++d) {
+        sum[d]+=v[d];
+      }
+      ++counts[assignment[s]];
+    }
+    for(uint l=0;l<lists;++l) {
+      float* c=&centroidData_[size_t(l)*dim];
+      if(counts[l]==0) {
+        // an empty list gets a new centroid from the sample
+        const double* v=&sample[size_t((uint64_t(l)*7919+it)%samples)*dim];
+        copy(v, v+dim, c);
+        continue;
+      }
+      for(uint d=0;d<dim;++d) {
+        c[d]=sums[size_t(l)*dim+d]/counts[l];
+      }
+    }
+  }
+
+  // put every image into the list of its nearest centroid
+  vector<uint> listOf(N);
+#pragma omp parallel
+  {
+    vector<double> buffer(dim);
+#pragma omp for schedule(static)
+    for(long i=0;i<long(N);++i) {
+      listOf[i]=nearest(vectors[i]->decoded(&buffer[0]));
+    }
+  }
+  offsetData_.assign(size_t(lists)+1, 0);
+  for(uint i=0;i<N;++i) {
+    ++offsetData_[listOf[i]+1];
+  }
+  for(uint l=0;l<lists;++l) {
+    offsetData_[l+1]+=offsetData_[l];
+  }
+  idData_.resize(N);
+  vector<uint64_t> next(offsetData_.begin(), offsetData_.end()-1);
+  for(uint i=0;i<N;++i) {
+    idData_[next[listOf[i]]++]=i;
+  }
+  offsets_=&offsetData_[0];
+  ids_=&idData_[0];
+
+  DBG(10) << "Built index for suffix " << suffix << ": " << N << " images of dimension " << dim << " in " << lists << " lists" << endl;
+  return true;
+}
+
+bool AnnIndex::save(const string& filename) const {
+  ofstream ofs(filename.c_str(), ios::binary);
+  if(!ofs.good() || !centroids_) {
+    ERR << "Cannot write index '" << filename << "'" << endl;
+    return false;
+  }
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, annMagic, sizeof(annMagic));
+  header.version=annVersion;
+  header.dim=dim_;
+  header.lists=lists_;
+  header.size=size_;
+  header.fingerprint=fingerprint_;
+  ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  ofs.write(reinterpret_cast<const char*>(centroids_), size_t(dim_)*lists_*sizeof(float));
+  const size_t padding=offsetsPosition(dim_, lists_)-sizeof(header)-size_t(dim_)*lists_*sizeof(float);
+  const char zeros[sizeof(uint64_t)]={0};
+  ofs.write(zeros, padding);
+  ofs.write(reinterpret_cast<const char*>(offsets_), (size_t(lists_)+1)*sizeof(uint64_t));
+  ofs.write(reinterpret_cast<const char*>(ids_), size_*sizeof(uint32_t));
+  if(!ofs.good()) {
+    ERR << "Cannot write index '" << filename << "'" << endl;
+    return false;
+  }
+  DBG(10) << "Saved index to " << filename << endl;
+  return true;
+}
+
+bool AnnIndex::load(const string& filename, const Database& db, uint suffix) {
+  if(db.size()==0) {
+    return false;
+  }
+  int fd=open(filename.c_str(), O_RDONLY);
+  struct stat st;
+  if(fd<0) {
+    return false;
+  }
+  if(fstat(fd,&st)!=0 || size_t(st.st_size)<sizeof(Header)) {
+    close(fd);
+    return false;
+  }
+  void *mem=mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(mem==MAP_FAILED) {
+    ERR << "Cannot map index '" << filename << "'" << endl;
+    return false;
+  }
+
+  Header header;
+  memcpy(&header, mem, sizeof(header));
+  bool ok=memcmp(header.magic, annMagic, sizeof(annMagic))==0 && header.version==annVersion &&
+    header.lists>0 && header.size==db.size() && header.fingerprint==fingerprint(db) &&
+    header.dim>0 && header.dim==featureSize(db, suffix, 0) &&
+    size_t(st.st_size)==idsPosition(header.dim, header.lists)+header.size*sizeof(uint32_t);
+  const char* data=static_cast<const char*>(mem);
+  if(ok) {
+    const uint64_t* offsets=reinterpret_cast<const uint64_t*>(data+offsetsPosition(header.dim, header.lists));
+    const uint32_t* ids=reinterpret_cast<const uint32_t*>(data+idsPosition(header.dim, header.lists));
+    ok=offsets[0]==0 && offsets[header.lists]==header.size;
+    for(uint l=0;ok && l<header.lists;++l) {
+      ok=offsets[l]<=offsets[l+1];
+    }
+    for(uint64_t i=0;ok && i<header.size;++i) {
+      ok=ids[i]<header.size;
+    }
+  }
+  if(!ok) {
+    DBG(10) << "Index '" << filename << "' does not fit the database" << endl;
+    munmap(mem, st.st_size);
+    return false;
+  }
+
+  unmap();
+  centroidData_.clear();
+  offsetData_.clear();
+  idData_.clear();
+  map_=data;
+  mapSize_=st.st_size;
+  dim_=header.dim;
+  lists_=header.lists;
+  size_=header.size;
+  fingerprint_=header.fingerprint;
+  centroids_=reinterpret_cast<const float*>(data+sizeof(Header));
+  offsets_=reinterpret_cast<const uint64_t*>(data+offsetsPosition(dim_, lists_));
+  ids_=reinterpret_cast<const uint32_t*>(data+idsPosition(dim_, lists_));
+  DBG(10) << "Mapped index " << filename << ": " << size_ << " images of dimension " << dim_ << " in " << lists_ << " lists" << endl;
+  return true;
+}
+
+bool AnnIndex::search(const BaseFeature* query, uint probes, vector<uint>& candidates) const {
+  const VectorFeature* v=VectorFeature::dense(query);
+  if(!centroids_ || !v || v->size()!=dim_) {
+    return false;
+  }
+  vector<double> buffer(dim_);
+  const double* q=v->decoded(&buffer[0]);
+
+  probes=max(1u, min(probes, lists_));
+  vector< pair<double,uint> > order(lists_);
+  for(uint l=0;l<lists_;++l) {
+    order[l]=make_pair(centroidDistance(q, l), l);
+  }
+  partial_sort(order.begin(), order.begin()+probes, order.end());
+
+  candidates.clear();
+  for(uint p=0;p<probes;++p) {
+    const uint l=order[p].second;
+    candidates.insert(candidates.end(), ids_+offsets_[l], ids_+offsets_[l+1]);
+  }
+  sort(candidates.begin(), candidates.end());
+  return true;
+}
@@ -0,0 +1,127 @@
+/*
+ This file is part of the FIRE -- Flexible Image Retrieval System
+
+ FIRE is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ FIRE is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with FIRE; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __annindex_hpp__
+#define __annindex_hpp__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "basefeature.hpp"
+#include "database.hpp"
+
+/** AnnIndex: an inverted file index over the plain vector or histogram
+    features of one suffix for approximate nearest neighbour search.
+
+    The features are clustered with k-means into lists() lists, each
+    database image is in the list of its nearest centroid. A search
+    looks at the lists of the probes centroids nearest to the query
+    and returns all images in them as candidates, the retriever then
+    computes the real distances only for these. More probes give a
+    higher recall at higher costs. The clustering uses the euclidean
+    distance, the candidates are useful for euclidean, L1 and
+    chisquare-like distances.
+
+    The index is saved in a file next to the filelist and mapped into
+    memory when it is loaded, the format is a header followed by the
+    centroids (floats), the list offsets (uint64) and the image
+    numbers (uint32) of all lists one after the other. The header
+    holds a fingerprint of the image names, so an index of another
+    database of the same size is not used.
+
+    search() may be called from several threads at the same time.
+ */
+class AnnIndex {
+private:
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t dim;
+    uint32_t lists;
+    uint32_t reserved;
+    uint64_t size;
+    uint64_t fingerprint;
+  };
+
+  uint dim_, lists_;
+  uint64_t size_, fingerprint_;
+
+  /// the index data, pointing into the vectors below after build()
+  /// and into the mapped file after load()
+  const float* centroids_;
+  const uint64_t* offsets_;
+  const uint32_t* ids_;
+
+  ::std::vector<float> centroidData_;
+  ::std::vector<uint64_t> offsetData_;
+  ::std::vector<uint32_t> idData_;
+
+  const char* map_;
+  size_t mapSize_;
+
+  /// the byte offsets of the parts of the file
+  static size_t offsetsPosition(uint dim, uint lists);
+  static size_t idsPosition(uint dim, uint lists);
+
+  /// the squared euclidean distance of v to the l-th centroid
+  double centroidDistance(const double* v, uint l) const;
+
+  /// the nearest centroid of v
+  uint nearest(const double* v) const;
+
+  void unmap();
+
+  /// a hash of the names of all images in the database
+  static uint64_t fingerprint(const Database& db);
+
+  /// the size of the dense vector feature of the given suffix of the
+  /// idx-th database image, 0 if it has none
+  static uint featureSize(const Database& db, uint suffix, uint idx);
+
+  // not copyable
+  AnnIndex(const AnnIndex&);
+  AnnIndex& operator=(const AnnIndex&);
+
+public:
+  AnnIndex();
+  ~AnnIndex();
+
+  /// cluster the features of the given suffix of all database images
+  /// into lists lists (0: the square root of the database size).
+  /// Returns false if not all of them are dense vectors (plain vectors
+  /// or histograms) of the same size.
+  bool build(const Database& db, uint suffix, uint lists=0);
+
+  /// write the index to the given file
+  bool save(const ::std::string& filename) const;
+
+  /// map the index from the given file. Returns false if it cannot be
+  /// read or was built for other images or features than the ones of
+  /// the given suffix of db, the caller then has to build it again.
+  bool load(const ::std::string& filename, const Database& db, uint suffix);
+
+  /// the images in the lists of the probes centroids nearest to the
+  /// query, in increasing order. Returns false if the query cannot be
+  /// searched with this index, the caller then has to use all images.
+  bool search(const BaseFeature* query, uint probes, ::std::vector<uint>& candidates) const;
+
+  uint dim() const { return dim_; }
+  uint lists() const { return lists_; }
+  uint64_t size() const { return size_; }
+};
+
+#endif
@@ -20,6 +20,7 @@ along with FIRE; if not, write to the Free Software Foundation, Inc.,
 #define __basescoring_hpp__
 #include "diag.hpp"
 #include "imagecomparator.hpp"
+#include "distancematrix.hpp"
 
 /** 
  * a class to calculate scores from distance vectors.  so far this
@@ -46,6 +47,17 @@ public:
   virtual ~BaseScoring() {}
   /// given a normalized distance vector return the score
   virtual double getScore(const ::std::vector<double>& dists)=0;
+
+  /// given a normalized distance matrix return the scores for all of
+  /// its rows. By default getScore is called for each row.
+  virtual void getScores(const DistanceMatrix& dists, ::std::vector<double>& scores) {
+    ::std::vector<double> row;
+    scores.resize(dists.rows());
+    for(uint i=0;i<dists.rows();++i) {
+      dists.getRow(i,row);
+      scores[i]=getScore(row);
+    }
+  }
   
   /// give the name of the scoring as reference
   virtual ::std::string& type() {return type_;}
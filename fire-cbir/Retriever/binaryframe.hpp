@@ -0,0 +1,129 @@
+/*
+ This file is part of the FIRE -- Flexible Image Retrieval System
+
+ FIRE is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ FIRE is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with FIRE; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __binaryframe_hpp__
+#define __binaryframe_hpp__
+
+#include <string>
+#include <cstring>
+#include <stdint.h>
+#include "net.hpp"
+
+/** Frames of the binary protocol (see server.hpp): the request types,
+    the answer status codes and little endian coding of the numbers.
+    Used by the servers and by the coordinator of sharded servers.
+ */
+
+/// request types
+static const uint32_t BINARY_TEXT=1;
+static const uint32_t BINARY_RETRIEVE=2;
+static const uint32_t BINARY_BYE=3;
+static const uint32_t BINARY_SHARD_RETRIEVE=4;
+static const uint32_t BINARY_MEANS=5;
+
+/// answer status codes
+static const uint32_t BINARY_OK=0;
+static const uint32_t BINARY_ERROR=1;
+static const uint32_t BINARY_NORMALIZE=2;
+
+/// larger frames are considered broken
+static const uint32_t BINARY_MAX_FRAME_SIZE=1<<26;
+
+inline void putUint32(::std::string& frame, uint32_t value) {
+  for(uint i=0;i<4;++i) {
+    frame+=char((value>>(8*i))&0xff);
+  }
+}
+
+inline void putFloat64(::std::string& frame, double value) {
+  uint64_t bits;
+  memcpy(&bits,&value,sizeof(bits));
+  for(uint i=0;i<8;++i) {
+    frame+=char((bits>>(8*i))&0xff);
+  }
+}
+
+inline void putString(::std::string& frame, const ::std::string& value) {
+  putUint32(frame,value.size());
+  frame+=value;
+}
+
+inline uint32_t getUint32(const char* data) {
+  const unsigned char* d=reinterpret_cast<const unsigned char*>(data);
+  return uint32_t(d[0]) | (uint32_t(d[1])<<8) | (uint32_t(d[2])<<16) | (uint32_t(d[3])<<24);
+}
+
+inline double getFloat64(const char* data) {
+  const unsigned char* d=reinterpret_cast<const unsigned char*>(data);
+  uint64_t bits=0;
+  for(uint i=0;i<8;++i) {
+    bits|=uint64_t(d[i])<<(8*i);
+  }
+  double value;
+  memcpy(&value,&bits,sizeof(value));
+  return value;
+}
+
+/// read a string written by putString at offset and move offset
+/// behind it. Returns false if the payload is too short.
+inline bool getString(const ::std::string& payload, size_t& offset, ::std::string& value) {
+  if(offset+4>payload.size()) {
+    return false;
+  }
+  const uint32_t size=getUint32(payload.data()+offset);
+  if(size>payload.size()-offset-4) {
+    return false;
+  }
+  value.assign(payload,offset+4,size);
+  offset+=4+size;
+  return true;
+}
+
+/// start a frame with the id and the request type or answer status,
+/// the size is filled in by sendFrame
+inline void startFrame(::std::string& frame, uint32_t id, uint32_t code) {
+  frame.clear();
+  putUint32(frame,0);
+  putUint32(frame,id);
+  putUint32(frame,code);
+}
+
+inline bool sendFrame(Socket& socket, ::std::string& frame) {
+  ::std::string size;
+  putUint32(size,frame.size()-4);
+  frame.replace(0,4,size);
+  return socket.sendBytes(frame.data(),frame.size());
+}
+
+/// receive the next frame. Returns false if the connection was closed,
+/// broke or the frame is invalid.
+inline bool receiveFrame(Socket& socket, uint32_t& id, uint32_t& code, ::std::string& payload) {
+  char header[12];
+  if(!socket.receiveBytes(header,4)) {
+    return false;
+  }
+  const uint32_t size=getUint32(header);
+  if(size<8 || size>BINARY_MAX_FRAME_SIZE || !socket.receiveBytes(header+4,8)) {
+    return false;
+  }
+  id=getUint32(header+4);
+  code=getUint32(header+8);
+  payload.resize(size-8);
+  return size==8 || socket.receiveBytes(&payload[0],size-8);
+}
+
+#endif
@@ -0,0 +1,525 @@
+/*
+ This file is part of the FIRE -- Flexible Image Retrieval System
+
+ FIRE is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ FIRE is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with FIRE; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <cstdlib>
+#include <errno.h>
+#include <poll.h>
+#include <sys/time.h>
+#include "coordinator.hpp"
+#include "binaryframe.hpp"
+#include "profiler.hpp"
+
+using namespace std;
+
+namespace {
+  /// seconds until a shard that could not be reached is tried again
+  const time_t retryDelay=5;
+
+  double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec+tv.tv_usec*1e-6;
+  }
+
+  void tokenize(const string& line, vector<string>& tokens) {
+    istringstream iss(line);
+    string t;
+    while(iss >> t) {
+      tokens.push_back(t);
+    }
+  }
+
+  typedef pair<double,string> NamedResult;
+
+  bool betterScore(const NamedResult& a, const NamedResult& b) {
+    return a.first>b.first;
+  }
+
+  /// the "name score name score ..." answers of the shards
+  void parseResults(const string& text, vector<NamedResult>& results) {
+    istringstream iss(text);
+    NamedResult r;
+    while(iss >> r.second >> r.first) {
+      results.push_back(r);
+    }
+  }
+}
+
+ShardCoordinator::ShardCoordinator() : timeout_(5000), results_(0) {
+  pthread_key_create(&connectionsKey_, deleteConnections);
+  pthread_mutex_init(&connectLock_, NULL);
+}
+
+ShardCoordinator::~ShardCoordinator() {
+  pthread_mutex_destroy(&connectLock_);
+  pthread_key_delete(connectionsKey_);
+}
+
+bool ShardCoordinator::setShards(const string& shards) {
+  shards_.clear();
+  istringstream iss(shards);
+  string item;
+  while(getline(iss,item,',')) {
+    string::size_type pos=item.rfind(':');
+    if(pos==string::npos || pos==0 || item.find_first_not_of("0123456789",pos+1)!=string::npos || pos+1==item.size()) {
+      shards_.clear();
+      return false;
+    }
+    Shard shard;
+    shard.host=item.substr(0,pos);
+    shard.port=atoi(item.substr(pos+1).c_str());
+    shards_.push_back(shard);
+  }
+  return !shards_.empty();
+}
+
+void ShardCoordinator::deleteConnections(void *data) {
+  Connections *c=static_cast<Connections*>(data);
+  for(uint s=0;s<c->shards.size();++s) {
+    if(c->shards[s].socket) {
+      c->shards[s].socket->close();
+      delete c->shards[s].socket;
+    }
+  }
+  delete c;
+}
+
+ShardCoordinator::Connections& ShardCoordinator::connections() {
+  Connections *c=static_cast<Connections*>(pthread_getspecific(connectionsKey_));
+  if(!c) {
+    c=new Connections();
+    pthread_setspecific(connectionsKey_, c);
+  }
+  c->shards.resize(shards_.size());
+  return *c;
+}
+
+bool ShardCoordinator::connect(Connections& c, uint s) {
+  Connection &conn=c.shards[s];
+  if(conn.socket) {
+    return true;
+  }
+  if(time(NULL)<conn.retry) {
+    return false;
+  }
+  pthread_mutex_lock(&connectLock_);
+  Socket *socket=new Socket(shards_[s].host, shards_[s].port);
+  pthread_mutex_unlock(&connectLock_);
+
+  bool ok=socket->connected();
+  if(ok) {
+    socket->setTimeout(timeout_);
+    const string binary("binary\r\n");
+    ok=socket->sendBytes(binary.data(),binary.size()) && socket->getline()=="binary";
+  }
+  if(ok && password_!="") {
+    string frame, answer;
+    uint32_t id, status;
+    startFrame(frame,0,BINARY_TEXT);
+    frame+="password "+password_;
+    ok=sendFrame(*socket,frame) && receiveFrame(*socket,id,status,answer) && answer=="ok";
+  }
+  if(!ok) {
+    ERR << "Cannot reach shard " << shards_[s].host << ":" << shards_[s].port << ", trying again in " << retryDelay << " seconds" << endl;
+    socket->close();
+    delete socket;
+    conn.retry=time(NULL)+retryDelay;
+    return false;
+  }
+  DBG(10) << "Connected to shard " << shards_[s].host << ":" << shards_[s].port << endl;
+  conn.socket=socket;
+  return true;
+}
+
+void ShardCoordinator::disconnect(Connections& c, uint s) {
+  Connection &conn=c.shards[s];
+  if(conn.socket) {
+    conn.socket->close();
+    delete conn.socket;
+    conn.socket=NULL;
+  }
+}
+
+void ShardCoordinator::sendMeans(Connections& c, uint32_t id, vector<Sums>& sums, vector<bool>& pending) {
+  uint waiting=0;
+  for(uint s=0;s<shards_.size();++s) {
+    if(pending[s]) {
+      if(!sums[s].waiting) {
+        return;
+      }
+      ++waiting;
+    }
+  }
+  if(waiting==0) {
+    return;
+  }
+
+  // the means over the images of all shards. If the shards have
+  // different numbers of distances they keep their own means
+  vector<double> total;
+  double images=0.0;
+  bool first=true, consistent=true;
+  for(uint s=0;s<shards_.size();++s) {
+    if(!pending[s]) continue;
+    if(first) {
+      total.assign(sums[s].sums.size(),0.0);
+      first=false;
+    }
+    if(sums[s].sums.size()!=total.size()) {
+      consistent=false;
+      continue;
+    }
+    for(uint j=0;j<total.size();++j) {
+      total[j]+=sums[s].sums[j];
+    }
+    images+=sums[s].images;
+  }
+  string frame;
+  startFrame(frame,id,BINARY_MEANS);
+  if(consistent && images>0.0) {
+    putUint32(frame,total.size());
+    for(uint j=0;j<total.size();++j) {
+      putFloat64(frame,total[j]/images);
+    }
+  } else {
+    ERR << "The shards have different numbers of distances, they normalise on their own" << endl;
+    putUint32(frame,0);
+  }
+
+  for(uint s=0;s<shards_.size();++s) {
+    if(!pending[s]) continue;
+    string f=frame;
+    if(!sendFrame(*c.shards[s].socket,f)) {
+      ERR << "Lost shard " << shards_[s].host << ":" << shards_[s].port << endl;
+      disconnect(c,s);
+      pending[s]=false;
+    }
+    sums[s].waiting=false;
+  }
+}
+
+void ShardCoordinator::exchange(uint32_t type, const string& payload, vector<Answer>& answers, int only) {
+  ProfileScope ps("ShardCoordinator::exchange");
+  Connections &c=connections();
+  const uint N=shards_.size();
+  const uint32_t id=++c.lastId;
+
+  string frame;
+  startFrame(frame,id,type);
+  frame+=payload;
+
+  answers.assign(N,Answer());
+  vector<bool> pending(N,false);
+  vector<Sums> sums(N);
+  for(uint s=0;s<N;++s) {
+    if((only>=0 && int(s)!=only) || !connect(c,s)) {
+      continue;
+    }
+    string f=frame;
+    if(!sendFrame(*c.shards[s].socket,f)) {
+      ERR << "Lost shard " << shards_[s].host << ":" << shards_[s].port << endl;
+      disconnect(c,s);
+      continue;
+    }
+    pending[s]=true;
+  }
+
+  double deadline=now()+timeout_/1000.0;
+  vector<struct pollfd> fds;
+  vector<uint> shardOf;
+  while(true) {
+    fds.clear();
+    shardOf.clear();
+    for(uint s=0;s<N;++s) {
+      if(pending[s]) {
+        struct pollfd p;
+        p.fd=c.shards[s].socket->socketPointer();
+        p.events=POLLIN;
+        p.revents=0;
+        fds.push_back(p);
+        shardOf.push_back(s);
+      }
+    }
+    if(fds.empty()) {
+      break;
+    }
+
+    const int remaining=int((deadline-now())*1000.0);
+    int ready=(remaining>0) ? poll(&fds[0],fds.size(),remaining) : 0;
+    if(ready<0 && errno==EINTR) {
+      continue;
+    }
+    if(ready<=0) {
+      // the shards that are too slow are left out. If others wait for
+      // the means they get them without the slow ones and some more time
+      bool waiting=false;
+      for(uint k=0;k<shardOf.size();++k) {
+        const uint s=shardOf[k];
+        if(!sums[s].waiting) {
+          ERR << "Shard " << shards_[s].host << ":" << shards_[s].port << " did not answer in time" << endl;
+          disconnect(c,s);
+          pending[s]=false;
+        } else {
+          waiting=true;
+        }
+      }
+      if(!waiting) {
+        break;
+      }
+      sendMeans(c,id,sums,pending);
+      deadline=now()+timeout_/1000.0;
+      continue;
+    }
+
+    for(uint k=0;k<fds.size();++k) {
+      if(fds[k].revents==0) continue;
+      const uint s=shardOf[k];
+      uint32_t answerId, status;
+      string data;
+      if(!receiveFrame(*c.shards[s].socket,answerId,status,data) || answerId!=id) {
+        ERR << "Lost shard " << shards_[s].host << ":" << shards_[s].port << endl;
+        disconnect(c,s);
+        pending[s]=false;
+        continue;
+      }
+      if(status==BINARY_NORMALIZE && data.size()>=8) {
+        const uint count=getUint32(data.data()+4);
+        if(data.size()!=8+8*size_t(count)) {
+          ERR << "Invalid normalisation request of shard " << shards_[s].host << ":" << shards_[s].port << endl;
+          disconnect(c,s);
+          pending[s]=false;
+          continue;
+        }
+        sums[s].waiting=true;
+        sums[s].images=getUint32(data.data());
+        sums[s].sums.resize(count);
+        for(uint j=0;j<count;++j) {
+          sums[s].sums[j]=getFloat64(data.data()+8+8*j);
+        }
+      } else {
+        answers[s].ok=true;
+        answers[s].status=status;
+        answers[s].payload=data;
+        pending[s]=false;
+      }
+    }
+    sendMeans(c,id,sums,pending);
+  }
+}
+
+void ShardCoordinator::exchangeText(const string& command, vector<Answer>& answers, int only) {
+  exchange(BINARY_TEXT,command,answers,only);
+  for(uint s=0;s<answers.size();++s) {
+    if(answers[s].ok && answers[s].status!=BINARY_OK) {
+      ERR << "Shard " << shards_[s].host << ":" << shards_[s].port << ": " << answers[s].payload << endl;
+      answers[s].ok=false;
+    }
+  }
+}
+
+string ShardCoordinator::retrieve(const vector<string>& tokens, const string& commandline) {
+  uint queriesStartFrom=1, resultsStep=0, nOfRanks=0;
+  if(tokens[0]=="expand") {
+    queriesStartFrom=2;
+    if(tokens.size()>1) resultsStep=atoi(tokens[1].c_str());
+  } else if(tokens[0]=="retrieveandsaveranks") {
+    queriesStartFrom=3;
+    if(tokens.size()>1) nOfRanks=atoi(tokens[1].c_str());
+  }
+
+  vector<string> positives, negatives;
+  for(uint i=queriesStartFrom;i<tokens.size();++i) {
+    if(tokens[i][0]=='-') {
+      negatives.push_back(tokens[i].substr(1));
+    } else if(tokens[i][0]=='+') {
+      positives.push_back(tokens[i].substr(1));
+    } else {
+      positives.push_back(tokens[i]);
+    }
+  }
+
+  // each shard gives as many results as may be shown (or saved)
+  const uint depth=max((resultsStep+1)*results_,nOfRanks);
+  string request;
+  putUint32(request,depth);
+  putUint32(request,positives.size());
+  putUint32(request,negatives.size());
+  for(uint i=0;i<positives.size();++i) putString(request,positives[i]);
+  for(uint i=0;i<negatives.size();++i) putString(request,negatives[i]);
+
+  vector<Answer> answers;
+  exchange(BINARY_SHARD_RETRIEVE,request,answers);
+
+  vector<NamedResult> results;
+  for(uint s=0;s<answers.size();++s) {
+    if(!answers[s].ok) continue;
+    const string& p=answers[s].payload;
+    if(answers[s].status!=BINARY_OK || p.size()<4) {
+      ERR << "Shard " << shards_[s].host << ":" << shards_[s].port << ": " << p << endl;
+      continue;
+    }
+    const uint count=getUint32(p.data());
+    size_t offset=4+8*size_t(count);
+    if(offset>p.size()) continue;
+    for(uint i=0;i<count;++i) {
+      NamedResult r;
+      r.first=getFloat64(p.data()+4+8*i);
+      if(!getString(p,offset,r.second)) break;
+      results.push_back(r);
+    }
+  }
+  stable_sort(results.begin(),results.end(),betterScore);
+
+  ostringstream os;
+  for(uint i=resultsStep*results_;i<(resultsStep+1)*results_ && i<results.size();++i) {
+    os << results[i].second << " " << results[i].first << " ";
+  }
+
+  if(tokens[0]=="retrieveandsaveranks" && tokens.size()>2) {
+    DBG(10) << "saving " << nOfRanks << " ranks to " << tokens[2] << endl;
+    ofstream ranks(tokens[2].c_str());
+    if(!ranks) { ERR << "Error opening logfile:" << tokens[2] << endl;}
+    ranks << "# " << commandline << endl;
+    for(uint i=0;i<nOfRanks && i<results.size();++i) {
+      ranks << i << " " << results[i].second << " " << results[i].first << endl;
+    }
+  }
+  return os.str();
+}
+
+string ShardCoordinator::textRetrieve(const vector<string>& tokens, const string& commandline) {
+  // the expand variants show the step-th page, which needs the pages
+  // before of all shards
+  const bool paged=(tokens[0]=="metaexpand" || tokens[0]=="textexpand");
+  const uint resultsStep=(paged && tokens.size()>1) ? atoi(tokens[1].c_str()) : 0;
+
+  vector<NamedResult> results;
+  string nothingFound;
+  vector<Answer> answers;
+  for(uint step=0;step<=resultsStep;++step) {
+    string command=commandline;
+    if(paged && tokens.size()>1) {
+      ostringstream oss;
+      oss << tokens[0] << " " << step << commandline.substr(commandline.find(tokens[1],tokens[0].size())+tokens[1].size());
+      command=oss.str();
+    }
+    exchangeText(command,answers);
+    for(uint s=0;s<answers.size();++s) {
+      if(!answers[s].ok) continue;
+      if(answers[s].payload=="nometainformation" || answers[s].payload=="notextinformation") {
+        nothingFound=answers[s].payload;
+      } else {
+        parseResults(answers[s].payload,results);
+      }
+    }
+  }
+  if(results.empty()) {
+    return nothingFound;
+  }
+  stable_sort(results.begin(),results.end(),betterScore);
+
+  ostringstream os;
+  for(uint i=resultsStep*results_;i<(resultsStep+1)*results_ && i<results.size();++i) {
+    os << results[i].second << " " << results[i].first << " ";
+  }
+  return os.str();
+}
+
+string ShardCoordinator::processCommand(const string& commandline, bool authorized) {
+  ProfileScope ps("ShardCoordinator::processCommand");
+  vector<string> tokens;
+  tokenize(commandline,tokens);
+  if(tokens.empty()) {
+    return "Unknown command: "+commandline;
+  }
+  const string& command=tokens[0];
+
+  if(command=="retrieve" || command=="expand" || command=="retrieveandsaveranks") {
+    return retrieve(tokens,commandline);
+  }
+  if(command=="metaretrieve" || command=="textretrieve" || command=="metaexpand" || command=="textexpand") {
+    return textRetrieve(tokens,commandline);
+  }
+
+  // the shards accept the settings from the coordinator, the client
+  // must be authorized here. Without arguments, they tell the syntax
+  // or what is available
+  string forward=commandline;
+  if(!authorized && (command=="setscoring" || command=="setextensions" || command=="setdist"
+                     || command=="setweight" || command=="filelist" || command=="setresults")) {
+    forward=command;
+  }
+
+  vector<Answer> answers;
+  exchangeText(forward,answers,command=="newfile" ? 0 : -1);
+  int first=-1;
+  for(uint s=0;s<answers.size() && first<0;++s) {
+    if(answers[s].ok) first=s;
+  }
+  if(first<0) {
+    return "no shard answered";
+  }
+
+  if(command=="info") {
+    // the size of the whole database
+    vector<string> info;
+    tokenize(answers[first].payload,info);
+    if(info.size()>1 && info[0]=="filelist") {
+      uint images=0;
+      for(uint s=0;s<answers.size();++s) {
+        vector<string> t;
+        tokenize(answers[s].payload,t);
+        if(answers[s].ok && t.size()>1) images+=atoi(t[1].c_str());
+      }
+      ostringstream os;
+      os << images;
+      info[1]=os.str();
+    }
+    ostringstream os;
+    for(uint i=0;i<info.size();++i) {
+      os << (i ? " " : "") << info[i];
+    }
+    return os.str();
+  } else if(command=="random") {
+    // as many as one shard gives, chosen from the images of all shards
+    vector<string> names, own;
+    tokenize(answers[first].payload,own);
+    for(uint s=0;s<answers.size();++s) {
+      if(answers[s].ok) tokenize(answers[s].payload,names);
+    }
+    random_shuffle(names.begin(),names.end());
+    ostringstream os;
+    for(uint i=0;i<own.size() && i<names.size();++i) {
+      os << names[i] << " ";
+    }
+    return os.str();
+  } else if(command=="listfiles") {
+    ostringstream os;
+    for(uint s=0;s<answers.size();++s) {
+      if(answers[s].ok) os << answers[s].payload;
+    }
+    return os.str();
+  }
+
+  if(command=="setresults" && authorized && tokens.size()==2) {
+    results_=atoi(tokens[1].c_str());
+  }
+  return answers[first].payload;
+}
@@ -0,0 +1,167 @@
+/*
+ This file is part of the FIRE -- Flexible Image Retrieval System
+
+ FIRE is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ FIRE is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with FIRE; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __coordinator_hpp__
+#define __coordinator_hpp__
+
+#include <string>
+#include <vector>
+#include <ctime>
+#include <stdint.h>
+#include <pthread.h>
+#include "diag.hpp"
+#include "net.hpp"
+
+/** ShardCoordinator: answers the commands of the server for a
+    database which is split into shards, each of which is served by a
+    fire server of its own. This replaces Python/fireproxyserver.py.
+
+    Each thread serving clients keeps its own connections to all
+    shards, which use the binary protocol (see server.hpp). A command
+    is sent to all shards at once and their answers are collected as
+    they arrive, so a query takes as long as the slowest shard, not as
+    long as all shards together. Shards which do not answer within
+    the timeout are dropped from the answer and reconnected for the
+    next command, shards which cannot be reached are tried again after
+    a few seconds.
+
+    The distances of a query are normalised by their means over the
+    database (see Retriever::getScores). A shard on its own would
+    normalise by the means over its images only and the scores of
+    different shards could not be compared. Thus, each shard sends the
+    sums of its distances to the coordinator before scoring and the
+    coordinator answers with the means over all shards once all of
+    them arrived. This happens for each query image and each filter
+    stage. Then, the best results of all shards are merged by their
+    scores.
+
+    retrieve, expand, retrieveandsaveranks, metaretrieve,
+    textretrieve, metaexpand and textexpand are merged this way,
+    info, random and listfiles combine the answers of all shards,
+    newfile goes to the first shard only. All other commands are sent
+    to all shards and answered by the first shard that answers.
+ */
+class ShardCoordinator {
+private:
+  struct Shard {
+    ::std::string host;
+    uint port;
+  };
+
+  /// the connection of one thread to one shard
+  struct Connection {
+    /// NULL if not connected
+    Socket *socket;
+    /// when to try to connect again after connecting failed
+    time_t retry;
+    Connection() : socket(NULL), retry(0) {}
+  };
+
+  /// the connections of one thread
+  struct Connections {
+    ::std::vector<Connection> shards;
+    uint32_t lastId;
+    Connections() : lastId(0) {}
+  };
+
+  /// the answer of one shard to one request
+  struct Answer {
+    /// false if the shard did not answer
+    bool ok;
+    uint32_t status;
+    ::std::string payload;
+    Answer() : ok(false), status(0) {}
+  };
+
+  /// the sums of the distances a shard sent to be normalised
+  struct Sums {
+    bool waiting;
+    uint images;
+    ::std::vector<double> sums;
+    Sums() : waiting(false), images(0) {}
+  };
+
+  ::std::vector<Shard> shards_;
+
+  /// how long to wait for the answers of the shards
+  uint timeout_;
+
+  /// the password the shards are configured with, if any
+  ::std::string password_;
+
+  /// the number of results of a query
+  uint results_;
+
+  /// the connections of the calling thread
+  pthread_key_t connectionsKey_;
+
+  /// Socket::connect looks up the host names, which is not reentrant
+  pthread_mutex_t connectLock_;
+
+  static void deleteConnections(void *connections);
+
+  Connections& connections();
+
+  /// connect to shard s unless connected already. Returns false if it
+  /// cannot be reached.
+  bool connect(Connections& c, uint s);
+
+  /// close the connection to shard s
+  void disconnect(Connections& c, uint s);
+
+  /// send the request to all shards (or only to shard only) and
+  /// collect their answers, answering their normalisation requests
+  void exchange(uint32_t type, const ::std::string& payload, ::std::vector<Answer>& answers, int only=-1);
+
+  /// exchange a text command, answers with errors are marked as not ok
+  void exchangeText(const ::std::string& command, ::std::vector<Answer>& answers, int only=-1);
+
+  /// answer the shards which wait for the means of their distances
+  /// once all shards that are still working wait
+  void sendMeans(Connections& c, uint32_t id, ::std::vector<Sums>& sums, ::std::vector<bool>& pending);
+
+  /// retrieve, expand and retrieveandsaveranks
+  ::std::string retrieve(const ::std::vector< ::std::string >& tokens, const ::std::string& commandline);
+
+  /// metaretrieve, textretrieve, metaexpand and textexpand
+  ::std::string textRetrieve(const ::std::vector< ::std::string >& tokens, const ::std::string& commandline);
+
+public:
+  ShardCoordinator();
+  ~ShardCoordinator();
+
+  /// set the shards from host:port[,host:port...]. Returns false if
+  /// the list is malformed.
+  bool setShards(const ::std::string& shards);
+
+  /// whether there are shards, i.e. the server is a coordinator
+  bool active() const {return !shards_.empty();}
+
+  /// the time in milliseconds to wait for the answers of the shards
+  void setTimeout(uint milliseconds) {timeout_=milliseconds;}
+
+  void setPassword(const ::std::string& password) {password_=password;}
+
+  void setResults(uint results) {results_=results;}
+
+  /// process a command of a client for all shards and return the
+  /// answer. commands changing the settings are only passed with
+  /// their arguments if the client is authorized.
+  ::std::string processCommand(const ::std::string& commandline, bool authorized);
+};
+
+#endif
@@ -17,6 +17,11 @@
 */
 #include <sstream>
 #include <algorithm>
+#include <limits>
+#include <sys/time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "database.hpp"
 #include "gzstream.hpp"
 #include "imagefeature.hpp"
@@ -29,6 +34,7 @@
 #include "largebinaryfeaturefile.hpp"
 #include "mpeg7feature.hpp"
 #include "histogramfeature.hpp"
+#include "compacthistogramfeature.hpp"
 #include "sparsehistogramfeature.hpp"
 #include "histogrampairfeature.hpp"
 #include "distancefilefeature.hpp"
@@ -53,6 +59,10 @@ void Database::clear() {
   	delete suffixBinFiles_[i];
   }
   suffixBinFiles_.clear();
+  for(uint i=0;i<compactStores_.size();++i) {
+    delete compactStores_[i];
+  }
+  compactStores_.clear();
 }
 
 uint Database::loadFileList(::std::string filelist) {
@@ -195,20 +205,30 @@ uint Database::loadFileList(::std::string filelist) {
 
 
 bool Database::loadQuery(const string& filename, ImageContainer *result) {
+  return loadQuery(filename, result, vector<BaseFeature*>());
+}
+
+bool Database::loadQuery(const string& filename, ImageContainer *result, const vector<BaseFeature*>& extracted) {
   bool featuresOK=true;
   for(uint j=0;j<numberOfSuffices();++j) {
-    string path=path_;
-    if(featuredirectories()) {
-      path+="/"+suffixList_[j];
+    if(j<extracted.size() && extracted[j]) {
+      FeatureSet *fs=new FeatureSet();
+      fs->add_feature(extracted[j]);
+      result->operator[](j)=fs;
+    } else {
+      string path=path_;
+      if(featuredirectories()) {
+        path+="/"+suffixList_[j];
+      }
+      //TODO: The feature loader returns a single BaseFeature to store in features_
+      // Change this so the feature loader appends to the associated feature collection instead
+      //result->operator[](j)=fl.load(filename,suffixList_[j],relevantSuffix(j),path);
+      result->operator[](j)=fl.load_set(filename,suffixList_[j],relevantSuffix(j),path);
     }
-    //TODO: The feature loader returns a single BaseFeature to store in features_
-    // Change this so the feature loader appends to the associated feature collection instead
-    //result->operator[](j)=fl.load(filename,suffixList_[j],relevantSuffix(j),path);
-    result->operator[](j)=fl.load_set(filename,suffixList_[j],relevantSuffix(j),path);
     // if partial loading is performed, the consistency can only be checked for features loaded at starteup
     uint partialLoadingSize =  binFilesNotToLoad_.size();
     if((partialLoadingSize==0) || (partialLoadingSize > 0 && j < partialLoadingSize &&  !binFilesNotToLoad_[j] ) ){
-      if(!checkConsistency(database_[j]->operator[](0),result->operator[](j))) {
+      if(!checkConsistency(database_[0]->operator[](j),result->operator[](j))) {
         featuresOK=false;
         DBG(10) << "loading feature " << j << ":"  << suffixList_[j] << ": features for " 
                 << "0:" << database_[0]->basename() << " and queryfeature " 
@@ -223,33 +243,74 @@ bool Database::loadQuery(const string& filename, ImageContainer *result) {
 //void Database::loadFeaturesForImage(int i) {
 //}
 
+namespace {
+  /// wall clock time in seconds, used to report the loading speed
+  double seconds() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec+tv.tv_usec*1e-6;
+  }
+}
+
 void Database::loadFeatures() {
   uint percent10=max(int(database_.size()/10),1);
   
   if(!largefeaturefiles_ && !largebinaryfeaturefiles_) { //old style: no large or large binary feature files
-    for(uint i=0;i<database_.size();++i) {
-      if(i%percent10==0) DBG(10) << i << " images loaded." << endl;
-      DBG(25) << "Loading features from " << i <<":'" << database_[i]->basename() << "'";
-      BLINK(30) << ": ";
-      for(uint j=0;j<suffixList_.size();++j) {
-        string path=path_;
-        if(featuredirectories_) {
-          path+="/"+suffixList_[j];
-        }
-        BLINK(30) << suffixList_[j] << " ";
-        DBG(20) << "loading " << path << "/" << database_[i]->basename() << " " << suffixList_[j] << "." << relevantSuffix(j) << endl;
+    // every feature is in a file of its own, thus loading is dominated
+    // by opening (and often decompressing) many small files. The
+    // images are loaded in parallel, suffix after suffix. Each thread
+    // only writes the feature sets of the images it loads, thus the
+    // database stays in the order of the filelist.
+#ifdef _OPENMP
+    int threads=(loadThreads_>0) ? int(loadThreads_) : omp_get_max_threads();
+#else
+    int threads=1;
+#endif
+    DBG(10) << "Loading features from single files using " << threads << " threads." << endl;
+    const long N=database_.size();
+    for(uint j=0;j<suffixList_.size();++j) {
+      string path=path_;
+      if(featuredirectories_) {
+        path+="/"+suffixList_[j];
+      }
+      const string relevant=relevantSuffix(j);
+      double start=seconds();
+
+      // the first image is the reference for the consistency check
+      // and therefore has to be there before the others are loaded
+      if(N>0) {
+        DBG(20) << "loading " << path << "/" << database_[0]->basename() << " " << suffixList_[j] << "." << relevant << endl;
+        database_[0]->operator[](j)=fl.load_set(database_[0]->basename(),suffixList_[j],relevant,path);
+      }
+
+      long loaded=(N>0) ? 1 : 0, frames=(N>0) ? database_[0]->operator[](j)->feature_count() : 0;
+#pragma omp parallel for schedule(dynamic,16) num_threads(threads) reduction(+:frames)
+      for(long i=1;i<N;++i) {
+        DBG(25) << "loading " << path << "/" << database_[i]->basename() << " " << suffixList_[j] << "." << relevant << endl;
         //TODO: The feature loader returns a single BaseFeature to store in features_
         // Change this so the feature loader appends to the associated feature collection instead
-        //database_[i]->operator[](j)=fl.load(database_[i]->basename(),suffixList_[j],relevantSuffix(j),path);
-        database_[i]->operator[](j)=fl.load_set(database_[i]->basename(),suffixList_[j],relevantSuffix(j),path);
+        FeatureSet *fs=fl.load_set(database_[i]->basename(),suffixList_[j],relevant,path);
+        database_[i]->operator[](j)=fs;
+        frames+=fs->feature_count();
         //TODO: Fix checkConsistency to work with feature sets
-        if(!checkConsistency(database_[0]->operator[](j), database_[i]->operator[](j))) {
+        if(!checkConsistency(database_[0]->operator[](j), fs)) {
+#pragma omp critical(databaseLog)
           DBG(10) << "loading feature " << j << ":"  << suffixList_[j] << ": features for " 
                   << "0:" << database_[0]->basename() << " and " 
                   <<  i <<":" << database_[i]->basename() << " are not consistent." << endl;
         }
+        long done;
+#pragma omp atomic capture
+        done=++loaded;
+        if(done%percent10==0) {
+#pragma omp critical(databaseLog)
+          DBG(10) << suffixList_[j] << ": " << done << " images loaded." << endl;
+        }
       }
-      BLINK(25) << endl;
+
+      double time=seconds()-start;
+      DBG(10) << "Loaded suffix " << suffixList_[j] << " for " << N << " images (" << frames << " features) in " 
+              << time << " s: " << ((time>0.0) ? double(N)/time : 0.0) << " images/s" << endl;
     }
   } else if(largefeaturefiles_) {   // large feature files
     for(uint j=0;j<suffixList_.size();++j) {
@@ -294,6 +355,8 @@ void Database::loadFeatures() {
 	// note that the lbff's aren't closed for reading !
       }
       else { // no partial loading
+        // the file is kept, features read from mapped files point into it
+        suffixBinFiles_.push_back(lbff);
         DBG(10) << "Loading all features for suffix " << suffixList_[j] << " from file " << filename << endl;
         for(uint i=0;i<database_.size();++i){
           if(!lbff->readNext(database_[i],j)){
@@ -311,9 +374,87 @@ void Database::loadFeatures() {
       } // end else
     } // end for
   } // end else
+  for(uint j=0;j<suffixList_.size() && j<compaction_.size();++j) {
+    if(compaction_[j]!=COMPACT_DOUBLE && (binFilesNotToLoad_.size()==0 || !binFilesNotToLoad_[j])) {
+      compact(j);
+    }
+  }
   DBG(10) <<  database_.size() <<" images in database." << endl;
 }
 
+void Database::setCompaction(uint j, CompactEncoding encoding) {
+  if(j>=compaction_.size()) {
+    compaction_.resize(j+1,COMPACT_DOUBLE);
+  }
+  compaction_[j]=encoding;
+}
+
+void Database::compact(uint j) {
+  // all features of the suffix have to be plain vectors or all
+  // histograms, of one size
+  size_t count=0;
+  uint dim=0;
+  FeatureType type=FT_VEC;
+  for(uint i=0;i<database_.size();++i) {
+    const FeatureSet* fs=database_[i]->operator[](j);
+    for(uint k=0;k<(fs ? fs->feature_count() : 1);++k) {
+      const VectorFeature* v=fs ? VectorFeature::dense((*fs)[k]) : NULL;
+      if(!v || (count>0 && (v->size()!=dim || v->type()!=type))) {
+        ERR << "Suffix " << suffixList_[j] << " is not held compactly: image " << i << " has no vector or histogram feature of the same size and type as the others." << endl;
+        return;
+      }
+      dim=v->size();
+      type=v->type();
+      ++count;
+    }
+  }
+  if(count==0 || count>=(size_t(1)<<32)) {
+    return;
+  }
+
+  CompactVectorStore* store=new CompactVectorStore(compaction_[j],dim,count);
+  vector<double> buffer(dim+1);
+  if(compaction_[j]==COMPACT_UINT8) {
+    vector<double> minimum(dim,numeric_limits<double>::max()), maximum(dim,-numeric_limits<double>::max());
+    for(uint i=0;i<database_.size();++i) {
+      const FeatureSet* fs=database_[i]->operator[](j);
+      for(uint k=0;k<fs->feature_count();++k) {
+        const double* v=static_cast<const VectorFeature*>((*fs)[k])->decoded(&buffer[0]);
+        for(uint d=0;d<dim;++d) {
+          minimum[d]=min(minimum[d],v[d]);
+          maximum[d]=max(maximum[d],v[d]);
+        }
+      }
+    }
+    store->setRange(minimum,maximum);
+  }
+
+  for(uint i=0;i<database_.size();++i) {
+    FeatureSet* fs=database_[i]->operator[](j);
+    for(uint k=0;k<fs->feature_count();++k) {
+      const VectorFeature* v=static_cast<const VectorFeature*>((*fs)[k]);
+      const uint idx=store->add(v->decoded(&buffer[0]));
+      BaseFeature* compact;
+      if(type==FT_HISTO) {
+        compact=new CompactHistogramFeature(store,idx,*static_cast<const HistogramFeature*>(v));
+      } else {
+        compact=new CompactVectorFeature(store,idx);
+      }
+      delete (*fs)[k];
+      (*fs)[k]=compact;
+    }
+  }
+
+  if(j>=compactStores_.size()) {
+    compactStores_.resize(j+1,NULL);
+  }
+  delete compactStores_[j];
+  compactStores_[j]=store;
+  DBG(10) << "Suffix " << suffixList_[j] << ": " << count << " vectors of dimension " << dim << " held as "
+          << CompactVectorStore::encodingName(compaction_[j]) << " in " << store->bytes()/1048576.0 << " MB ("
+          << count*dim*sizeof(double)/1048576.0 << " MB as double)" << endl;
+}
+
 bool Database::checkConsistency(const FeatureSet *ref_set, const FeatureSet *test_set) const {
   bool result=false;
   
@@ -630,14 +771,9 @@ bool Database::loadFromLBFF(const uint lbffidx,const vector<uint>& images){
   bool retrval=true;
   //get correct pointer
   LargeBinaryFeatureFile* lbff = suffixBinFiles_[lbffidx];
-  //get necessary information from the fileheader
-  long unsigned int stepsize = lbff->getFeaturesize(); 
   for(uint i=0;i<images.size();++i){
-    //seek to the correct position in the largebinaryfeaturefile
-    long unsigned int step = images[i] * stepsize;
-    lbff->seekreading(step);
-    //read the feature information
-    retrval = retrval && lbff->readNext(database_[images[i]],lbffidx);
+    //read the feature information of the images[i]-th image
+    retrval = retrval && lbff->read(database_[images[i]],lbffidx,images[i]);
   }
   return retrval;
 }
@@ -657,10 +793,8 @@ void Database::removeFeatureInformation(uint idx,vector<uint>& reallyLoaded){
   } // end for
   // now reset the read pointer of the largebinaryfeature file
   // i.e. move it right behind the end of the header information
-  // the seekreading function uses the headersize as base, therefore the 0
   // this is only neccessary to ensure that loadFromLBFF(uint) works correctly
-  long unsigned int seekpos = 0;  
-  suffixBinFiles_[idx]->seekreading(seekpos);
+  suffixBinFiles_[idx]->rewind();
 }
 
 const bool Database::binFilesNotToLoad(uint idx){
@@ -24,6 +24,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "diag.hpp"
 #include "featureloader.hpp"
 #include "largebinaryfeaturefile.hpp" 
+#include "compactvectorfeature.hpp"
 
 class Database {
 private:
@@ -72,6 +73,19 @@ private:
   /// the path to the type2bin file
   ::std::string t2bpath_;
 
+  /// how many threads are used to load the features of the
+  /// individual files. 0 means as many as OpenMP decides
+  uint loadThreads_;
+
+  /// per suffix: how the vectors are held in memory after loading
+  ::std::vector<CompactEncoding> compaction_;
+
+  /// the stores of the compactly held suffixes (NULL for the others)
+  ::std::vector<CompactVectorStore*> compactStores_;
+
+  /// move the vectors of suffix j into a CompactVectorStore as set by setCompaction
+  void compact(uint j);
+
   ///  a method that compares whether the two given feature sets are
   ///  consistent. returns true if they are, false otherwise. But true
   ///  is only a "probably true"
@@ -81,7 +95,7 @@ public:
 
 
   /// constructor
-  Database() : featuredirectories_(false), classes_(false), descriptions_(false), largefeaturefiles_(false), largebinaryfeaturefiles_(false), path_("") {}
+  Database() : featuredirectories_(false), classes_(false), descriptions_(false), largefeaturefiles_(false), largebinaryfeaturefiles_(false), path_(""), loadThreads_(0) {}
   ~Database();
 
 
@@ -92,6 +106,12 @@ public:
   /// given in single files
   bool loadQuery(const ::std::string& filename, ImageContainer *result);
 
+  /// like loadQuery, but the features of the suffixes for which
+  /// extracted holds a feature (it may be shorter than the number of
+  /// suffixes) are taken from there instead of from files. result
+  /// takes the ownership of these features.
+  bool loadQuery(const ::std::string& filename, ImageContainer *result, const ::std::vector<BaseFeature*>& extracted);
+
   /// return the idx-th ImageContainer object
   ImageContainer* operator[](uint idx) { return database_[idx]; }
 
@@ -122,8 +142,22 @@ public:
   /// TODO: document format of filelist
   uint loadFileList(::std::string filelist);
   
-  /// load the features specified by a previously loaded filelist
+  /// load the features specified by a previously loaded filelist.
+  /// if the features are given in single files, the images of each
+  /// suffix are loaded in parallel. The order of the database is not
+  /// affected by this.
   void loadFeatures();
+
+  /// set the number of threads used for loading single feature
+  /// files. 0 lets OpenMP decide.
+  void setLoadThreads(uint threads) { loadThreads_=threads; }
+  uint loadThreads() const { return loadThreads_; }
+
+  /// hold the vectors of suffix j as float or uint8 once they are
+  /// loaded by loadFeatures. Only for suffixes of plain vector
+  /// features or of histograms of equal size, features loaded later
+  /// (partial loading, added images) are held as doubles.
+  void setCompaction(uint j, CompactEncoding encoding);
  
   /// how many images are in this database
   uint size() const { return database_.size(); }
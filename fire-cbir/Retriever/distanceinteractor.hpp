@@ -53,6 +53,7 @@
 #include <string>
 #include <vector>
 #include <limits>
+#include "distancematrix.hpp"
 
 
 /** abstract base class for an interaction. given a distance vector it
@@ -70,6 +71,17 @@ public:
   /** this is the function that actually should analyse and modify
       distances */
   virtual void apply(::std::vector<double> & d)=0;
+
+  /** apply the interaction to all rows of a distance matrix. By
+      default each row is copied out, modified and copied back. */
+  virtual void apply(DistanceMatrix& d) {
+    ::std::vector<double> row;
+    for(uint n=0;n<d.rows();++n) {
+      d.getRow(n,row);
+      apply(row);
+      d.setRow(n,row);
+    }
+  }
 };
 
 
@@ -99,6 +111,25 @@ public:
       d[*i]=min;
     }
   }
+
+  /// column-wise version of apply
+  virtual void apply(DistanceMatrix& d) {
+    if(positions_.empty()) return;
+    uint N=d.rows();
+    double *first=d.column(positions_[0]);
+    for(uint k=1;k<positions_.size();++k) {
+      const double *c=d.column(positions_[k]);
+      for(uint n=0;n<N;++n) {
+        if(first[n]>c[n]) first[n]=c[n];
+      }
+    }
+    for(uint k=1;k<positions_.size();++k) {
+      double *c=d.column(positions_[k]);
+      for(uint n=0;n<N;++n) {
+        c[n]=first[n];
+      }
+    }
+  }
 };
 
 /** simple implementation of Interaction. Take the distances at the
@@ -127,6 +158,25 @@ public:
       d[*i]=max;
     }
   }
+
+  /// column-wise version of apply
+  virtual void apply(DistanceMatrix& d) {
+    if(positions_.empty()) return;
+    uint N=d.rows();
+    double *first=d.column(positions_[0]);
+    for(uint k=1;k<positions_.size();++k) {
+      const double *c=d.column(positions_[k]);
+      for(uint n=0;n<N;++n) {
+        if(first[n]<c[n]) first[n]=c[n];
+      }
+    }
+    for(uint k=1;k<positions_.size();++k) {
+      double *c=d.column(positions_[k]);
+      for(uint n=0;n<N;++n) {
+        c[n]=first[n];
+      }
+    }
+  }
 };
 
 /** simple implementation of Interaction. Take the distances at the
@@ -153,6 +203,25 @@ public:
       d[*i]=mul;
     }
   }
+
+  /// column-wise version of apply
+  virtual void apply(DistanceMatrix& d) {
+    if(positions_.empty()) return;
+    uint N=d.rows();
+    ::std::vector<double> mul(N,1.0);
+    for(uint k=0;k<positions_.size();++k) {
+      const double *c=d.column(positions_[k]);
+      for(uint n=0;n<N;++n) {
+        mul[n]*=c[n];
+      }
+    }
+    for(uint k=0;k<positions_.size();++k) {
+      double *c=d.column(positions_[k]);
+      for(uint n=0;n<N;++n) {
+        c[n]=mul[n];
+      }
+    }
+  }
 };
 
 
@@ -253,17 +322,10 @@ public:
   
 
   /// apply all defined actions to a given distance matrix.
-  void apply(::std::vector< ::std::vector<double> >& d) {
-    uint N=d.size();
-    //uint M=d[0].size();
-    
+  void apply(DistanceMatrix& d) {
     for(uint i=0;i<interactions_.size();++i) {
       DBG(10) << "Applying interaction " << i << ::std::endl;
-      Interaction* I=interactions_[i];
-      for(uint n=0;n<N;++n) {
-        
-        I->apply(d[n]);
-      }
+      interactions_[i]->apply(d);
     }
   }
 
@@ -203,11 +203,12 @@ BaseDistance* DistanceMaker::makeDistance(const DistanceType distType, const str
   }
 
   case DT_GLFD: {
-    string treename=getStringAfter(par,"TREE=","tree.kdt");
+    string treename=getStringAfter(par,"TREE=","tree.lfi");
     uint k=getIntAfter(par,"K=",10);
     double epsilon=getDoubleAfter(par,"EPS=",0.1);
+    uint checks=getIntAfter(par,"CHECKS=",256);
     
-    result=new GlobalLocalFeatureDistance(treename,k,epsilon);
+    result=new GlobalLocalFeatureDistance(treename,k,epsilon,checks);
     break;}
 
   case DT_MPEG7:{
@@ -243,7 +244,8 @@ BaseDistance* DistanceMaker::makeDistance(const DistanceType distType, const str
     break;
   }
   case DT_LFSIGEMD: {
-    result=new LFSignatureEMDistance();
+    double maxDistance=getDoubleAfter(par,"MAX=",0.0);
+    result=new LFSignatureEMDistance(maxDistance);
     break;
   }
   case DT_RAST: {
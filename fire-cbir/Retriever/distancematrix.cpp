@@ -0,0 +1,115 @@
+/*
+ This file is part of the FIRE -- Flexible Image Retrieval System
+
+ FIRE is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ FIRE is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with FIRE; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <cstdlib>
+#include "distancematrix.hpp"
+
+using namespace std;
+
+DistanceMatrix::DistanceMatrix(uint rows, uint cols) : data_(NULL), rows_(0), cols_(0), stride_(0), capacity_(0) {
+  resize(rows, cols);
+}
+
+DistanceMatrix::~DistanceMatrix() {
+  free(data_);
+}
+
+void DistanceMatrix::resize(uint rows, uint cols) {
+  const uint perLine=alignment/sizeof(double);
+  uint stride=(rows+perLine-1)/perLine*perLine;
+  size_t needed=size_t(stride)*cols;
+
+  if(needed>capacity_) {
+    free(data_);
+    data_=NULL;
+    void *mem=NULL;
+    if(posix_memalign(&mem, alignment, needed*sizeof(double))!=0) {
+      ERR << "Cannot allocate distance matrix of size " << rows << "x" << cols << endl;
+      exit(20);
+    }
+    data_=static_cast<double*>(mem);
+    capacity_=needed;
+  }
+  rows_=rows;
+  cols_=cols;
+  stride_=stride;
+}
+
+void DistanceMatrix::fill(double v) {
+  for(uint j=0;j<cols_;++j) {
+    double *c=column(j);
+    for(uint i=0;i<rows_;++i) {
+      c[i]=v;
+    }
+  }
+}
+
+void DistanceMatrix::normalizeColumns() {
+  long N=rows_;
+#pragma omp for schedule(static)
+  for(long j=0;j<long(cols_);++j) {
+    double *c=column(j);
+    double sum=0.0;
+    for(long i=0;i<N;++i) {
+      sum+=c[i];
+    }
+    sum/=double(N);
+    if(sum!=0.0) {
+      double tmp=1/sum;
+      for(long i=0;i<N;++i) {
+        c[i]*=tmp;
+      }
+    }
+  }
+}
+
+void DistanceMatrix::columnSums(vector<double>& sums) const {
+  sums.assign(cols_,0.0);
+  for(uint j=0;j<cols_;++j) {
+    const double *c=column(j);
+    double sum=0.0;
+    for(uint i=0;i<rows_;++i) {
+      sum+=c[i];
+    }
+    sums[j]=sum;
+  }
+}
+
+void DistanceMatrix::divideColumns(const vector<double>& divisors) {
+  for(uint j=0;j<cols_ && j<divisors.size();++j) {
+    if(divisors[j]!=0.0) {
+      double *c=column(j);
+      const double tmp=1/divisors[j];
+      for(uint i=0;i<rows_;++i) {
+        c[i]*=tmp;
+      }
+    }
+  }
+}
+
+void DistanceMatrix::getRow(uint i, vector<double>& row) const {
+  row.resize(cols_);
+  for(uint j=0;j<cols_;++j) {
+    row[j]=(*this)(i,j);
+  }
+}
+
+void DistanceMatrix::setRow(uint i, const vector<double>& row) {
+  for(uint j=0;j<cols_;++j) {
+    (*this)(i,j)=row[j];
+  }
+}
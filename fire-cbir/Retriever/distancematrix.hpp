@@ -0,0 +1,105 @@
+/*
+ This file is part of the FIRE -- Flexible Image Retrieval System
+
+ FIRE is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ FIRE is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with FIRE; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __distancematrix_hpp__
+#define __distancematrix_hpp__
+
+#include <vector>
+#include <cstddef>
+#include "diag.hpp"
+
+/** DistanceMatrix: the distances of one query to all database
+    images. There is one row per database image and one column per
+    distance (i.e. per suffix).
+
+    The matrix is stored column-major in one aligned block of memory,
+    that is the distances of all images for one suffix are contiguous.
+    Thus, the column-wise normalisation and the scoring can run over
+    plain arrays. The memory is kept when the matrix is resized to a
+    smaller or equal size, such that one matrix can be reused for all
+    queries.
+ */
+class DistanceMatrix {
+private:
+  /// the data, column j starts at data_+j*stride_
+  double *data_;
+
+  /// number of rows (database images)
+  uint rows_;
+
+  /// number of columns (distances)
+  uint cols_;
+
+  /// distance between the starts of two columns, rows_ rounded up
+  /// such that each column is aligned
+  uint stride_;
+
+  /// number of doubles allocated
+  size_t capacity_;
+
+  // not copyable
+  DistanceMatrix(const DistanceMatrix&);
+  DistanceMatrix& operator=(const DistanceMatrix&);
+
+public:
+  /// alignment of each column in bytes
+  static const uint alignment=64;
+
+  /// constructor
+  DistanceMatrix(uint rows=0, uint cols=0);
+
+  /// destructor
+  ~DistanceMatrix();
+
+  /// set the size of the matrix. memory is only allocated if the
+  /// current block is too small. the contents are undefined afterwards.
+  void resize(uint rows, uint cols);
+
+  /// set all entries to v
+  void fill(double v);
+
+  /// divide each column by its mean (if the mean is not 0). When
+  /// called from inside a parallel region, the columns are shared
+  /// among the threads.
+  void normalizeColumns();
+
+  /// the sum of each column
+  void columnSums(::std::vector<double>& sums) const;
+
+  /// divide each column by the given value (if it is not 0)
+  void divideColumns(const ::std::vector<double>& divisors);
+
+  uint rows() const {return rows_;}
+  uint cols() const {return cols_;}
+  uint stride() const {return stride_;}
+
+  /// the distances of all images for the j-th suffix
+  double* column(uint j) {return data_+size_t(j)*stride_;}
+  const double* column(uint j) const {return data_+size_t(j)*stride_;}
+
+  /// the j-th distance of the i-th image
+  double& operator()(uint i, uint j) {return data_[size_t(j)*stride_+i];}
+  const double& operator()(uint i, uint j) const {return data_[size_t(j)*stride_+i];}
+
+  /// copy the distances of the i-th image to row
+  void getRow(uint i, ::std::vector<double>& row) const;
+
+  /// set the distances of the i-th image from row
+  void setRow(uint i, const ::std::vector<double>& row);
+};
+
+#endif
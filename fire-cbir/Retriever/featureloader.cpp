@@ -31,6 +31,7 @@
 #include "pasannotation.hpp"
 #include "lfsignaturefeature.hpp"                   
 #include "lfposclusteridfeature.hpp"
+#include "profiler.hpp"
 
 #include <sstream>
 
@@ -183,6 +184,8 @@ FeatureSet* FeatureLoader::load_set(const ::std::string& basename, const ::std::
       feature->load(filename);
       DBG(35) << "Loaded from '" << filename << "'." << endl;
     }
+    Profiler::count("features/files");
+    Profiler::count("features/bytes", buffer.st_size);
     
     fs->add_feature(feature);
     i++;
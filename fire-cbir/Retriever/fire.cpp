@@ -86,6 +86,10 @@ void USAGE() {
        << "                              scoring of all previous computations; syntax:" << endl
        << "                              distanceID:amountToBeUsed-distanceID:amountToBeUsed" << endl
        << "                              example: 0:1000-3:500-2:20" << endl
+       << "                              several distances can be computed in one stage: 0,1,4:1000-3:20" << endl
+       << "                              auto:amount:amount... measures the costs of the distances and" << endl
+       << "                              computes the cheap ones on the whole database, the expensive ones" << endl
+       << "                              on the amount best images of the previous stage" << endl
        << "  -u,--dontload <featureindexsequence> only useable if also the -F/--filter option is used." << endl
        << "                              the first feature specified in the filtersequence following" << endl
        << "                              -F/--filter will always be loaded at startup. all features specified" << endl
@@ -99,6 +103,29 @@ void USAGE() {
        << "                              only usable when also -F/--filter is used otherwise ignored." << endl
        << " --cache <filename>           use sqlite cache from that file" << endl
        << "  -t,--type2bin <file>        override the type2bin-path set in the filelist" << endl
+       << " --loadthreads <n>            number of threads used to load features from single files" << endl
+       << "                              default: 0, i.e. as many as there are cores" << endl
+       << " --workers <n>                number of clients served at the same time (default: 4)" << endl
+       << "                              the cores are divided among them" << endl
+       << " --resultcache <n>            keep up to n results of recent queries (default: 1000000, 0: off)" << endl
+       << " --ann <suffix>:<probes>[:<lists>] compare queries only with the images in the <probes> nearest" << endl
+       << "                              lists of an approximate nearest neighbour index for this (vector" << endl
+       << "                              or histogram) suffix. more probes: better recall, slower queries." << endl
+       << "                              the index is read from <filelist>.<suffix>.ivf or built with" << endl
+       << "                              <lists> lists (default: sqrt of the database size) and saved there" << endl
+       << " --compact <suffix>:<encoding>[,<suffix>:<encoding>...] hold the vectors of these (vector" << endl
+       << "                              or histogram) suffixes as float or uint8 (quantised per" << endl
+       << "                              dimension) instead of double to save memory. distances become" << endl
+       << "                              slightly less exact" << endl
+       << " --profile <file>:<seconds>   write the profile (times of the query steps, comparisons per" << endl
+       << "                              distance, ...) to <file> every <seconds> seconds. the server" << endl
+       << "                              command \"profile\" shows it, \"profile reset|on|off\" controls it" << endl
+       << "                              (authorized connections only)" << endl
+       << " --shards <host>:<port>[,<host>:<port>...] coordinate these servers, each serving a part of" << endl
+       << "                              the database, instead of loading a filelist. queries are sent to" << endl
+       << "                              all of them at once and the results are merged" << endl
+       << " --shardtimeout <ms>          how long to wait for the shards, or as a shard for the coordinator" << endl
+       << "                              (default: 5000)" << endl
        << endl;
   exit(20);
 }
@@ -118,7 +145,7 @@ int main(int argc, char **argv)
 
   Server server;
 
-  vector<string> ufos=cl.unidentified_options(46,
+  vector<string> ufos=cl.unidentified_options(54,
                       "-h", "--help", "-c", "--config", "-s",//5
                       "--server", "-f", "--filelist", "-d", "--dist", //10
                       "-D", "--defaultdists", "-w", "--weight", "-r",//15
@@ -128,7 +155,9 @@ int main(int argc, char **argv)
                       "-P","--proxy","-B","--batch","-F", //35
                       "--filter","-u","--dontload","-U","--defdontload",//40
                                               "-t", "--type2bin","--cache","-q","--queryCombiner", //45
-                                              "--reRanker"); //46
+                                              "--reRanker","--loadthreads","--workers", //48
+                                              "--resultcache","--ann","--profile","--compact", //52
+                                              "--shards","--shardtimeout"); //54
 
   if(ufos.size()!=0)
   {
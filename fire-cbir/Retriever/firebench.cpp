@@ -0,0 +1,431 @@
+/*
+  This file is part of the FIRE -- Flexible Image Retrieval System
+  
+  FIRE is free software; you can redistribute it and/or modify it under
+  the terms of the GNU General Public License as published by the Free
+  Software Foundation; either version 2 of the License, or (at your
+  option) any later version. 
+  
+  FIRE is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+  for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with FIRE; if not, write to the Free Software Foundation, Inc.,
+  59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+/** firebench: measures the retrieval engine in-process, without the
+    network layer of the server.
+
+    The database is read from a filelist (-f, as for fire) or generated
+    synthetically (--synthetic). The queries are read from a log of the
+    server (lines "RECV: <command>") or drawn randomly from the
+    database, and are processed by several clients at the same time
+    just as fire would do it. The result is the throughput, the latency
+    percentiles and the profile (time per query step and per distance).
+    Additionally, each distance can be timed on its own (--micro).
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include "diag.hpp"
+#include "getpot.hpp"
+#include "server.hpp"
+#include "profiler.hpp"
+#include "vectorfeature.hpp"
+#include "histogramfeature.hpp"
+#include "sparsehistogramfeature.hpp"
+#include "localfeatures.hpp"
+
+using namespace std;
+
+void USAGE() {
+  cout << "USAGE: firebench [options] [fire options]" << endl
+       << "  -h,--help                   give help" << endl
+       << "  --synthetic <dir> <n> <types> generate a database of n images into dir (reused if" << endl
+       << "                              it was generated with the same parameters before) and" << endl
+       << "                              use it instead of -f. types is a comma separated list of" << endl
+       << "                              vec<dim>, histo<bins>, sparsehisto<steps> (3 dimensional)," << endl
+       << "                              lf<features>x<dim>. example: vec64,histo512,lf100x32" << endl
+       << "  --queries <logfile>         replay the queries (retrieve, expand, metaretrieve," << endl
+       << "                              textretrieve) of this server log or file of commands" << endl
+       << "  --random <n>                n random queries \"retrieve +<image>\" (default: 100)" << endl
+       << "  --seed <s>                  seed for the synthetic database and the random queries" << endl
+       << "  --threads <n>               number of clients querying at the same time (default: 1)" << endl
+       << "                              the cores are divided among them as in fire --workers" << endl
+       << "  --warmup <n>                process the first n queries once before measuring (default: 0)" << endl
+       << "  --micro <n>                 time each distance on its own for n queries against the" << endl
+       << "                              whole database (default: 0, i.e. no micro benchmark)" << endl
+       << "  --microdist <nr> <distname> additionally time distname on feature nr (repeatable)" << endl
+       << endl
+       << "  all options of fire which set up the retriever can be given (-f, -d, -D, -w, -F, -C," << endl
+       << "  --ann, ...). if no distance is given, -D is assumed, if no number of results is given," << endl
+       << "  -r 10. the result cache is off unless --resultcache is given." << endl
+       << endl
+       << "  output: one \"<key> <value>\" per line, followed by the profile" << endl
+       << endl;
+  exit(20);
+}
+
+/// one type of feature of the synthetic database
+struct SyntheticType {
+  ::std::string kind;
+  uint size, dim;
+};
+
+/// parse vec64,histo512,... into types, returns false on an unknown type
+bool parseSyntheticTypes(const string& spec, vector<SyntheticType>& types) {
+  istringstream iss(spec);
+  string item;
+  while(getline(iss,item,',')) {
+    SyntheticType t;
+    t.size=0; t.dim=1;
+    string::size_type digits=item.find_first_of("0123456789");
+    if(digits==string::npos) return false;
+    t.kind=item.substr(0,digits);
+    if(t.kind=="lf") {
+      if(sscanf(item.c_str()+digits,"%ux%u",&t.size,&t.dim)!=2) return false;
+    } else if(t.kind=="vec" || t.kind=="histo" || t.kind=="sparsehisto") {
+      t.size=atoi(item.c_str()+digits);
+    } else {
+      return false;
+    }
+    if(t.size==0 || t.dim==0) return false;
+    types.push_back(t);
+  }
+  return types.size()>0;
+}
+
+/// the suffix of the files of this type, e.g. lf100x32.lf.gz
+string syntheticSuffix(const SyntheticType& t) {
+  ostringstream oss;
+  oss << t.kind << t.size;
+  if(t.kind=="lf") oss << "x" << t.dim;
+  oss << "." << t.kind << ".gz";
+  return oss.str();
+}
+
+BaseFeature* makeSyntheticFeature(const SyntheticType& t, const string& basename) {
+  if(t.kind=="vec") {
+    VectorFeature* f=new VectorFeature(t.size);
+    for(uint i=0;i<t.size;++i) (*f)[i]=drand48();
+    return f;
+  } else if(t.kind=="histo") {
+    HistogramFeature* f=new HistogramFeature(t.size);
+    for(uint i=0;i<256;++i) f->feedbin(lrand48()%t.size);
+    return f;
+  } else if(t.kind=="sparsehisto") {
+    SparseHistogramFeature* f=new SparseHistogramFeature(vector<uint>(3,t.size),vector<double>(3,0.0),vector<double>(3,1.0));
+    SHPoint p(3);
+    for(uint i=0;i<256;++i) {
+      for(uint d=0;d<3;++d) p[d]=drand48();
+      f->feed(p);
+    }
+    return f;
+  } else {
+    LocalFeatures* f=new LocalFeatures();
+    f->filename()=basename;
+    f->dim()=t.dim;
+    f->imageSizeX()=256;
+    f->imageSizeY()=256;
+    vector<double> lf(t.dim);
+    for(uint i=0;i<t.size;++i) {
+      for(uint d=0;d<t.dim;++d) lf[d]=drand48();
+      FeatureExtractionPosition pos;
+      pos.x=lrand48()%256; pos.y=lrand48()%256; pos.s=8;
+      f->addLocalFeature(lf,pos);
+    }
+    return f;
+  }
+}
+
+/// write n images with features of the given types and their filelist
+/// into dir, returns the name of the filelist. The first line after the
+/// header records the parameters, if it matches, the files are reused.
+string makeSyntheticDatabase(const string& dir, uint n, const string& spec, long seed) {
+  vector<SyntheticType> types;
+  if(!parseSyntheticTypes(spec,types)) {
+    ERR << "Invalid synthetic feature types: " << spec << endl;
+    exit(20);
+  }
+
+  string filelist=dir+"/filelist";
+  ostringstream parameters;
+  parameters << "# synthetic " << n << " " << spec << " " << seed;
+
+  ifstream is(filelist.c_str());
+  string line;
+  if(getline(is,line) && line=="FIRE_filelist" && getline(is,line) && line==parameters.str()) {
+    DBG(10) << "Reusing synthetic database in " << dir << endl;
+    return filelist;
+  }
+
+  mkdir(dir.c_str(),0755);
+  ofstream os(filelist.c_str());
+  if(!os.good()) {
+    ERR << "Cannot write '" << filelist << "'." << endl;
+    exit(20);
+  }
+  os << "FIRE_filelist" << endl
+     << parameters.str() << endl
+     << "path this" << endl;
+  for(uint t=0;t<types.size();++t) {
+    os << "suffix " << syntheticSuffix(types[t]) << endl;
+  }
+
+  srand48(seed);
+  for(uint i=0;i<n;++i) {
+    ostringstream basename;
+    basename << "img";
+    basename.width(7); basename.fill('0');
+    basename << i;
+    for(uint t=0;t<types.size();++t) {
+      BaseFeature* f=makeSyntheticFeature(types[t],basename.str());
+      f->save(dir+"/"+basename.str()+"."+syntheticSuffix(types[t]));
+      delete f;
+    }
+    os << "file " << basename.str() << endl;
+  }
+  DBG(10) << "Generated synthetic database of " << n << " images in " << dir << endl;
+  return filelist;
+}
+
+/// the query commands of a server log or command file. Lines of the
+/// log look like "<date> <time> RECV: <command>"
+void readQueries(const string& filename, vector<string>& queries) {
+  ifstream is(filename.c_str());
+  if(!is.good()) {
+    ERR << "Cannot open '" << filename << "' for reading." << endl;
+    exit(20);
+  }
+  string line;
+  while(getline(is,line)) {
+    string::size_type pos=line.find("RECV: ");
+    if(pos!=string::npos) {
+      line=line.substr(pos+6);
+    }
+    string command;
+    istringstream iss(line);
+    iss >> command;
+    if(command=="retrieve" || command=="expand" || command=="metaretrieve" || command=="textretrieve") {
+      queries.push_back(line);
+    }
+  }
+}
+
+/// shared by the clients of one run
+struct BenchRun {
+  Server* server;
+  const vector<string>* queries;
+  uint threads;
+  uint next;
+  pthread_mutex_t lock;
+  vector<uint64_t> latencies;
+};
+
+void* benchClient(void* arg) {
+  BenchRun& run=*static_cast<BenchRun*>(arg);
+  omp_set_num_threads(max(1, omp_get_num_procs()/int(run.threads)));
+  bool authorized=true;
+  while(true) {
+    pthread_mutex_lock(&run.lock);
+    uint q=run.next++;
+    pthread_mutex_unlock(&run.lock);
+    if(q>=run.queries->size()) break;
+
+    string toClient;
+    uint64_t start=Profiler::now();
+    run.server->execute((*run.queries)[q],toClient,authorized);
+    run.latencies[q]=Profiler::now()-start;
+    DBG(20) << (*run.queries)[q] << " -> " << toClient << endl;
+  }
+  return NULL;
+}
+
+/// process all queries with threads clients, returns the seconds needed
+double runQueries(Server& server, const vector<string>& queries, uint threads, vector<uint64_t>& latencies) {
+  BenchRun run;
+  run.server=&server;
+  run.queries=&queries;
+  run.threads=threads;
+  run.next=0;
+  pthread_mutex_init(&run.lock,NULL);
+  run.latencies.resize(queries.size(),0);
+
+  uint64_t start=Profiler::now();
+  vector<pthread_t> clients(threads);
+  for(uint i=0;i<threads;++i) {
+    if(pthread_create(&clients[i],NULL,benchClient,&run)!=0) {
+      ERR << "Cannot start client thread" << endl;
+      exit(20);
+    }
+  }
+  for(uint i=0;i<threads;++i) {
+    pthread_join(clients[i],NULL);
+  }
+  double seconds=double(Profiler::now()-start)*1e-9;
+
+  pthread_mutex_destroy(&run.lock);
+  latencies.swap(run.latencies);
+  return seconds;
+}
+
+/// milliseconds of the p-th percentile of the sorted latencies
+double percentile(const vector<uint64_t>& sorted, double p) {
+  uint idx=min(uint(sorted.size()-1),uint(p*sorted.size()));
+  return double(sorted[idx])*1e-6;
+}
+
+/// time d on feature nr of the database for queries random query
+/// images, print the nanoseconds per comparison
+void microBenchmark(Database& db, uint nr, BaseDistance* d, uint queries) {
+  vector<const BaseFeature*> features;
+  for(uint i=0;i<db.size();++i) {
+    const FeatureSet* fs=(*db[i])[nr];
+    if(fs && fs->feature_count()>0 && (*fs)[0]) features.push_back((*fs)[0]);
+  }
+  if(features.empty()) {
+    DBG(10) << "No features loaded for distance " << nr << ", skipping micro benchmark" << endl;
+    return;
+  }
+
+  vector<double> result(features.size());
+  uint64_t nanoseconds=0, comparisons=0;
+  for(uint q=0;q<queries;++q) {
+    const BaseFeature* query=features[lrand48()%features.size()];
+    d->start(query);
+    uint64_t start=Profiler::now();
+    d->distances(query,&features[0],features.size(),&result[0]);
+    nanoseconds+=Profiler::now()-start;
+    comparisons+=features.size();
+    d->stop();
+  }
+  cout << "micro " << nr << ":" << d->name()
+       << " comparisons " << comparisons
+       << " ns_per_comparison " << double(nanoseconds)/double(comparisons) << endl;
+}
+
+int main(int argc, char **argv)
+{
+  GetPot cl(argc,argv);
+
+  if(cl.search(2,"-h","--help")) {
+    USAGE();
+  }
+
+  long seed=cl.follow(1,"--seed");
+
+  // the synthetic database and the default distances are passed to the
+  // server as if they were given on the command line
+  vector<string> args(argv,argv+argc);
+  if(cl.search("--synthetic")) {
+    string dir=cl.follow("synthetic","--synthetic");
+    uint n=cl.next(1000);
+    string spec=cl.next("vec64");
+    args.push_back("-f");
+    args.push_back(makeSyntheticDatabase(dir,n,spec,seed));
+  }
+  if(!cl.search(4,"-d","--dist","-D","--defaultdists")) {
+    args.push_back("-D");
+  }
+  if(!cl.search(2,"-r","--results")) {
+    args.push_back("-r");
+    args.push_back("10");
+  }
+  vector<char*> argp;
+  for(uint i=0;i<args.size();++i) argp.push_back(const_cast<char*>(args[i].c_str()));
+  GetPot config(argp.size(),&argp[0]);
+  if(config.search(2,"-c","--config")) {
+    GetPot cf(config.follow("config.pot",2,"-c","--config"));
+    config.absorb(cf);
+  }
+
+  Server server;
+  server.parseConfig(config);
+  if(!config.search("--resultcache")) {
+    server.retriever().resultCache().setCapacity(0);
+  }
+  server.initialize();
+  Retriever& retriever=server.retriever();
+  if(retriever.database().size()==0) {
+    ERR << "Empty database, use -f or --synthetic" << endl;
+    exit(20);
+  }
+
+  srand48(seed);
+  vector<string> queries;
+  if(cl.search("--queries")) {
+    readQueries(cl.follow("queries.txt","--queries"),queries);
+  } else {
+    uint n=cl.follow(100,"--random");
+    for(uint i=0;i<n;++i) {
+      queries.push_back("retrieve +"+retriever.database().filename(lrand48()%retriever.database().size()));
+    }
+  }
+  uint threads=max(1,cl.follow(1,"--threads"));
+  uint warmup=min(uint(queries.size()),uint(max(0,cl.follow(0,"--warmup"))));
+
+  cout << "images " << retriever.database().size() << endl;
+  for(uint i=0;i<retriever.imageComparator().size();++i) {
+    if(retriever.dist(i)) cout << "distance " << i << " " << retriever.dist(i)->name() << endl;
+  }
+
+  if(queries.size()>0) {
+    vector<uint64_t> latencies;
+    if(warmup>0) {
+      vector<string> first(queries.begin(),queries.begin()+warmup);
+      runQueries(server,first,threads,latencies);
+    }
+
+    Profiler::reset();
+    double seconds=runQueries(server,queries,threads,latencies);
+    sort(latencies.begin(),latencies.end());
+    double total=0.0;
+    for(uint i=0;i<latencies.size();++i) total+=double(latencies[i])*1e-6;
+
+    cout << "queries " << queries.size() << endl
+         << "threads " << threads << endl
+         << "seconds " << seconds << endl
+         << "queries_per_second " << double(queries.size())/seconds << endl
+         << "latency_ms_mean " << total/latencies.size() << endl
+         << "latency_ms_p50 " << percentile(latencies,0.5) << endl
+         << "latency_ms_p90 " << percentile(latencies,0.9) << endl
+         << "latency_ms_p99 " << percentile(latencies,0.99) << endl
+         << "latency_ms_max " << double(latencies.back())*1e-6 << endl
+         << Profiler::report() << endl;
+  } else {
+    DBG(10) << "No queries" << endl;
+  }
+
+  uint micro=cl.follow(0,"--micro");
+  if(micro>0) {
+    for(uint i=0;i<retriever.imageComparator().size();++i) {
+      if(retriever.dist(i)) microBenchmark(retriever.database(),i,retriever.dist(i),micro);
+    }
+    DistanceMaker distanceMaker;
+    cl.init_multiple_occurrence();
+    while(cl.search("--microdist")) {
+      uint nr=cl.follow(0,"--microdist");
+      string distname=cl.next("basedist");
+      if(nr>=retriever.numberOfSuffices()) {
+        ERR << "No feature " << nr << " for --microdist " << distname << endl;
+        continue;
+      }
+      BaseDistance* d=distanceMaker.makeDistance(distname);
+      d->initialize(retriever.database(),nr);
+      microBenchmark(retriever.database(),nr,d,micro);
+      delete d;
+    }
+  }
+}
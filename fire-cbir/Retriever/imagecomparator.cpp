@@ -19,65 +19,181 @@ using namespace std;
 
 #include "imagecomparator.hpp"
 #include "diag.hpp"
+#include "profiler.hpp"
 #include <iostream>
 #include <csignal>
 #include <sstream>
+#include <pthread.h>
 
 using namespace std;
 
-ImageComparator::ImageComparator() : distances_(0), cacheActive_(false)
+namespace {
+  /// the last generation of distances given to a comparator
+  uint lastGeneration=0;
+
+  uint nextGeneration() {
+    uint result;
+#pragma omp critical(imageComparatorGeneration)
+    result=++lastGeneration;
+    return result;
+  }
+
+  pthread_key_t sessionKey;
+  pthread_once_t sessionOnce=PTHREAD_ONCE_INIT;
+
+  void deleteSession(void *session) {
+    delete static_cast<ImageComparator::Session*>(session);
+  }
+
+  void createSessionKey() {
+    if(pthread_key_create(&sessionKey, deleteSession)!=0) {
+      ERR << "Cannot create thread specific comparator session" << endl;
+      exit(20);
+    }
+  }
+
+  /// the session of the calling thread, NULL if it has none yet
+  ImageComparator::Session* threadSession() {
+    pthread_once(&sessionOnce, createSessionKey);
+    return static_cast<ImageComparator::Session*>(pthread_getspecific(sessionKey));
+  }
+}
+
+ImageComparator::Session::~Session() {
+  clear();
+}
+
+void ImageComparator::Session::clear() {
+  for(uint i=0;i<copies_.size();++i) {
+    delete copies_[i];
+  }
+  copies_.clear();
+  cachedQuery_.clear();
+  cachedDistances_.clear();
+  newDistances_.clear();
+}
+
+#ifdef HAVE_SQLITE3
+ImageComparator::ImageComparator() : distances_(0), generation_(nextGeneration()), sqliteDB_(NULL), selectStmt_(NULL), lookupStmt_(NULL), insertStmt_(NULL), cacheActive_(false), concurrent_(0)
+{}
+
+ImageComparator::ImageComparator(uint size)  :distances_(size), generation_(nextGeneration()), sqliteDB_(NULL), selectStmt_(NULL), lookupStmt_(NULL), insertStmt_(NULL), cacheActive_(false), concurrent_(size, true) {};
+#else
+ImageComparator::ImageComparator() : distances_(0), generation_(nextGeneration()), cacheActive_(false), concurrent_(0)
 {}
 
-ImageComparator::ImageComparator(uint size)  :distances_(size), cacheActive_(false) {};
+ImageComparator::ImageComparator(uint size)  :distances_(size), generation_(nextGeneration()), cacheActive_(false), concurrent_(size, true) {};
+#endif
 
 void ImageComparator::initialize(Database &db) {
   for(uint i=0;i<distances_.size();++i) {
     distances_[i]->initialize(db,i);
   }
+  renew();
 }
 
 
 ImageComparator::~ImageComparator() {
+  // the names of the distances are needed to write the cache
+  if(cacheActive_) closeCache();
   for(uint i=0;i<distances_.size();++i) {
     delete distances_[i];
   }
-  if(cacheActive_) closeCache();
+}
+
+void ImageComparator::renew() {
+  generation_=nextGeneration();
+}
+
+ImageComparator::Session& ImageComparator::session() const {
+  Session *session=threadSession();
+  if(!session) {
+    session=new Session();
+    pthread_setspecific(sessionKey, session);
+  }
+  if(session->comparator_!=this || session->generation_!=generation_) {
+    session->clear();
+    session->comparator_=this;
+    session->generation_=generation_;
+    session->copies_.resize(distances_.size(), NULL);
+    for(uint i=0;i<distances_.size();++i) {
+      if(distances_[i] && !distances_[i]->reentrant()) {
+        session->copies_[i]=distances_[i]->clone();
+      }
+    }
+  }
+  return *session;
+}
+
+bool ImageComparator::concurrent() const {
+  for(uint i=0;i<concurrent_.size();++i) {
+    if(!concurrent_[i]) return false;
+  }
+  return true;
+}
+
+BaseDistance* ImageComparator::distance(Session& session, uint idx) const {
+  if(idx<session.copies_.size() && session.copies_[idx]) {
+    return session.copies_[idx];
+  }
+  return distances_[idx];
+}
+
+BaseDistance* ImageComparator::queryDistance(uint idx) const {
+  return distance(session(), idx);
 }
 
 void ImageComparator::start(const ImageContainer *query) {
   //TODO: Start only on first frame... does this work for every distance function?
+  Session& s=session();
   for(uint i=0;i<distances_.size();++i) {
-    distances_[i]->start((*query)[i]->operator[](0));
+    distance(s, i)->start((*query)[i]->operator[](0));
+    if(cacheActive_) readCache(s, query, i);
   }
 }
 
 void ImageComparator::start(const ImageContainer *query, uint distanceID) {
   if (distanceID < distances_.size()) {
-    distances_[distanceID]->start((*query)[distanceID]->operator[](0));
+    Session& s=session();
+    distance(s, distanceID)->start((*query)[distanceID]->operator[](0));
+    if(cacheActive_) readCache(s, query, distanceID);
   }
 }
 
 vector<double> ImageComparator::compare(const ImageContainer *queryImage, const ImageContainer* databaseImage) {
   vector<double> result(distances_.size());
   DBG(35) << "Comparing " << queryImage->basename() << " with " << databaseImage->basename() << endl;
+  Session& s=session();
   for(uint i=0;i<distances_.size();++i) {
-    result[i]=this->compare(queryImage, databaseImage,i);
+    result[i]=this->compare(s, queryImage, databaseImage,i);
     //result[i]=distances_[i]->distance((*queryImage)[i],(*databaseImage)[i]);
   }
   return result;
 }
 
 double ImageComparator::compare(const ImageContainer *queryImage, const ImageContainer *databaseImage, const uint distanceID) {
+  return compare(session(), queryImage, databaseImage, distanceID);
+}
+
+double ImageComparator::compare(Session& session, const ImageContainer *queryImage, const ImageContainer *databaseImage, const uint distanceID) {
   if (distanceID >= distances_.size()) { ERR << "distanceID larger than distances_.size " << endl; }
   
   DBG(35) << "Comparing " << queryImage->basename() << " with " << databaseImage->basename() << " with regard to distance "<< distances_[distanceID]->name() <<endl;
   
-  double cache_d,result;
-#ifdef HAVE_SQLITE3
-  if(cacheActive_ and getFromCache(databaseImage->basename(), queryImage->basename(), distances_[distanceID]->name(),cache_d)) {
-    result=cache_d;
-  } else {
-#endif
+  double result;
+  // the distances of the started query were read in start(), other
+  // comparisons (e.g. between database images) ask the cache directly
+  const bool started=cacheActive_ && queryImage->basename()==session.cachedQuery_;
+  if(started && lookup(session, distanceID, databaseImage->basename(), result)) {
+    return result;
+  }
+  if(cacheActive_ && !started) {
+    bool found;
+#pragma omp critical(imageComparatorCache)
+    found=getFromCache(databaseImage->basename(), queryImage->basename(), distances_[distanceID]->name(), result);
+    if(found) return result;
+  }
+  {
     //result = distances_[distanceID]->distance((*queryImage)[distanceID],(*databaseImage)[distanceID]);
     
     const uint Q = (*queryImage)[distanceID]->feature_count();
@@ -91,7 +207,7 @@ double ImageComparator::compare(const ImageContainer *queryImage, const ImageCon
       double score_min = 0.;
       bool set = false;
       for (uint d = 0; d < D; ++d) {
-        double score = distances_[distanceID]->distance((*queryImage)[distanceID]->operator[](q),(*databaseImage)[distanceID]->operator[](d));
+        double score = distance(session, distanceID)->distance((*queryImage)[distanceID]->operator[](q),(*databaseImage)[distanceID]->operator[](d));
         scores_per_query_frame[d][q] = score;
         if (score < score_min || d == 0)
           score_min = score;
@@ -112,33 +228,122 @@ double ImageComparator::compare(const ImageContainer *queryImage, const ImageCon
     DBG(25) << "Q = " << queryImage->basename() << " ScoreQ " << score_Q / Q << " D = " << databaseImage->basename() << " ScoreD " << score_D / D << endl;
     result = (score_Q / Q + score_D / D) / 2.;
     
-#ifdef HAVE_SQLITE3
-    if(cacheActive_) { setInCache(databaseImage->basename(), queryImage->basename(), distances_[distanceID]->name(),result); }
+    if(started) {
+      remember(session, distanceID, databaseImage->basename(), result);
+    } else if(cacheActive_) {
+#pragma omp critical(imageComparatorCache)
+      setInCache(databaseImage->basename(), queryImage->basename(), distances_[distanceID]->name(),result);
+    }
   }
-#endif
   return result;
 }
 
+void ImageComparator::compare(const ImageContainer *queryImage, const Database& database, uint from, uint to, DistanceMatrix& result) {
+  compare(session(), queryImage, database, from, to, result);
+}
+
+void ImageComparator::compare(Session& session, const ImageContainer *queryImage, const Database& database, uint from, uint to, DistanceMatrix& result) {
+  vector<uint> rows;
+  rows.reserve(to-from);
+  for(uint i=from;i<to;++i) {
+    rows.push_back(i);
+  }
+  if(rows.empty()) return;
+  for(uint j=0;j<distances_.size();++j) {
+    compare(session, queryImage, database, j, &rows[0], rows.size(), result.column(j));
+  }
+}
+
+void ImageComparator::compare(const ImageContainer *queryImage, const Database& database, uint distanceID,
+                              const uint* rows, uint count, double* column) {
+  compare(session(), queryImage, database, distanceID, rows, count, column);
+}
+
+void ImageComparator::compare(Session& session, const ImageContainer *queryImage, const Database& database, uint distanceID,
+                              const uint* rows, uint count, double* column) {
+  const uint64_t start=Profiler::now();
+  compareRows(session, queryImage, database, distanceID, rows, count, column);
+  if(Profiler::enabled()) {
+    ostringstream name;
+    name << "distance/" << distanceID << ":" << distances_[distanceID]->name() << "/";
+    Profiler::count(name.str()+"comparisons", count);
+    Profiler::count(name.str()+"nanoseconds", Profiler::now()-start);
+  }
+}
+
+void ImageComparator::compareRows(Session& session, const ImageContainer *queryImage, const Database& database, uint distanceID,
+                                  const uint* rows, uint count, double* column) {
+  const bool started=cacheActive_ && queryImage->basename()==session.cachedQuery_;
+  const FeatureSet *queryFeatures=(*queryImage)[distanceID];
+
+  // animations and queries whose cache was not read take the long way
+  if((cacheActive_ && !started) or queryFeatures->feature_count()!=1) {
+    for(uint k=0;k<count;++k) {
+      column[rows[k]]=compare(session, queryImage, database[rows[k]], distanceID);
+    }
+    return;
+  }
+
+  vector<const BaseFeature*> features;
+  vector<uint> batchRows;
+  features.reserve(count);
+  batchRows.reserve(count);
+  for(uint k=0;k<count;++k) {
+    const uint i=rows[k];
+    if(started && lookup(session, distanceID, database[i]->basename(), column[i])) {
+      continue;
+    }
+    const FeatureSet *dbFeatures=(*database[i])[distanceID];
+    if(dbFeatures->feature_count()==1) {
+      features.push_back((*dbFeatures)[0]);
+      batchRows.push_back(i);
+    } else {
+      column[i]=compare(session, queryImage, database[i], distanceID);
+    }
+  }
+
+  if(features.size()>0) {
+    vector<double> dists(features.size());
+    distance(session, distanceID)->distances((*queryFeatures)[0], &features[0], features.size(), &dists[0]);
+    for(uint k=0;k<batchRows.size();++k) {
+      column[batchRows[k]]=dists[k];
+      if(started) remember(session, distanceID, database[batchRows[k]]->basename(), dists[k]);
+    }
+  }
+}
+
 void ImageComparator::stop() {
+  Session& s=session();
   for(uint i=0;i<distances_.size();++i) {
-    distances_[i]->stop();
+    distance(s, i)->stop();
   }
+  if(cacheActive_) writeCache(s, distances_.size());
 }
 
 void ImageComparator::stop(uint distanceID) {
   if(distanceID < distances_.size())
   {
-    distances_[distanceID]->stop();
+    Session& s=session();
+    distance(s, distanceID)->stop();
+    if(cacheActive_) writeCache(s, distanceID);
   }
 }
 
 void ImageComparator::distance(const uint& idx, BaseDistance* d) {
   if(distances_.size() < idx+1) {
     distances_.resize(idx+1);
+    concurrent_.resize(idx+1, true);
   }
   if(d!=distances_[idx]) {delete distances_[idx];}
 
   distances_[idx]=d;
+  concurrent_[idx]=true;
+  if(d && !d->reentrant()) {
+    BaseDistance *copy=d->clone();
+    concurrent_[idx]=(copy!=NULL);
+    delete copy;
+  }
+  renew();
 }
 
 BaseDistance *ImageComparator::distance(const uint& idx) const {
@@ -162,10 +367,24 @@ void ImageComparator::openCache() {
     ERR << "Cannot open cache database in file '" << cacheFileName_ << "'." << endl;
     ERR << "Ignoring and continuing without..." << endl;
     sqlite3_close(sqliteDB_);
-  } else {
-    DBG(10) << "Database successfully opened." << endl;
-    cacheActive_=true;
+    sqliteDB_=NULL;
+    return;
+  }
+  createTable();
+  if(sqlite3_prepare_v2(sqliteDB_, "select dbimg, dist from cache where qimg=?1 and distfct=?2;", -1, &selectStmt_, NULL)!=SQLITE_OK or
+     sqlite3_prepare_v2(sqliteDB_, "select dist from cache where qimg=?1 and distfct=?2 and dbimg=?3;", -1, &lookupStmt_, NULL)!=SQLITE_OK or
+     sqlite3_prepare_v2(sqliteDB_, "insert or replace into cache (dbimg, qimg, distfct, dist) values (?1, ?2, ?3, ?4);", -1, &insertStmt_, NULL)!=SQLITE_OK) {
+    ERR << "Cannot prepare cache statements: " << sqlite3_errmsg(sqliteDB_) << endl;
+    ERR << "Ignoring and continuing without..." << endl;
+    sqlite3_finalize(selectStmt_); selectStmt_=NULL;
+    sqlite3_finalize(lookupStmt_); lookupStmt_=NULL;
+    sqlite3_finalize(insertStmt_); insertStmt_=NULL;
+    sqlite3_close(sqliteDB_);
+    sqliteDB_=NULL;
+    return;
   }
+  DBG(10) << "Database successfully opened." << endl;
+  cacheActive_=true;
 #else
   cacheActive_=false;
 #warning "SQLite distance caching will not be avilable"
@@ -174,63 +393,140 @@ void ImageComparator::openCache() {
 
 void ImageComparator::closeCache() {
 #ifdef HAVE_SQLITE3
+  // the distances computed by other threads were written when their queries stopped
+  Session *session=threadSession();
+  if(cacheActive_ && session && session->comparator_==this) writeCache(*session, distances_.size());
+  sqlite3_finalize(selectStmt_); selectStmt_=NULL;
+  sqlite3_finalize(lookupStmt_); lookupStmt_=NULL;
+  sqlite3_finalize(insertStmt_); insertStmt_=NULL;
   sqlite3_close(sqliteDB_);
+  sqliteDB_=NULL;
 #endif
+  cacheActive_=false;
 }
 
 void ImageComparator::createTable() {
-  string create="create table cache(dbimg varchar, qimg varchar, distfct varchar, dist double);";
-  string createindex="create index dbimgidx on cache (dbimg,qimg,dist);";
+#ifdef HAVE_SQLITE3
+  // a cached distance is found by query, distance function and database
+  // image, each of them is stored once
+  string create="create table if not exists cache(dbimg varchar, qimg varchar, distfct varchar, dist double);";
+  string createindex="create unique index if not exists cachekey on cache (qimg,distfct,dbimg);";
+  char *zErrMsg=0;
+  if(sqlite3_exec(sqliteDB_,create.c_str(),NULL,NULL,&zErrMsg)!=SQLITE_OK) {
+    ERR << "SQL error: " << zErrMsg << endl;
+    sqlite3_free(zErrMsg); zErrMsg=0;
+  }
+  if(sqlite3_exec(sqliteDB_,createindex.c_str(),NULL,NULL,NULL)!=SQLITE_OK) {
+    // caches written by older versions may hold a distance several
+    // times, only the last one is kept
+    DBG(10) << "Removing duplicate distances from the cache." << endl;
+    string dedup="delete from cache where rowid not in (select max(rowid) from cache group by qimg,distfct,dbimg);";
+    if(sqlite3_exec(sqliteDB_,(dedup+createindex).c_str(),NULL,NULL,&zErrMsg)!=SQLITE_OK) {
+      ERR << "SQL error: " << zErrMsg << endl;
+      sqlite3_free(zErrMsg);
+    }
+  }
+#endif
 }
 
+void ImageComparator::readCache(Session& session, const ImageContainer *query, uint idx) {
+  if(query->basename()!=session.cachedQuery_) {
+    // a new query: forget the distances read for the previous one
+    writeCache(session, distances_.size());
+    session.cachedQuery_=query->basename();
+    session.cachedDistances_.clear();
+  }
+  session.cachedDistances_.resize(distances_.size());
+  map<string,double> &table=session.cachedDistances_[idx];
+  table.clear();
 #ifdef HAVE_SQLITE3
-static int callbackInsert(void *, int argc, char **argv, char **azColName){
-  int i;
-  for(i=0; i<argc; i++){ printf("%s = %s\n", azColName[i], argv[i] ? argv[i] : "NULL"); }
-  printf("\n");
-  return 0;
-}
+  const string distname=distances_[idx]->name();
+  // the statements are shared by the sessions of all threads
+#pragma omp critical(imageComparatorCache)
+  {
+    sqlite3_bind_text(selectStmt_, 1, session.cachedQuery_.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(selectStmt_, 2, distname.c_str(), -1, SQLITE_TRANSIENT);
+    int rc;
+    while((rc=sqlite3_step(selectStmt_))==SQLITE_ROW) {
+      const char *dbimg=(const char*)sqlite3_column_text(selectStmt_, 0);
+      if(dbimg) table[dbimg]=sqlite3_column_double(selectStmt_, 1);
+    }
+    if(rc!=SQLITE_DONE) {
+      ERR << "SQL error: " << sqlite3_errmsg(sqliteDB_) << endl;
+    }
+    sqlite3_reset(selectStmt_);
+  }
+  DBG(20) << "Read " << table.size() << " cached distances " << distname << " for " << session.cachedQuery_ << endl;
 #endif
+}
 
+void ImageComparator::writeCache(Session& session, uint idx) {
 #ifdef HAVE_SQLITE3
-static int callbackDistance(void *dist, int argc, char **argv, char **azColName) {
-  int i;
-
-  double v;
-  if(argc!=1) { DBG(10) << "Found " << argc << " distances for this combination of (dbimg,qimg,dist)" << endl; }
-  for(i=0; i<argc; i++){
-    if(string(azColName[i])==string("dist")) {
-      std::istringstream iss(argv[i]);
-      iss >> v;
+  vector< pair< uint, pair< string, double > > > &newDistances=session.newDistances_;
+  if(newDistances.empty()) return;
+
+  vector<string> names(distances_.size());
+  for(uint i=0;i<distances_.size();++i) names[i]=distances_[i]->name();
+
+  uint written=0, kept=0;
+#pragma omp critical(imageComparatorCache)
+  {
+    sqlite3_exec(sqliteDB_, "begin transaction;", NULL, NULL, NULL);
+    for(uint k=0;k<newDistances.size();++k) {
+      const uint i=newDistances[k].first;
+      if(idx<distances_.size() && i!=idx) {
+        newDistances[kept++]=newDistances[k];
+        continue;
+      }
+      sqlite3_bind_text(insertStmt_, 1, newDistances[k].second.first.c_str(), -1, SQLITE_STATIC);
+      sqlite3_bind_text(insertStmt_, 2, session.cachedQuery_.c_str(), -1, SQLITE_STATIC);
+      sqlite3_bind_text(insertStmt_, 3, names[i].c_str(), -1, SQLITE_STATIC);
+      sqlite3_bind_double(insertStmt_, 4, newDistances[k].second.second);
+      if(sqlite3_step(insertStmt_)!=SQLITE_DONE) {
+        ERR << "SQL error: " << sqlite3_errmsg(sqliteDB_) << endl;
+      } else {
+        ++written;
+      }
+      sqlite3_reset(insertStmt_);
     }
-    *((double*)dist)=v;
-    DBG(50) << VAR(v) << endl;
+    sqlite3_exec(sqliteDB_, "commit transaction;", NULL, NULL, NULL);
   }
-  return 0;
-}
+  newDistances.resize(kept);
+  DBG(20) << "Wrote " << written << " distances for " << session.cachedQuery_ << " to the cache" << endl;
+  if(idx<session.cachedDistances_.size()) session.cachedDistances_[idx].clear();
+  else session.cachedDistances_.clear();
 #endif
+}
+
+bool ImageComparator::lookup(const Session& session, uint idx, const string& dbimg, double &dist) const {
+  if(idx>=session.cachedDistances_.size()) return false;
+  map<string,double>::const_iterator it=session.cachedDistances_[idx].find(dbimg);
+  if(it==session.cachedDistances_[idx].end()) return false;
+  dist=it->second;
+  return true;
+}
+
+void ImageComparator::remember(Session& session, uint idx, const string& dbimg, double dist) {
+  // called from the threads comparing the database images in parallel
+#pragma omp critical(imageComparatorSession)
+  session.newDistances_.push_back(make_pair(idx, make_pair(dbimg, dist)));
+}
 
 bool ImageComparator::getFromCache(const std::string& dbimg, const std::string &qimg, const std::string& distname, double &dist) {
 #ifdef HAVE_SQLITE3
-  //string query="select dist from cache where dbimg=\"asdf\" and qimg=\"sdfg\" and distfct=\"idm\";";
- 
-  ostringstream oss;
-  oss << "select dist from cache where dbimg=\"" << dbimg << "\" and qimg=\"" << qimg << "\" and distfct=\"" << distname << "\";";
- 
-  string query=oss.str();
-  char *zErrMsg=0;
-  double distFromDB=-1000;
-  int rc=sqlite3_exec(sqliteDB_,query.c_str(),callbackDistance,&distFromDB,&zErrMsg);
-  if( rc!=SQLITE_OK ){
-    ERR << "SQL error: " << zErrMsg << endl;
-    sqlite3_free(zErrMsg);
-  } 
-  dist=distFromDB;
-  DBG(50) << "cache ->" << VAR(distFromDB) << endl;
-
-  return dist>-1;
+  if(!cacheActive_) return false;
+  bool found=false;
+  sqlite3_bind_text(lookupStmt_, 1, qimg.c_str(), -1, SQLITE_TRANSIENT);
+  sqlite3_bind_text(lookupStmt_, 2, distname.c_str(), -1, SQLITE_TRANSIENT);
+  sqlite3_bind_text(lookupStmt_, 3, dbimg.c_str(), -1, SQLITE_TRANSIENT);
+  if(sqlite3_step(lookupStmt_)==SQLITE_ROW) {
+    dist=sqlite3_column_double(lookupStmt_, 0);
+    found=true;
+  }
+  sqlite3_reset(lookupStmt_);
+  DBG(50) << "cache ->" << VAR(found) << endl;
+  return found;
 #else
-#warning "Caching SQLite distance caching will not be avilable"
   return false;
 #endif
 }
@@ -239,28 +535,22 @@ bool ImageComparator::setInCache(const std::string& dbimg, const std::string &qi
 #ifdef HAVE_SQLITE3
   DBG(50) << "-> cache" << endl;
   if(cacheActive_) {  
-    // string query="insert into cache (\"asdf\",\"sdfg\",\"idm\",7.8);";
-    ostringstream oss;
-    oss << "insert into cache values(\"" << dbimg << "\",\"" << qimg << "\",\"" << distname << "\","<<dist<<");";
-    string query=oss.str(); 
-    double distFromDB;
-    char *zErrMsg=0;
-
-
-    int rc=sqlite3_exec(sqliteDB_,query.c_str(),callbackInsert,&distFromDB,&zErrMsg);
-    if( rc!=SQLITE_OK ){
-      ERR << "SQL error: " << zErrMsg << endl;
-      sqlite3_free(zErrMsg);
+    sqlite3_bind_text(insertStmt_, 1, dbimg.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(insertStmt_, 2, qimg.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(insertStmt_, 3, distname.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_double(insertStmt_, 4, dist);
+    int rc=sqlite3_step(insertStmt_);
+    sqlite3_reset(insertStmt_);
+    if(rc!=SQLITE_DONE) {
+      ERR << "SQL error: " << sqlite3_errmsg(sqliteDB_) << endl;
       return false;
     } 
     return true;
-  
   } else {
     ERR << "Caching not active... not saved " << endl;
     return false;
   }
 #else
-#warning "Caching SQLite distance caching will not be avilable"
   return false;
 #endif
 
@@ -269,10 +559,11 @@ bool ImageComparator::setInCache(const std::string& dbimg, const std::string &qi
 void ImageComparator::tuneDistances(const vector<ImageContainer*>& posQueries, const vector<ImageContainer*>& negQueries) {
   //TODO: Distance tuning only adjusts on the first frame. This may not be correct...
   DBG(10) << "Tuning distances" << endl;  
+  Session& s=session();
   for(uint i=0;i<distances_.size();++i) {
     vector<const BaseFeature*> posFeat(posQueries.size()), negFeat(negQueries.size());
     for(uint n=0;n<posQueries.size();++n) {posFeat[n]=(*posQueries[n]->operator[](0))[i];}
     for(uint n=0;n<negQueries.size();++n) {negFeat[n]=(*negQueries[n]->operator[](0))[i];}    
-    distances_[i]->tune(posFeat,negFeat);
+    distance(s, i)->tune(posFeat,negFeat);
   }
 }
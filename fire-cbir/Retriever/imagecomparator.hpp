@@ -19,10 +19,12 @@ along with FIRE; if not, write to the Free Software Foundation, Inc.,
 #ifndef __imagecomparator_hpp__
 #define __imagecomparator_hpp__
 
+#include <map>
 #include "basedistance.hpp"
 #include "imagecontainer.hpp"
 #include "diag.hpp"
 #include "database.hpp"
+#include "distancematrix.hpp"
 #ifdef HAVE_SQLITE3
 extern "C" {
 #include <sqlite3.h>
@@ -34,16 +36,91 @@ extern "C" {
  * retrieval process.  That is: The distances used are stored here.
  */
 class ImageComparator {
+public:
+  /** what a thread needs for the queries it compares: copies of the
+   * distances which are not reentrant (see BaseDistance::clone) and
+   * the cached distances of its query. Each thread has a session of
+   * its own, so that the queries of several threads can be compared
+   * at the same time. The threads of an OpenMP region all work for the
+   * query of the thread which started the region and are passed its
+   * session.
+   */
+  class Session {
+    friend class ImageComparator;
+  public:
+    Session() : comparator_(NULL), generation_(0) {}
+    ~Session();
+  private:
+    Session(const Session&);
+    Session& operator=(const Session&);
+
+    /// delete the copies and forget the cached distances
+    void clear();
+
+    /// the comparator and its distances the copies were made for
+    const ImageComparator* comparator_;
+    uint generation_;
+
+    /// the copy of each distance, NULL where the distance itself is used
+    ::std::vector<BaseDistance*> copies_;
+
+    /// the name of the query started last. For this query, the cached
+    /// distances are read in start() and the new ones are written in stop()
+    ::std::string cachedQuery_;
+
+    /// for each distance function the cached distances of cachedQuery_
+    /// to the database images, indexed by the database image name
+    ::std::vector< ::std::map< ::std::string, double > > cachedDistances_;
+
+    /// distances computed for cachedQuery_ which are not yet in the cache:
+    /// distance function index, database image name, distance
+    ::std::vector< ::std::pair< uint, ::std::pair< ::std::string, double > > > newDistances_;
+  };
+
 private:
   /** the distances used */
   ::std::vector<BaseDistance*> distances_;
 
+  /// changed whenever a distance is set or initialized, the sessions
+  /// of older generations make new copies of the distances
+  uint generation_;
+
   ::std::string cacheFileName_;
 #ifdef HAVE_SQLITE3
   sqlite3 *sqliteDB_;
+  /// prepared statements to read all cached distances of a query for
+  /// one distance function, to read a single distance and to insert one
+  sqlite3_stmt *selectStmt_, *lookupStmt_, *insertStmt_;
 #endif
   bool cacheActive_;
 
+  /// whether each distance is reentrant or can be copied for the sessions
+  ::std::vector<bool> concurrent_;
+
+  /// start a new generation of the distances
+  void renew();
+
+  /// the idx-th distance as used in the session
+  BaseDistance* distance(Session& session, uint idx) const;
+
+  /// read all cached distances of query for the idx-th distance function
+  void readCache(Session& session, const ImageContainer *query, uint idx);
+
+  /// write the new distances of the idx-th distance function (or of
+  /// all if idx is size()) in one transaction
+  void writeCache(Session& session, uint idx);
+
+  /// compare() for a list of rows without counting it in the profile
+  void compareRows(Session& session, const ImageContainer* queryImage, const Database& database, uint distanceID,
+                   const uint* rows, uint count, double* column);
+
+  /// look up the distance between the cached query of the session and
+  /// the named database image. returns false if it is not cached
+  bool lookup(const Session& session, uint idx, const ::std::string& dbimg, double &dist) const;
+
+  /// remember a distance of the cached query to be written in stop()
+  void remember(Session& session, uint idx, const ::std::string& dbimg, double dist);
+
 public:
 
   ///default constructor
@@ -61,13 +138,34 @@ public:
   /// return the idx-th distance
   BaseDistance *distance(const uint& idx) const;
 
-  /// functions related to caching distances in sqlite
+  /// functions related to caching distances in sqlite. The cached
+  /// distances of a query are read at once in start(), the ones
+  /// computed are written in one transaction in stop().
   void setCache(const std::string& cachefile);
   void openCache();
   void closeCache();
 
+  /// whether distances are cached
+  bool cacheActive() const {return cacheActive_;}
+
+  /// the session of the calling thread, with copies of the current
+  /// distances
+  Session& session() const;
+
+  /// whether queries can be compared by several threads at the same
+  /// time, i.e. each distance is reentrant or can be copied
+  bool concurrent() const;
+
+  /// the idx-th distance as used for the query of the calling thread:
+  /// its copy in the session if it is not reentrant
+  BaseDistance* queryDistance(uint idx) const;
+
+  /// read or write a single distance, for comparisons of images which
+  /// are not the started query
   bool getFromCache(const std::string& dbimg, const std::string &qimg, const std::string& distname, double &dist);
   bool setInCache(const std::string& dbimg, const std::string &qimg, const std::string& distname, const double &dist);
+
+  /// create the cache table and its index if they do not exist
   void createTable();
 
   ///  how many distances  do we have?
@@ -109,5 +207,34 @@ public:
   /// return the distance valie for two images and distanceID given.
   double compare(const ImageContainer* queryImage, 
                  const ImageContainer* databaseImage,const uint distanceID);
+
+  /// the same for the query of the given session
+  double compare(Session& session, const ImageContainer* queryImage,
+                 const ImageContainer* databaseImage, const uint distanceID);
+
+  /// compare the query image with the database images from..to-1 and
+  /// write the distances to the rows from..to-1 of result. For
+  /// single-frame images the batch interface of the distances is
+  /// used, all other comparisons are done by compare() above.
+  void compare(const ImageContainer* queryImage, const Database& database,
+               uint from, uint to, DistanceMatrix& result);
+
+  /// the same for the query of the given session, for the threads of
+  /// an OpenMP region
+  void compare(Session& session, const ImageContainer* queryImage, const Database& database,
+               uint from, uint to, DistanceMatrix& result);
+
+  /// compare the query image with the count database images given in
+  /// rows with respect to the distanceID-th distance and write the
+  /// distances to the same rows of column. Used by the filter stages
+  /// which only look at some of the database images. The comparisons
+  /// and their time are counted per distance in the profile.
+  void compare(const ImageContainer* queryImage, const Database& database, uint distanceID,
+               const uint* rows, uint count, double* column);
+
+  /// the same for the query of the given session, for the threads of
+  /// an OpenMP region
+  void compare(Session& session, const ImageContainer* queryImage, const Database& database, uint distanceID,
+               const uint* rows, uint count, double* column);
 };
 #endif
@@ -26,10 +26,122 @@ Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
 #include "histogramfeature.hpp"
 #include "sparsehistogramfeature.hpp"
 #include "histogrampairfeature.hpp"
+#include "mappedvectorfeature.hpp"
+#include "mappedhistogramfeature.hpp"
+#include "profiler.hpp"
+#include <cstring>
+#include <streambuf>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace std;
 
-LargeBinaryFeatureFile::LargeBinaryFeatureFile(string filename){
+namespace {
+
+  /// the header of B_FORMAT_MAPPED files, see largebinaryfeaturefile.hpp
+  struct MappedHeader {
+    char magic[28];
+    uint32_t format;
+    uint32_t suffixtype;
+    uint32_t reserved;
+    uint64_t numsaved;
+    uint64_t indexOffset;
+    uint64_t namesOffset;
+  };
+
+  const char MAPPED_MAGIC[28] = "FIRE_mappedfeaturefile";
+
+  /// records (and the values in them) start at multiples of this
+  const uint64_t RECORD_ALIGNMENT = 64;
+
+  /// write what the system holds of the file to the disk, such that
+  /// it survives a crash of the machine. The streams writing it have
+  /// to be flushed before.
+  bool syncToDisk(const string& filename) {
+    int fd=open(filename.c_str(), O_RDONLY);
+    if(fd<0) {
+      return false;
+    }
+    bool ok=(fsync(fd)==0);
+    close(fd);
+    return ok;
+  }
+
+  inline uint64_t alignUp(uint64_t pos, uint64_t alignment) {
+    return (pos+alignment-1)/alignment*alignment;
+  }
+
+  /// write zeros up to the next multiple of alignment
+  void pad(ostream& os, uint64_t alignment) {
+    uint64_t pos=os.tellp();
+    for(uint64_t i=pos;i<alignUp(pos,alignment);++i) {
+      os.put(0);
+    }
+  }
+
+  /// an istream buffer reading from memory, used to parse the records
+  /// of the features which can't be mapped using their readBinary
+  class MemoryBuffer : public streambuf {
+  public:
+    MemoryBuffer(const char* data, size_t size) {
+      char *p=const_cast<char*>(data);
+      setg(p, p, p+size);
+    }
+  };
+
+  /// store feat as the (first) frame of the j-th feature of img
+  void setFeature(ImageContainer *img, uint j, BaseFeature* feat) {
+    FeatureSet*& set=img->operator[](j);
+    if(!set) {
+      set=new FeatureSet();
+    }
+    if(set->feature_count()==0) {
+      set->add_feature(feat);
+    } else {
+      set->operator[](0)=feat;
+    }
+  }
+
+  /// create an empty feature of the given type for readBinary
+  BaseFeature* newFeature(FeatureType type) {
+    BaseFeature* feat = NULL;
+    switch(type){
+    case FT_VEC: feat = new VectorFeature(); break;
+    case FT_BINARY: feat = new BinaryFeature(); break;
+      //  case FT_DISTFILE: feat = new DistanceFileFeature(); break;
+      //  case FT_FACEFEAT: feat = new FaceFeature(); break;
+    case FT_IMG: feat = new ImageFeature(); break;
+      //  case FT_OLDHISTO: // depreciated
+    case FT_HISTO: feat = new HistogramFeature(); break;
+    case FT_SPARSEHISTO: feat = new SparseHistogramFeature(); break;
+      //    case FT_HISTOPAIR: feat = new HistogramPairFeature(); break;
+      //	  case FT_LF: feat = new LocalFeatures(); break;
+      //	  case FT_LFPOSCLSIDFEAT: feat = new LFPositionClusterIdFeature(); break;
+      //	  case FT_LFSIGNATURE: feat = new LFSignatureFeature(); break;
+      //	  case FT_MPEG7: feat = new MPEG7Feature(); break;
+      //	  case FT_META: feat = new MetaFeature(); break;
+      //	  case FT_TEXT_EN:
+      //	  case FT_TEXT_FR:
+      //	  case FT_TEXT_GE:
+      //	  case FT_TEXT: feat = new TextFeature(); break;
+      //	  case FT_PASCALANNOTATION: feat = new PascalAnnotationFeature(); break;
+      // not yet implemented
+    case FT_GABOR:
+    case FT_BLOBS:
+    case FT_REGIONS:
+      ERR << "This feature type is not yet implemented: " << type << endl;
+      break;
+    default:
+      ERR << "This feature type is not yet known: " << type << endl;
+    }
+    return feat;
+  }
+}
+
+LargeBinaryFeatureFile::LargeBinaryFeatureFile(string filename) : format_(B_FORMAT_STREAMED), map_(NULL), mapSize_(0), index_(NULL), names_(NULL), namesSize_(0), next_(0), journaled_(0) {
   ifs_.open(filename.c_str(),ios::in | ios::binary);
   if(!ifs_.good() || !ifs_){
     ERR << "Cannot open LargeBinaryFeatureFile '" <<filename  << "'. Aborting." << endl;
@@ -39,10 +151,15 @@ LargeBinaryFeatureFile::LargeBinaryFeatureFile(string filename){
     writing_ = false;
     loaded_ = false;
     char magic[28];
-    
+
     // read the MagicNumber
     ifs_.read(magic,sizeof(char[28]));
-    if(strcmp(magic,"FIRE_largebinaryfeaturefile")!= 0){
+    if(ifs_.good() && strncmp(magic,MAPPED_MAGIC,sizeof(char[28]))==0) {
+      ifs_.close();
+      map(filename);
+      return;
+    }
+    if(strncmp(magic,"FIRE_largebinaryfeaturefile",sizeof(char[28]))!= 0){
       ERR << filename << " is not a FIRE_largefeaturefile. Aborting" << endl;
       exit(20);
     }
@@ -64,12 +181,27 @@ LargeBinaryFeatureFile::LargeBinaryFeatureFile(string filename){
   } // end else
 }
 
-LargeBinaryFeatureFile::LargeBinaryFeatureFile(string filename, uint suffixtype, unsigned long int numsaved, unsigned long int featuresize,bool differ,uint filenamelength){
-  
+LargeBinaryFeatureFile::LargeBinaryFeatureFile(string filename, uint suffixtype, unsigned long int numsaved, unsigned long int featuresize,bool differ,uint filenamelength, uint format) :
+  format_(format), map_(NULL), mapSize_(0), index_(NULL), names_(NULL), namesSize_(0), next_(0), journaled_(0) {
+
   ofs_.open(filename.c_str(),ios::out|ios::binary);
   if(!ofs_.good()){
     ERR << "Cannot open LargeBinaryFeatureFile '" << filename << "' for writing. Aborting!" << endl;
     exit(20);
+  } else if(format_==B_FORMAT_MAPPED) {
+    reading_ = false;
+    suffixtype_=suffixtype;
+    numsaved_=numsaved;
+    featuresize_=0;
+    filenamesize_=0;
+    differ_=false;
+    writeIndex_.reserve(3*numsaved);
+    // the header is written by closeWriting, when the offsets are known
+    MappedHeader header;
+    memset(&header,0,sizeof(header));
+    ofs_.write((char*)&header,sizeof(header));
+    writing_ = true;
+    loaded_= false;
   } else {
     reading_ = false;
     // write MagicNumber
@@ -95,9 +227,166 @@ LargeBinaryFeatureFile::LargeBinaryFeatureFile(string filename, uint suffixtype,
     writing_ = true;
     loaded_= false;
   }  
-} 
+}
+
+LargeBinaryFeatureFile::~LargeBinaryFeatureFile() {
+  if(map_) {
+    munmap(const_cast<char*>(map_), mapSize_);
+  }
+}
+
+void LargeBinaryFeatureFile::map(const string& filename) {
+  format_=B_FORMAT_MAPPED;
+  int fd=open(filename.c_str(), O_RDONLY);
+  struct stat st;
+  if(fd<0 || fstat(fd,&st)!=0) {
+    ERR << "Cannot open LargeBinaryFeatureFile '" << filename << "'. Aborting." << endl;
+    exit(20);
+  }
+  mapSize_=st.st_size;
+  void *mem=MAP_FAILED;
+  if(mapSize_>=sizeof(MappedHeader)) {
+    // MAP_SHARED: all processes serving this file share the page cache
+    mem=mmap(NULL, mapSize_, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if(mem==MAP_FAILED) {
+    ERR << "Cannot map LargeBinaryFeatureFile '" << filename << "'. Aborting." << endl;
+    exit(20);
+  }
+  map_=static_cast<const char*>(mem);
+
+  MappedHeader header;
+  memcpy(&header, map_, sizeof(header));
+  if(header.format!=B_FORMAT_MAPPED) {
+    ERR << filename << " has the unsupported format version " << header.format << ". Aborting" << endl;
+    exit(20);
+  }
+  suffixtype_=header.suffixtype;
+  numsaved_=header.numsaved;
+  featuresize_=0;
+  filenamesize_=0;
+  differ_=false;
+  if(header.indexOffset%sizeof(uint64_t)!=0 || header.indexOffset>mapSize_ ||
+     (mapSize_-header.indexOffset)/(3*sizeof(uint64_t))<numsaved_ || header.namesOffset>mapSize_) {
+    ERR << filename << " is truncated or corrupt. Aborting" << endl;
+    exit(20);
+  }
+  index_=reinterpret_cast<const uint64_t*>(map_+header.indexOffset);
+  names_=map_+header.namesOffset;
+  namesSize_=mapSize_-header.namesOffset;
+  next_=0;
+  DBG(10) << "mapped " << filename << ": " << VAR(suffixtype_) << " " << VAR(numsaved_) << " " << VAR(mapSize_) << endl;
+}
+
+BaseFeature* LargeBinaryFeatureFile::mappedFeature(unsigned long int idx) const {
+  uint64_t offset=index_[3*idx], size=index_[3*idx+1];
+  if(offset<sizeof(MappedHeader) || offset>mapSize_ || size>mapSize_-offset) {
+    ERR << "Record " << idx << " exceeds the mapped file." << endl;
+    return NULL;
+  }
+  const char *record=map_+offset;
+
+  if(suffixtype_==FT_VEC || suffixtype_==FT_HISTO) {
+    uint32_t descSize=0, n=0;
+    if(size>=2*sizeof(uint32_t)) {
+      memcpy(&descSize, record, sizeof(uint32_t));
+      memcpy(&n, record+sizeof(uint32_t), sizeof(uint32_t));
+    }
+    uint64_t valuesOffset=alignUp(offset+2*sizeof(uint32_t)+descSize, RECORD_ALIGNMENT)-offset;
+    uint64_t needed=valuesOffset+uint64_t(n)*sizeof(double);
+    if(suffixtype_==FT_HISTO) needed+=uint64_t(n)*sizeof(uint);
+    if(size<2*sizeof(uint32_t) || needed>size) {
+      ERR << "Record " << idx << " is corrupt." << endl;
+      return NULL;
+    }
+    const double *values=reinterpret_cast<const double*>(record+valuesOffset);
+    if(suffixtype_==FT_VEC) {
+      return new MappedVectorFeature(values, n);
+    }
+
+    // the description of the histogram: dim, counter, steps, min, max
+    const char *desc=record+2*sizeof(uint32_t);
+    uint32_t dim=0, counter=0;
+    if(descSize>=2*sizeof(uint32_t)) {
+      memcpy(&dim, desc, sizeof(uint32_t));
+      memcpy(&counter, desc+sizeof(uint32_t), sizeof(uint32_t));
+    }
+    if(descSize!=2*sizeof(uint32_t)+uint64_t(dim)*(sizeof(uint32_t)+2*sizeof(double))) {
+      ERR << "Record " << idx << " is corrupt." << endl;
+      return NULL;
+    }
+    desc+=2*sizeof(uint32_t);
+    vector<uint> steps(dim);
+    vector<double> min(dim), max(dim);
+    for(uint i=0;i<dim;++i, desc+=sizeof(uint32_t)) memcpy(&steps[i], desc, sizeof(uint32_t));
+    for(uint i=0;i<dim;++i, desc+=sizeof(double)) memcpy(&min[i], desc, sizeof(double));
+    for(uint i=0;i<dim;++i, desc+=sizeof(double)) memcpy(&max[i], desc, sizeof(double));
+    const uint *bins=reinterpret_cast<const uint*>(record+valuesOffset+uint64_t(n)*sizeof(double));
+    return new MappedHistogramFeature(counter, steps, min, max, values, bins, n);
+  }
+
+  // all other features are parsed from the mapped memory
+  BaseFeature* feat=newFeature(suffixtype_);
+  if(feat) {
+    MemoryBuffer buffer(record, size);
+    istream is(&buffer);
+    if(!feat->readBinary(is)) {
+      delete feat;
+      feat=NULL;
+    }
+  }
+  return feat;
+}
+
+bool LargeBinaryFeatureFile::read(ImageContainer *img, uint j, unsigned long int idx){
+  if(!reading_) {
+    ERR << "file not in reading mode" << endl;
+    return false;
+  }
+  if(format_==B_FORMAT_STREAMED) {
+    unsigned long int seekpos=idx*featuresize_;
+    seekreading(seekpos);
+    return readNext(img,j);
+  }
+
+  if(idx>=numsaved_) {
+    ERR << "There is no feature for image " << idx << ", only " << numsaved_ << " features are saved." << endl;
+    return false;
+  }
+  uint64_t nameOffset=index_[3*idx+2];
+  if(nameOffset>=namesSize_ || memchr(names_+nameOffset, 0, namesSize_-nameOffset)==NULL) {
+    ERR << "Record " << idx << " has no valid filename." << endl;
+    return false;
+  }
+  string filename(names_+nameOffset);
+  if(filename!=img->basename()){
+    ERR << "Expected feature for file '" << img->basename() << "', got '" << filename << "'." << endl;
+    exit(20);
+  }
+  //TODO: Works on first frame only
+  BaseFeature* feat=mappedFeature(idx);
+  if(!feat) {
+    return false;
+  }
+  setFeature(img,j,feat);
+  loaded_=true;
+  return true;
+}
+
+void LargeBinaryFeatureFile::rewind(){
+  if(format_==B_FORMAT_MAPPED) {
+    next_=0;
+  } else {
+    unsigned long int seekpos=0;
+    seekreading(seekpos);
+  }
+}
 
 bool LargeBinaryFeatureFile::readNext(ImageContainer *img, uint j){
+  if(reading_ && format_==B_FORMAT_MAPPED) {
+    return read(img,j,next_++);
+  }
   if(reading_){
     // read the file name
     char file[filenamesize_];
@@ -125,37 +414,10 @@ bool LargeBinaryFeatureFile::readNext(ImageContainer *img, uint j){
       ERR << "Expected feature for file '" << img->basename() << "', got '" << filename << "'." << endl;
       exit(20);
     } else {
-      BaseFeature* feat = NULL;
-      switch(suffixtype_){
-      case FT_VEC: feat = new VectorFeature(); break;
-      case FT_BINARY: feat = new BinaryFeature(); break; 
-        //  case FT_DISTFILE: feat = new DistanceFileFeature(); break;
-        //  case FT_FACEFEAT: feat = new FaceFeature(); break;
-      case FT_IMG: feat = new ImageFeature(); break; 
-        //  case FT_OLDHISTO: // depreciated
-      case FT_HISTO: feat = new HistogramFeature(); break;
-      case FT_SPARSEHISTO: feat = new SparseHistogramFeature(); break; 
-        //    case FT_HISTOPAIR: feat = new HistogramPairFeature(); break;
-        //	  case FT_LF: feat = new LocalFeatures(); break;
-        //	  case FT_LFPOSCLSIDFEAT: feat = new LFPositionClusterIdFeature(); break;
-        //	  case FT_LFSIGNATURE: feat = new LFSignatureFeature(); break;
-        //	  case FT_MPEG7: feat = new MPEG7Feature(); break;
-        //	  case FT_META: feat = new MetaFeature(); break;
-        //	  case FT_TEXT_EN:
-        //	  case FT_TEXT_FR:
-        //	  case FT_TEXT_GE:
-        //	  case FT_TEXT: feat = new TextFeature(); break;
-        //	  case FT_PASCALANNOTATION: feat = new PascalAnnotationFeature(); break;
-        // not yet implemented
-      case FT_GABOR:
-      case FT_BLOBS:
-      case FT_REGIONS:
-        ERR << "This feature type is not yet implemented: " << suffixtype_ << endl;
+      BaseFeature* feat = newFeature(suffixtype_);
+      if(!feat){
         return false;
-      default:
-        ERR << "This feature type is not yet known: " << suffixtype_ << endl;
-        return false;
-      } 
+      }
           
       //TODO: Works on first frame only
           
@@ -163,7 +425,8 @@ bool LargeBinaryFeatureFile::readNext(ImageContainer *img, uint j){
       if(!readBool){
         return false;
       }
-      img->operator[](j)->operator[](0)=feat;
+      setFeature(img,j,feat);
+      Profiler::count("features/bytes", featuresize_);
       // if the features differ in size the padded zeros have to be skipped
       if(differ_){
         long unsigned int local = img->operator[](j)->operator[](0)->calcBinarySize();
@@ -179,8 +442,57 @@ bool LargeBinaryFeatureFile::readNext(ImageContainer *img, uint j){
   return true;
 }
 
+void LargeBinaryFeatureFile::writeMapped(BaseFeature* feat){
+  pad(ofs_, RECORD_ALIGNMENT);
+  uint64_t offset=ofs_.tellp();
+
+  if(suffixtype_==FT_VEC || suffixtype_==FT_HISTO) {
+    const VectorFeature *vec=dynamic_cast<const VectorFeature*>(feat);
+    const HistogramFeature *histo=dynamic_cast<const HistogramFeature*>(feat);
+    if(!vec || (suffixtype_==FT_HISTO && !histo)) {
+      ERR << "Feature of unexpected type " << feat->type() << " in file of type " << suffixtype_ << ". Aborting!" << endl;
+      exit(20);
+    }
+    uint32_t n=vec->size();
+    uint32_t descSize=0;
+    if(histo) {
+      descSize=2*sizeof(uint32_t)+histo->dim()*(sizeof(uint32_t)+2*sizeof(double));
+    }
+    ofs_.write((char*)&descSize,sizeof(uint32_t));
+    ofs_.write((char*)&n,sizeof(uint32_t));
+    if(histo) {
+      uint32_t dim=histo->dim(), counter=histo->counter();
+      ofs_.write((char*)&dim,sizeof(uint32_t));
+      ofs_.write((char*)&counter,sizeof(uint32_t));
+      for(uint i=0;i<dim;++i) {ofs_.write((char*)&histo->steps()[i],sizeof(uint32_t));}
+      for(uint i=0;i<dim;++i) {ofs_.write((char*)&histo->min()[i],sizeof(double));}
+      for(uint i=0;i<dim;++i) {ofs_.write((char*)&histo->max()[i],sizeof(double));}
+    }
+    pad(ofs_, RECORD_ALIGNMENT);
+    for(uint i=0;i<n;++i) {
+      double v=(*vec)[i];
+      ofs_.write((char*)&v,sizeof(double));
+    }
+    if(histo) {
+      for(uint i=0;i<n;++i) {ofs_.write((char*)&histo->bin(i),sizeof(uint));}
+    }
+  } else {
+    feat->writeBinary(ofs_);
+  }
+
+  uint64_t end=ofs_.tellp();
+  writeIndex_.push_back(offset);
+  writeIndex_.push_back(end-offset);
+}
+
 void LargeBinaryFeatureFile::writeNext(ImageContainer *img, uint j){
-  if(writing_){
+  if(writing_ && format_==B_FORMAT_MAPPED){
+    DBG(105) << "write Data for file: " << img->basename() << endl;
+    writeMapped(img->operator[](j)->operator[](0));
+    writeIndex_.push_back(writeNames_.size());
+    writeNames_+=img->basename();
+    writeNames_.push_back('\0');
+  } else if(writing_){
     // write the filename
     string filen = img->basename();
     // stretch the filenname to a length of filenamesize_
@@ -211,7 +523,154 @@ void LargeBinaryFeatureFile::closeReading(){
 }
 
 void LargeBinaryFeatureFile::closeWriting(){
+  if(writing_ && format_==B_FORMAT_MAPPED) {
+    MappedHeader header;
+    memset(&header,0,sizeof(header));
+    memcpy(header.magic,MAPPED_MAGIC,sizeof(header.magic));
+    header.format=B_FORMAT_MAPPED;
+    header.suffixtype=suffixtype_;
+    header.numsaved=writeIndex_.size()/3;
+    if(header.numsaved!=numsaved_) {
+      DBG(10) << "Announced " << numsaved_ << " features, but wrote " << header.numsaved << endl;
+    }
+
+    pad(ofs_, sizeof(uint64_t));
+    header.indexOffset=ofs_.tellp();
+    if(!writeIndex_.empty()) {
+      ofs_.write((char*)&writeIndex_[0],writeIndex_.size()*sizeof(uint64_t));
+    }
+    header.namesOffset=ofs_.tellp();
+    ofs_.write(writeNames_.data(),writeNames_.size());
+
+    ofs_.seekp(0);
+    ofs_.write((char*)&header,sizeof(header));
+    if(!ofs_.good()) {
+      ERR << "Error writing LargeBinaryFeatureFile." << endl;
+    } else if(!journal_.empty()) {
+      // the file is complete, nothing has to be continued
+      remove(journal_.c_str());
+    }
+    writing_=false;
+  }
   ofs_.close();
 }
 
+LargeBinaryFeatureFile::LargeBinaryFeatureFile(string filename, uint suffixtype, unsigned long int numsaved, const string& journal) :
+  format_(B_FORMAT_MAPPED), map_(NULL), mapSize_(0), index_(NULL), names_(NULL), namesSize_(0), next_(0), filename_(filename), journal_(journal), journaled_(0) {
+  reading_ = false;
+  suffixtype_=suffixtype;
+  numsaved_=numsaved;
+  featuresize_=0;
+  filenamesize_=0;
+  differ_=false;
+  loaded_= false;
+  writeIndex_.reserve(3*numsaved);
+
+  uint64_t end=readJournal();
+  if(end>0) {
+    // everything after the synced records is written again
+    if(truncate(filename.c_str(), end)!=0) {
+      ERR << "Cannot continue LargeBinaryFeatureFile '" << filename << "'. Aborting!" << endl;
+      exit(20);
+    }
+    ofs_.open(filename.c_str(),ios::in|ios::out|ios::binary);
+    ofs_.seekp(end);
+    DBG(10) << "Continuing '" << filename << "' after " << written() << " records" << endl;
+  } else {
+    ofs_.open(filename.c_str(),ios::out|ios::binary);
+    // the header is written by closeWriting, when the offsets are known
+    MappedHeader header;
+    memset(&header,0,sizeof(header));
+    ofs_.write((char*)&header,sizeof(header));
+  }
+  if(!ofs_.good()){
+    ERR << "Cannot open LargeBinaryFeatureFile '" << filename << "' for writing. Aborting!" << endl;
+    exit(20);
+  }
+  journaled_=written();
+  writing_ = true;
+}
+
+uint64_t LargeBinaryFeatureFile::readJournal() {
+  ifstream js(journal_.c_str(),ios::in|ios::binary);
+  uint64_t end=0;
+  uint64_t entry[3];
+  // an entry which was not written completely is ignored
+  while(js.read((char*)entry,sizeof(entry))) {
+    vector<uint64_t> index(3*entry[0]);
+    string names(entry[2],'\0');
+    if((!index.empty() && !js.read((char*)&index[0],index.size()*sizeof(uint64_t))) ||
+       (!names.empty() && !js.read(&names[0],names.size()))) {
+      break;
+    }
+    writeIndex_.insert(writeIndex_.end(),index.begin(),index.end());
+    writeNames_+=names;
+    end=entry[1];
+  }
+  return end;
+}
+
+void LargeBinaryFeatureFile::appendJournal(ofstream& js) {
+  if(journaled_==written()) {
+    return;
+  }
+  uint64_t namesStart=writeIndex_[3*journaled_+2];
+  uint64_t entry[3];
+  entry[0]=written()-journaled_;
+  entry[1]=ofs_.tellp();
+  entry[2]=writeNames_.size()-namesStart;
+  js.write((char*)entry,sizeof(entry));
+  js.write((char*)&writeIndex_[3*journaled_],3*entry[0]*sizeof(uint64_t));
+  js.write(writeNames_.data()+namesStart,entry[2]);
+  js.flush();
+  if(!js.good()) {
+    ERR << "Error writing journal '" << journal_ << "'. Aborting!" << endl;
+    exit(20);
+  }
+  journaled_=written();
+}
+
+void LargeBinaryFeatureFile::sync() {
+  // the records have to be on the disk before the journal refers to them
+  ofs_.flush();
+  if(!ofs_.good() || !syncToDisk(filename_)) {
+    ERR << "Error writing LargeBinaryFeatureFile '" << filename_ << "'. Aborting!" << endl;
+    exit(20);
+  }
+  {
+    ofstream js(journal_.c_str(),ios::out|ios::binary|ios::app);
+    appendJournal(js);
+  }
+  if(!syncToDisk(journal_)) {
+    ERR << "Error writing journal '" << journal_ << "'. Aborting!" << endl;
+    exit(20);
+  }
+}
+
+void LargeBinaryFeatureFile::discardFrom(unsigned long int keep) {
+  if(keep>=written()) {
+    return;
+  }
+  uint64_t end=writeIndex_[3*keep];
+  writeNames_.resize(writeIndex_[3*keep+2]);
+  writeIndex_.resize(3*keep);
+
+  ofs_.flush();
+  if(truncate(filename_.c_str(), end)!=0) {
+    ERR << "Cannot truncate LargeBinaryFeatureFile '" << filename_ << "'. Aborting!" << endl;
+    exit(20);
+  }
+  ofs_.seekp(end);
+
+  {
+    ofstream js(journal_.c_str(),ios::out|ios::binary|ios::trunc);
+    journaled_=0;
+    appendJournal(js);
+  }
+  if(!syncToDisk(journal_)) {
+    ERR << "Error writing journal '" << journal_ << "'. Aborting!" << endl;
+    exit(20);
+  }
+}
+
   
@@ -18,7 +18,9 @@
 #define _largebinaryfeaturefile_hpp_
 
 #include<string>
+#include<vector>
 #include<fstream>
+#include<stdint.h>
 #include"diag.hpp"
 #include"basefeature.hpp"
 #include"imagecontainer.hpp"
@@ -46,12 +48,52 @@
  * the feature information is read/written by the readBinary/writeBinary methods
  * from the features, thus make sure that this work sufficiently
  * stable.
+ *
+ * Version 2 of the format (B_FORMAT_MAPPED) is read using mmap, such
+ * that several processes on one machine share the pages and nothing
+ * is parsed at startup. All numbers are in the byte order of the
+ * machine which wrote the file:
+ *
+ * header (64 bytes):
+ *   FIRE_mappedfeaturefile [Type Char[28]]
+ *   <format version>, i.e. 2 [Type uint32]
+ *   <suffixtype> [Type uint32]
+ *   <reserved> [Type uint32]
+ *   <number of saved features> [Type uint64]
+ *   <offset of the index> [Type uint64]
+ *   <offset of the names> [Type uint64]
+ * records, each starting at a multiple of 64 bytes
+ * index: for each image <offset of the record> <size of the record>
+ *   <offset of the name in the names> [Type uint64 each]
+ * names: the file names, each terminated by '\0'
+ *
+ * For FT_VEC and FT_HISTO the records are laid out such that the
+ * values can be used in place (see MappedVectorFeature and
+ * MappedHistogramFeature): <size of the description> <number of values>
+ * [Type uint32 each], the description (FT_HISTO: dim, counter, steps,
+ * min, max as in writeBinary), padding to the next multiple of 64 bytes,
+ * the values [Type double], and for FT_HISTO the bin counts [Type uint32].
+ * All other feature types store their writeBinary output.
+ *
+ * A B_FORMAT_MAPPED file can be written with a journal, to which sync
+ * appends the index and the names of the records written since the
+ * last sync. sync writes the file and the journal to the disk
+ * (fsync) before it returns. Opening it for writing again keeps the
+ * synced records, such that long running extractions can continue
+ * after a crash of the program or the machine. Each entry of the journal is <number of records> <offset
+ * after the last record> <size of the names> [Type uint64 each], the
+ * index and the names of the records. closeWriting removes the journal.
  */
 
 
 static const unsigned long int B_HEADERSIZE = sizeof(char[28])+sizeof(uint)+sizeof(FeatureType)+2*sizeof(unsigned long int)+sizeof(bool);
 const uint B_FILENAMESIZE = 50; 
 
+/// the original stream based format
+const uint B_FORMAT_STREAMED = 1;
+/// the format with an index which is read using mmap
+const uint B_FORMAT_MAPPED = 2;
+
 class LargeBinaryFeatureFile{
 
 private:
@@ -68,10 +110,58 @@ private:
   bool reading_, writing_;
   // if loaded is true if the header and at least the feature data of one image was read
   bool loaded_;
+
+  /// B_FORMAT_STREAMED or B_FORMAT_MAPPED
+  uint format_;
+
+  /// B_FORMAT_MAPPED: the mapped file and its size
+  const char *map_;
+  size_t mapSize_;
+
+  /// B_FORMAT_MAPPED: the index, three numbers per image (see above)
+  const uint64_t *index_;
+
+  /// B_FORMAT_MAPPED: the names
+  const char *names_;
+  size_t namesSize_;
+
+  /// B_FORMAT_MAPPED: the record read by the next call of readNext
+  unsigned long int next_;
+
+  /// B_FORMAT_MAPPED writing: the index and the names, written by closeWriting
+  ::std::vector<uint64_t> writeIndex_;
+  ::std::string writeNames_;
+
+  /// B_FORMAT_MAPPED writing with a journal: the files and the number
+  /// of records in the journal
+  ::std::string filename_, journal_;
+  unsigned long int journaled_;
+
+  /// read the complete entries of the journal into writeIndex_ and
+  /// writeNames_, returns the offset after the last record
+  uint64_t readJournal();
+
+  /// append the records from the journaled_-th on to the journal
+  void appendJournal(::std::ofstream& js);
+
+  /// map the file and check its header and index
+  void map(const ::std::string& filename);
+
+  /// B_FORMAT_MAPPED: create the idx-th feature, a view for FT_VEC and FT_HISTO
+  BaseFeature* mappedFeature(unsigned long int idx) const;
+
+  /// B_FORMAT_MAPPED: write the record for feat
+  void writeMapped(BaseFeature* feat);
+
+  // not copyable, the features may point into the mapped file
+  LargeBinaryFeatureFile(const LargeBinaryFeatureFile&);
+  LargeBinaryFeatureFile& operator=(const LargeBinaryFeatureFile&);
  
 public:
 
-  ~LargeBinaryFeatureFile() {}
+  /// unmaps the file. Thus, features which were read from a mapped
+  /// file have to be deleted before.
+  ~LargeBinaryFeatureFile();
 
   /*-------------------------------------------------------- 
     reading
@@ -84,22 +174,50 @@ public:
   // ImageContainer
   bool readNext(ImageContainer *img, uint j); 
 
-  // close the read file
+  // read the feature of the idx-th image into the j-th feature of
+  // the given ImageContainer. For B_FORMAT_MAPPED this is a lookup in
+  // the index, for B_FORMAT_STREAMED this requires features of equal
+  // size or differ_.
+  bool read(ImageContainer *img, uint j, unsigned long int idx);
+
+  // let the next readNext read the feature of the first image
+  void rewind();
+
+  // close the read file. features read from a mapped file stay valid.
   void closeReading();
   
   /*---------------------------------------------------------
     writing
     ---------------------------------------------------------*/
   
-  // initalize a file for writing. That is, write the header
-  LargeBinaryFeatureFile(::std::string filename, uint suffixtype,unsigned long int numsaved, unsigned long int featuresize,bool differ=false,uint filenamelength=B_FILENAMESIZE);
+  // initalize a file for writing. That is, write the header.
+  // featuresize, differ and filenamelength are only used for B_FORMAT_STREAMED
+  LargeBinaryFeatureFile(::std::string filename, uint suffixtype,unsigned long int numsaved, unsigned long int featuresize,bool differ=false,uint filenamelength=B_FILENAMESIZE, uint format=B_FORMAT_STREAMED);
   
   // write the next feature into the LargeFeature file, that is, write
   // the j-th feature from the given ImageContainer.
   void writeNext(ImageContainer *img, uint j);
   
-  // close the write file
+  // close the write file. For B_FORMAT_MAPPED this writes the index.
   void closeWriting();
+
+  // initialize a B_FORMAT_MAPPED file for writing with the given
+  // journal. If the journal exists, the records synced before are
+  // kept and the next writeNext appends to them.
+  LargeBinaryFeatureFile(::std::string filename, uint suffixtype, unsigned long int numsaved, const ::std::string& journal);
+
+  // append the records written since the last sync to the journal
+  // and write both files to the disk
+  void sync();
+
+  // the number of records written (or kept from the journal)
+  unsigned long int written() const { return writeIndex_.size()/3; }
+
+  // the name of the idx-th record written
+  ::std::string writtenName(unsigned long int idx) const { return ::std::string(writeNames_.c_str()+writeIndex_[3*idx+2]); }
+
+  // discard the records from the keep-th on, also from the journal
+  void discardFrom(unsigned long int keep);
   
   /*---------------------------------------------------------
    * helper functions
@@ -127,5 +245,7 @@ public:
 
   const unsigned long int getNumSaved() { return numsaved_; }
 
+  const uint getFormat() { return format_; }
+
 };
 #endif
@@ -113,6 +113,26 @@ public:
     return exp(-result);
   }
 
+  /// the same as getScore for all rows, but running down the columns
+  virtual void getScores(const DistanceMatrix& dists, ::std::vector<double>& scores) {
+    uint N=dists.rows();
+    uint M=dists.cols();
+    if (M>weights_.size()) {weights_.resize(M,0.0);}
+    scores.assign(N,0.0);
+    if (N==0) return;
+    double *s=&scores[0];
+    for(uint j=0;j<M;++j) {
+      const double w=weights_[j];
+      const double *d=dists.column(j);
+      for(uint i=0;i<N;++i) {
+        s[i]+=w*d[i];
+      }
+    }
+    for(uint i=0;i<N;++i) {
+      s[i]=exp(-s[i]);
+    }
+  }
+
   virtual double& weight(const uint idx) {
     return weights_[idx];
   }
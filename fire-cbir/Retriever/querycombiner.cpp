@@ -13,7 +13,7 @@ ScoreSumQueryCombiner::ScoreSumQueryCombiner(Retriever& retriever) :
 ScoreSumQueryCombiner::~ScoreSumQueryCombiner() {
 }
 
-void ScoreSumQueryCombiner::query(const vector<ImageContainer*> posQueries, const vector<ImageContainer*> negQueries, vector<ResultPair>& results) {
+void ScoreSumQueryCombiner::query(const vector<ImageContainer*> posQueries, const vector<ImageContainer*> negQueries, vector<double>& scores) {
 
   double posWeight=posWeight_/posQueries.size();
   double negWeight=negWeight_/negQueries.size();
@@ -33,7 +33,7 @@ void ScoreSumQueryCombiner::query(const vector<ImageContainer*> posQueries, cons
     retriever_.getScores(posQueries[q], activeScores);
     retriever_.imageComparator().stop();
     for (uint i=0; i<N; ++i) {
-      results[i].first+=posWeight*activeScores[i];
+      scores[i]+=posWeight*activeScores[i];
     }
   }
 
@@ -49,7 +49,7 @@ void ScoreSumQueryCombiner::query(const vector<ImageContainer*> posQueries, cons
     retriever_.getScores(negQueries[q], activeScores);
     retriever_.imageComparator().stop();
     for (uint i=0; i<N; ++i) {
-      results[i].first+=negWeight*(1.0-activeScores[i]);
+      scores[i]+=negWeight*(1.0-activeScores[i]);
     }
 
   }
@@ -69,7 +69,7 @@ NNQuotientQueryCombiner::~NNQuotientQueryCombiner() {
 
 }
 
-void NNQuotientQueryCombiner::query(const vector<ImageContainer*> posQueries, const vector<ImageContainer*> negQueries, vector<ResultPair>& results) {
+void NNQuotientQueryCombiner::query(const vector<ImageContainer*> posQueries, const vector<ImageContainer*> negQueries, vector<double>& scores) {
 
   uint N=retriever_.database().size();
   vector<double> activeScores(N, 0.0), bestPos(N, 0.0), bestNeg(N, 0.0);
@@ -118,7 +118,7 @@ void NNQuotientQueryCombiner::query(const vector<ImageContainer*> posQueries, co
 
   // now combine these scores
   for (uint n=0; n<N; ++n) {
-    results[n].first=bestPos[n]/bestNeg[n];
+    scores[n]=bestPos[n]/bestNeg[n];
   }
 
 }
@@ -130,14 +130,14 @@ SVMQueryCombiner::SVMQueryCombiner(Retriever& retriever) :
 SVMQueryCombiner::~SVMQueryCombiner() {
 }
 
-void SVMQueryCombiner::query(const vector<ImageContainer*> posQueries, const vector<ImageContainer*> negQueries, vector<ResultPair>& results) {
+void SVMQueryCombiner::query(const vector<ImageContainer*> posQueries, const vector<ImageContainer*> negQueries, vector<double>& scores) {
   vector<DoubleVector> trainingExamples;
   vector<int> classes;
 
   if (negQueries.size()==0) {
     DBG(10) << "Only one example: NN" << endl;
     ScoreSumQueryCombiner adc(retriever_);
-    adc.query(posQueries, negQueries, results);
+    adc.query(posQueries, negQueries, scores);
   } else {
     DBG(10) << "Training new SVM" << endl;
     trainingExamples.reserve(posQueries.size()+negQueries.size());
@@ -155,10 +155,10 @@ void SVMQueryCombiner::query(const vector<ImageContainer*> posQueries, const vec
     DBG(10) << "training SVM with " << trainingExamples.size() << " vectors of size " << trainingExamples[0].size() <<endl;
     svm.train(trainingExamples, classes);
     uint N=retriever_.database().size();
-    DoubleVector scores;
+    DoubleVector svmScores;
     for (uint n=0; n<N; ++n) {
-      svm.classify(retriever_.database()[n]->asVector(), scores);
-      results[n].first=scores[0];
+      svm.classify(retriever_.database()[n]->asVector(), svmScores);
+      scores[n]=svmScores[0];
     }
   }
 }
@@ -178,7 +178,7 @@ SumQuotientQueryCombiner::SumQuotientQueryCombiner(Retriever& retriever) :
 SumQuotientQueryCombiner::~SumQuotientQueryCombiner() {
 }
 
-void SumQuotientQueryCombiner::query(const vector<ImageContainer*> posQueries, const vector<ImageContainer*> negQueries, vector<ResultPair>& results) {
+void SumQuotientQueryCombiner::query(const vector<ImageContainer*> posQueries, const vector<ImageContainer*> negQueries, vector<double>& scores) {
 
   uint N=retriever_.database().size();
 
@@ -223,7 +223,7 @@ void SumQuotientQueryCombiner::query(const vector<ImageContainer*> posQueries, c
   BLINK(10) << endl;
 
   for (uint n=0; n<N; ++n) {
-    results[n].first=posScores[n]/negScores[n];
+    scores[n]=posScores[n]/negScores[n];
   }
 }
 
@@ -235,7 +235,7 @@ RelevanceScoreQueryCombiner::~RelevanceScoreQueryCombiner() {
 
 }
 
-void RelevanceScoreQueryCombiner::query(const vector<ImageContainer*> posQueries, const vector<ImageContainer*> negQueries, vector<ResultPair>& results) {
+void RelevanceScoreQueryCombiner::query(const vector<ImageContainer*> posQueries, const vector<ImageContainer*> negQueries, vector<double>& scores) {
 
   uint N=retriever_.database().size();
   vector<double> activeScores(N, 0.0), bestPos(N, std::numeric_limits<double>::epsilon()), bestNeg(N, std::numeric_limits<double>::epsilon());
@@ -284,7 +284,7 @@ void RelevanceScoreQueryCombiner::query(const vector<ImageContainer*> posQueries
   BLINK(10) << endl;
   // now combine these scores
   for (uint n=0; n<N; ++n) {
-    results[n].first=1.0/(1.0+log(bestPos[n])/log(bestNeg[n]));
+    scores[n]=1.0/(1.0+log(bestPos[n])/log(bestNeg[n]));
   }
 
 }
@@ -311,7 +311,7 @@ void DistSumQuotientQueryCombiner::setParameters(const std::string &parameters)
 DistSumQuotientQueryCombiner::~DistSumQuotientQueryCombiner() {
 }
 
-void DistSumQuotientQueryCombiner::query(const vector<ImageContainer*> posQueries, const vector<ImageContainer*> negQueries, vector<ResultPair>& results) {
+void DistSumQuotientQueryCombiner::query(const vector<ImageContainer*> posQueries, const vector<ImageContainer*> negQueries, vector<double>& scores) {
   uint N=retriever_.database().size();
 
   vector<double> activeScores(N, 0.0), posScores(N, 0.0), negScores(N, 0.0);
@@ -354,11 +354,11 @@ void DistSumQuotientQueryCombiner::query(const vector<ImageContainer*> posQuerie
   BLINK(10) << endl;
   if(mode_==negDenom) {
     for (uint n=0; n<N; ++n) {
-      results[n].first=1.0/(1.0+posScores[n]/negScores[n]);
+      scores[n]=1.0/(1.0+posScores[n]/negScores[n]);
     }
   } else {
     for (uint n=0; n<N; ++n) {
-      results[n].first=(posScores[n])/(negScores[n]+posScores[n]);
+      scores[n]=(posScores[n])/(negScores[n]+posScores[n]);
     }
   }
 }
@@ -371,12 +371,12 @@ WeightedDistanceQueryCombiner::WeightedDistanceQueryCombiner(Retriever& retrieve
 WeightedDistanceQueryCombiner::~WeightedDistanceQueryCombiner() {
 }
 
-void WeightedDistanceQueryCombiner::query(const vector<ImageContainer*> posQueries, const vector<ImageContainer*> negQueries, vector<ResultPair>& results) {
+void WeightedDistanceQueryCombiner::query(const vector<ImageContainer*> posQueries, const vector<ImageContainer*> negQueries, vector<double>& scores) {
   
   if (negQueries.size()==0) {
     DBG(10) << "Only positive examples: defaulting to ScoreSumQueryCombiner" << endl;
     ScoreSumQueryCombiner adc(retriever_);
-    adc.query(posQueries, negQueries, results);
+    adc.query(posQueries, negQueries, scores);
   } else {
     DBG(10) << "Training new WeightedDistance" << endl;
     
@@ -435,7 +435,7 @@ void WeightedDistanceQueryCombiner::query(const vector<ImageContainer*> posQueri
           } else if(sel[i]==-1) {
             if(minNRel>dis) {minNRel=dis;}
           }
-          results[n].first=minNRel/minRel;
+          scores[n]=minNRel/minRel;
         } 
       }
       break;
@@ -448,7 +448,7 @@ void WeightedDistanceQueryCombiner::query(const vector<ImageContainer*> posQueri
           else if(sel[i]==-1) {sumNRel+=dis;}
           else ERR << "Something wrong" << endl;
         }
-        results[n].first=sumNRel/sumRel;
+        scores[n]=sumNRel/sumRel;
       } 
       break;
     case WDScoreSum: {
@@ -470,7 +470,7 @@ void WeightedDistanceQueryCombiner::query(const vector<ImageContainer*> posQueri
           else if(sel[i]==-1) {sumNRel+=1-distances[n][i]; nrel+=1;}
           else ERR << "Something wrong" <<endl;
         }
-        results[n].first=sumRel/rel + 0.8*sumNRel/nrel;
+        scores[n]=sumRel/rel + 0.8*sumNRel/nrel;
       }
       break;}
     default:
@@ -700,12 +700,12 @@ ClassDependentWeightedDistanceQueryCombiner::ClassDependentWeightedDistanceQuery
 ClassDependentWeightedDistanceQueryCombiner::~ClassDependentWeightedDistanceQueryCombiner() {
 }
 
-void ClassDependentWeightedDistanceQueryCombiner::query(const vector<ImageContainer*> posQueries, const vector<ImageContainer*> negQueries, vector<ResultPair>& results) {
+void ClassDependentWeightedDistanceQueryCombiner::query(const vector<ImageContainer*> posQueries, const vector<ImageContainer*> negQueries, vector<double>& scores) {
   
   if (negQueries.size()==0) {
     DBG(10) << "Only positive examples: defaulting to ScoreSumQueryCombiner" << endl;
     ScoreSumQueryCombiner adc(retriever_);
-    adc.query(posQueries, negQueries, results);
+    adc.query(posQueries, negQueries, scores);
   } else {
     DBG(10) << "Training new WeightedDistance" << endl;
     
@@ -766,7 +766,7 @@ void ClassDependentWeightedDistanceQueryCombiner::query(const vector<ImageContai
           } else if(sel[i]==-1) {
             if(minNRel>dis) {minNRel=dis;}
           }
-          results[n].first=minNRel/minRel;
+          scores[n]=minNRel/minRel;
         } 
       }
       break;
@@ -778,7 +778,7 @@ void ClassDependentWeightedDistanceQueryCombiner::query(const vector<ImageContai
           if(sel[i]==1) {sumRel+=dis;}
           else if(sel[i]==-1) {sumNRel+=dis;}
         }
-        results[n].first=sumNRel/sumRel;
+        scores[n]=sumNRel/sumRel;
       } 
       break;
     default:
@@ -982,7 +982,7 @@ RocchioRelevanceFeedbackQueryCombiner::RocchioRelevanceFeedbackQueryCombiner(Ret
 RocchioRelevanceFeedbackQueryCombiner::~RocchioRelevanceFeedbackQueryCombiner() {
 }
 
-void RocchioRelevanceFeedbackQueryCombiner::query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<ResultPair>& results) {
+void RocchioRelevanceFeedbackQueryCombiner::query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<double>& scores) {
   ImageContainer Q(*posQ[0]);
   double beta=beta_; double gamma=gamma_;
   
@@ -1029,7 +1029,7 @@ void RocchioRelevanceFeedbackQueryCombiner::query(const std::vector<ImageContain
   ScoreSumQueryCombiner adc(retriever_);
   vector<ImageContainer*> positiveQ(1,&Q);
   vector<ImageContainer*> negativeQ(0);
-  adc.query(positiveQ, negativeQ, results);
+  adc.query(positiveQ, negativeQ, scores);
 }
 
 void RocchioRelevanceFeedbackQueryCombiner::setParameters(const std::string& parameters) {
@@ -1144,7 +1144,7 @@ void QueryWeightingQueryCombiner::calcWeights(const std::vector<ImageContainer*>
   }
 }
 
-void QueryWeightingQueryCombiner::query(const std::vector<ImageContainer*> posQueries, const std::vector<ImageContainer*> negQueries, std::vector<ResultPair>& results) {
+void QueryWeightingQueryCombiner::query(const std::vector<ImageContainer*> posQueries, const std::vector<ImageContainer*> negQueries, std::vector<double>& scores) {
   vector<double> posWeights(posQueries.size(),1.0),negWeights(negQueries.size(),1.0);
   double posWeight=posWeight_/posQueries.size();
   double negWeight=negWeight_/negQueries.size();
@@ -1168,11 +1168,11 @@ void QueryWeightingQueryCombiner::query(const std::vector<ImageContainer*> posQu
     retriever_.imageComparator().stop();
     if(mode_==WeightScores) {
       for (uint i=0; i<N; ++i) {
-        results[i].first+=posWeights[q]*posWeight*activeScores[i];
+        scores[i]+=posWeights[q]*posWeight*activeScores[i];
       }
     } else if(mode_==WeightDistances) {
       for (uint i=0; i<N; ++i) {
-        results[i].first+=posWeights[q]*exp(posWeight*log(activeScores[i]));
+        scores[i]+=posWeights[q]*exp(posWeight*log(activeScores[i]));
       }    
     }
   }
@@ -1190,11 +1190,11 @@ void QueryWeightingQueryCombiner::query(const std::vector<ImageContainer*> posQu
     retriever_.imageComparator().stop();
     if(mode_==WeightScores) {
       for (uint i=0; i<N; ++i) {
-        results[i].first+=negWeights[q]*negWeight*(1.0-activeScores[i]);
+        scores[i]+=negWeights[q]*negWeight*(1.0-activeScores[i]);
       }
     } else if(mode_==WeightDistances) {
       for (uint i=0; i<N; ++i) {
-        results[i].first+=negWeight*(1.0-log(exp(negWeights[q]*activeScores[i])));
+        scores[i]+=negWeight*(1.0-log(exp(negWeights[q]*activeScores[i])));
       }
     }
   }
@@ -29,12 +29,20 @@ public:
   QueryCombiner() {}
   QueryCombiner(Retriever&) { }
   virtual ~QueryCombiner(){}
-  
+
+  /// combine the given queries into one score per database image.
+  /// scores is handed in with one zero-initialised entry per database
+  /// image; ranking the scores is left to the Retriever
   virtual void query(const std::vector<ImageContainer*> posQ, 
                      const std::vector<ImageContainer*> negQ, 
-                     std::vector<ResultPair>& results)=0;
+                     std::vector<double>& scores)=0;
   
   virtual void setParameters(const std::string&) {}
+
+  /// whether query() can be called for several queries at the same
+  /// time. Combiners which store data of the current query in the
+  /// object return false.
+  virtual bool reentrant() const {return true;}
 };
 
 /** this is the default query combiner that was used in FIRE between 2003 and early 2008.
@@ -44,7 +52,7 @@ class ScoreSumQueryCombiner : public QueryCombiner {
 public:
   ScoreSumQueryCombiner(Retriever& r);
   virtual ~ScoreSumQueryCombiner();
-  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<ResultPair>& results);
+  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<double>& scores);
 
   virtual void setParameters(const std::string& parameters);
   
@@ -65,7 +73,7 @@ class NNQuotientQueryCombiner : public QueryCombiner {
 public:
   NNQuotientQueryCombiner(Retriever& r);
   virtual ~NNQuotientQueryCombiner();
-  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<ResultPair>& results);
+  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<double>& scores);
   
 private:
   Retriever& retriever_;
@@ -75,7 +83,7 @@ class NNScoreQueryCombiner : public QueryCombiner {
 public:
   NNScoreQueryCombiner(Retriever& r);
   virtual ~NNScoreQueryCombiner();
-  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<ResultPair>& results);
+  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<double>& scores);
   
 private:
   Retriever& retriever_;
@@ -91,7 +99,7 @@ class RelevanceScoreQueryCombiner : public QueryCombiner {
 public:
   RelevanceScoreQueryCombiner(Retriever& r);
   virtual ~RelevanceScoreQueryCombiner();
-  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<ResultPair>& results);
+  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<double>& scores);
   
 private:
   Retriever& retriever_;
@@ -102,7 +110,7 @@ class SumQuotientQueryCombiner : public QueryCombiner {
 public:
   SumQuotientQueryCombiner(Retriever& r);
   virtual ~SumQuotientQueryCombiner();
-  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<ResultPair>& results);
+  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<double>& scores);
   
 private:
   Retriever& retriever_;
@@ -113,7 +121,7 @@ class DistSumQuotientQueryCombiner : public QueryCombiner {
 public:
   DistSumQuotientQueryCombiner(Retriever& r);
   virtual ~DistSumQuotientQueryCombiner();
-  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<ResultPair>& results);
+  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<double>& scores);
   virtual void setParameters(const std::string& parameters);
   
 private:
@@ -131,7 +139,7 @@ class SVMQueryCombiner : public QueryCombiner {
 public:
   SVMQueryCombiner(Retriever& r);
   virtual ~SVMQueryCombiner();
-  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<ResultPair>& results);
+  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<double>& scores);
   virtual void setParameters(const std::string& parameters);
 private:
   Retriever& retriever_;
@@ -143,7 +151,7 @@ class RocchioRelevanceFeedbackQueryCombiner : public QueryCombiner {
 public:
   RocchioRelevanceFeedbackQueryCombiner(Retriever& r);
   virtual ~RocchioRelevanceFeedbackQueryCombiner();
-  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<ResultPair>& results);
+  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<double>& scores);
   virtual void setParameters(const std::string& parameters);
 
 private:
@@ -157,10 +165,12 @@ class WeightedDistanceQueryCombiner : public QueryCombiner {
 public:
   WeightedDistanceQueryCombiner(Retriever& r);
   virtual ~WeightedDistanceQueryCombiner();
-  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<ResultPair>& results);
+  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<double>& scores);
   virtual void setParameters(const std::string& parameters);
 
   std::string printSigmas() const;
+  /// the training data and weights are members
+  virtual bool reentrant() const {return false;}
 private:
   double WeightedL1Distance(float *v1, const std::vector<double>& v2);
   void calcWeights();
@@ -191,10 +201,12 @@ class ClassDependentWeightedDistanceQueryCombiner : public QueryCombiner {
 public:
   ClassDependentWeightedDistanceQueryCombiner(Retriever& r);
   virtual ~ClassDependentWeightedDistanceQueryCombiner();
-  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<ResultPair>& results);
+  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<double>& scores);
   virtual void setParameters(const std::string& parameters);
 
   std::string printSigmas() const;
+  /// the training data and weights are members
+  virtual bool reentrant() const {return false;}
 private:
   double WeightedL1Distance(float *v1, const std::vector<double>& v2, int cls);
   void calcWeights();
@@ -217,7 +229,7 @@ class QueryWeightingQueryCombiner: public QueryCombiner {
 public:
   QueryWeightingQueryCombiner(Retriever& r);
   virtual ~QueryWeightingQueryCombiner();
-  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<ResultPair>& results);
+  virtual void query(const std::vector<ImageContainer*> posQ, const std::vector<ImageContainer*> negQ, std::vector<double>& scores);
   virtual void setParameters(const std::string& parameters);
   double distBetweenImages(const ImageContainer* q1, const ImageContainer* q2);
 private:
@@ -18,6 +18,7 @@
 #ifndef __reranker_hpp__
 #define __reranker_hpp__
 #include <vector>
+#include <algorithm>
 #include "imagecontainer.hpp"
 #include "em.hpp"
 #include "retriever.hpp"
@@ -38,6 +39,16 @@ public:
   
   virtual void setParameters(const std::string&){}
 
+  /// how many images from the top of the ranking have to be passed to
+  /// rerank such that the best wanted images of the reranked list are
+  /// correct
+  virtual uint depth(uint wanted) const {return wanted;}
+
+  /// whether the order of the results depends on the number of
+  /// candidates, i.e. the best n results of a longer list may differ
+  /// from those of a list with n results
+  virtual bool reorders() const {return false;}
+
 };
 
 
@@ -50,6 +61,9 @@ public:
                       const std::vector<ImageContainer*>& negQueries,
                       const std::vector<ResultPair> & oldList, std::vector<ResultPair>& results);
   virtual void setParameters(const std::string& parameters);
+  /// the nConsider_ best images and the score of the next one are needed
+  virtual uint depth(uint wanted) const {return std::max(wanted, uint(nConsider_+2));}
+  virtual bool reorders() const {return true;}
   
 private:
   
@@ -66,6 +80,8 @@ public:
                       const std::vector<ImageContainer*>& negQueries,
                       const std::vector<ResultPair> & oldList, std::vector<ResultPair>& results);
   virtual void setParameters(const std::string& parameters);
+  virtual uint depth(uint wanted) const {return std::max(wanted, uint(nConsider_+2));}
+  virtual bool reorders() const {return true;}
 private:
   Retriever & retriever_;
   int nConsider_,nReRank_;
@@ -81,6 +97,8 @@ public:
                       const std::vector<ImageContainer*>& negQueries,
                       const std::vector<ResultPair> & oldList, std::vector<ResultPair>& results);
   virtual void setParameters(const std::string& parameters);
+  virtual uint depth(uint wanted) const {return std::max(wanted, uint(nConsider_+2));}
+  virtual bool reorders() const {return true;}
 
 protected:
   Retriever &retriever_;
@@ -108,6 +126,8 @@ public:
                       const std::vector<ImageContainer*>& negQueries,
                       const std::vector<ResultPair> & oldList, std::vector<ResultPair>& results);
   virtual void setParameters(const std::string& parameters);
+  virtual uint depth(uint wanted) const {return std::max(wanted, uint(nConsider_+2));}
+  virtual bool reorders() const {return true;}
 private:
   Retriever & retriever_;
   int nConsider_,nReRank_;
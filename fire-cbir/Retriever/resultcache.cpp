@@ -0,0 +1,124 @@
+/*
+ This file is part of the FIRE -- Flexible Image Retrieval System
+
+ FIRE is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ FIRE is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with FIRE; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <sstream>
+#include "resultcache.hpp"
+#include "profiler.hpp"
+
+using namespace std;
+
+ResultCache::ResultCache(size_t capacity) : size_(0), capacity_(capacity), lookups_(0), hits_(0) {
+  pthread_mutex_init(&lock_, NULL);
+}
+
+ResultCache::~ResultCache() {
+  pthread_mutex_destroy(&lock_);
+}
+
+string ResultCache::key(const vector<string>& posQueries, const vector<string>& negQueries) {
+  // the order of the queries is kept, some query combiners weight them differently
+  string result;
+  for(uint i=0;i<posQueries.size();++i) {
+    result+="+"+posQueries[i]+"\n";
+  }
+  for(uint i=0;i<negQueries.size();++i) {
+    result+="-"+negQueries[i]+"\n";
+  }
+  return result;
+}
+
+bool ResultCache::get(const string& key, uint depth, bool prefix, vector<ResultPair>& results) {
+  pthread_mutex_lock(&lock_);
+  ++lookups_;
+  bool found=false;
+  map<string, EntryList::iterator>::iterator it=index_.find(key);
+  if(it!=index_.end()) {
+    const Entry &entry=*(it->second);
+    if(entry.depth==depth || (prefix && depth!=0 && (entry.depth==0 || entry.depth>depth))) {
+      if(depth!=0 && entry.results.size()>depth) {
+        results.assign(entry.results.begin(), entry.results.begin()+depth);
+      } else {
+        results=entry.results;
+      }
+      // most recently used first
+      entries_.splice(entries_.begin(), entries_, it->second);
+      ++hits_;
+      found=true;
+    }
+  }
+  pthread_mutex_unlock(&lock_);
+  Profiler::count("resultcache/lookups");
+  if(found) Profiler::count("resultcache/hits");
+  return found;
+}
+
+void ResultCache::put(const string& key, uint depth, const vector<ResultPair>& results) {
+  pthread_mutex_lock(&lock_);
+  if(results.size()<=capacity_) {
+    map<string, EntryList::iterator>::iterator it=index_.find(key);
+    if(it!=index_.end()) {
+      size_-=it->second->results.size();
+      entries_.erase(it->second);
+      index_.erase(it);
+    }
+    Entry entry;
+    entry.key=key;
+    entry.depth=depth;
+    entries_.push_front(entry);
+    entries_.front().results=results;
+    index_[key]=entries_.begin();
+    size_+=results.size();
+    shrink();
+  }
+  pthread_mutex_unlock(&lock_);
+}
+
+void ResultCache::shrink() {
+  while(size_>capacity_ && !entries_.empty()) {
+    size_-=entries_.back().results.size();
+    index_.erase(entries_.back().key);
+    entries_.pop_back();
+  }
+}
+
+void ResultCache::clear() {
+  pthread_mutex_lock(&lock_);
+  entries_.clear();
+  index_.clear();
+  size_=0;
+  pthread_mutex_unlock(&lock_);
+}
+
+void ResultCache::setCapacity(size_t capacity) {
+  pthread_mutex_lock(&lock_);
+  capacity_=capacity;
+  shrink();
+  pthread_mutex_unlock(&lock_);
+}
+
+size_t ResultCache::capacity() const {
+  return capacity_;
+}
+
+string ResultCache::statistics() const {
+  pthread_mutex_lock(&lock_);
+  ostringstream oss;
+  oss << "lookups " << lookups_ << " hits " << hits_ << " hitrate " << ((lookups_>0) ? double(hits_)/double(lookups_) : 0.0)
+      << " entries " << entries_.size() << " results " << size_ << " capacity " << capacity_;
+  pthread_mutex_unlock(&lock_);
+  return oss.str();
+}
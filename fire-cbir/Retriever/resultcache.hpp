@@ -0,0 +1,101 @@
+/*
+ This file is part of the FIRE -- Flexible Image Retrieval System
+
+ FIRE is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ FIRE is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with FIRE; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __resultcache_hpp__
+#define __resultcache_hpp__
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "topkselector.hpp"
+
+/** ResultCache: the rankings of the most recently used queries.
+
+    The web interface asks for the same query over and over again
+    (next page, back button, the same example images). The rankings
+    are kept here, the least recently used ones are dropped when more
+    than capacity() results are kept in total.
+
+    The key of a query consists of the names of the positive and the
+    negative query images. The settings of the retriever are not part
+    of it, instead the Retriever clears the cache whenever a setting
+    or the database is changed.
+
+    All methods may be called from several threads at the same time.
+ */
+class ResultCache {
+private:
+  struct Entry {
+    ::std::string key;
+    /// the depth the results were retrieved with, 0 = complete ranking
+    uint depth;
+    ::std::vector<ResultPair> results;
+  };
+  typedef ::std::list<Entry> EntryList;
+
+  /// the entries, most recently used first
+  EntryList entries_;
+
+  /// to find the entries by their key
+  ::std::map< ::std::string, EntryList::iterator > index_;
+
+  /// how many results are kept in all entries together, and at most
+  size_t size_, capacity_;
+
+  /// statistics for sizing the cache
+  unsigned long lookups_, hits_;
+
+  mutable pthread_mutex_t lock_;
+
+  /// drop the least recently used entries until at most capacity_ results are kept
+  void shrink();
+
+  // not copyable
+  ResultCache(const ResultCache&);
+  ResultCache& operator=(const ResultCache&);
+
+public:
+  /// constructor, capacity is the number of results kept at most
+  ResultCache(size_t capacity=1000000);
+
+  ~ResultCache();
+
+  /// the key for the query given by positive and negative image names
+  static ::std::string key(const ::std::vector< ::std::string >& posQueries, const ::std::vector< ::std::string >& negQueries);
+
+  /// find the results for key which were retrieved with the given
+  /// depth. If prefix is true, the best depth results of a deeper
+  /// ranking may be used as well.
+  bool get(const ::std::string& key, uint depth, bool prefix, ::std::vector<ResultPair>& results);
+
+  /// keep the results of the query key retrieved with depth
+  void put(const ::std::string& key, uint depth, const ::std::vector<ResultPair>& results);
+
+  /// forget all results, the statistics are kept
+  void clear();
+
+  /// set the number of results kept at most, 0 switches the cache off
+  void setCapacity(size_t capacity);
+  size_t capacity() const;
+
+  /// "lookups <n> hits <n> hitrate <r> entries <n> results <n> capacity <n>"
+  ::std::string statistics() const;
+};
+
+#endif
@@ -21,6 +21,8 @@
 #include <vector>
 #include <stack>
 #include <algorithm>
+#include <pthread.h>
+#include <sys/time.h>
 #include "retriever.hpp"
 #include "dist_metafeature.hpp"
 #include "dist_textfeature.hpp"
@@ -31,10 +33,10 @@
 
 using namespace std;
 
-#include "ScopeTimer.h"
+#include "profiler.hpp"
 
 Retriever::Retriever() :
-  database_(), imageComparator_(), queryCombiner_(new ScoreSumQueryCombiner(*this)), reRanker_(new ReRanker(*this)), results_(0), extensions_(0), interactor_(), filterApply_(false), partialLoadingApply_(false), filter_() {
+  database_(), imageComparator_(), queryCombiner_(new ScoreSumQueryCombiner(*this)), reRanker_(new ReRanker(*this)), results_(0), extensions_(0), interactor_(), filterApply_(false), partialLoadingApply_(false), filter_(), annIndex_(NULL), annApply_(false), annSuffix_(0), annProbes_(1), annLists_(0) {
   scorer_=new LinearScoring();
   //  queryCombiner_=new AddingQueryCombiner(*this);
 }
@@ -42,16 +44,79 @@ Retriever::Retriever() :
 Retriever::~Retriever() {
   delete scorer_;
   delete queryCombiner_;
+  delete annIndex_;
   database_.clear();
 }
 
 void Retriever::initialize() {
   imageComparator_.initialize(database_);
+  openAnn();
+  planFilter();
+}
+
+namespace {
+  double seconds() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec+tv.tv_usec*1e-6;
+  }
+
+  pthread_key_t queryContextKey;
+  pthread_once_t queryContextOnce=PTHREAD_ONCE_INIT;
+
+  void deleteQueryContext(void *context) {
+    delete static_cast<Retriever::QueryContext*>(context);
+  }
+
+  /// the numbers 0..N-1 which are not in sorted
+  void complement(const vector<uint>& sorted, uint N, vector<uint>& result) {
+    result.clear();
+    uint i=0;
+    for (uint k=0; k<sorted.size(); ++k) {
+      for (; i<sorted[k]; ++i) {
+        result.push_back(i);
+      }
+      i=sorted[k]+1;
+    }
+    for (; i<N; ++i) {
+      result.push_back(i);
+    }
+  }
+
+  void createQueryContextKey() {
+    if(pthread_key_create(&queryContextKey, deleteQueryContext)!=0) {
+      ERR << "Cannot create thread specific query context" << endl;
+      exit(20);
+    }
+  }
+}
+
+Retriever::QueryContext& Retriever::queryContext() {
+  pthread_once(&queryContextOnce, createQueryContextKey);
+  QueryContext *context=static_cast<QueryContext*>(pthread_getspecific(queryContextKey));
+  if(!context) {
+    context=new QueryContext();
+    pthread_setspecific(queryContextKey, context);
+  }
+  return *context;
+}
+
+bool Retriever::reentrant() const {
+  if(filterApply_ && partialLoadingApply_) {
+    return false;
+  }
+  if(!queryCombiner_->reentrant()) {
+    return false;
+  }
+  // each thread compares with its own copies of the distances which
+  // keep information about the query, and its own cached distances
+  return imageComparator_.concurrent();
 }
 
 void Retriever::setScoring(const string &scoringname) {
   delete scorer_;
   scorer_=getScoring(scoringname, database_.numberOfSuffices());
+  resultCache_.clear();
 }
 
 void Retriever::setQueryCombiner(const string &queryCombiningName) {
@@ -82,6 +147,7 @@ void Retriever::setQueryCombiner(const string &queryCombiningName) {
     queryCombiner_=new ScoreSumQueryCombiner(*this);
   }
   queryCombiner_->setParameters(queryCombiningName);
+  resultCache_.clear();
 }
 
 void Retriever::setReranking(const string &rerankingName){
@@ -106,6 +172,7 @@ void Retriever::setReranking(const string &rerankingName){
     reRanker_=new ReRanker(*this);
   }
   reRanker_->setParameters(rerankingName);
+  resultCache_.clear();
 }
   
 
@@ -131,7 +198,17 @@ void Retriever::resolveNames(const vector< string > &queryNames, vector<ImageCon
   }
 }
 
-void Retriever::retrieve(const vector< string >& posQueryNames, const vector< string >& negQueryNames, vector<ResultPair>& results) {
+void Retriever::retrieve(const vector< string >& posQueryNames, const vector< string >& negQueryNames, vector<ResultPair>& results, uint depth) {
+
+  // the best results of a deeper ranking can be used unless the
+  // reranker changes the order depending on the number of candidates
+  // the results of a shard also depend on the other shards
+  const bool caching=resultCache_.capacity()>0 && !queryContext().normalizer;
+  const string key=caching ? ResultCache::key(posQueryNames, negQueryNames) : string();
+  if (caching && resultCache_.get(key, depth, !reRanker_->reorders(), results)) {
+    DBG(15) << "results taken from the result cache" << endl;
+    return;
+  }
 
   // get image containers for these images
   vector<ImageContainer*> posQueries;
@@ -142,11 +219,10 @@ void Retriever::retrieve(const vector< string >& posQueryNames, const vector< st
   resolveNames(posQueryNames, posQueries, newCreated);
   resolveNames(negQueryNames, negQueries, newCreated);
 
-  retrieve(posQueries, negQueries, results);
-  
-  vector<ResultPair> tmp;
-  reRanker_->rerank(posQueries, negQueries, results,tmp);
-  results=tmp;
+  retrieveReranked(posQueries, negQueries, results, depth);
+  if (caching) {
+    resultCache_.put(key, depth, results);
+  }
   
   while (!newCreated.empty()) {
     delete newCreated.top();
@@ -154,83 +230,89 @@ void Retriever::retrieve(const vector< string >& posQueryNames, const vector< st
   }
 }
 
+void Retriever::retrieveReranked(const vector<ImageContainer*>& posQueries, const vector<ImageContainer*>& negQueries, vector<ResultPair>& results, uint depth) {
+  // the reranker may need more candidates than are finally returned
+  uint candidates=0;
+  if (depth!=0) {
+    candidates=reRanker_->depth(depth);
+  }
+  retrieve(posQueries, negQueries, results, candidates);
+  
+  vector<ResultPair> tmp;
+  reRanker_->rerank(posQueries, negQueries, results,tmp);
+  results=tmp;
+  // rerankers change the scores of the candidates, only this short list has to be sorted again
+  sort(results.rbegin(), results.rend());
+  if (depth!=0 && results.size()>depth) {
+    results.resize(depth);
+  }
+}
+
 void Retriever::getScores(const ImageContainer* q, vector<double>&scores) {
 
-  ScopeTimer st1((char*)"Retriever::getScores");
+  ProfileScope st1("Retriever::getScores");
 
   uint N=database_.size();
   uint M=database_.numberOfSuffices();
 
-  vector< vector<double> > distMatrix(N, vector<double>(M));
-  vector<double> imgDists;
+  // one column per distance, reused from the previous query of this thread
+  DistanceMatrix &distMatrix=queryContext().distances;
+  distMatrix.resize(N, M);
 
-  // from here, we want parallelization using OpenMP
-#pragma omp parallel
-  {
-    //get distance to each of the database images
-    { // begin "get distance" scope
-      ScopeTimer st2((char*)"Retriever::getScores -> get distance");
-
-      //this next llop can be done in parallel
-      //but each of the threads needs its own imgDists vector
-      //all the other variables (q,database_[i]) are readonly
-      //when doing things parallel: take care with static, shared mem
-#pragma omp for schedule(static) private(imgDists)
-      for (long i=0; i<long(N); ++i) {
-        vector<double>&d=distMatrix[i];
-        imgDists=imageComparator_.compare(q, database_[i]);
-        for (long j=0; j<long(M); ++j) {
-          d[j]=imgDists[j];
-        }
-      }
-
-      //here we wait until all threads have finished.
-      //that is, distMatrix is completely
-      //this is called barrier; to enforce this manually: #pragma omp barrier
-    } // end "get distance" scope
+  vector<uint> candidates;
+  if (annCandidates(q, candidates)) {
+    // only the candidates of the index are compared, all others get
+    // larger distances than the candidates
+    vector<uint> others;
+    complement(candidates, N, others);
+    for (uint j=0; j<M; ++j) {
+      getDistances(q, candidates, others, distMatrix, j);
+    }
+    getScores(distMatrix, scores);
+    return;
+  }
 
+  // from here, we want parallelization using OpenMP. The scopes are
+  // around the parallel regions, they measure the time of all threads
+  { // begin "get distance" scope
+    ProfileScope st2("distances");
+
+    //this next llop can be done in parallel
+    //each thread compares the query to blocks of database images,
+    //such that the distances can work on many images at once
+    //all the other variables (q,database_[i]) are readonly
+    //when doing things parallel: take care with static, shared mem
+    //the threads work for the query of this thread and use its session
+    const long blockSize=256;
+    const long nBlocks=(long(N)+blockSize-1)/blockSize;
+    ImageComparator::Session& session=imageComparator_.session();
+#pragma omp parallel for schedule(static)
+    for (long b=0; b<nBlocks; ++b) {
+      imageComparator_.compare(session, q, database_, b*blockSize, min(long(N), (b+1)*blockSize), distMatrix);
+    }
+  } // end "get distance" scope
 
-    //normalize the distances
-    { // begin "normalize" scope
-      ScopeTimer st3((char*)"Retriever::getScores -> normalize");
+  //normalize the distances
+  { // begin "normalize" scope
+    ProfileScope st3("normalize");
 
-      //this next loop is parallelized, too. note that loop-local
-      //variables are not problematic, as they are instantiated for each
-      //thread
-#pragma omp for schedule(static)
-      for (long j=0; j<long(M); ++j) {
-        double sum=0.0;
-        for (long i=0; i<long(N); ++i) {
-          sum+=distMatrix[i][j];
-        }
-        sum/=double(N);
-        if (sum!=0.0) {
-          double tmp=1/sum;
-          for (long i=0; i<long(N); ++i) {
-            distMatrix[i][j]*=tmp;
-          }
-        }
-      }
-    } // end "normalize" scope
-  } // end omp parallel
+    //the columns are shared among the threads
+    if (!normalizeGlobally(distMatrix)) {
+#pragma omp parallel
+      distMatrix.normalizeColumns();
+    }
+  } // end "normalize" scope
 
   // here: distance interactions: this is still quite buggy
   { // begin "interactor" scope
-    ScopeTimer st4((char*)"Retriever::getScores -> interactor.apply()");
+    ProfileScope st4("interactor");
     interactor_.apply(distMatrix);
   } // end "interactor" scope
 
   //now get the scores
   { // begin "get the scores" scope
-    ScopeTimer st5((char*)"Retriever::getScores -> get the scores");
-    for (uint i=0; i<N; ++i) {
-      DBG(105) << "DISTS:";
-      for (uint j=0; j<M; ++j) {
-        BLINK(105) << distMatrix[i][j] << " ";
-      }
-      scores[i]=scorer_->getScore(distMatrix[i]);
-      BLINK(105) << "->" << scores[i] << endl;
-    }
+    ProfileScope st5("scoring");
+    scorer_->getScores(distMatrix, scores);
   } // end "get the scores" scope
 }
 
@@ -241,8 +323,6 @@ void Retriever::saveDistances(string imagename, string filename) {
   uint N=database_.size();
   uint M=database_.numberOfSuffices();
   bool newlyLoaded=false;
-  vector< vector<double> > distMatrix(N, vector<double>(M));
-  vector<double> imgDists;
 
   ImageContainer *q=database_.getByName(imagename);
   if (!q) {
@@ -257,31 +337,15 @@ void Retriever::saveDistances(string imagename, string filename) {
       newlyLoaded=true;
     }
   }
+  DistanceMatrix &distMatrix=queryContext().distances;
+  distMatrix.resize(N, M);
   imageComparator_.start(q);
   //get distance to each of the database images
-  for (uint i=0; i<N; ++i) {
-    vector<double>&d=distMatrix[i];
-    imgDists=imageComparator_.compare(q, database_[i]);
-    for (uint j=0; j<M; ++j) {
-      d[j]=imgDists[j];
-    }
-  }
+  imageComparator_.compare(q, database_, 0, N, distMatrix);
   imageComparator_.stop();
 
   //normalize
-  for (uint j=0; j<M; ++j) {
-    double sum=0.0;
-    for (uint i=0; i<N; ++i) {
-      sum+=distMatrix[i][j];
-    }
-    sum/=double(N);
-    if (sum!=0.0) {
-      double tmp=1/sum;
-      for (uint i=0; i<N; ++i) {
-        distMatrix[i][j]*=tmp;
-      }
-    }
-  }
+  distMatrix.normalizeColumns();
 
   /*----------------------------------------------------------------------
    * save distance matrix
@@ -310,7 +374,7 @@ void Retriever::saveDistances(string imagename, string filename) {
       for (uint i=0; i<N; ++i) {
         os << i;
         for (uint j=0; j<M; ++j) {
-          os << " "<<distMatrix[i][j];
+          os << " "<<distMatrix(i,j);
         }
         os << endl;
       }
@@ -326,14 +390,25 @@ void Retriever::saveDistances(string imagename, string filename) {
 
 // fill the distance matrix taking into account that some distance have NOT been calculated.
 // put 1.2*maxdist into these positions
-void Retriever::getDistances(const ImageContainer* q, const vector<uint>& stillToConsider, const vector<uint>& depreciated, vector< vector<double> >& distMatrix, const uint distanceID) {
-  double imgDist;
+void Retriever::getDistances(const ImageContainer* q, const vector<uint>& stillToConsider, const vector<uint>& depreciated, DistanceMatrix& distMatrix, const uint distanceID) {
   double maxDist = 0.0;
+  double *d = distMatrix.column(distanceID);
+
+  // the images are compared in blocks as in getScores, the blocks are
+  // smaller and scheduled dynamically since the later stages usually
+  // have few images and expensive distances
+  const long count=stillToConsider.size();
+  const long blockSize=32;
+  const long nBlocks=(count+blockSize-1)/blockSize;
+  ImageComparator::Session& session=imageComparator_.session();
+#pragma omp parallel for schedule(dynamic)
+  for (long b=0; b<nBlocks; ++b) {
+    const long from=b*blockSize;
+    imageComparator_.compare(session, q, database_, distanceID, &stillToConsider[from], min(count, from+blockSize)-from, d);
+  }
 
-  for (long i=0; i<long(stillToConsider.size()); ++i) {
-    imgDist = imageComparator_.compare(q, database_[stillToConsider[i]], distanceID);
-    distMatrix[stillToConsider[i]][distanceID] = imgDist;
-    maxDist = max(maxDist, imgDist);
+  for (long i=0; i<count; ++i) {
+    maxDist = max(maxDist, d[stillToConsider[i]]);
   }
 
   // beware: here an overflow might occur !
@@ -341,107 +416,197 @@ void Retriever::getDistances(const ImageContainer* q, const vector<uint>& stillT
 
   // now we set the distance matrix values for the unwanted images
   for (long j=0; j<long(depreciated.size()); ++j) {
-    distMatrix[depreciated[j]][distanceID] = maxDist;
+    d[depreciated[j]] = maxDist;
   }
 }
 
 void Retriever::getBest(vector<uint> &stillToConsider, vector<uint> &depreciated, const vector<double> &scores, uint &amount) {
 
-  uint imageSize = stillToConsider.size();
-  vector<ResultPair> toSort;
-  uint img;
-  for (uint i=0; i<imageSize; ++i) {
-    img = stillToConsider[i];
-    toSort.push_back(ResultPair(scores[img], img));
+  if (amount > stillToConsider.size()) {
+    amount = stillToConsider.size();
   }
 
-  // sorting indizies according to scores
-  sort(toSort.rbegin(), toSort.rend());
+  // select the best images, the others are appended to depreciated
+  vector<ResultPair> best;
+  selectTopK(scores, stillToConsider, amount, best, &depreciated);
 
-  if (amount > imageSize) {
-    amount = imageSize;
+  stillToConsider.clear();
+  for (uint j=0; j<best.size(); ++j) {
+    stillToConsider.push_back(best[j].second);
   }
+}
 
-  // tmp construct
-  vector<uint> imageTmp;
-  for (uint j=0; j<amount; ++j) {
-    img = toSort[j].second;
-    imageTmp.push_back(img);
+bool Retriever::normalizeGlobally(DistanceMatrix &distMatrix) const {
+  Normalizer *normalizer=queryContext().normalizer;
+  if (!normalizer) {
+    return false;
   }
-
-  for (uint i=amount; i<imageSize; ++i) {
-    img = toSort[i].second;
-    depreciated.push_back(img);
+  vector<double> sums, means;
+  distMatrix.columnSums(sums);
+  if (!normalizer->means(sums, distMatrix.rows(), means)) {
+    means.resize(sums.size());
+    for (uint j=0; j<sums.size(); ++j) {
+      means[j]=sums[j]/double(distMatrix.rows());
+    }
   }
+  distMatrix.divideColumns(means);
+  return true;
+}
 
-  // swap contents of tmp construct and real construct
-  swap(stillToConsider, imageTmp);
+void Retriever::getScores(DistanceMatrix &distMatrix, vector<double> &scores) {
+  if (!normalizeGlobally(distMatrix)) {
+    distMatrix.normalizeColumns();
+  }
+  interactor_.apply(distMatrix);
+  scorer_->getScores(distMatrix, scores);
 }
 
-void Retriever::getScores(vector<vector<double> > &distMatrix, vector<double> &scores) {
+void Retriever::getFilteredScores(const ImageContainer* q, vector<double> &scores) {
   uint N=database_.size();
   uint M=database_.numberOfSuffices();
 
-  scores=vector<double>(N, 0.0);
-
-  for (long j=0; j<long(M); ++j) {
-    double sum=0.0;
-    for (long i=0; i<long(N); ++i) {
-      sum+=distMatrix[i][j];
+  // the stillToConsider vector contains the best images of the previous stages,
+  // the depreciated vector contains the remaining database images
+  vector<uint> stillToConsider;
+  vector<uint> depreciated;
+  if (annCandidates(q, stillToConsider)) {
+    complement(stillToConsider, N, depreciated);
+  } else {
+    stillToConsider.resize(N);
+    for (uint i=0; i<N; ++i) {
+      stillToConsider[i]=i;
     }
-    sum/=double(N);
-    if (sum!=0.0) {
-      double tmp=1/sum;
-      for (long i=0; i<long(N); ++i) {
-        distMatrix[i][j]*=tmp;
+  }
+
+  // initial value for the distances. Distances not computed yet have
+  // this value for all images and thus do not change the ranking
+  const double initDummyDist = 100.0;
+  DistanceMatrix &distMatrix=queryContext().distances;
+  distMatrix.resize(N, M);
+  distMatrix.fill(initDummyDist);
+  scores.resize(N);
+
+  if (imageComparator_.size() != q->numberOfFeatureSets()) {
+    ERR << "ImageComparator has different number of distances (" << imageComparator_.size() << ") than query " << q->basename() << " (" << q->numberOfFeatureSets() << ")." << endl;
+  }
+
+  for (uint s=0; s<filter_.size(); ++s) {
+    const FilterStage &stage=filter_[s];
+    const uint candidates=stillToConsider.size();
+    double start=seconds();
+
+    for (uint k=0; k<stage.distances.size(); ++k) {
+      const uint id=stage.distances[k];
+      if (id>=M || id>=imageComparator_.size()) {
+        ERR << "Filter stage " << s << " uses distance " << id << " but there are only " << M << " features." << endl;
+        continue;
+      }
+      // first check whether or not feature information has to be loaded into
+      // the database
+      const bool partial=partialLoadingApply_ && database_.binFilesNotToLoad(id);
+      if (partial) {
+        DBG(105) << "DEBUG Load from LBFF with idx " << id << endl;
+        database_.loadFromLBFF(id, stillToConsider);
+      }
+      imageComparator_.start(q, id);
+      getDistances(q, stillToConsider, depreciated, distMatrix, id);
+      imageComparator_.stop(id);
+      // remove the loaded feature information as early as possible
+      if (partial) {
+        database_.removeFeatureInformation(id, stillToConsider);
       }
     }
+    getScores(distMatrix, scores);
+
+    uint keep=stage.keep;
+    getBest(stillToConsider, depreciated, scores, keep);
+    DBG(10) << "Filter stage " << s+1 << "/" << filter_.size() << " (distances ";
+    for (uint k=0; k<stage.distances.size(); ++k) {
+      BLINK(10) << (k ? "," : "") << stage.distances[k];
+    }
+    BLINK(10) << "): " << candidates << " -> " << stillToConsider.size() << " images in " << (seconds()-start)*1000 << " ms" << endl;
   }
+}
 
-  interactor_.apply(distMatrix);
+void Retriever::planFilter() {
+  uint N=database_.size();
+  uint M=imageComparator_.size();
+  if (autoFilter_.empty() || N==0 || M==0 || M!=database_.numberOfSuffices()) {
+    return;
+  }
+  if (partialLoadingApply_) {
+    ERR << "The filter cannot be planned with partial loading, the features might be missing." << endl;
+    return;
+  }
 
-  for (uint i=0; i<N; ++i) {
-    DBG(105) << "DISTS:";
-    for (uint j=0; j<M; ++j) {
-      BLINK(105) << distMatrix[i][j] << " ";
+  // measure the costs of the distances, the first database image is the query
+  const uint sample=min(N, 64u);
+  vector<uint> rows(sample);
+  for (uint i=0; i<sample; ++i) {
+    rows[i]=uint(double(i)*N/sample);
+  }
+  vector<double> column(N);
+  const ImageContainer *q=database_[0];
+  const LinearScoring *linear=dynamic_cast<LinearScoring*>(scorer_);
+
+  vector< pair<double,uint> > costs;
+  for (uint j=0; j<M; ++j) {
+    if (linear && linear->weight(j)==0.0) {
+      continue;
     }
-    scores[i]=scorer_->getScore(distMatrix[i]);
-    BLINK(105) << "->" << scores[i] << endl;
+    double start=seconds();
+    imageComparator_.start(q, j);
+    imageComparator_.compare(q, database_, j, &rows[0], sample, &column[0]);
+    imageComparator_.stop(j);
+    costs.push_back(make_pair((seconds()-start)/sample, j));
   }
+  sort(costs.begin(), costs.end());
+
+  // distances up to this factor slower than the cheapest one are in the first stage
+  const double cheapFactor=10.0;
+  filter_.clear();
+  for (uint c=0; c<costs.size(); ++c) {
+    if (filter_.empty() || costs[c].first>cheapFactor*costs[0].first) {
+      FilterStage stage;
+      stage.keep=autoFilter_[min(uint(filter_.size()), uint(autoFilter_.size()-1))];
+      filter_.push_back(stage);
+    }
+    filter_.back().distances.push_back(costs[c].second);
+    DBG(10) << "distance " << costs[c].second << " " << imageComparator_.distance(costs[c].second)->name() << ": " << costs[c].first*1e6 << " us per image, filter stage " << filter_.size() << endl;
+  }
+  resultCache_.clear();
+  DBG(10) << "Planned filter: " << filterString() << endl;
 }
 
-void Retriever::retrieve(const vector<ImageContainer*>& posQueries, const vector<ImageContainer*>& negQueries, vector<ResultPair>& results) {
+void Retriever::retrieve(const vector<ImageContainer*>& posQueries, const vector<ImageContainer*>& negQueries, vector<ResultPair>& results, uint depth) {
 
   uint N=database_.size();
   vector<double> activeScores(N, 0.0);
-  //init result field
-  results.clear();
-  for (uint i=0; i<database_.size(); ++i) {
-    results.push_back(ResultPair(0.0, i));
+  // combined score for each database image, ranking is done at the very end
+  vector<double> scores(N, 0.0);
+  if (depth==0 || depth>N) {
+    depth=N;
   }
   if (!filterApply_) {
     //positive queries
 
-    queryCombiner_->query(posQueries, negQueries, results);
+    queryCombiner_->query(posQueries, negQueries, scores);
 
     //check whether query expansion has to be done
     if (extensions_!=0) {
       //if query expansion has to be done:
-      // get ranks
-      sort(results.rbegin(), results.rend());
+      // get the best extensions_ images
+      selectTopK(scores, extensions_, results);
 
       vector<ImageContainer*> expansion;
 
       //copy extensions_ into positive queries
-      for (uint i=0; i<extensions_; ++i) {
+      for (uint i=0; i<results.size(); ++i) {
         expansion.push_back(database_[results[i].second]);
       }
 
-      //init result field
-      results.clear();
-      for (uint i=0; i<N; ++i) {
-        results.push_back(ResultPair(0.0, i));
-      }
+      //init score field
+      fill(scores.begin(), scores.end(), 0.0);
 
       // and requery using these positive queries
       for (uint q=0; q<expansion.size(); ++q) {
@@ -449,172 +614,59 @@ void Retriever::retrieve(const vector<ImageContainer*>& posQueries, const vector
         getScores(expansion[q], activeScores);
         imageComparator_.stop();
         for (uint i=0; i<N; ++i) {
-          results[i].first+=activeScores[i];
+          scores[i]+=activeScores[i];
         }
       }
     }
   } else { // filterApply=true
-
-    // the stillToConsider vector contains the best images as results of the filtered retrieval
-    // and this vector is reused through out the filtered retrieval
-    // in analogous fashion the neqimages vector contains the remaining database images
-    vector<uint> stillToConsider;
-    vector<uint> depreciated;
-
-    // initial value for the distances. this value is used to ensure that the distance matrix
-    // contains in every step definied values and not just memory garbage
-    const double initDummyDist = 100.0;
-    uint lbffidx=0;
-    uint M = database_.numberOfSuffices();
+    vector<double> activeScores(N, 0.0);
 
     //positive queries
     for (long q=0; q<long(posQueries.size()); ++q) {
-
-      vector< vector <double> > distMatrix(N, vector<double>(M, initDummyDist));
-      for (uint i=0; i<N; ++i) {
-        stillToConsider.push_back(i);
-      }
-      vector<double> activeScores(N, 0.0);
-
       DBG(10) << "Positive query: " << posQueries[q]->basename() << endl;
-      if (imageComparator_.size() != posQueries[q]->numberOfFeatureSets()) {
-        ERR << "ImageComparator has different number of distances (" << imageComparator_.size() << ") than positive query " << q << " (" << posQueries[q]->numberOfFeatureSets() << ")." << endl;
-      }
-      for (uint i=0; i<filter_.size(); ++i) {
-        DBG(20) << "Filtering " << i+1 << "/" << filter_.size()<< ":  " <<filter_[i].first << ":" << filter_[i].second << endl;
-        // first check whether or not feature information has to be loaded into
-        // the database
-        if (partialLoadingApply_) {
-          // check if the current feature is not loaded
-          lbffidx=filter_[i].first;
-          if (database_.binFilesNotToLoad(lbffidx)) {
-            DBG(105) << "DEBUG Load from LBFF with idx " << lbffidx << endl;
-            database_.loadFromLBFF(lbffidx, stillToConsider);
-          }
-        }
-        imageComparator_.start(posQueries[q], filter_[i].first);
-        getDistances(posQueries[q], stillToConsider, depreciated, distMatrix, filter_[i].first);
-        imageComparator_.stop(filter_[i].first);
-        getScores(distMatrix, activeScores);
-        // remove the loaded feature information if partial loading
-        // doing this as early as possible
-        if (partialLoadingApply_ && database_.binFilesNotToLoad(lbffidx)) {
-          database_.removeFeatureInformation(lbffidx, stillToConsider);
-        }
-        getBest(stillToConsider, depreciated, activeScores, filter_[i].second);
-      }
-
+      getFilteredScores(posQueries[q], activeScores);
       for (uint i=0; i<N; ++i) {
-        results[i].first+=activeScores[i];
+        scores[i]+=activeScores[i];
       }
-
-      // cleaning memory for next iteration
-      stillToConsider.clear();
-      depreciated.clear();
-      distMatrix.clear();
-    } // end for loop for positive queries
+    }
 
     //negative queries
     for (long q=0; q<long(negQueries.size()); ++q) {
-
-      vector< vector <double> > distMatrix(N, vector<double>(M, initDummyDist));
-      for (uint i=0; i<N; ++i) {
-        stillToConsider.push_back(i);
-      }
-      vector<double> activeScores(N, 0.0);
-
       DBG(10) << "Negative query: " << negQueries[q]->basename() << endl;
-      if (imageComparator_.size() != negQueries[q]->numberOfFeatureSets()) {
-        ERR << "ImageComparator has different number of distances (" << imageComparator_.size() << ") than negative query " << q << " (" << negQueries[q]->numberOfFeatureSets() << ")." << endl;
-      }
-      for (uint i=0; i<filter_.size(); ++i) {
-        // first check whether or not feature information has to be loaded into
-        // the database
-        if (partialLoadingApply_) {
-          // check if the current feature is not loaded
-          lbffidx=filter_[i].first;
-          if (database_.binFilesNotToLoad(lbffidx)) {
-            database_.loadFromLBFF(lbffidx, stillToConsider);
-          }
-        }
-        imageComparator_.start(negQueries[q], filter_[i].first);
-        getDistances(negQueries[q], stillToConsider, depreciated, distMatrix, filter_[i].first);
-        imageComparator_.stop(filter_[i].first);
-        getScores(distMatrix, activeScores);
-        if (partialLoadingApply_ && database_.binFilesNotToLoad(lbffidx)) {
-          database_.removeFeatureInformation(lbffidx, stillToConsider);
-        }
-        getBest(stillToConsider, depreciated, activeScores, filter_[i].second);
-      }
-
+      getFilteredScores(negQueries[q], activeScores);
       for (uint i=0; i<N; ++i) {
-        results[i].first+=(1-activeScores[i]);
+        scores[i]+=(1-activeScores[i]);
       }
-
-      // cleaning memory for next iteration
-      stillToConsider.clear();
-      depreciated.clear();
-      distMatrix.clear();
-    } // end negative query
+    }
 
     //check whether query expansion has to be done
     if (extensions_!=0) {
       //if query expansion has to be done:
-      // get ranks
-      sort(results.rbegin(), results.rend());
+      // get the best extensions_ images
+      selectTopK(scores, extensions_, results);
 
       vector<ImageContainer*> expansion;
 
       //copy extensions_ into positive queries
-      for (uint i=0; i<extensions_; ++i) {
+      for (uint i=0; i<results.size(); ++i) {
         expansion.push_back(database_[results[i].second]);
       }
 
-      //init result field
-      results.clear();
-      for (uint i=0; i<N; ++i) {
-        results.push_back(ResultPair(0.0, i));
-      }
+      //init score field
+      fill(scores.begin(), scores.end(), 0.0);
 
       // and requery using these positive queries
       for (uint q=0; q<expansion.size(); ++q) {
-
-        vector< vector <double> > distMatrix(N, vector<double>(M, initDummyDist));
-        for (uint i=0; i<N; ++i) {
-          stillToConsider.push_back(i);
-        }
-
-        for (uint i=0; i<filter_.size(); ++i) {
-          // first check whether or not feature information has to be loaded into
-          // the database
-          if (partialLoadingApply_) {
-            // check if the current feature is not loaded
-            lbffidx=filter_[i].first;
-            if (database_.binFilesNotToLoad(lbffidx)) {
-              database_.loadFromLBFF(lbffidx, stillToConsider);
-            }
-          }
-          imageComparator_.start(expansion[q], filter_[i].first);
-          getDistances(expansion[q], stillToConsider, depreciated, distMatrix, filter_[i].first);
-          imageComparator_.stop(filter_[i].first);
-          getScores(distMatrix, activeScores);
-          if (partialLoadingApply_ && database_.binFilesNotToLoad(lbffidx)) {
-            database_.removeFeatureInformation(lbffidx, stillToConsider);
-          }
-          getBest(stillToConsider, depreciated, activeScores, filter_[i].second);
-        }
-
+        getFilteredScores(expansion[q], activeScores);
         for (uint i=0; i<N; ++i) {
-          results[i].first+=activeScores[i];
+          scores[i]+=activeScores[i];
         }
-
-        // cleaning memory for next iteration
-        stillToConsider.clear();
-        depreciated.clear();
-        distMatrix.clear();
       }
     } // end extensions
   } // end else
+
+  // get the ranking, only the best depth images are sorted
+  selectTopK(scores, depth, results);
   DBG(15) << "end retrieve" << endl;
 }
 
@@ -782,7 +834,8 @@ vector<ResultPair> Retriever::textretrieve(const string& query) {
   for (unsigned int i=0; i<M; ++i) {
     dist_name = imageComparator_.distance(i)->name();
     if (dist_name=="textfeature") {
-      tfd = (TextFeatureDistance*)imageComparator_.distance(i);
+      // the retrieval status values of the query are kept in the copy of this thread
+      tfd = (TextFeatureDistance*)imageComparator_.queryDistance(i);
       textdists[tfd->language()] = tfd;
       textdistindices[tfd->language()] = i;
       DBG(10) << "found " << tfd->language() << " at index " << i << endl;
@@ -1002,6 +1055,10 @@ vector<ResultPair> Retriever::textretrieve(const string& query) {
 
 string Retriever::dist(const uint idx, BaseDistance* dist) {
   imageComparator_.distance(idx, dist);
+  resultCache_.clear();
+  // an automatic filter depends on the costs and weights of the
+  // distances, plan it anew. A filter set by hand is kept
+  planFilter();
   ostringstream oss("");
   oss << "dist " << idx << " " << dist->name();
   return oss.str();
@@ -1012,6 +1069,8 @@ string Retriever::weight(const uint idx, const double w) {
   ostringstream oss("");
   if (s) {
     s->weight(idx)=w;
+    resultCache_.clear();
+    planFilter();
     oss << "weight " << idx << " " << w;
   } else {
     oss << "setting weight not supported";
@@ -1022,6 +1081,10 @@ string Retriever::weight(const uint idx, const double w) {
 string Retriever::filelist(const string filelist, string partialLoadingString) {
   DBG(10) << "Reading filelist: " << filelist << endl;
   database_.clear();
+  resultCache_.clear();
+  delete annIndex_;
+  annIndex_=NULL;
+  filelistName_=filelist;
   uint nr=database_.loadFileList(filelist);
   if (nr<=0) {
     return "filelist FAILURE";
@@ -1053,6 +1116,7 @@ string Retriever::results(const uint res) {
 
 string Retriever::extensions(const uint ext) {
   extensions_=ext;
+  resultCache_.clear();
   ostringstream oss("");
   oss << "extensions = " << extensions_;
   return oss.str();
@@ -1130,6 +1194,13 @@ string Retriever::info() const {
   for(uint i=0;i<imageComparator_.size() and i<database_.numberOfSuffices();++i) {
     oss << " suffix "<< i << " " << database_.suffix(i) << " " <<imageComparator_.distance(i)->name();
   }
+  if (filterApply_) {
+    oss << " filter " << filterString();
+  }
+  if (annIndex_) {
+    oss << " ann " << annSuffix_ << " probes " << annProbes_ << " lists " << annIndex_->lists();
+  }
+  oss << " resultcache " << resultCache_.statistics();
   return oss.str();
 }
 
@@ -1215,14 +1286,98 @@ uint Retriever::numberOfFilelistEntries() const {
 
     void Retriever::setFilterApply(bool apply) {
       filterApply_ = apply;
+      resultCache_.clear();
     }
 
-    void Retriever::setFilter(vector< pair<uint,uint> > filter) {
+    void Retriever::setFilter(const vector<FilterStage>& filter) {
       filter_ = filter;
+      autoFilter_.clear();
+      resultCache_.clear();
+    }
+
+    void Retriever::setAutoFilter(const vector<uint>& keep) {
+      filter_.clear();
+      autoFilter_ = keep;
+      resultCache_.clear();
+      planFilter();
+    }
+
+    string Retriever::filterString() const {
+      ostringstream oss;
+      for (uint s=0; s<filter_.size(); ++s) {
+        if (s) oss << "-";
+        for (uint k=0; k<filter_[s].distances.size(); ++k) {
+          if (k) oss << ",";
+          oss << filter_[s].distances[k];
+        }
+        oss << ":" << filter_[s].keep;
+      }
+      return oss.str();
+    }
+
+    void Retriever::setAnn(uint suffix, uint probes, uint lists) {
+      annApply_=true;
+      annSuffix_=suffix;
+      annProbes_=probes;
+      annLists_=lists;
+      openAnn();
+    }
+
+    void Retriever::clearAnn() {
+      annApply_=false;
+      delete annIndex_;
+      annIndex_=NULL;
+      resultCache_.clear();
+    }
+
+    void Retriever::openAnn() {
+      delete annIndex_;
+      annIndex_=NULL;
+      resultCache_.clear();
+      if (!annApply_ || database_.size()==0) {
+        return;
+      }
+      if (annSuffix_>=database_.numberOfSuffices()) {
+        ERR << "No suffix " << annSuffix_ << " for the approximate nearest neighbour index" << endl;
+        return;
+      }
+
+      annIndex_=new AnnIndex();
+      string filename=filelistName_+"."+database_.suffix(annSuffix_)+".ivf";
+      if (filelistName_!="" && annIndex_->load(filename, database_, annSuffix_) &&
+          (annLists_==0 || annLists_==annIndex_->lists())) {
+        return;
+      }
+      if (!annIndex_->build(database_, annSuffix_, annLists_)) {
+        delete annIndex_;
+        annIndex_=NULL;
+        return;
+      }
+      if (filelistName_!="") {
+        annIndex_->save(filename);
+      }
+    }
+
+    bool Retriever::annCandidates(const ImageContainer* q, vector<uint>& candidates) const {
+      if (!annIndex_ || annSuffix_>=q->numberOfFeatureSets()) {
+        return false;
+      }
+      const FeatureSet* fs=(*q)[annSuffix_];
+      if (!fs || fs->feature_count()!=1 || !annIndex_->search((*fs)[0], annProbes_, candidates)) {
+        return false;
+      }
+      // images added to the database after the index was built are always compared
+      for (uint i=annIndex_->size(); i<database_.size(); ++i) {
+        candidates.push_back(i);
+      }
+      DBG(20) << candidates.size() << " candidates from the index for " << q->basename() << endl;
+      return true;
     }
 
     void Retriever::clearFilter() {
       filter_.clear();
+      autoFilter_.clear();
+      resultCache_.clear();
     }
 
     bool Retriever::setPartialLoadingApply(bool apply) {
@@ -1261,12 +1416,16 @@ uint Retriever::numberOfFilelistEntries() const {
           }
           // now ensure that the bit representing the first feature selected in the filter
           // is not set
-          dontLoad[filter_[0].first]=false;
+          for (uint k=0; k<filter_[0].distances.size(); ++k) {
+            dontLoad[filter_[0].distances[k]]=false;
+          }
           database_.setNotToLoad(dontLoad);
         } else { //default partial loading i.e. all features specified in the filter will be loaded
           vector<bool> dontLoad(suffSize, true);
           for (uint i=0; i<filter_.size(); ++i) {
-            dontLoad[filter_[i].first]=false;
+            for (uint k=0; k<filter_[i].distances.size(); ++k) {
+              dontLoad[filter_[i].distances[k]]=false;
+            }
           }
           database_.setNotToLoad(dontLoad);
         }
@@ -1292,5 +1451,20 @@ uint Retriever::numberOfFilelistEntries() const {
       ImageContainer *t=new ImageContainer(filename, database_.numberOfSuffices());
       database_.loadQuery(filename, t);
       database_.addToDatabase(filename, t);
+      resultCache_.clear();
+
+    }
+
+    ImageContainer* Retriever::makeQuery(const string &filename, const vector<BaseFeature*>& extracted) {
+      ImageContainer *q=new ImageContainer(filename, database_.numberOfSuffices());
+      if (!database_.loadQuery(filename, q, extracted)) {
+        delete q;
+        return NULL;
+      }
+      return q;
+    }
 
+    void Retriever::addToDatabase(const string &filename, ImageContainer *image) {
+      database_.addToDatabase(filename, image);
+      resultCache_.clear();
     }
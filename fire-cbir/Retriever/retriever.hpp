@@ -30,9 +30,9 @@
 #include "svmscoring.hpp"
 #include "getscoring.hpp"
 #include "distanceinteractor.hpp"
-
-
-typedef ::std::pair<double,uint> ResultPair;
+#include "topkselector.hpp"
+#include "resultcache.hpp"
+#include "annindex.hpp"
 
 
 class Retriever;
@@ -86,6 +86,17 @@ class ReRanker;
  */
 class Retriever {
 
+public:
+
+  /// one stage of a filtered retrieval: the distances computed for
+  /// the images that are still considered and how many of the best
+  /// images (according to all distances computed so far) are kept for
+  /// the next stage
+  struct FilterStage {
+    ::std::vector<uint> distances;
+    uint keep;
+  };
+
 private:
 
   /// this database object holds the database of images from which we retrieve images
@@ -126,11 +137,40 @@ private:
   /// if filterApply_ is notset and partialLoadingApply_ is set this is an error
   bool partialLoadingApply_;
 
-  /// a pair containing in first postion which distance should be used and
-  /// in second position how many best images will be used for further
-  /// retrieval. Example filter_.first = 0 and filter_.second = 1000
-  /// means that the 1000 best images regarding distance 0 will be used
-  ::std::vector< ::std::pair<uint,uint> > filter_;
+  /// the stages of filtered retrieval. Example: a first stage with
+  /// distances 0 and 1 keeping 1000 images means that the 1000 best
+  /// images regarding distances 0 and 1 will be used in the second stage
+  ::std::vector<FilterStage> filter_;
+
+  /// if not empty, filter_ is planned by planFilter() from the measured
+  /// costs of the distances and these are the numbers of images kept
+  /// after the first, second, ... stage
+  ::std::vector<uint> autoFilter_;
+
+  /// the results of recent queries. It is cleared whenever a setting
+  /// that changes the results or the database is changed.
+  ResultCache resultCache_;
+
+  /// the approximate nearest neighbour index which preselects the
+  /// images compared with a query, NULL if none is used
+  AnnIndex* annIndex_;
+
+  /// whether an index is to be used, for which suffix, how many of
+  /// its lists are searched and how many lists it is built with
+  /// (0: default)
+  bool annApply_;
+  uint annSuffix_, annProbes_, annLists_;
+
+  /// the name of the filelist, the index files are saved next to it
+  ::std::string filelistName_;
+
+  /// load the index for annSuffix_ or build and save it if there is
+  /// none that fits the database
+  void openAnn();
+
+  /// the database images the index proposes for q in increasing order.
+  /// Returns false if no index is used or it cannot be used for q.
+  bool annCandidates(const ImageContainer* q, ::std::vector<uint>& candidates) const;
 
   /**
    * given the queries, find the appropriate ImageContainers. If a
@@ -148,15 +188,68 @@ private:
    * given vectors stillToConsider containing the best images in regard to score of the
    * preceeding filtering steps and depreciated containing the remaining images in the
    * database getBest adapts stillToConsider to a size of amount of the best images with
-   * regard to the given scores. depreciated is adapted likewise
+   * regard to the given scores (best first). depreciated is adapted likewise
    * @param stillToConsider vector of suitable images resulting from previous filter steps
    * @param depreciated vector of nonsuitable images
    * @param scores vector of scores: size=databasesize
    * @param amount number of how many good images are wanted: is expected to be smaller than stillToConsider.size()
    */
   void getBest(::std::vector<uint> &stillToConsider, ::std::vector<uint> &depreciated, const ::std::vector<double> &scores, uint &amount);
+
+  /// get the scores of all database images for q by running the
+  /// stages of filter_ one after the other
+  void getFilteredScores(const ImageContainer* q, ::std::vector<double> &scores);
+
+  /// plan filter_ from autoFilter_: the costs of the distances are
+  /// measured on a sample of the database, all distances which are
+  /// about as cheap as the cheapest one form the first stage, which
+  /// runs on the whole database, the more expensive ones follow in
+  /// stages of their own, cheapest first. Distances with weight 0 are
+  /// left out.
+  void planFilter();
+
+  /// normalise the distances by the means of the normalizer of the
+  /// query context. Returns false if there is none, i.e. they have to
+  /// be normalised by their means over this database.
+  bool normalizeGlobally(DistanceMatrix &distMatrix) const;
 public:
 
+  /// gives the means by which the distances of a query are normalised
+  /// if the database is only one shard of a larger database, such
+  /// that the scores of all shards can be compared
+  class Normalizer {
+  public:
+    virtual ~Normalizer() {}
+    /// the means of the distances (one per column) given their sums
+    /// over the images of this database. Returns false if they are
+    /// not known, the distances are then normalised locally.
+    virtual bool means(const ::std::vector<double>& sums, uint images, ::std::vector<double>& means)=0;
+  };
+
+  /// the data of one query which must not be shared between queries
+  /// that are served at the same time. Each thread has a context of
+  /// its own which is reused for all its queries to avoid allocating
+  /// a distance matrix per query.
+  struct QueryContext {
+    /// the distances of the query to all database images
+    DistanceMatrix distances;
+
+    /// if not NULL, the distances are normalised by the means it
+    /// gives instead of their means over this database
+    Normalizer* normalizer;
+
+    QueryContext() : normalizer(NULL) {}
+  };
+
+  /// the query context of the calling thread
+  static QueryContext& queryContext();
+
+  /// whether several queries can be processed at the same time with
+  /// the current settings. This is not the case if a distance, the
+  /// query combiner or the distance cache keeps query dependent state
+  /// or if features are loaded and removed during filtered retrieval.
+  bool reentrant() const;
+
   void setCache(const std::string filename) {
     imageComparator_.setCache(filename);
     imageComparator_.openCache();
@@ -176,13 +269,25 @@ public:
   /// given a set of positive and a set of negative example image
   /// names the retrieval process is started. This function is
   /// basically a wrapper to resolve names and
-  /// retrieve(vector<ImageContainer>, vector<ImageContainer>)
-  void retrieve(const ::std::vector< ::std::string >& posQueries, const ::std::vector< ::std::string >& neqQueries, ::std::vector<ResultPair>& results);
+  /// retrieve(vector<ImageContainer>, vector<ImageContainer>) and
+  /// to apply the reranking.
+  /// results contains the best depth images, best first. depth=0
+  /// means that the complete database is ranked.
+  void retrieve(const ::std::vector< ::std::string >& posQueries, const ::std::vector< ::std::string >& neqQueries, ::std::vector<ResultPair>& results, uint depth=0);
 
   /// given a set of positive and a set of negative example
   /// ImageContainers get the results of the retrieval. For this, the
   /// right ImageComparator is necessary.
-  void retrieve(const ::std::vector<ImageContainer*>& posQueries, const ::std::vector<ImageContainer*>& negQueries, ::std::vector<ResultPair>& results);
+  /// Only the best depth images are selected (best first), such that
+  /// the complete database never has to be sorted. depth=0 means
+  /// that the complete database is ranked.
+  void retrieve(const ::std::vector<ImageContainer*>& posQueries, const ::std::vector<ImageContainer*>& negQueries, ::std::vector<ResultPair>& results, uint depth=0);
+
+  /// retrieve(vector<ImageContainer>, vector<ImageContainer>)
+  /// followed by the reranking, as done for queries given by names.
+  /// The result cache is not used as the queries need not have names
+  /// in the database.
+  void retrieveReranked(const ::std::vector<ImageContainer*>& posQueries, const ::std::vector<ImageContainer*>& negQueries, ::std::vector<ResultPair>& results, uint depth=0);
 
   /// start a retrieval using some meta information
   ::std::vector<ResultPair> metaretrieve(const ::std::string& query);
@@ -199,12 +304,12 @@ public:
   void getScores(const ImageContainer* q, ::std::vector<double> &scores);
 
   /// get the scores for the given distance matrix
-  void getScores(::std::vector< ::std::vector<double> > &distMatrix, ::std::vector<double> &scores);
+  void getScores(DistanceMatrix &distMatrix, ::std::vector<double> &scores);
 
   /// get the distances for given example ImageContainer q to all wanted postive
   /// images according to current distanceID and sets the distances for all
   /// not wanted images to 1.2 times maximum distance of the wanted images
-  void getDistances(const ImageContainer* q, const ::std::vector<uint>& stillToConsider, const ::std::vector<uint>& depreciated, ::std::vector< ::std::vector<double> >& distMatrix, const uint distanceID);
+  void getDistances(const ImageContainer* q, const ::std::vector<uint>& stillToConsider, const ::std::vector<uint>& depreciated, DistanceMatrix& distMatrix, const uint distanceID);
 
   /// save the distances from the given example Image (specified by
   /// the imagename) to all database images to the specified file.
@@ -245,6 +350,12 @@ public:
   /// set a new interactor
   void setInteractor(::std::string interactor) {
     interactor_=DistanceInteractor(interactor);
+    resultCache_.clear();
+  }
+
+  /// the cache of query results
+  ResultCache& resultCache() {
+    return resultCache_;
   }
 
   /// return the available scorings
@@ -324,8 +435,17 @@ public:
   ///sets the filterApply member variable
   void setFilterApply(bool apply);
 
-  ///sets the filter to given pair vector
-  void setFilter(::std::vector< ::std::pair<uint,uint> > filter);
+  ///sets the filter to the given stages
+  void setFilter(const ::std::vector<FilterStage>& filter);
+
+  /// let the filter be planned from the costs of the distances, keep
+  /// gives the number of images kept after each stage (the last value
+  /// is used for all further stages). The plan is made as soon as the
+  /// database and the distances are known and renewed when they change.
+  void setAutoFilter(const ::std::vector<uint>& keep);
+
+  /// the current filter stages in the syntax of -F/--filter
+  ::std::string filterString() const;
 
   ///set the partialLoadingAppy member variable
   // returns a boolean indicating if partial loading is applicable or not
@@ -340,9 +460,18 @@ public:
     return partialLoadingApply_;
   }
 
-  ///sets the filter pair vector to an empty pair vector
+  ///removes all filter stages
   void clearFilter();
 
+  /// compare queries only with the images in the probes lists of the
+  /// approximate nearest neighbour index for the given suffix that are
+  /// nearest to the query. The index is built with lists lists (0: the
+  /// square root of the database size) if there is no index file.
+  void setAnn(uint suffix, uint probes, uint lists=0);
+
+  /// compare queries with all database images again
+  void clearAnn();
+
   /// returns all used features
   ::std::string getFeatures() const;
   /// returns image-path
@@ -352,6 +481,16 @@ public:
   /// loads new image into database
   void loadQuery(const ::std::string &filename);
 
+  /// make a query of features that were extracted in process (see
+  /// Database::loadQuery), the other features are loaded from
+  /// files. NULL (and the features are deleted) if the features do
+  /// not fit to those of the database.
+  ImageContainer* makeQuery(const ::std::string &filename, const ::std::vector<BaseFeature*>& extracted);
+
+  /// adds a query made by makeQuery to the database, which takes the
+  /// ownership
+  void addToDatabase(const ::std::string &filename, ImageContainer *image);
+
 };
 
 #endif
@@ -18,87 +18,265 @@
 #include <pthread.h>
 #include <cstring>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <csignal>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "server.hpp"
 
 #include "net.hpp"
+#include "binaryframe.hpp"
 #include "diag.hpp"
 #include "logfile.hpp"
 #include "runprogram.hpp"
-#include "ScopeTimer.h"
+#include "profiler.hpp"
 
 using namespace std;
 
-typedef struct DataForThread_ {
-  Server* server;
-  Socket* client;
-} DataForThread;
-
-
 void Server::initialize() {
   retriever_.initialize();
 }
 
-void* threadProcess(void *data)
+namespace {
+  /// asks the coordinator of the shards for the means by which the
+  /// distances of a query are normalised, as long as the shard
+  /// retrieval of request id runs. The server lock is given up while
+  /// waiting for the answer, which must come within the shard timeout.
+  class CoordinatorNormalizer : public Retriever::Normalizer {
+  private:
+    Server& server_;
+    Socket& coordinator_;
+    uint32_t id_;
+    bool broken_;
+  public:
+    CoordinatorNormalizer(Server& server, Socket& coordinator, uint32_t id) : server_(server), coordinator_(coordinator), id_(id), broken_(false) {
+      coordinator_.setTimeout(server_.shardTimeout());
+    }
+
+    ~CoordinatorNormalizer() {
+      // back to waiting as long as it takes for the next request
+      coordinator_.setTimeout(0);
+    }
+
+    /// whether the connection is unusable because it broke or the
+    /// coordinator did not answer as expected
+    bool broken() const {return broken_;}
+
+    virtual bool means(const vector<double>& sums, uint images, vector<double>& means) {
+      if(broken_) {
+        return false;
+      }
+      string frame;
+      startFrame(frame,id_,BINARY_NORMALIZE);
+      putUint32(frame,images);
+      putUint32(frame,sums.size());
+      for(uint j=0;j<sums.size();++j) putFloat64(frame,sums[j]);
+      uint32_t id, type;
+      string payload;
+      const bool suspended=server_.suspend();
+      const bool received=sendFrame(coordinator_,frame) && receiveFrame(coordinator_,id,type,payload);
+      if(suspended) {
+        server_.resume();
+      }
+      if(!received || id!=id_ || type!=BINARY_MEANS || payload.size()<4) {
+        ERR << "No normalisation from the coordinator, closing connection" << endl;
+        broken_=true;
+        return false;
+      }
+      const uint32_t count=getUint32(payload.data());
+      if(count!=sums.size() || payload.size()!=4+8*count) {
+        // the coordinator could not combine the sums of the shards
+        return false;
+      }
+      means.resize(count);
+      for(uint j=0;j<count;++j) means[j]=getFloat64(payload.data()+4+8*j);
+      return true;
+    }
+  };
+}
+
+// answer the next frame of a client which has switched to the binary
+// protocol. Returns ServerStatusQUIT if it asked the server to quit,
+// ServerStatusBYE if the connection is to be closed and
+// ServerStatusGOOD otherwise.
+ServerStatus serveFrame(Server &serv, Socket &client, bool &authorized)
 {
-#ifdef __USE_PTHREADS_FOR_SERVER__
-  pthread_detach(pthread_self());
-#endif
+  ServerStatus status=ServerStatusGOOD;
+  bool open=true;
+  string request;
+  string answer;
+  vector<uint> positives, negatives;
+  vector<ResultPair> results;
+  vector<string> names;
+  {
+    uint32_t id, type;
+    if(!receiveFrame(client,id,type,request)) {
+      return ServerStatusBYE;
+    }
+    const char* payload=request.data();
+    const uint32_t payloadSize=request.size();
+
+    if(type==BINARY_TEXT) {
+      string commandLine(payload,payloadSize), toClient;
+      serv.log().log("RECV: "+commandLine);
+      status=serv.execute(commandLine,toClient,authorized);
+      open=(status!=ServerStatusBYE && status!=ServerStatusQUIT);
+      serv.log().log("SEND: "+toClient);
+      startFrame(answer,id,BINARY_OK);
+      answer+=toClient;
+    } else if(type==BINARY_RETRIEVE && payloadSize>=12) {
+      const uint32_t count=getUint32(payload), pos=getUint32(payload+4), neg=getUint32(payload+8);
+      if(uint64_t(pos)+neg!=(payloadSize-12)/4) {
+        startFrame(answer,id,BINARY_ERROR);
+        answer+="malformed retrieve request";
+      } else {
+        positives.resize(pos);
+        negatives.resize(neg);
+        for(uint i=0;i<pos;++i) positives[i]=getUint32(payload+12+4*i);
+        for(uint i=0;i<neg;++i) negatives[i]=getUint32(payload+12+4*(pos+i));
+        if(serv.retrieve(positives,negatives,count,results)) {
+          startFrame(answer,id,BINARY_OK);
+          putUint32(answer,results.size());
+          for(uint i=0;i<results.size();++i) putUint32(answer,results[i].second);
+          for(uint i=0;i<results.size();++i) putFloat64(answer,results[i].first);
+        } else {
+          startFrame(answer,id,BINARY_ERROR);
+          answer+="invalid image index";
+        }
+      }
+    } else if(type==BINARY_SHARD_RETRIEVE && payloadSize>=12) {
+      // a part of a retrieval of the coordinator of several shards:
+      // the images are named and the distances are normalised by the
+      // means over all shards
+      const uint32_t count=getUint32(payload), pos=getUint32(payload+4), neg=getUint32(payload+8);
+      bool valid=(uint64_t(pos)+neg<=(payloadSize-12)/4);
+      vector<string> posNames, negNames;
+      size_t offset=12;
+      if(valid) {
+        posNames.resize(pos);
+        negNames.resize(neg);
+      }
+      for(uint i=0;i<posNames.size() && valid;++i) valid=getString(request,offset,posNames[i]);
+      for(uint i=0;i<negNames.size() && valid;++i) valid=getString(request,offset,negNames[i]);
+      if(!valid) {
+        startFrame(answer,id,BINARY_ERROR);
+        answer+="malformed shard retrieve request";
+      } else {
+        CoordinatorNormalizer normalizer(serv,client,id);
+        Retriever::queryContext().normalizer=&normalizer;
+        serv.retrieve(posNames,negNames,count,results,names);
+        Retriever::queryContext().normalizer=NULL;
+        if(normalizer.broken()) {
+          return ServerStatusBYE;
+        }
+        startFrame(answer,id,BINARY_OK);
+        putUint32(answer,results.size());
+        for(uint i=0;i<results.size();++i) putFloat64(answer,results[i].first);
+        for(uint i=0;i<results.size();++i) putString(answer,names[i]);
+      }
+    } else if(type==BINARY_BYE) {
+      status=ServerStatusBYE;
+      open=false;
+      startFrame(answer,id,BINARY_OK);
+    } else {
+      startFrame(answer,id,BINARY_ERROR);
+      answer+="unknown request type";
+    }
+    if(!sendFrame(client,answer)) {
+      return ServerStatusBYE;
+    }
+  }
+  return open ? ServerStatusGOOD : status;
+}
 
-  
-  DataForThread& dfs=*((DataForThread*)data);
-  
-  Socket &client=*(dfs.client);
-  Server &serv=(*dfs.server);
-  bool authorized=(serv.password()=="");
-  ServerStatus processCommandReturned=ServerStatusGOOD;
+// answer the next request of a client: a command line, or a frame if
+// it has switched to the binary protocol. Returns false if the
+// connection is to be closed.
+bool serveRequest(Server &serv, Server::Connection &connection)
+{
+  Socket &client=*connection.socket;
+  if(connection.binary) {
+    ServerStatus status=serveFrame(serv,client,connection.authorized);
+    if(status==ServerStatusQUIT) {
+      serv.quit();
+    }
+    return status==ServerStatusGOOD;
+  }
 
-  DBG(2) << "Client connected" << endl;
-  serv.log().log("client connected");
+  string toClient;
+  // get one line
+  string commandLine=client.getline();
+  serv.log().log("RECV: "+commandLine);
+
+  if(commandLine=="binary") {
+    DBG(2) << "Client switched to the binary protocol" << endl;
+    client << string("binary\r\n");
+    connection.binary=true;
+    return true;
+  }
+
+  // process the line
+  ServerStatus processCommandReturned=serv.execute(commandLine,toClient,connection.authorized);
+
+  // everything fine?
   bool notBye=true;
-  while(notBye)
+  switch(processCommandReturned)
   {
-    string toClient;
-    // get one line
-    string commandLine=client.getline();
-    serv.log().log("RECV: "+commandLine);
-
-    // process the line
-    processCommandReturned=serv.processCommand(commandLine,toClient,authorized);
+  case ServerStatusGOOD:
+    break;
+  case ServerStatusBYE:
+    notBye=false;
+    connection.authorized=false;
+    break;
+  case ServerStatusQUIT:
+    serv.quit();
+    notBye=false;
+    connection.authorized=false;
+    break;
+  case ServerStatusBAD:
+    break;
+  }
+  serv.log().log("SEND: "+toClient);
+  toClient+="\r\n";
+  client << toClient;
+  return notBye;
+}
 
-    // everything fine?
-    switch(processCommandReturned)
-    {
-    case ServerStatusGOOD:
-      break;
-    case ServerStatusBYE:
-      notBye=false;
-      authorized=false;
-      break;
-    case ServerStatusQUIT:
-      serv.notQuit()=false;
-      notBye=false;
-      authorized=false;
-      break;
-    case ServerStatusBAD:
-      break;
-    }
-    serv.log().log("SEND: "+toClient);
-    toClient+="\r\n";
-    client << toClient;
-  } // while (notBye)
-  // the client has said goodbye or quit
-  client.close();
+// the client has said goodbye or quit
+void closeConnection(Server &serv, Server::Connection *connection)
+{
+  connection->socket->close();
+  delete connection->socket;
+  delete connection;
   serv.log().log("client connection closed");
-  
-  //delete dfs.client;
-  
-  delete data;
-  
+}
+
 #ifdef __USE_PTHREADS_FOR_SERVER__
-  pthread_exit(0);
+// one of the workers_ threads of the server. It answers the requests
+// of all connections as they come in.
+void* workerProcess(void *data)
+{
+  Server &serv=*((Server*)data);
+
+#ifdef _OPENMP
+  // the queries served at the same time share the processors
+  omp_set_num_threads(max(1, omp_get_num_procs()/int(serv.workers())));
 #endif
+
+  Server::Connection *connection;
+  while((connection=serv.nextRequest())!=NULL) {
+    if(serveRequest(serv, *connection)) {
+      serv.answered(connection);
+    } else {
+      closeConnection(serv, connection);
+    }
+  }
   return NULL;
 }
+#endif
 
 static const CommandType CMD_INFO=10000;
 static const CommandType CMD_RETRIEVE=10001;
@@ -129,9 +307,19 @@ static const CommandType CMD_IMAGE=10026;
 static const CommandType CMD_FEATURE=10027;
 static const CommandType CMD_SETFILTER=10028;
 static const CommandType CMD_NEWFILE=10029;
+static const CommandType CMD_SETANN=10030;
+static const CommandType CMD_PROFILE=10031;
+static const CommandType CMD_BINARY=10032;
 
-Server::Server()  :  port_(12960), retriever_(),batchfile_(""), notQuit_(true)
+Server::Server()  :  port_(12960), retriever_(),batchfile_(""), notQuit_(true), workers_(4), exclusive_(false), suspended_(0), shardTimeout_(5000)
 {
+  pthread_mutex_init(&connectionsLock_, NULL);
+  pthread_cond_init(&requestReady_, NULL);
+  pthread_rwlock_init(&configLock_, NULL);
+  pthread_mutex_init(&suspendLock_, NULL);
+  pthread_cond_init(&resumed_, NULL);
+  wakeup_[0]=wakeup_[1]=-1;
+
   map_["info"]=CMD_INFO;
   map_["retrieve"]=CMD_RETRIEVE;
   map_["setdist"]=CMD_SETDIST;
@@ -161,58 +349,89 @@ Server::Server()  :  port_(12960), retriever_(),batchfile_(""), notQuit_(true)
   map_["feature"]=CMD_FEATURE;
   map_["setfilter"]=CMD_SETFILTER;
   map_["newfile"]=CMD_NEWFILE;
+  map_["setann"]=CMD_SETANN;
+  map_["profile"]=CMD_PROFILE;
+  map_["binary"]=CMD_BINARY;
 
 }
 
+Server::~Server()
+{
+  pthread_cond_destroy(&resumed_);
+  pthread_mutex_destroy(&suspendLock_);
+  pthread_rwlock_destroy(&configLock_);
+  pthread_cond_destroy(&requestReady_);
+  pthread_mutex_destroy(&connectionsLock_);
+  if(wakeup_[0]>=0) {
+    ::close(wakeup_[0]);
+    ::close(wakeup_[1]);
+  }
+}
+
 bool Server::parseFilter(const char* str)
 {
-  bool filterOK = false;
-  string fst;
-  string snd;
-  vector< pair<uint,uint> > filter;
-  while (*str != '\0')
+  string unparsed(str);
+  string token;
+
+  // auto:amount:amount... lets the retriever plan the stages
+  if (unparsed.compare(0,4,"auto")==0)
   {
-    fst.clear();
-    snd.clear();
-    while(*str != ':' && *str != '\0')
+    vector<uint> keep;
+    istringstream iss(unparsed.substr(4));
+    while (getline(iss, token, ':'))
     {
-      if (isalpha(*str))
+      if (token.empty() && keep.empty()) continue;
+      if (token.empty() || token.find_first_not_of("0123456789")!=string::npos)
       {
-        filterOK = false;
-        return(filterOK);
+        return(false);
       }
-      fst.append(str,1);
-      str++;
+      keep.push_back(atoi(token.c_str()));
+    }
+    if (keep.empty())
+    {
+      return(false);
     }
-    if (*str == '\0')
+    retriever_.setAutoFilter(keep);
+    DBG(105) << "Filter parsed: auto" ; for(uint i=0;i<keep.size();++i) { BLINK(105) << ":" << keep[i]; } BLINK(105) << endl;
+    return(true);
+  }
+
+  // distanceID,distanceID...:amountToBeUsed-...
+  vector<Retriever::FilterStage> filter;
+  istringstream stages(unparsed);
+  while (getline(stages, token, '-'))
+  {
+    size_t colon=token.find(':');
+    if (colon==string::npos || token.find(':',colon+1)!=string::npos || token.find_first_not_of("0123456789,:")!=string::npos)
     {
-      filterOK = false;
-      return(filterOK);
+      return(false);
     }
-    str++;
-    while(*str != '-' && *str != '\0')
+    Retriever::FilterStage stage;
+    stage.keep=atoi(token.substr(colon+1).c_str());
+    istringstream ids(token.substr(0,colon));
+    string id;
+    while (getline(ids, id, ','))
     {
-      if (isalpha(*str) || *str==':')
+      if (id.empty())
       {
-        filterOK = false;
-        return(filterOK);
+        return(false);
       }
-      snd.append(str,1);
-      str++;
+      stage.distances.push_back(atoi(id.c_str()));
     }
-    if (*str == '-')
+    if (stage.distances.empty())
     {
-      str++;
+      return(false);
     }
-    /// converting numbers in string format to uint, since atoi is only capable
-    /// of c-style strings fst and snd must be converted.
-    filter.push_back(make_pair(atoi(fst.c_str()),atoi(snd.c_str())));
+    filter.push_back(stage);
+  }
+  if (filter.empty())
+  {
+    return(false);
   }
   retriever_.setFilter(filter);
-  filterOK = true;
 
-  DBG(105) << "Filter parsed: " ; for(uint i=0;i<filter.size();++i) { BLINK(105) << "   " << filter[i].first << ":" << filter[i].second; }
-  return(filterOK);
+  DBG(105) << "Filter parsed: " << retriever_.filterString() << endl;
+  return(true);
 }
 
 void Server::parseConfig(GetPot &config)
@@ -290,6 +509,28 @@ void Server::parseConfig(GetPot &config)
     }
   }
 
+  if(config.search("--loadthreads")) {
+    retriever_.database().setLoadThreads(config.follow(0,"--loadthreads"));
+    DBG(10) << "loadthreads=" << retriever_.database().loadThreads() << endl;
+  }
+
+  if(config.search("--compact")) {
+    // suffix:encoding[,suffix:encoding...], has to be known before loading
+    string unparsed=config.follow("0:float","--compact");
+    istringstream iss(unparsed);
+    string item;
+    while(getline(iss,item,',')) {
+      string::size_type pos=item.find(':');
+      CompactEncoding encoding;
+      if(pos==string::npos || !CompactVectorStore::parseEncoding(item.substr(pos+1),encoding)) {
+        ERR << "Invalid --compact entry '" << item << "', expected <suffix>:<double|float|uint8>" << endl;
+        continue;
+      }
+      retriever_.database().setCompaction(atoi(item.substr(0,pos).c_str()),encoding);
+      DBG(10) << "compact suffix " << item.substr(0,pos) << " as " << item.substr(pos+1) << endl;
+    }
+  }
+
   if(config.search(2,"-f","--filelist"))
   {
     string filelistname=config.follow("list.txt",2,"-f","--filelist");
@@ -388,6 +629,40 @@ void Server::parseConfig(GetPot &config)
     retriever_.setCache(config.follow("cache.sqlite3.db","--cache"));
   }
 
+  if(config.search("--resultcache")) {
+    retriever_.resultCache().setCapacity(config.follow(1000000,"--resultcache"));
+    DBG(10) << "resultcache=" << retriever_.resultCache().capacity() << endl;
+  }
+
+  if(config.search("--ann")) {
+    // suffix:probes[:lists]
+    string unparsed=config.follow("0:8","--ann");
+    uint suffix=0, probes=8, lists=0;
+    char sep;
+    istringstream iss(unparsed);
+    iss >> suffix >> sep >> probes;
+    if(!iss.fail() && iss >> sep) {
+      iss >> lists;
+    }
+    retriever_.setAnn(suffix, probes, lists);
+    DBG(10) << "ann suffix=" << suffix << " probes=" << probes << " lists=" << lists << endl;
+  }
+
+  if(config.search("--profile")) {
+    // filename:seconds
+    string unparsed=config.follow("profile.txt:60","--profile");
+    string::size_type pos=unparsed.rfind(':');
+    string filename=unparsed.substr(0,pos);
+    uint seconds=(pos==string::npos) ? 60 : atoi(unparsed.substr(pos+1).c_str());
+    Profiler::startDump(filename, seconds);
+    DBG(10) << "profile=" << filename << " every " << seconds << " seconds" << endl;
+  }
+
+  if(config.search("--workers")) {
+    workers_=max(1,config.follow(4,"--workers"));
+    DBG(10) << "workers=" << workers_ << endl;
+  }
+
 
   if(config.search(2,"-e","--expansion"))
   {
@@ -406,6 +681,22 @@ void Server::parseConfig(GetPot &config)
     t2bpath=config.follow("",2,"-t","--type2bin");
     DBG(10) << "type2bin-file has been reset to: " << t2bpath << endl;
   }
+
+  shardTimeout_=config.follow(5000,"--shardtimeout");
+
+  if(config.search("--shards"))
+  {
+    string shards=config.follow("localhost:12960","--shards");
+    if(!coordinator_.setShards(shards))
+    {
+      ERR << "Invalid --shards '" << shards << "', expected <host>:<port>[,<host>:<port>...]" << endl;
+      exit(20);
+    }
+    coordinator_.setTimeout(shardTimeout_);
+    coordinator_.setResults(retriever_.results());
+    coordinator_.setPassword(password_);
+    DBG(10) << "coordinating shards " << shards << endl;
+  }
 }
 
 
@@ -420,9 +711,188 @@ void Server::tokenize(const string &cmdline, vector<string> &tokens)
   }
 }
 
-CommandType Server::mapCommand(const string &cmd)
+CommandType Server::mapCommand(const string &cmd) const
 {
-  return map_[cmd];
+  // map_ is shared by all threads and must not grow for unknown commands
+  map<const string,CommandType>::const_iterator it=map_.find(cmd);
+  if(it==map_.end()) {
+    return 0;
+  }
+  return it->second;
+}
+
+ServerStatus Server::execute(const ::std::string& commandline, ::std::string& toclient, bool & authorized)
+{
+  vector<string> tokens(0);
+  tokenize(commandline,tokens);
+  if(tokens.empty() || tokens[0].empty()) {
+    toclient="empty command";
+    return ServerStatusBAD;
+  }
+
+  bool exclusive=false;
+  switch(mapCommand(tokens[0])) {
+  // these change the settings or the database
+  case CMD_SETDIST:
+  case CMD_SETWEIGHT:
+  case CMD_FILELIST:
+  case CMD_SETRESULTS:
+  case CMD_SETEXTENSION:
+  case CMD_SETSCORING:
+  case CMD_SAVERELEVANCES:
+  case CMD_INTERACTOR:
+  case CMD_SETFILTER:
+  case CMD_NEWFILE:
+  case CMD_SETANN:
+    exclusive=true;
+    break;
+  default:
+    break;
+  }
+
+  lock(exclusive);
+  ServerStatus result=processCommand(commandline,toclient,authorized);
+  unlock();
+  return result;
+}
+
+void Server::lock(bool exclusive) {
+  pthread_rwlock_rdlock(&configLock_);
+  if(!exclusive && !retriever_.reentrant()) {
+    // the current distances or settings keep per query state, so
+    // queries are answered one at a time
+    exclusive=true;
+  }
+  if(exclusive) {
+    pthread_rwlock_unlock(&configLock_);
+    pthread_rwlock_wrlock(&configLock_);
+    // queries waiting for the coordinator have given the lock up but
+    // still use the settings, wait until they are done with them
+    pthread_mutex_lock(&suspendLock_);
+    while(suspended_>0) {
+      pthread_rwlock_unlock(&configLock_);
+      pthread_cond_wait(&resumed_,&suspendLock_);
+      pthread_mutex_unlock(&suspendLock_);
+      pthread_rwlock_wrlock(&configLock_);
+      pthread_mutex_lock(&suspendLock_);
+    }
+    pthread_mutex_unlock(&suspendLock_);
+    exclusive_=true;
+  }
+}
+
+void Server::unlock() {
+  if(exclusive_) {
+    exclusive_=false;
+  }
+  pthread_rwlock_unlock(&configLock_);
+}
+
+bool Server::suspend() {
+  if(exclusive_) {
+    return false;
+  }
+  pthread_mutex_lock(&suspendLock_);
+  ++suspended_;
+  pthread_mutex_unlock(&suspendLock_);
+  pthread_rwlock_unlock(&configLock_);
+  return true;
+}
+
+void Server::resume() {
+  pthread_rwlock_rdlock(&configLock_);
+  pthread_mutex_lock(&suspendLock_);
+  --suspended_;
+  pthread_cond_broadcast(&resumed_);
+  pthread_mutex_unlock(&suspendLock_);
+}
+
+bool Server::retrieve(const vector<uint>& positives, const vector<uint>& negatives, uint results, vector<ResultPair>& out) {
+  ProfileScope st("Server::retrieve");
+  lock(false);
+  const uint N=retriever_.numberOfFilelistEntries();
+  vector<string> posNames, negNames;
+  bool valid=true;
+  for(uint i=0;i<positives.size() && valid;++i) {
+    valid=positives[i]<N;
+    if(valid) posNames.push_back(retriever_.filelist(positives[i]));
+  }
+  for(uint i=0;i<negatives.size() && valid;++i) {
+    valid=negatives[i]<N;
+    if(valid) negNames.push_back(retriever_.filelist(negatives[i]));
+  }
+  out.clear();
+  if(valid) {
+    retrieveLocked(posNames,negNames,results,out);
+  }
+  unlock();
+  return valid;
+}
+
+void Server::retrieve(const vector<string>& positives, const vector<string>& negatives, uint results, vector<ResultPair>& out, vector<string>& names) {
+  ProfileScope st("Server::retrieve");
+  lock(false);
+  out.clear();
+  retrieveLocked(positives,negatives,results,out);
+  names.resize(out.size());
+  for(uint i=0;i<out.size();++i) {
+    names[i]=retriever_.filelist(out[i].second);
+  }
+  unlock();
+}
+
+void Server::retrieveLocked(const vector<string>& positives, const vector<string>& negatives, uint results, vector<ResultPair>& out) {
+  if(positives.size()+negatives.size()>0) {
+    if(results==0) {
+      results=retriever_.results();
+    }
+    retriever_.retrieve(positives,negatives,out,results);
+    if(out.size()>results) {
+      out.resize(results);
+    }
+  }
+}
+
+Server::Connection* Server::nextRequest()
+{
+  pthread_mutex_lock(&connectionsLock_);
+  while(ready_.empty() && notQuit_) {
+    pthread_cond_wait(&requestReady_, &connectionsLock_);
+  }
+  Connection *connection=NULL;
+  if(notQuit_) {
+    connection=ready_.front();
+    ready_.pop_front();
+  }
+  pthread_mutex_unlock(&connectionsLock_);
+  return connection;
+}
+
+void Server::answered(Connection *connection)
+{
+  pthread_mutex_lock(&connectionsLock_);
+  answered_.push_back(connection);
+  pthread_mutex_unlock(&connectionsLock_);
+  wakeup();
+}
+
+void Server::quit()
+{
+  pthread_mutex_lock(&connectionsLock_);
+  notQuit_=false;
+  pthread_cond_broadcast(&requestReady_);
+  pthread_mutex_unlock(&connectionsLock_);
+  wakeup();
+}
+
+void Server::wakeup()
+{
+  if(wakeup_[1]>=0) {
+    const char c=0;
+    if(write(wakeup_[1],&c,1)<0 && errno!=EAGAIN) {
+      ERR << "Cannot wake up the server: " << strerror(errno) << endl;
+    }
+  }
 }
 
 
@@ -430,7 +900,7 @@ CommandType Server::mapCommand(const string &cmd)
 ServerStatus Server::processCommand(const ::std::string& commandline, ::std::string& toclient, bool & authorized)
 {
 
-  ScopeTimer st1("Server::processCommand");
+  ProfileScope st1("Server::processCommand");
   toclient=string("");
   ServerStatus result=ServerStatusGOOD;
 
@@ -438,9 +908,19 @@ ServerStatus Server::processCommand(const ::std::string& commandline, ::std::str
 
   vector<string> tokens(0);
   tokenize(commandline,tokens);
+  if(tokens.empty() || tokens[0].empty()) {
+    toclient="empty command";
+    return ServerStatusBAD;
+  }
 
   CommandType command=mapCommand(tokens[0]);
 
+  if(coordinator_.active() && command!=CMD_PASSWORD && command!=CMD_QUIT
+     && command!=CMD_BYE && command!=CMD_HELP && command!=CMD_BINARY) {
+    toclient=coordinator_.processCommand(commandline,authorized);
+    return result;
+  }
+
   switch(command) {
   case CMD_PASSWORD: {
     if(tokens.size()>1) {
@@ -507,7 +987,7 @@ ServerStatus Server::processCommand(const ::std::string& commandline, ::std::str
   case CMD_RETRIEVE:     // normal retrieval
   case CMD_RETRIEVEANDSAVERANKS:   //normal retrieval + save ranks file
   case CMD_EXPAND: {    // the n-th step of normal retrieval (that is show more results)
-    ScopeTimer st1("Server::processCommand -> CMD_RETRIEVE");
+    ProfileScope st2("retrieve");
     uint queriesStartFrom, // where do the names of the queries
       // start, there are some more
       // parameters at the start of the
@@ -546,18 +1026,22 @@ ServerStatus Server::processCommand(const ::std::string& commandline, ::std::str
         posQueriesNames.push_back(tokens[i]);
       }
     }
-    retriever_.retrieve(posQueriesNames, negQueriesNames,results);
+    // only as many results as are shown (or saved) have to be ranked
+    uint depth=(resultsStep+1)*retriever_.results();
+    uint nOfRanks=0;
+    if(command==CMD_RETRIEVEANDSAVERANKS) {
+      istringstream iss(tokens[1]);
+      iss >> nOfRanks;
+      depth=max(depth,nOfRanks);
+    }
+    retriever_.retrieve(posQueriesNames, negQueriesNames,results,depth);
         
-    // output!
-    sort(results.rbegin(), results.rend());
-    for(uint i=resultsStep*retriever_.results();i<(resultsStep+1)*retriever_.results() and i<retriever_.numberOfFilelistEntries();++i) {
+    // output! results are sorted already
+    for(uint i=resultsStep*retriever_.results();i<(resultsStep+1)*retriever_.results() and i<results.size();++i) {
       os << retriever_.filelist(results[i].second) << " " << results[i].first << " ";
     }
     
     if(command==CMD_RETRIEVEANDSAVERANKS) { //now save ranks:
-      istringstream iss(tokens[1]);
-      uint nOfRanks;
-      iss >> nOfRanks;
       string filename=tokens[2];
       
       DBG(10) << "saving " << nOfRanks << " ranks to " << filename << endl;
@@ -565,7 +1049,7 @@ ServerStatus Server::processCommand(const ::std::string& commandline, ::std::str
       ofstream os(filename.c_str());
       if(!os) { ERR << "Error opening logfile:" << filename << endl;}
       os << "# " << commandline << endl;
-      for(uint i=0;i<nOfRanks;++i) {
+      for(uint i=0;i<nOfRanks && i<results.size();++i) {
         os << i << " " << retriever_.filelist(results[i].second) << " " << results[i].first << endl;
       }
       os.close();
@@ -777,6 +1261,9 @@ ServerStatus Server::processCommand(const ::std::string& commandline, ::std::str
     } else if (!tokens[1].empty() && parseFilter(tokens[1].c_str())) {
       retriever_.setFilterApply(true);
       os << "filter = " << tokens[1];
+      if (tokens[1]!=retriever_.filterString()) {
+        os << " (" << retriever_.filterString() << ")";
+      }
     } else {
       retriever_.setFilterApply(false);
       retriever_.clearFilter();
@@ -784,6 +1271,43 @@ ServerStatus Server::processCommand(const ::std::string& commandline, ::std::str
     }
     break;
   }
+  case CMD_SETANN: {
+    // only authorized users may change this, building an index rewrites its file
+    if(tokens.size()==2 && tokens[1]=="off" && authorized) {
+      retriever_.clearAnn();
+      os << "ann = off";
+    } else if((tokens.size()==3 || tokens.size()==4) && authorized) {
+      uint suffix=atoi(tokens[1].c_str());
+      uint probes=atoi(tokens[2].c_str());
+      uint lists=(tokens.size()==4) ? atoi(tokens[3].c_str()) : 0;
+      retriever_.setAnn(suffix, probes, lists);
+      os << "ann = " << suffix << " " << probes << " " << lists;
+    } else {
+      os << "wrong syntax or not authorized: setann <suffix> <probes> [<lists>] | setann off";
+    }
+    break;
+  }
+  case CMD_PROFILE: {
+    // everybody may read the report, only authorized users may change
+    // the profiler, which is shared by all connections
+    if(tokens.size()==1) {
+      os << Profiler::report(" ");
+    } else if(tokens.size()==2 && tokens[1]=="reset" && authorized) {
+      Profiler::reset();
+      os << "profile = reset";
+    } else if(tokens.size()==2 && (tokens[1]=="on" || tokens[1]=="off") && authorized) {
+      Profiler::enable(tokens[1]=="on");
+      os << "profile = " << tokens[1];
+    } else {
+      os << "wrong syntax or not authorized: profile [on|off|reset]";
+    }
+    break;
+  }
+  case CMD_BINARY: {
+    // network connections switch in serveRequest before getting here
+    os << "binary: only possible on network connections";
+    break;
+  }
   case CMD_NEWFILE: {
     
     DBG(50) << "newfile 1" << endl;
@@ -807,6 +1331,8 @@ ServerStatus Server::processCommand(const ::std::string& commandline, ::std::str
 
     char *end;      // unnecessary but needed since this is a stupid function ;-)
     uint mode=strtoul(tokens[1].c_str(), &end, 10);
+    // the new image may get the name of an image that was deleted before
+    retriever_.resultCache().clear();
     if(t2bpath.empty()) {t2bpath=retriever_.getT2bPath(); } 
 
     ::std::string newfile=tokens[2];    // absolute path to the image
@@ -843,53 +1369,92 @@ ServerStatus Server::processCommand(const ::std::string& commandline, ::std::str
 
     DBG(50) << "newfile 7 (" << t2bpath << ")" << endl;
 
-    // opens file type2bin, gets the path to the feature-extractors and executes them on the image
-    bool process_successful=true;
-    ifstream is; is.open(t2bpath.c_str());
-    if(!is.good()) {
+    // opens file type2bin and gets the feature-extractors of the used features
+    map<string,string> type2bin;
+    if(!ExtractorRegistry::readType2Bin(t2bpath, type2bin)) {
       ERR << "Unable to open file type2bin. Corrupted t2bpath!" << endl;
       os << "Server configuration error.";
       break;
-    } else {
-      ::std::string line;
-      ::std::string bin_command;
-      
-      while(!is.eof()) {
-        getline(is,line);
-        if(line=="") break;
-        bin_command=line.substr(line.find(' ')+1, line.length() - 1);   // extractor-executable
-        line.erase(line.find(' '), line.length()+1);    // feature-suffix
-        
-        for(uint i=0;i<features.size();++i) {
-          if(features[i]==line) {
-            DBG(20) << "Command: " << bin_command << " --suffix " << line << " --images \"" << imagepath+imagename << "\"" << endl;
-            if(system((bin_command+" --suffix "+line+" --images \""+imagepath+imagename+"\"").c_str())!=0) {
-              os << "Server configuration error." << endl;
-              ERR << "Unable to process image file with " << bin_command << endl;
-              process_successful=false;
-              break;
+    }
+    vector<string> commands(features.size());   // per suffix, empty if there is no extractor
+    for(uint i=0;i<features.size();++i) {
+      if(type2bin.count(features[i])) {
+        commands[i]=type2bin[features[i]];
+      }
+    }
+
+    // the extractors known to extractors_ are run in process on the
+    // image loaded once and in parallel, the others are executed on the
+    // image file
+    bool process_successful=true;
+    vector<uint> inProcess;
+    for(uint i=0;i<features.size() && process_successful;++i) {
+      if(commands[i].empty()) {
+        continue;
+      } else if(extractors_.known(commands[i])) {
+        inProcess.push_back(i);
+        continue;
+      }
+      if(!ExtractorRegistry::runProgram(commands[i], features[i], imagepath+imagename)) {
+        os << "Server configuration error." << endl;
+        ERR << "Unable to process image file with " << commands[i] << endl;
+        process_successful=false;
+        break;
+      }
+      used_features.push_back(features[i]);
+    }
+
+    vector<BaseFeature*> extracted(features.size(), (BaseFeature*)NULL);
+    if(process_successful && !inProcess.empty()) {
+      ProfileScope st2("newfile/extraction");
+      ImageFeature image;
+      if(!image.load(imagepath+imagename)) {
+        os << "Server configuration error." << endl;
+        ERR << "Unable to load image file " << imagepath+imagename << endl;
+        process_successful=false;
+      } else {
+#pragma omp parallel for schedule(dynamic)
+        for(int k=0;k<int(inProcess.size());++k) {
+          extracted[inProcess[k]]=extractors_.extract(commands[inProcess[k]], image);
+        }
+        // the kept image gets its feature files as if the programs had been run
+        if(mode > 0) {
+          for(uint i=0;i<extracted.size();++i) {
+            if(extracted[i]) {
+              extracted[i]->save(imagepath+imagename+"."+features[i]);
+              used_features.push_back(features[i]);
             }
-            used_features.push_back(line);
           }
         }
       }
     }
-    is.close();
     
     DBG(50) << "newfile 8" << endl;
     if(process_successful) {
-      // save image in database (mode 2,3)
-      if(mode > 1) { retriever_.loadQuery(imagename); }
-      
-      // uses the existing command "retrieve" and shows the output
-      ::std::string retrieve_output;
-
-      processCommand("retrieve "+imagename, retrieve_output, authorized);
+      // the extracted features are used directly, the others are loaded
+      ImageContainer *query=retriever_.makeQuery(imagename, extracted);
+      if(!query) {
+        os << "Features of the image do not fit to the database." << endl;
+        ERR << "Features of " << imagename << " are not consistent with the database" << endl;
+        process_successful=false;
+      }
     DBG(50) << "newfile 9" << endl;
 
-      //      retriever_.retrieve(posQueriesNames, negQueriesNames,results);      
-      cout << retrieve_output << endl;
-      os << retrieve_output;
+      if(query) {
+        // save image in database (mode 2,3)
+        if(mode > 1) { retriever_.addToDatabase(imagename, query); }
+
+        vector<ResultPair> results;
+        retriever_.retrieveReranked(vector<ImageContainer*>(1,query), vector<ImageContainer*>(), results, retriever_.results());
+        ostringstream retrieve_output;
+        for(uint i=0;i<retriever_.results() && i<results.size();++i) {
+          retrieve_output << retriever_.filelist(results[i].second) << " " << results[i].first << " ";
+        }
+        if(mode < 2) { delete query; }
+
+        cout << retrieve_output.str() << endl;
+        os << retrieve_output.str();
+      }
     DBG(50) << "newfile 10" << endl;
 
     }
@@ -989,32 +1554,120 @@ void Server::start() {
     runInBackground(startAfterInit_);
   }
 
-  /// and now we are in process commands from network mode
-  string commandLine;
-
-  string toClient;
-  DataForThread *dfs;
-  while (notQuit_) {
-    DBG(2) << "Waiting for connections on port " << port_ << endl;
-    Socket * client=server.acceptPointer();
-
-    dfs=new DataForThread(); dfs->server=this; dfs->client=client;
+  /// writing to a client (or shard) which closed its connection must
+  /// not end the server, the write fails instead
+  signal(SIGPIPE, SIG_IGN);
 
+  /// and now we are in process commands from network mode
 #ifdef __USE_PTHREADS_FOR_SERVER__
+  // the workers wake this thread up through the pipe when they have
+  // answered a request, it must not block them when it is full
+  if(pipe(wakeup_)!=0) {
+    ERR << "Cannot create pipe: " << strerror(errno) << endl;
+    exit(20);
+  }
+  fcntl(wakeup_[0], F_SETFL, O_NONBLOCK);
+  fcntl(wakeup_[1], F_SETFL, O_NONBLOCK);
+
+  // a fixed number of workers answers the requests, such that many
+  // connections cannot start arbitrarily many concurrent queries
+  DBG(10) << "Starting " << workers_ << " worker threads" << endl;
+  for(uint i=0;i<workers_;++i) {
     pthread_t thr;
-    int errcode=pthread_create(&thr, NULL , threadProcess, (void*)dfs);
+    int errcode=pthread_create(&thr, NULL , workerProcess, (void*)this);
     if(errcode!=0)
     {
-      ERR << "Problems with starting thread!: "<< strerror(errno) << endl;
+      ERR << "Problems with starting thread!: "<< strerror(errcode) << endl;
       exit(20);
     }
-#else
-    threadProcess( (void*)dfs);
+    workerThreads_.push_back(thr);
+  }
 #endif
 
+#ifdef __USE_PTHREADS_FOR_SERVER__
+  // the connections waiting for their next request
+  vector<Connection*> idle;
+#endif
+
+  while (notQuit_) {
+#ifdef __USE_PTHREADS_FOR_SERVER__
+    // wait for new connections, requests of the idle connections and
+    // answered connections
+    DBG(20) << "Waiting for requests of " << idle.size() << " connections on port " << port_ << endl;
+    vector<struct pollfd> fds(2+idle.size());
+    fds[0].fd=server.listenerFilePointer();
+    fds[1].fd=wakeup_[0];
+    for(uint i=0;i<idle.size();++i) {
+      fds[2+i].fd=idle[i]->socket->socketPointer();
+    }
+    for(uint i=0;i<fds.size();++i) {
+      fds[i].events=POLLIN;
+      fds[i].revents=0;
+    }
+    if(poll(&fds[0],fds.size(),-1)<0) {
+      if(errno==EINTR) continue;
+      ERR << "Error waiting for requests: " << strerror(errno) << endl;
+      break;
+    }
+    if(fds[1].revents) {
+      char buffer[256];
+      while(read(wakeup_[0],buffer,sizeof(buffer))>0) {}
+    }
+
+    // a closed connection is ready as well, the worker finds it closed
+    vector<Connection*> waiting;
+    pthread_mutex_lock(&connectionsLock_);
+    for(uint i=0;i<idle.size();++i) {
+      if(fds[2+i].revents) {
+        ready_.push_back(idle[i]);
+      } else {
+        waiting.push_back(idle[i]);
+      }
+    }
+    if(!ready_.empty()) {
+      pthread_cond_broadcast(&requestReady_);
+    }
+    waiting.insert(waiting.end(),answered_.begin(),answered_.end());
+    answered_.clear();
+    pthread_mutex_unlock(&connectionsLock_);
+
+    if(fds[0].revents & POLLIN) {
+      Socket *client=server.acceptPointer();
+      if(client->socketPointer()<0) {
+        delete client;
+      } else {
+        DBG(2) << "Client connected" << endl;
+        log_.log("client connected");
+        waiting.push_back(new Connection(client, password_==""));
+      }
+    }
+    idle.swap(waiting);
+#else
+    DBG(2) << "Waiting for connections on port " << port_ << endl;
+    Connection *connection=new Connection(server.acceptPointer(), password_=="");
+    DBG(2) << "Client connected" << endl;
+    log_.log("client connected");
+    while(serveRequest(*this, *connection)) {}
+    closeConnection(*this, connection);
+#endif
 
   } // while (notQuit_)
 
+#ifdef __USE_PTHREADS_FOR_SERVER__
+  // the workers finish the requests they are answering
+  for(uint i=0;i<workerThreads_.size();++i) {
+    pthread_join(workerThreads_[i], NULL);
+  }
+  workerThreads_.clear();
+  idle.insert(idle.end(),ready_.begin(),ready_.end());
+  idle.insert(idle.end(),answered_.begin(),answered_.end());
+  ready_.clear();
+  answered_.clear();
+  for(uint i=0;i<idle.size();++i) {
+    closeConnection(*this, idle[i]);
+  }
+#endif
+
   // that's it, were are going to terminate
   server.close();
 
@@ -19,12 +19,16 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #define __server_hpp__
 
 #include <map>
+#include <deque>
 #include <string>
+#include <pthread.h>
 #include "distancemaker.hpp"
 #include "getpot.hpp"
 #include "retriever.hpp"
 #include "logfile.hpp"
 #include "net.hpp"
+#include "coordinator.hpp"
+#include "extractorregistry.hpp"
 
 typedef uint CommandType;
 
@@ -38,10 +42,54 @@ static const ServerStatus ServerStatusAUTH=4;
 /**
  * Server class: Handling of network connectivity, parsing of
  * commands, initialization of retrieval engine
+ *
+ * Clients send one command per line and get one line as answer. The
+ * command "binary" (answered by the line "binary") switches the
+ * connection to frames, which avoid formatting and parsing the
+ * results as text. All numbers are little endian. A client may send
+ * further frames before the answers to the previous ones arrived,
+ * the answers come in the order of the requests.
+ *
+ * request:  <size> <id> <type> <payload>  [uint32 each, size counts
+ *           the bytes after size]
+ *   type 1 (BINARY_TEXT): payload is a text command, e.g. "info"
+ *   type 2 (BINARY_RETRIEVE): <results> <positives> <negatives>
+ *           [uint32 each] followed by the indices of the positive and
+ *           of the negative query images in the filelist [uint32
+ *           each]. results 0 means as many as set by "setresults".
+ *   type 3 (BINARY_BYE): close the connection
+ *   type 4 (BINARY_SHARD_RETRIEVE): as type 2, but the query images
+ *           are given by their names, each as <length> [uint32] and
+ *           the characters. Used by the coordinator of shards (see
+ *           coordinator.hpp).
+ *   type 5 (BINARY_MEANS): the coordinator's answer to status 2 with
+ *           the id of the type 4 request: <count> [uint32] means
+ *           [float64], count 0 if the shard is to use its own means
+ * answer:   <size> <id> <status> <payload>  [uint32 each]
+ *   status 0: type 1: the text answer, type 2: <count> [uint32],
+ *           count indices of images [uint32], count scores [float64],
+ *           best first, type 4: <count> [uint32], count scores
+ *           [float64], count names as in the request
+ *   status 1: the payload is an error message
+ *   status 2 (BINARY_NORMALIZE): during a type 4 request, before a
+ *           query is scored: <images> <count> [uint32 each] and the
+ *           sums of the count distances over the images [float64].
+ *           The shard waits for the means (type 5).
  */
 class Server
 {
 
+public:
+  /// a client connection. Between its requests it waits in start(),
+  /// each request is answered by one of the workers.
+  struct Connection {
+    Connection(Socket *s, bool auth) : socket(s), binary(false), authorized(auth) {}
+    Socket *socket;
+    /// whether the client switched to frames
+    bool binary;
+    bool authorized;
+  };
+
 private:
   /// the port on which this server listens
   uint port_;
@@ -96,13 +144,68 @@ private:
   /// path to type2bin-file
   ::std::string t2bpath;
 
+  /// the extraction programs of type2bin that newfile runs in process
+  ExtractorRegistry extractors_;
+
   bool notQuit_;
 
+  /// if there are shards, the commands are answered by them and this
+  /// server is their coordinator
+  ShardCoordinator coordinator_;
+
+  /// the number of threads answering requests. A worker answers one
+  /// request of a connection and then takes the next ready request of
+  /// any connection, such that idle connections hold no worker.
+  uint workers_;
+  ::std::vector<pthread_t> workerThreads_;
+
+  /// connections with a request to be answered, taken by the workers
+  ::std::deque<Connection*> ready_;
+  /// connections whose request was answered, start() waits for their
+  /// next request
+  ::std::deque<Connection*> answered_;
+  pthread_mutex_t connectionsLock_;
+  pthread_cond_t requestReady_;
+  /// a pipe written to wake start() up from waiting for requests
+  int wakeup_[2];
+
+  /// wake start() up
+  void wakeup();
+
+  /// queries share the retriever (read lock), commands changing the
+  /// settings or the database need it exclusively (write lock)
+  pthread_rwlock_t configLock_;
+  /// whether configLock_ is held for writing. Only the thread holding
+  /// it can see true here.
+  bool exclusive_;
+
+  /// the number of queries which gave configLock_ up while waiting
+  /// for the coordinator of the shards, see suspend(). Commands
+  /// taking the lock for writing wait until they are resumed.
+  uint suspended_;
+  pthread_mutex_t suspendLock_;
+  pthread_cond_t resumed_;
+
+  /// how long a shard waits for the coordinator (milliseconds)
+  uint shardTimeout_;
+
+  /// take configLock_ for reading, or for writing if exclusive or the
+  /// distances cannot be used by several queries at the same time
+  void lock(bool exclusive);
+
+  /// release configLock_
+  void unlock();
+
+  /// the common part of the retrieve functions, the lock is held
+  void retrieveLocked(const ::std::vector< ::std::string >& positives, const ::std::vector< ::std::string >& negatives, uint results, ::std::vector<ResultPair>& out);
+
 public:
 
   /// constructor, only initialization of variables
   Server() ;
 
+  ~Server();
+
   /// read the configuration from a GetPot object which can be read
   /// from command line or from a file
   /// this may include reading filelists and files (e.g. images, features)
@@ -116,7 +219,7 @@ public:
   void batch();
 
   /// map a command to a command identifier
-  CommandType mapCommand(const ::std::string &cmd);
+  CommandType mapCommand(const ::std::string &cmd) const;
 
   /// tokenize a line by white spaces
   void tokenize(const ::std::string &cmdline, ::std::vector< ::std::string > &tokens);
@@ -124,6 +227,43 @@ public:
   /// process a command.
   ServerStatus processCommand(const ::std::string& commandline, ::std::string& toclient, bool & authorized);
 
+  /// process a command holding the lock it needs. This is what the
+  /// threads serving clients call.
+  ServerStatus execute(const ::std::string& commandline, ::std::string& toclient, bool & authorized);
+
+  /// retrieve for the images with the given indices in the filelist
+  /// as "retrieve" does, holding the lock it needs. results 0 means
+  /// retriever().results(). Returns false for invalid indices.
+  bool retrieve(const ::std::vector<uint>& positives, const ::std::vector<uint>& negatives, uint results, ::std::vector<ResultPair>& out);
+
+  /// retrieve for the named images, names gets the names of the results
+  void retrieve(const ::std::vector< ::std::string >& positives, const ::std::vector< ::std::string >& negatives, uint results, ::std::vector<ResultPair>& out, ::std::vector< ::std::string >& names);
+
+  /// give the lock of a running query up while it waits for the
+  /// network. The settings and the database do not change until
+  /// resume() took it again. Returns false, and keeps the lock, if
+  /// the query holds it exclusively.
+  bool suspend();
+
+  /// take the lock given up by suspend() again
+  void resume();
+
+  /// how long a shard waits for the coordinator (milliseconds)
+  uint shardTimeout() const {return shardTimeout_;}
+
+  /// wait for the next connection with a request, called by the
+  /// workers. Returns NULL when the server quits.
+  Connection* nextRequest();
+
+  /// give a connection whose request was answered back to start()
+  void answered(Connection *connection);
+
+  /// stop accepting connections and requests
+  void quit();
+
+  /// the number of threads serving clients
+  uint workers() const {return workers_;}
+
   /// tell a proxy where the server is running
   void announceYourselfToProxy() const;
 
@@ -138,6 +278,9 @@ public:
 
   LogFile& log() {return log_;}
 
+  /// the retrieval engine, e.g. for benchmarks running it in-process
+  Retriever& retriever() {return retriever_;}
+
   /// initialize all components
   void initialize();
 
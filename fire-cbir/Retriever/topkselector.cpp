@@ -0,0 +1,101 @@
+/*
+ This file is part of the FIRE -- Flexible Image Retrieval System
+
+ FIRE is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ FIRE is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with FIRE; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <algorithm>
+#include <functional>
+#include "topkselector.hpp"
+
+using namespace std;
+
+TopKSelector::TopKSelector(uint k) : k_(k), heap_() {
+  heap_.reserve(k_);
+}
+
+void TopKSelector::reset(uint k) {
+  k_=k;
+  heap_.clear();
+  heap_.reserve(k_);
+}
+
+// greater<> makes this a min-heap, i.e. the worst kept result is in heap_[0]
+void TopKSelector::push(const ResultPair& candidate) {
+  heap_.push_back(candidate);
+  push_heap(heap_.begin(), heap_.end(), greater<ResultPair>());
+}
+
+void TopKSelector::replaceWorst(const ResultPair& candidate) {
+  pop_heap(heap_.begin(), heap_.end(), greater<ResultPair>());
+  heap_.back()=candidate;
+  push_heap(heap_.begin(), heap_.end(), greater<ResultPair>());
+}
+
+void TopKSelector::merge(const TopKSelector& other) {
+  for(uint i=0;i<other.heap_.size();++i) {
+    add(other.heap_[i]);
+  }
+}
+
+void TopKSelector::results(vector<ResultPair>& results) const {
+  results=heap_;
+  sort(results.rbegin(), results.rend());
+}
+
+void selectTopK(const vector<double>& scores, uint k, vector<ResultPair>& results) {
+  long N=scores.size();
+  if(long(k)>N) k=N;
+  TopKSelector best(k);
+
+#pragma omp parallel
+  {
+    TopKSelector local(k);
+#pragma omp for schedule(static) nowait
+    for(long i=0;i<N;++i) {
+      local.add(scores[i], i);
+    }
+#pragma omp critical
+    best.merge(local);
+  }
+  best.results(results);
+}
+
+void selectTopK(const vector<double>& scores, const vector<uint>& candidates, uint k, vector<ResultPair>& results, vector<uint>* rejected) {
+  long N=candidates.size();
+  if(long(k)>N) k=N;
+  TopKSelector best(k);
+
+#pragma omp parallel
+  {
+    TopKSelector local(k);
+#pragma omp for schedule(static) nowait
+    for(long i=0;i<N;++i) {
+      local.add(scores[candidates[i]], candidates[i]);
+    }
+#pragma omp critical
+    best.merge(local);
+  }
+  best.results(results);
+
+  if(rejected) {
+    // as the image indices are unique, everything worse than the worst
+    // kept result has been rejected
+    for(long i=0;i<N;++i) {
+      if(best.size()==0 || ResultPair(scores[candidates[i]], candidates[i]) < best.worst()) {
+        rejected->push_back(candidates[i]);
+      }
+    }
+  }
+}
@@ -0,0 +1,101 @@
+/*
+ This file is part of the FIRE -- Flexible Image Retrieval System
+
+ FIRE is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ FIRE is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with FIRE; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __topkselector_hpp__
+#define __topkselector_hpp__
+
+#include <vector>
+#include <utility>
+#include "diag.hpp"
+
+/// a score together with the index of the database image it belongs to
+typedef ::std::pair<double,uint> ResultPair;
+
+/** TopKSelector: keeps the k best ResultPairs of a stream of
+    candidates in a bounded min-heap.
+
+    "Best" uses the same ordering as sort(results.rbegin(),
+    results.rend()), which was used throughout FIRE to rank the
+    results, i.e. higher scores first and for equal scores the higher
+    image index first. Thus, results() returns exactly the first k
+    entries of the completely sorted list, but only costs O(N log k)
+    instead of O(N log N) and never holds more than k entries.
+
+    Several selectors (e.g. one per OpenMP thread) can be combined
+    using merge().
+ */
+class TopKSelector {
+private:
+  /// how many results are kept at most
+  uint k_;
+
+  /// the heap, the worst of the kept results is on top
+  ::std::vector<ResultPair> heap_;
+
+public:
+  /// constructor, k is the number of results to be kept
+  TopKSelector(uint k=0);
+
+  /// forget all results seen so far and set the number of results to keep
+  void reset(uint k);
+
+  /// offer a candidate to the selector
+  void add(const ResultPair& candidate) {
+    if(heap_.size()<k_) {
+      push(candidate);
+    } else if(k_>0 && heap_[0]<candidate) {
+      replaceWorst(candidate);
+    }
+  }
+
+  /// offer a candidate to the selector
+  void add(double score, uint idx) {
+    add(ResultPair(score,idx));
+  }
+
+  /// offer all candidates of another selector to this one
+  void merge(const TopKSelector& other);
+
+  /// how many results are currently kept
+  uint size() const {return heap_.size();}
+
+  /// how many results are kept at most
+  uint k() const {return k_;}
+
+  /// the worst of the kept results. only valid if size()>0
+  const ResultPair& worst() const {return heap_[0];}
+
+  /// write the kept results to results, best first. The selector is
+  /// not changed.
+  void results(::std::vector<ResultPair>& results) const;
+
+private:
+  void push(const ResultPair& candidate);
+  void replaceWorst(const ResultPair& candidate);
+};
+
+/// select the k best entries of scores (the index in scores is the
+/// image index) and write them best first to results. This is done
+/// in parallel if OpenMP is available.
+void selectTopK(const ::std::vector<double>& scores, uint k, ::std::vector<ResultPair>& results);
+
+/// as above, but only the images listed in candidates are taken into
+/// account. The candidates that are not selected are appended to
+/// rejected, if it is given.
+void selectTopK(const ::std::vector<double>& scores, const ::std::vector<uint>& candidates, uint k, ::std::vector<ResultPair>& results, ::std::vector<uint>* rejected=NULL);
+
+#endif